@@ -0,0 +1,1047 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BenchmarkSubsystem.h"
+#include "MCUECharacter.h"
+#include "Camera/CameraComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Dom/JsonObject.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Item/DroppedItemSubsystem.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Projectile/ProjectileSubsystem.h"
+#include "RenderCore.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Wieldable/Wieldable.h"
+#include "World/VoxelWorldRenderer.h"
+#include "World/VoxelWorldSubsystem.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMCUEBenchmark, Log, All);
+
+//////////////////////////////////////////////////////////////////////////
+// FBenchmarkScenario
+
+void FBenchmarkScenario::StartMining(AMCUECharacter& Character)
+{
+	Character.OnHit();
+}
+
+void FBenchmarkScenario::StopMining(AMCUECharacter& Character)
+{
+	Character.EndHit();
+}
+
+void FBenchmarkScenario::CheckForBlocks(AMCUECharacter& Character)
+{
+	Character.CheckForBlocks();
+}
+
+void FBenchmarkScenario::Throw(AMCUECharacter& Character)
+{
+	Character.Throw();
+}
+
+void FBenchmarkScenario::ResetInventory(AMCUECharacter& Character)
+{
+	Character.Inventory = FInventory();
+	Character.CurrentInventorySlots = 0;
+	Character.UpdateWieldedItem();
+}
+
+bool FBenchmarkScenario::HasTargetBlock(const AMCUECharacter& Character)
+{
+	return Character.bHasTargetBlock;
+}
+
+void FBenchmarkScenario::Aim(AMCUECharacter& Character, const FRotator& Rotation)
+{
+	if (AController* Controller = Character.GetController())
+	{
+		Controller->SetControlRotation(Rotation);
+	}
+	Character.FirstPersonCameraComponent->SetWorldRotation(Rotation);
+}
+
+FIntVector FBenchmarkScenario::GetFeetBlock(const UVoxelWorldSubsystem& VoxelWorld, const AMCUECharacter& Character)
+{
+	const float HalfHeight = Character.GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	return VoxelWorld.WorldToBlock(Character.GetActorLocation() - FVector(0.0f, 0.0f, HalfHeight - 1.0f));
+}
+
+namespace
+{
+	//scenarios write blocks through this so the world can be put back the way it was afterwards, the world may be saved
+	class FBlockWriter
+	{
+	public:
+		bool Write(UVoxelWorldSubsystem& VoxelWorld, const FIntVector& BlockCoord, FBlockID Block)
+		{
+			if (!OriginalBlocks.Contains(BlockCoord))
+			{
+				OriginalBlocks.Add(BlockCoord, VoxelWorld.GetBlock(BlockCoord));
+			}
+			return VoxelWorld.SetBlock(BlockCoord, Block);
+		}
+
+		void Restore(UVoxelWorldSubsystem& VoxelWorld)
+		{
+			for (const TPair<FIntVector, FBlockID>& Original : OriginalBlocks)
+			{
+				VoxelWorld.SetBlock(Original.Key, Original.Value);
+			}
+			OriginalBlocks.Empty();
+		}
+
+	private:
+		TMap<FIntVector, FBlockID> OriginalBlocks;
+	};
+
+	//places blocks in front of the character at a steady rate, pillar by pillar, so sections fill up and remesh
+	class FBlockPlacementScenario : public FBenchmarkScenario
+	{
+	public:
+		FBlockPlacementScenario(int32 InNumBlocks, float Seconds)
+			: NumBlocks(InNumBlocks)
+			, BlocksPerSecond(InNumBlocks / FMath::Max(Seconds, 1.0f))
+		{
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("BlockPlacement"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Corner = GetFeetBlock(VoxelWorld, Character) + FIntVector(3, -Side / 2, 0);
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			Budget += BlocksPerSecond * DeltaTime;
+			for (; Budget >= 1.0f && NextBlock < NumBlocks; Budget -= 1.0f)
+			{
+				const int32 Block = NextBlock++;
+				const FIntVector Coord = Corner + FIntVector(Block % Side, (Block / Side) % Side, Block / (Side * Side));
+				NumPlaced += Blocks.Write(VoxelWorld, Coord, (Block & 1) ? EBlockID::Cobble : EBlockID::Rock) ? 1 : 0;
+			}
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Blocks.Restore(VoxelWorld);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			OutCounters.Emplace(TEXT("blocks_placed"), NumPlaced);
+			OutCounters.Emplace(TEXT("blocks_per_second"), BlocksPerSecond);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumPlaced = 0;
+		}
+
+	private:
+		static constexpr int32 Side = 32;
+
+		int32 NumBlocks;
+		float BlocksPerSecond;
+
+		FIntVector Corner = FIntVector::ZeroValue;
+		int32 NextBlock = 0;
+		float Budget = 0.0f;
+		int32 NumPlaced = 0;
+
+		FBlockWriter Blocks;
+	};
+
+	//turns the character on the spot among pillars and retargets after every step of the turn
+	class FTargetSweepScenario : public FBenchmarkScenario
+	{
+	public:
+		explicit FTargetSweepScenario(int32 InRaysPerFrame)
+			: RaysPerFrame(FMath::Max(InRaysPerFrame, 1))
+		{
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("TargetSweep"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			//a checkered ring of pillars just inside reach, so about half the rays hit something
+			const FIntVector Feet = GetFeetBlock(VoxelWorld, Character);
+			for (int32 Y = -3; Y <= 3; ++Y)
+			{
+				for (int32 X = -3; X <= 3; ++X)
+				{
+					if (FMath::Max(FMath::Abs(X), FMath::Abs(Y)) < 2 || ((X + Y) & 1) != 0)
+					{
+						continue;
+					}
+					for (int32 Z = 0; Z < 3; ++Z)
+					{
+						Blocks.Write(VoxelWorld, Feet + FIntVector(X, Y, Z), EBlockID::Rock);
+					}
+				}
+			}
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < RaysPerFrame; ++i)
+			{
+				Yaw = FRotator::ClampAxis(Yaw + 360.0f / RaysPerFrame + 0.37f);
+				Aim(Character, FRotator(FMath::Sin(FMath::DegreesToRadians(Yaw * 3.0f)) * 30.0f, Yaw, 0.0f));
+				CheckForBlocks(Character);
+				NumHits += HasTargetBlock(Character) ? 1 : 0;
+			}
+			TraceSeconds += FPlatformTime::Seconds() - StartTime;
+			NumRays += RaysPerFrame;
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Blocks.Restore(VoxelWorld);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			OutCounters.Emplace(TEXT("rays"), NumRays);
+			OutCounters.Emplace(TEXT("hit_fraction"), NumRays > 0 ? (double)NumHits / NumRays : 0.0);
+			OutCounters.Emplace(TEXT("check_for_blocks_us_mean"), NumRays > 0 ? TraceSeconds * 1.0e6 / NumRays : 0.0);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumRays = 0;
+			NumHits = 0;
+			TraceSeconds = 0.0;
+		}
+
+	private:
+		int32 RaysPerFrame;
+		float Yaw = 0.0f;
+
+		int64 NumRays = 0;
+		int64 NumHits = 0;
+		double TraceSeconds = 0.0;
+
+		FBlockWriter Blocks;
+	};
+
+	//holds the mining input on a block that grows back as soon as it breaks
+	class FMiningScenario : public FBenchmarkScenario
+	{
+	public:
+		virtual const TCHAR* GetName() const override { return TEXT("Mining"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			//at eye height two blocks ahead, with nothing in between
+			const FIntVector Feet = GetFeetBlock(VoxelWorld, Character);
+			Target = Feet + FIntVector(2, 0, 1);
+			Blocks.Write(VoxelWorld, Feet + FIntVector(1, 0, 1), EBlockID::Air);
+			Blocks.Write(VoxelWorld, Target, EBlockID::Grass);
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			if (VoxelWorld.GetBlock(Target) == EBlockID::Air)
+			{
+				++NumMined;
+				Blocks.Write(VoxelWorld, Target, EBlockID::Grass);
+			}
+
+			const FVector Eye = Character.GetPawnViewLocation();
+			Aim(Character, (VoxelWorld.GetBlockCenter(Target) - Eye).Rotation());
+			CheckForBlocks(Character);
+
+			if (!bMining && HasTargetBlock(Character))
+			{
+				StartMining(Character);
+				bMining = true;
+			}
+			Seconds += DeltaTime;
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			StopMining(Character);
+			Blocks.Restore(VoxelWorld);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			OutCounters.Emplace(TEXT("blocks_mined"), NumMined);
+			OutCounters.Emplace(TEXT("blocks_per_second"), Seconds > 0.0f ? NumMined / Seconds : 0.0);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumMined = 0;
+			Seconds = 0.0f;
+		}
+
+	private:
+		FIntVector Target = FIntVector::ZeroValue;
+		bool bMining = false;
+
+		int32 NumMined = 0;
+		float Seconds = 0.0f;
+
+		FBlockWriter Blocks;
+	};
+
+	//picks items up and throws them straight out again, so the inventory, the hud delegates and the dropped items all churn
+	class FInventoryChurnScenario : public FBenchmarkScenario
+	{
+	public:
+		explicit FInventoryChurnScenario(int32 InItemsPerFrame)
+			: ItemsPerFrame(FMath::Max(InItemsPerFrame, 1))
+		{
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("InventoryChurn"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			ResetInventory(Character);
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			//the item is only read from the class defaults, nothing has to be spawned for it
+			AWieldable* Pickup = GetMutableDefault<AWieldable>();
+			for (int32 i = 0; i < ItemsPerFrame; ++i)
+			{
+				NumAdded += Character.AddItemToInventory(Pickup) ? 1 : 0;
+				Throw(Character);
+				++NumThrown;
+			}
+
+			const UDroppedItemSubsystem* Drops = Character.GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+			NumDropped = Drops != nullptr ? Drops->GetItems().Num() : 0;
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			OutCounters.Emplace(TEXT("items_added"), NumAdded);
+			OutCounters.Emplace(TEXT("items_thrown"), NumThrown);
+			OutCounters.Emplace(TEXT("dropped_items_at_end"), NumDropped);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumAdded = 0;
+			NumThrown = 0;
+		}
+
+	private:
+		int32 ItemsPerFrame;
+
+		int32 NumAdded = 0;
+		int32 NumThrown = 0;
+		int32 NumDropped = 0;
+	};
+
+	//fires volleys from the character's eyes into a thick wall that grows back wherever it breaks
+	class FProjectileScenario : public FBenchmarkScenario
+	{
+	public:
+		explicit FProjectileScenario(int32 InProjectilesPerFrame)
+			: ProjectilesPerFrame(FMath::Max(InProjectilesPerFrame, 1))
+			, Random(0x5EED)
+		{
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("Projectiles"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Projectiles = Character.GetWorld()->GetSubsystem<UProjectileSubsystem>();
+
+			//the wall, and a floor under the whole range so the rounds bouncing back only land on blocks put back afterwards
+			const FIntVector Feet = GetFeetBlock(VoxelWorld, Character);
+			for (int32 Y = -8; Y < 8; ++Y)
+			{
+				for (int32 X = 1; X <= 10; ++X)
+				{
+					Blocks.Write(VoxelWorld, Feet + FIntVector(X, Y, -1), EBlockID::Rock);
+				}
+				for (int32 Z = 0; Z < 8; ++Z)
+				{
+					for (int32 X = 8; X <= 10; ++X)
+					{
+						WallCells.Add(Feet + FIntVector(X, Y, Z));
+						Blocks.Write(VoxelWorld, WallCells.Last(), EBlockID::Rock);
+					}
+				}
+			}
+			Target = VoxelWorld.GetBlockCenter(Feet + FIntVector(8, 0, 3));
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			UProjectileSubsystem* Subsystem = Projectiles.Get();
+			if (Subsystem == nullptr)
+			{
+				return;
+			}
+
+			for (const FIntVector& Cell : WallCells)
+			{
+				if (VoxelWorld.GetBlock(Cell) == EBlockID::Air)
+				{
+					Blocks.Write(VoxelWorld, Cell, EBlockID::Rock);
+					++NumRegrown;
+				}
+			}
+
+			const FVector Eye = Character.GetPawnViewLocation();
+			const FVector Aim = (Target - Eye).GetSafeNormal();
+			for (int32 i = 0; i < ProjectilesPerFrame; ++i)
+			{
+				NumFired += Subsystem->Fire(Eye, Random.VRandCone(Aim, FMath::DegreesToRadians(SpreadDegrees)), &Character) ? 1 : 0;
+			}
+			MaxInFlight = FMath::Max(MaxInFlight, Subsystem->GetProjectiles().Num());
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			if (UProjectileSubsystem* Subsystem = Projectiles.Get())
+			{
+				Subsystem->Clear();
+			}
+			Blocks.Restore(VoxelWorld);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			const UProjectileSubsystem* Subsystem = Projectiles.Get();
+			OutCounters.Emplace(TEXT("projectiles_fired"), NumFired);
+			OutCounters.Emplace(TEXT("projectiles_in_flight_max"), MaxInFlight);
+			OutCounters.Emplace(TEXT("impacts"), Subsystem != nullptr ? Subsystem->GetNumImpacts() - ImpactsAtReset : 0);
+			OutCounters.Emplace(TEXT("wall_blocks_regrown"), NumRegrown);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumFired = 0;
+			MaxInFlight = 0;
+			NumRegrown = 0;
+			ImpactsAtReset = Projectiles.IsValid() ? Projectiles->GetNumImpacts() : 0;
+		}
+
+	private:
+		static constexpr float SpreadDegrees = 3.0f;
+
+		int32 ProjectilesPerFrame;
+
+		//the same volleys every run
+		FRandomStream Random;
+
+		TWeakObjectPtr<UProjectileSubsystem> Projectiles;
+		TArray<FIntVector> WallCells;
+		FVector Target = FVector::ZeroVector;
+
+		int32 NumFired = 0;
+		int32 MaxInFlight = 0;
+		int32 NumRegrown = 0;
+		int32 ImpactsAtReset = 0;
+
+		FBlockWriter Blocks;
+	};
+
+	//blows a crater into the ground ahead of the character every so often and fills it back in on the next frame
+	class FExplosionScenario : public FBenchmarkScenario
+	{
+	public:
+		FExplosionScenario(float InRadius, float InInterval)
+			: Radius(FMath::Max(InRadius, 1.0f))
+			, Interval(FMath::Max(InInterval, 0.1f))
+		{
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("Explosions"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			//far enough ahead that the character stays on solid ground, half buried so most of the blast is in rock
+			const int32 Blocks = FMath::CeilToInt(Radius);
+			Center = VoxelWorld.GetBlockCenter(GetFeetBlock(VoxelWorld, Character) + FIntVector(Blocks + 4, 0, -Blocks / 2));
+			EditedHandle = VoxelWorld.OnRegionEdited().AddRaw(this, &FExplosionScenario::OnRegionEdited);
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			if (Crater.Num() > 0)
+			{
+				Restore(VoxelWorld);
+				return;
+			}
+
+			Budget += DeltaTime;
+			if (Budget < Interval)
+			{
+				return;
+			}
+			Budget = 0.0f;
+
+			bRecording = true;
+			const double StartTime = FPlatformTime::Seconds();
+			NumRemoved += VoxelWorld.CarveExplosion(Center, Radius, Power);
+			const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+			bRecording = false;
+
+			++NumExplosions;
+			TotalMilliseconds += Milliseconds;
+			MaxMilliseconds = FMath::Max(MaxMilliseconds, Milliseconds);
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Restore(VoxelWorld);
+			VoxelWorld.OnRegionEdited().Remove(EditedHandle);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			OutCounters.Emplace(TEXT("explosions"), NumExplosions);
+			OutCounters.Emplace(TEXT("explosion_radius"), Radius);
+			OutCounters.Emplace(TEXT("blocks_removed"), NumRemoved);
+			OutCounters.Emplace(TEXT("explosion_ms_avg"), NumExplosions > 0 ? TotalMilliseconds / NumExplosions : 0.0);
+			OutCounters.Emplace(TEXT("explosion_ms_max"), MaxMilliseconds);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumExplosions = 0;
+			NumRemoved = 0;
+			TotalMilliseconds = 0.0;
+			MaxMilliseconds = 0.0;
+		}
+
+	private:
+		//rock gives way out to about three quarters of the radius
+		static constexpr float Power = 250.0f;
+
+		void OnRegionEdited(const FVoxelRegionEdit& Edit)
+		{
+			if (bRecording)
+			{
+				Crater.Append(Edit.Changes);
+			}
+		}
+
+		void Restore(UVoxelWorldSubsystem& VoxelWorld)
+		{
+			if (Crater.Num() == 0)
+			{
+				return;
+			}
+
+			FIntVector Min = Crater[0].BlockCoord;
+			FIntVector Max = Crater[0].BlockCoord;
+			for (const FVoxelBlockChange& Change : Crater)
+			{
+				Min = FIntVector(FMath::Min(Min.X, Change.BlockCoord.X), FMath::Min(Min.Y, Change.BlockCoord.Y), FMath::Min(Min.Z, Change.BlockCoord.Z));
+				Max = FIntVector(FMath::Max(Max.X, Change.BlockCoord.X), FMath::Max(Max.Y, Change.BlockCoord.Y), FMath::Max(Max.Z, Change.BlockCoord.Z));
+			}
+
+			//bulk edits visit blocks in one fixed order, so the crater is put back by walking its changes in step
+			int32 Next = 0;
+			VoxelWorld.EditRegion(Min, Max, [this, &Next](const FIntVector& BlockCoord, FBlockID Block)
+			{
+				return Next < Crater.Num() && Crater[Next].BlockCoord == BlockCoord ? Crater[Next++].OldBlock : Block;
+			});
+			Crater.Reset();
+		}
+
+		float Radius;
+		float Interval;
+
+		FVector Center = FVector::ZeroVector;
+		FDelegateHandle EditedHandle;
+
+		//what the last explosion removed, until it is put back
+		TArray<FVoxelBlockChange> Crater;
+		bool bRecording = false;
+		float Budget = 0.0f;
+
+		int32 NumExplosions = 0;
+		int32 NumRemoved = 0;
+		double TotalMilliseconds = 0.0;
+		double MaxMilliseconds = 0.0;
+	};
+
+	//digs a pit ahead of the character layer by layer, so whole sections empty out and their components go back to the pool
+	//run once with mcue.PoolSectionComponents 0 and once with 1 to compare
+	class FDiggingScenario : public FBenchmarkScenario
+	{
+	public:
+		explicit FDiggingScenario(int32 InBlocksPerSecond)
+			: BlocksPerSecond((float)FMath::Max(InBlocksPerSecond, 1))
+		{
+		}
+
+		virtual ~FDiggingScenario()
+		{
+			FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGCHandle);
+			FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGCHandle);
+		}
+
+		virtual const TCHAR* GetName() const override { return TEXT("Digging"); }
+
+		virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			//the pit starts a few blocks out along whichever axis the character faces most, so it never digs under its feet
+			const FVector Forward = Character.GetActorForwardVector();
+			const bool bAlongX = FMath::Abs(Forward.X) >= FMath::Abs(Forward.Y);
+			const int32 Sign = (bAlongX ? Forward.X : Forward.Y) >= 0.0f ? 1 : -1;
+			Ahead = bAlongX ? FIntVector(Sign, 0, 0) : FIntVector(0, Sign, 0);
+			Across = bAlongX ? FIntVector(0, 1, 0) : FIntVector(1, 0, 0);
+			Corner = GetFeetBlock(VoxelWorld, Character) + Ahead * 3 - Across * (Side / 2) - FIntVector(0, 0, 1);
+
+			Renderer = VoxelWorld.GetRenderer();
+
+			PreGCHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddRaw(this, &FDiggingScenario::OnPreGC);
+			PostGCHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FDiggingScenario::OnPostGC);
+		}
+
+		virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) override
+		{
+			Budget += BlocksPerSecond * DeltaTime;
+			for (; Budget >= 1.0f; Budget -= 1.0f)
+			{
+				const int32 Block = NextBlock++;
+				const FIntVector Coord = Corner + Ahead * (Block % Side) + Across * ((Block / Side) % Side) - FIntVector(0, 0, Block / (Side * Side));
+				if (Coord.Z < 1)
+				{
+					break;
+				}
+				NumDug += Blocks.Write(VoxelWorld, Coord, EBlockID::Air) ? 1 : 0;
+			}
+		}
+
+		virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) override
+		{
+			Blocks.Restore(VoxelWorld);
+		}
+
+		virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const override
+		{
+			static const IConsoleVariable* PoolVar = IConsoleManager::Get().FindConsoleVariable(TEXT("mcue.PoolSectionComponents"));
+			const FSectionPoolStats Pool = Renderer.IsValid() ? Renderer->GetSectionPoolStats() : FSectionPoolStats();
+
+			OutCounters.Emplace(TEXT("blocks_dug"), NumDug);
+			OutCounters.Emplace(TEXT("blocks_per_second"), BlocksPerSecond);
+			OutCounters.Emplace(TEXT("section_pooling"), PoolVar != nullptr ? PoolVar->GetInt() : 0);
+			OutCounters.Emplace(TEXT("section_pool_hits"), Pool.Hits);
+			OutCounters.Emplace(TEXT("section_pool_misses"), Pool.Misses);
+			OutCounters.Emplace(TEXT("section_pool_destroyed"), Pool.Overflows);
+			OutCounters.Emplace(TEXT("garbage_collections"), NumGCs);
+			OutCounters.Emplace(TEXT("garbage_collection_ms"), GCSeconds * 1000.0);
+		}
+
+		virtual void ResetCounters() override
+		{
+			NumDug = 0;
+			NumGCs = 0;
+			GCSeconds = 0.0;
+			if (Renderer.IsValid())
+			{
+				Renderer->ResetSectionPoolStats();
+			}
+		}
+
+	private:
+		static constexpr int32 Side = 16;
+
+		void OnPreGC()
+		{
+			GCStartTime = FPlatformTime::Seconds();
+		}
+
+		void OnPostGC()
+		{
+			GCSeconds += FPlatformTime::Seconds() - GCStartTime;
+			++NumGCs;
+		}
+
+		float BlocksPerSecond;
+
+		FIntVector Corner = FIntVector::ZeroValue;
+		FIntVector Ahead = FIntVector::ZeroValue;
+		FIntVector Across = FIntVector::ZeroValue;
+		int32 NextBlock = 0;
+		float Budget = 0.0f;
+		int32 NumDug = 0;
+
+		TWeakObjectPtr<AVoxelWorldRenderer> Renderer;
+
+		FDelegateHandle PreGCHandle;
+		FDelegateHandle PostGCHandle;
+		double GCStartTime = 0.0;
+		double GCSeconds = 0.0;
+		int32 NumGCs = 0;
+
+		FBlockWriter Blocks;
+	};
+
+	const TCHAR* const ScenarioNames[] = { TEXT("BlockPlacement"), TEXT("TargetSweep"), TEXT("Mining"), TEXT("InventoryChurn"), TEXT("Projectiles"), TEXT("Explosions"), TEXT("Digging") };
+
+	//the suite only starts from the command line once, not again on every map the game travels to
+	bool bCommandLineConsumed = false;
+
+	//nearest rank percentile of sorted values
+	float GetPercentile(const TArray<float>& Sorted, float Percentile)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.0f;
+		}
+		const int32 Rank = FMath::CeilToInt(Percentile * Sorted.Num()) - 1;
+		return Sorted[FMath::Clamp(Rank, 0, Sorted.Num() - 1)];
+	}
+
+	TSharedRef<FJsonObject> MakeDistribution(TArray<float> Values)
+	{
+		Values.Sort();
+
+		double Sum = 0.0;
+		for (float Value : Values)
+		{
+			Sum += Value;
+		}
+
+		TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetNumberField(TEXT("mean"), Values.Num() > 0 ? Sum / Values.Num() : 0.0);
+		Object->SetNumberField(TEXT("p50"), GetPercentile(Values, 0.5f));
+		Object->SetNumberField(TEXT("p90"), GetPercentile(Values, 0.9f));
+		Object->SetNumberField(TEXT("p95"), GetPercentile(Values, 0.95f));
+		Object->SetNumberField(TEXT("p99"), GetPercentile(Values, 0.99f));
+		Object->SetNumberField(TEXT("max"), Values.Num() > 0 ? Values.Last() : 0.0f);
+		return Object;
+	}
+
+	//mcue.Benchmark
+	void RunBenchmark(const TArray<FString>& Args, UWorld* World)
+	{
+		UBenchmarkSubsystem* Benchmark = World != nullptr ? World->GetSubsystem<UBenchmarkSubsystem>() : nullptr;
+		if (Benchmark == nullptr || Benchmark->IsRunning())
+		{
+			UE_LOG(LogMCUEBenchmark, Warning, TEXT("mcue.Benchmark needs a game world with no benchmark running"));
+			return;
+		}
+
+		if (!Benchmark->RunScenarios(Args.Num() > 0 ? Args[0] : TEXT("All")))
+		{
+			TArray<FString> Names;
+			UBenchmarkSubsystem::GetScenarioNames(Names);
+			UE_LOG(LogMCUEBenchmark, Warning, TEXT("Unknown scenario, pick All or some of %s"), *FString::Join(Names, TEXT(",")));
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BenchmarkCommand(
+		TEXT("mcue.Benchmark"),
+		TEXT("Runs benchmark scenarios on the player's character and writes their frame times to Saved/Benchmarks. Args: [All|Scenario,Scenario...]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunBenchmark));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UBenchmarkSubsystem
+
+UBenchmarkSubsystem::UBenchmarkSubsystem()
+{
+	Phase = EPhase::Loading;
+	PhaseTime = 0.0f;
+	bAnyFailed = false;
+
+	ScenarioSeconds = 20.0f;
+	WarmupSeconds = 2.0f;
+	LoadTimeout = 60.0f;
+	NumPlacedBlocks = 8000;
+	SweepRaysPerFrame = 256;
+	ChurnItemsPerFrame = 8;
+	ProjectilesPerFrame = 128;
+	ExplosionRadius = 32.0f;
+	ExplosionInterval = 1.0f;
+	DigBlocksPerSecond = 400;
+}
+
+bool UBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FString Names;
+	if (!bCommandLineConsumed && FParse::Value(FCommandLine::Get(), TEXT("MCUEBenchmark="), Names))
+	{
+		bCommandLineConsumed = true;
+		if (!RunScenarios(Names))
+		{
+			UE_LOG(LogMCUEBenchmark, Error, TEXT("Unknown benchmark scenario in %s"), *Names);
+			if (FApp::IsUnattended())
+			{
+				FPlatformMisc::RequestExitWithStatus(false, 1);
+			}
+		}
+	}
+}
+
+void UBenchmarkSubsystem::Deinitialize()
+{
+	Scenarios.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBenchmarkSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject) && Scenarios.Num() > 0;
+}
+
+TStatId UBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+void UBenchmarkSubsystem::GetScenarioNames(TArray<FString>& OutNames)
+{
+	OutNames.Reset();
+	for (const TCHAR* Name : ScenarioNames)
+	{
+		OutNames.Add(Name);
+	}
+}
+
+TUniquePtr<FBenchmarkScenario> UBenchmarkSubsystem::MakeScenario(const FString& Name) const
+{
+	if (Name == TEXT("BlockPlacement"))
+	{
+		return MakeUnique<FBlockPlacementScenario>(NumPlacedBlocks, WarmupSeconds + ScenarioSeconds);
+	}
+	if (Name == TEXT("TargetSweep"))
+	{
+		return MakeUnique<FTargetSweepScenario>(SweepRaysPerFrame);
+	}
+	if (Name == TEXT("Mining"))
+	{
+		return MakeUnique<FMiningScenario>();
+	}
+	if (Name == TEXT("InventoryChurn"))
+	{
+		return MakeUnique<FInventoryChurnScenario>(ChurnItemsPerFrame);
+	}
+	if (Name == TEXT("Projectiles"))
+	{
+		return MakeUnique<FProjectileScenario>(ProjectilesPerFrame);
+	}
+	if (Name == TEXT("Explosions"))
+	{
+		return MakeUnique<FExplosionScenario>(ExplosionRadius, ExplosionInterval);
+	}
+	if (Name == TEXT("Digging"))
+	{
+		return MakeUnique<FDiggingScenario>(DigBlocksPerSecond);
+	}
+	return nullptr;
+}
+
+bool UBenchmarkSubsystem::RunScenarios(const FString& Names)
+{
+	TArray<FString> Requested;
+	if (Names.Equals(TEXT("All"), ESearchCase::IgnoreCase))
+	{
+		GetScenarioNames(Requested);
+	}
+	else
+	{
+		Names.ParseIntoArray(Requested, TEXT(","));
+	}
+
+	TArray<TUniquePtr<FBenchmarkScenario>> NewScenarios;
+	for (const FString& Name : Requested)
+	{
+		TUniquePtr<FBenchmarkScenario> Scenario = MakeScenario(Name.TrimStartAndEnd());
+		if (!Scenario.IsValid())
+		{
+			return false;
+		}
+		NewScenarios.Add(MoveTemp(Scenario));
+	}
+
+	if (NewScenarios.Num() == 0)
+	{
+		return false;
+	}
+
+	Scenarios = MoveTemp(NewScenarios);
+	Phase = EPhase::Loading;
+	PhaseTime = 0.0f;
+	bAnyFailed = false;
+	return true;
+}
+
+void UBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	if (Scenarios.Num() == 0)
+	{
+		return;
+	}
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	AMCUECharacter* Driven = Character.Get();
+	PhaseTime += DeltaTime;
+
+	if (Phase == EPhase::Loading)
+	{
+		//the character has to stand on loaded ground with nothing left to stream, or the loading shows up in the numbers
+		const APlayerController* Player = GetWorld()->GetFirstPlayerController();
+		Driven = Player != nullptr ? Cast<AMCUECharacter>(Player->GetPawn()) : nullptr;
+
+		const bool bReady = Driven != nullptr && VoxelWorld != nullptr
+			&& VoxelWorld->GetStreamingStats().NumPending == 0 && VoxelWorld->GetStreamingStats().NumInFlight == 0
+			&& VoxelWorld->FindChunk(UVoxelWorldSubsystem::BlockToChunk(VoxelWorld->WorldToBlock(Driven->GetActorLocation()))) != nullptr
+			&& FMath::IsNearlyZero(Driven->GetVelocity().Z);
+		if (!bReady)
+		{
+			if (PhaseTime > LoadTimeout)
+			{
+				FailScenario(TEXT("no character on loaded ground"));
+			}
+			return;
+		}
+
+		Character = Driven;
+		Scenarios[0]->Setup(*VoxelWorld, *Driven);
+		UE_LOG(LogMCUEBenchmark, Display, TEXT("Benchmark %s: warming up for %.1f s"), Scenarios[0]->GetName(), WarmupSeconds);
+
+		Phase = EPhase::WarmingUp;
+		PhaseTime = 0.0f;
+		return;
+	}
+
+	if (Driven == nullptr || VoxelWorld == nullptr)
+	{
+		FailScenario(TEXT("the character went away"));
+		return;
+	}
+
+	Scenarios[0]->Tick(*VoxelWorld, *Driven, DeltaTime);
+
+	if (Phase == EPhase::WarmingUp)
+	{
+		if (PhaseTime >= WarmupSeconds)
+		{
+			Scenarios[0]->ResetCounters();
+			FrameTimes.Reset();
+			GameThreadTimes.Reset();
+
+			Phase = EPhase::Measuring;
+			PhaseTime = 0.0f;
+		}
+		return;
+	}
+
+	//undilated wall clock time of the frame, and the game thread's share of the last one
+	FrameTimes.Add(FApp::GetDeltaTime() * 1000.0f);
+	GameThreadTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+
+	if (PhaseTime >= ScenarioSeconds)
+	{
+		WriteResults();
+		Scenarios[0]->Teardown(*VoxelWorld, *Driven);
+		NextScenario();
+	}
+}
+
+void UBenchmarkSubsystem::FailScenario(const TCHAR* Reason)
+{
+	UE_LOG(LogMCUEBenchmark, Error, TEXT("Benchmark %s failed: %s"), Scenarios[0]->GetName(), Reason);
+	bAnyFailed = true;
+	NextScenario();
+}
+
+void UBenchmarkSubsystem::WriteResults()
+{
+	const FBenchmarkScenario& Scenario = *Scenarios[0];
+	const FPlatformMemoryStats Memory = FPlatformMemory::GetStats();
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("scenario"), Scenario.GetName());
+	Result->SetStringField(TEXT("map"), GetWorld()->GetMapName());
+	Result->SetNumberField(TEXT("seconds"), PhaseTime);
+	Result->SetNumberField(TEXT("frames"), FrameTimes.Num());
+	Result->SetObjectField(TEXT("frame_ms"), MakeDistribution(FrameTimes));
+	Result->SetObjectField(TEXT("game_thread_ms"), MakeDistribution(GameThreadTimes));
+
+	TSharedRef<FJsonObject> MemoryObject = MakeShared<FJsonObject>();
+	MemoryObject->SetNumberField(TEXT("used_physical_mb"), Memory.UsedPhysical / (1024.0 * 1024.0));
+	MemoryObject->SetNumberField(TEXT("peak_used_physical_mb"), Memory.PeakUsedPhysical / (1024.0 * 1024.0));
+	MemoryObject->SetNumberField(TEXT("voxel_world_mb"), VoxelWorld != nullptr ? VoxelWorld->GetAllocatedSize() / (1024.0 * 1024.0) : 0.0);
+	Result->SetObjectField(TEXT("memory"), MemoryObject);
+
+	TArray<TPair<FString, double>> Counters;
+	Scenario.GetCounters(Counters);
+	TSharedRef<FJsonObject> CounterObject = MakeShared<FJsonObject>();
+	for (const TPair<FString, double>& Counter : Counters)
+	{
+		CounterObject->SetNumberField(Counter.Key, Counter.Value);
+	}
+	Result->SetObjectField(TEXT("counters"), CounterObject);
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Result, Writer);
+
+	FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"));
+	FParse::Value(FCommandLine::Get(), TEXT("MCUEBenchmarkDir="), Directory);
+	const FString Filename = FPaths::Combine(Directory, FString(Scenario.GetName()) + TEXT(".json"));
+
+	if (!FFileHelper::SaveStringToFile(Json, *Filename))
+	{
+		UE_LOG(LogMCUEBenchmark, Error, TEXT("Couldn't write %s"), *Filename);
+		bAnyFailed = true;
+	}
+
+	TArray<float> Sorted = FrameTimes;
+	Sorted.Sort();
+	UE_LOG(LogMCUEBenchmark, Display, TEXT("Benchmark %s: %d frames, %.2f ms median, %.2f ms p99, %.2f ms worst, written to %s"),
+		Scenario.GetName(), Sorted.Num(), GetPercentile(Sorted, 0.5f), GetPercentile(Sorted, 0.99f), Sorted.Num() > 0 ? Sorted.Last() : 0.0f, *Filename);
+}
+
+void UBenchmarkSubsystem::NextScenario()
+{
+	Scenarios.RemoveAt(0);
+	FrameTimes.Reset();
+	GameThreadTimes.Reset();
+
+	Phase = EPhase::Loading;
+	PhaseTime = 0.0f;
+
+	if (Scenarios.Num() > 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogMCUEBenchmark, Display, TEXT("Benchmarks done%s"), bAnyFailed ? TEXT(", some failed") : TEXT(""));
+
+	//a pipeline running the suite headless waits on the process, not on the log
+	if (bCommandLineConsumed && FApp::IsUnattended())
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bAnyFailed ? 1 : 0);
+	}
+}
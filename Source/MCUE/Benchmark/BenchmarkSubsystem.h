@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "BenchmarkSubsystem.generated.h"
+
+class AMCUECharacter;
+class UVoxelWorldSubsystem;
+
+//one workload the benchmark suite measures, driven through the character the way a player would drive it
+//scenarios are friends of the character so they can call its input handlers directly
+class FBenchmarkScenario
+{
+public:
+	virtual ~FBenchmarkScenario() {}
+
+	virtual const TCHAR* GetName() const = 0;
+
+	//builds whatever the scenario needs around the character, before the warm up
+	virtual void Setup(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) {}
+
+	//drives one frame of the workload, during the warm up as well as the measured run
+	virtual void Tick(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character, float DeltaTime) = 0;
+
+	virtual void Teardown(UVoxelWorldSubsystem& VoxelWorld, AMCUECharacter& Character) {}
+
+	//counters only the scenario knows about, reported next to the frame times
+	virtual void GetCounters(TArray<TPair<FString, double>>& OutCounters) const {}
+
+	//clears the counters at the end of the warm up
+	virtual void ResetCounters() {}
+
+protected:
+	//the character's private mining, targeting and inventory handlers
+	static void StartMining(AMCUECharacter& Character);
+	static void StopMining(AMCUECharacter& Character);
+	static void CheckForBlocks(AMCUECharacter& Character);
+	static void Throw(AMCUECharacter& Character);
+	static void ResetInventory(AMCUECharacter& Character);
+	static bool HasTargetBlock(const AMCUECharacter& Character);
+
+	//points the controller and the camera along the rotation, so targeting sees it without waiting for the camera manager
+	static void Aim(AMCUECharacter& Character, const FRotator& Rotation);
+
+	//the block the character's feet are in
+	static FIntVector GetFeetBlock(const UVoxelWorldSubsystem& VoxelWorld, const AMCUECharacter& Character);
+};
+
+//runs the benchmark scenarios one after another on the first player's character and writes one json file per scenario
+//to Saved/Benchmarks, with frame time and game thread time percentiles, memory and the scenario's own counters
+//started with -MCUEBenchmark=All (or a comma separated list of scenario names) on the command line, or mcue.Benchmark,
+//with -unattended the game exits when the suite is done, with a non zero code if a scenario couldn't run, e.g.
+//  UE4Editor MCUE.uproject -game -nullrhi -unattended -nosound -MCUEBenchmark=All
+UCLASS(config=Game)
+class MCUE_API UBenchmarkSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UBenchmarkSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//queues the named scenarios, All for every one, returns false if a name isn't known
+	bool RunScenarios(const FString& Names);
+
+	bool IsRunning() const { return Scenarios.Num() > 0; }
+
+	//names RunScenarios accepts
+	static void GetScenarioNames(TArray<FString>& OutNames);
+
+private:
+	enum class EPhase : uint8
+	{
+		//waiting for a character and for the chunks around it
+		Loading,
+		WarmingUp,
+		Measuring
+	};
+
+	TUniquePtr<FBenchmarkScenario> MakeScenario(const FString& Name) const;
+
+	//gives up on the scenario, e.g. when nothing spawned a character to drive
+	void FailScenario(const TCHAR* Reason);
+
+	//measured frames of the current scenario out to json
+	void WriteResults();
+
+	//moves on to the next scenario, or finishes the suite
+	void NextScenario();
+
+	TArray<TUniquePtr<FBenchmarkScenario>> Scenarios;
+
+	EPhase Phase;
+	float PhaseTime;
+
+	TWeakObjectPtr<AMCUECharacter> Character;
+
+	//per measured frame, in milliseconds
+	TArray<float> FrameTimes;
+	TArray<float> GameThreadTimes;
+
+	bool bAnyFailed;
+
+	//seconds every scenario is measured for, after the warm up
+	UPROPERTY(config)
+	float ScenarioSeconds;
+
+	UPROPERTY(config)
+	float WarmupSeconds;
+
+	//seconds to wait for a character and its chunks before the scenario fails
+	UPROPERTY(config)
+	float LoadTimeout;
+
+	//blocks written over the block placement run
+	UPROPERTY(config)
+	int32 NumPlacedBlocks;
+
+	//targeting rays cast every frame of the sweep
+	UPROPERTY(config)
+	int32 SweepRaysPerFrame;
+
+	//items picked up and thrown every frame of the inventory churn
+	UPROPERTY(config)
+	int32 ChurnItemsPerFrame;
+
+	//projectiles fired every frame of the projectile run
+	UPROPERTY(config)
+	int32 ProjectilesPerFrame;
+
+	//radius in blocks of the explosions, and seconds between them
+	UPROPERTY(config)
+	float ExplosionRadius;
+
+	UPROPERTY(config)
+	float ExplosionInterval;
+
+	//blocks removed every second of the digging run
+	UPROPERTY(config)
+	int32 DigBlocksPerSecond;
+};
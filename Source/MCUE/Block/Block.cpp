@@ -1,7 +1,8 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Block.h"
-#include "Materials/MaterialInstanceDynamic.h"
+#include "World/VoxelWorldRenderer.h"
+#include "World/VoxelWorldSubsystem.h"
 
 
 // Sets default values
@@ -9,52 +10,34 @@ ABlock::ABlock()
 {
 	SM_Block = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Bloxk"));
 
-	Resistance = 20.0f;
-	BreakingStage = 0.0f;
-	MinimumMaterial = 0;
+	BlockID = EBlockID::Grass;
 }
 
 // Called when the game starts or when spawned
 void ABlock::BeginPlay()
 {
 	Super::BeginPlay();
-	
-}
-
-void ABlock::Break()
-{
-	++BreakingStage;
-
-	float CrackingValue = 1.0f - (BreakingStage / 5.0f);
-
-	UMaterialInstanceDynamic* MatInstance = SM_Block->CreateDynamicMaterialInstance(0);
-
-	if (MatInstance != nullptr)
-	{
-		MatInstance->SetScalarParameterValue(FName("CrackingValue"), CrackingValue);
-	}
 
-	if (BreakingStage == 5.0f)
+	//move this block into the chunk data, the chunk mesh draws and collides it from now on
+	//a saved chunk already has it, or whatever replaced it since
+	if (UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>())
 	{
-		OnBroken(true);
-	}
-}
-
-void ABlock::ResetBlock()
-{
-	BreakingStage = 0.0f;
+		VoxelWorld->PlaceLevelBlock(GetBlockCoord(), BlockID);
 
-	UMaterialInstanceDynamic* MatInstance = SM_Block->CreateDynamicMaterialInstance(0);
+		if (AVoxelWorldRenderer* Renderer = VoxelWorld->GetRenderer())
+		{
+			Renderer->SetDefaultBlockMaterial(BlockID, SM_Block->GetMaterial(0));
+		}
 
-	if (MatInstance != nullptr)
-	{
-		MatInstance->SetScalarParameterValue(FName("CrackingValue"), 1.0f);
+		Destroy();
 	}
 }
 
-void ABlock::OnBroken(bool HasRequiredPickaxe)
+FIntVector ABlock::GetBlockCoord() const
 {
-	Destroy();
-}
-
+	//use the bounds centre so the result doesn't depend on where the mesh pivot is
+	const FVector Center = GetComponentsBoundingBox().GetCenter();
 
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	return VoxelWorld != nullptr ? VoxelWorld->WorldToBlock(Center) : FIntVector::ZeroValue;
+}
@@ -4,8 +4,10 @@
 
 #include "Engine.h"
 #include "GameFramework/Actor.h"
+#include "World/BlockTypes.h"
 #include "Block.generated.h"
 
+//a block placed by hand in a level, it writes itself into the chunk data on begin play and then goes away
 UCLASS()
 class MCUE_API ABlock : public AActor
 {
@@ -22,19 +24,15 @@ public:
 	UPROPERTY(EditDefaultsOnly)
 	UStaticMeshComponent* SM_Block;
 
-	uint8 MinimumMaterial;
-
+	//the block type this actor represents, resistance and minimum material are looked up by it
+	//as wide as FBlockID, which UPROPERTY can't take by name
 	UPROPERTY(EditDefaultsOnly)
-	float Resistance;
-
-	UPROPERTY(BlueprintReadWrite)
-	float BreakingStage;
+	uint16 BlockID;
 
-	//called every time we want to break the black down further
-	void Break();
+	float GetResistance() const { return FBlockRegistry::Get(BlockID).Resistance; }
 
-	void ResetBlock();
+	uint8 GetMinimumMaterial() const { return FBlockRegistry::Get(BlockID).MinimumMaterial; }
 
-	//called once the block has hit the final breaking stage
-	void OnBroken(bool HasRequiredPickaxe);
+	//the cell this block occupies in the voxel world
+	FIntVector GetBlockCoord() const;
 };
@@ -0,0 +1,325 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CraftingIndex.h"
+#include "CraftingRecipe.h"
+#include "Misc/Crc.h"
+
+FCraftingPattern FCraftingPattern::MakeShaped(const FItemID* Grid, int32 GridWidth, int32 GridHeight)
+{
+	int32 MinX = GridWidth;
+	int32 MinY = GridHeight;
+	int32 MaxX = -1;
+	int32 MaxY = -1;
+	for (int32 Y = 0; Y < GridHeight; ++Y)
+	{
+		for (int32 X = 0; X < GridWidth; ++X)
+		{
+			if (Grid[X + Y * GridWidth] != EItemID::None)
+			{
+				MinX = FMath::Min(MinX, X);
+				MinY = FMath::Min(MinY, Y);
+				MaxX = FMath::Max(MaxX, X);
+				MaxY = FMath::Max(MaxY, Y);
+			}
+		}
+	}
+
+	FCraftingPattern Pattern;
+	Pattern.Width = 0;
+	Pattern.Height = 0;
+	if (MaxX >= 0)
+	{
+		Pattern.Width = (uint8)(MaxX - MinX + 1);
+		Pattern.Height = (uint8)(MaxY - MinY + 1);
+		for (int32 Y = MinY; Y <= MaxY; ++Y)
+		{
+			for (int32 X = MinX; X <= MaxX; ++X)
+			{
+				Pattern.Items.Add(Grid[X + Y * GridWidth]);
+			}
+		}
+	}
+	Pattern.UpdateHash();
+	return Pattern;
+}
+
+FCraftingPattern FCraftingPattern::MakeShapeless(const FItemID* Grid, int32 NumCells)
+{
+	FCraftingPattern Pattern;
+	Pattern.Width = 0;
+	Pattern.Height = 0;
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		if (Grid[Cell] != EItemID::None)
+		{
+			Pattern.Items.Add(Grid[Cell]);
+		}
+	}
+	Pattern.Items.Sort();
+	Pattern.UpdateHash();
+	return Pattern;
+}
+
+FCraftingPattern FCraftingPattern::Mirrored() const
+{
+	FCraftingPattern Pattern = *this;
+	for (int32 Y = 0; Y < Height; ++Y)
+	{
+		for (int32 X = 0; X < Width; ++X)
+		{
+			Pattern.Items[X + Y * Width] = Items[(Width - 1 - X) + Y * Width];
+		}
+	}
+	Pattern.UpdateHash();
+	return Pattern;
+}
+
+void FCraftingPattern::UpdateHash()
+{
+	Hash = FCrc::MemCrc32(Items.GetData(), Items.Num() * sizeof(FItemID), Width | (Height << 8));
+}
+
+bool FCraftingIndex::Add(FName Name, const FCraftingRecipe& Row)
+{
+	if (Row.ResultItemID <= EItemID::None || Row.ResultItemID > MAX_uint16 || Row.Ingredients.Num() == 0 || Row.Ingredients.Num() > GridCells)
+	{
+		return false;
+	}
+
+	FItemID Grid[GridCells];
+	for (int32 Cell = 0; Cell < Row.Ingredients.Num(); ++Cell)
+	{
+		if (Row.Ingredients[Cell] < EItemID::None || Row.Ingredients[Cell] > MAX_uint16)
+		{
+			return false;
+		}
+		Grid[Cell] = (FItemID)Row.Ingredients[Cell];
+	}
+
+	FCraftingPattern Pattern;
+	if (Row.bShaped)
+	{
+		const int32 Width = FMath::Clamp(Row.Width, 1, GridSize);
+		const int32 Height = FMath::DivideAndRoundUp(Row.Ingredients.Num(), Width);
+		if (Height > GridSize)
+		{
+			return false;
+		}
+
+		//a short last row is padded with empty cells
+		for (int32 Cell = Row.Ingredients.Num(); Cell < Width * Height; ++Cell)
+		{
+			Grid[Cell] = EItemID::None;
+		}
+		Pattern = FCraftingPattern::MakeShaped(Grid, Width, Height);
+	}
+	else
+	{
+		Pattern = FCraftingPattern::MakeShapeless(Grid, Row.Ingredients.Num());
+	}
+
+	if (Pattern.IsEmpty())
+	{
+		return false;
+	}
+
+	FRecipe Recipe;
+	Recipe.Name = Name;
+	Recipe.Result = (FItemID)Row.ResultItemID;
+	Recipe.ResultCount = (uint8)FMath::Clamp(Row.ResultCount, 1, (int32)MAX_uint8);
+
+	//the same pattern means the same ingredients, so a replacement only changes what comes out
+	TMap<FCraftingPattern, int32>& Patterns = Row.bShaped ? ShapedRecipes : ShapelessRecipes;
+	if (const int32* Existing = Patterns.Find(Pattern))
+	{
+		FRecipe& Replaced = Recipes[*Existing];
+		Replaced.Name = Recipe.Name;
+		Replaced.Result = Recipe.Result;
+		Replaced.ResultCount = Recipe.ResultCount;
+		return true;
+	}
+
+	for (FItemID Item : Pattern.Items)
+	{
+		if (Item == EItemID::None)
+		{
+			continue;
+		}
+
+		TPair<FItemID, int32>* Existing = Recipe.Ingredients.FindByPredicate([Item](const TPair<FItemID, int32>& Ingredient) { return Ingredient.Key == Item; });
+		if (Existing != nullptr)
+		{
+			++Existing->Value;
+		}
+		else
+		{
+			Recipe.Ingredients.Emplace(Item, 1);
+		}
+	}
+
+	const int32 RecipeIndex = Recipes.Add(MoveTemp(Recipe));
+	for (const TPair<FItemID, int32>& Ingredient : Recipes[RecipeIndex].Ingredients)
+	{
+		RecipesByIngredient.FindOrAdd(Ingredient.Key).Add(RecipeIndex);
+	}
+
+	Patterns.Add(Pattern, RecipeIndex);
+	if (Row.bShaped)
+	{
+		MirroredRecipes.Add(Pattern.Mirrored(), RecipeIndex);
+	}
+	return true;
+}
+
+int32 FCraftingIndex::Find(const FItemID* Grid) const
+{
+	const FCraftingPattern Shaped = FCraftingPattern::MakeShaped(Grid, GridSize, GridSize);
+	if (Shaped.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	//a recipe written for the mirror image wins over the flipped copy of another one
+	if (const int32* RecipeIndex = ShapedRecipes.Find(Shaped))
+	{
+		return *RecipeIndex;
+	}
+	if (const int32* RecipeIndex = MirroredRecipes.Find(Shaped))
+	{
+		return *RecipeIndex;
+	}
+
+	const int32* RecipeIndex = ShapelessRecipes.Find(FCraftingPattern::MakeShapeless(Grid, GridCells));
+	return RecipeIndex != nullptr ? *RecipeIndex : INDEX_NONE;
+}
+
+int32 FCraftingIndex::GetRequiredCount(const FRecipe& Recipe, FItemID ItemID)
+{
+	for (const TPair<FItemID, int32>& Ingredient : Recipe.Ingredients)
+	{
+		if (Ingredient.Key == ItemID)
+		{
+			return Ingredient.Value;
+		}
+	}
+	return 0;
+}
+
+const TArray<int32>& FCraftingIndex::GetRecipesUsing(FItemID ItemID) const
+{
+	static const TArray<int32> NoRecipes;
+	const TArray<int32>* Using = RecipesByIngredient.Find(ItemID);
+	return Using != nullptr ? *Using : NoRecipes;
+}
+
+SIZE_T FCraftingIndex::GetAllocatedSize() const
+{
+	SIZE_T Size = Recipes.GetAllocatedSize() + ShapedRecipes.GetAllocatedSize() + MirroredRecipes.GetAllocatedSize() + ShapelessRecipes.GetAllocatedSize() + RecipesByIngredient.GetAllocatedSize();
+	for (const TPair<FItemID, TArray<int32>>& Pair : RecipesByIngredient)
+	{
+		Size += Pair.Value.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FCraftableRecipes::FCraftableRecipes()
+	: BuiltFor(nullptr)
+	, InventoryRevision(0)
+{
+}
+
+void FCraftableRecipes::Update(const FCraftingIndex& Index, const FInventory& Inventory)
+{
+	//a different index means starting over from nothing
+	if (BuiltFor != &Index || NumCovered.Num() != Index.Num())
+	{
+		BuiltFor = &Index;
+		ItemCounts.Reset();
+		NumCovered.Init(0, Index.Num());
+		CraftablePositions.Init(INDEX_NONE, Index.Num());
+		Craftable.Reset();
+	}
+	else if (Inventory.GetRevision() == InventoryRevision)
+	{
+		return;
+	}
+	InventoryRevision = Inventory.GetRevision();
+
+	TMap<FItemID, int32, TInlineSetAllocator<FInventory::NumSlots>> NewCounts;
+	for (int32 Slot = 0; Slot < FInventory::NumSlots; ++Slot)
+	{
+		const FItemStack& Stack = Inventory.GetSlot(Slot);
+		if (!Stack.IsEmpty())
+		{
+			NewCounts.FindOrAdd(Stack.ItemID) += Stack.Count;
+		}
+	}
+
+	//items that went away entirely first, then everything the inventory holds now
+	TArray<FItemID, TInlineAllocator<FInventory::NumSlots>> Gone;
+	for (const TPair<FItemID, int32>& Pair : ItemCounts)
+	{
+		if (!NewCounts.Contains(Pair.Key))
+		{
+			Gone.Add(Pair.Key);
+		}
+	}
+	for (FItemID ItemID : Gone)
+	{
+		SetItemCount(Index, ItemID, 0);
+	}
+	for (const TPair<FItemID, int32>& Pair : NewCounts)
+	{
+		SetItemCount(Index, Pair.Key, Pair.Value);
+	}
+}
+
+void FCraftableRecipes::SetItemCount(const FCraftingIndex& Index, FItemID ItemID, int32 NewCount)
+{
+	const int32* Existing = ItemCounts.Find(ItemID);
+	const int32 OldCount = Existing != nullptr ? *Existing : 0;
+	if (NewCount == OldCount)
+	{
+		return;
+	}
+
+	if (NewCount > 0)
+	{
+		ItemCounts.Add(ItemID, NewCount);
+	}
+	else
+	{
+		ItemCounts.Remove(ItemID);
+	}
+
+	for (int32 RecipeIndex : Index.GetRecipesUsing(ItemID))
+	{
+		const FCraftingIndex::FRecipe& Recipe = Index.GetRecipe(RecipeIndex);
+		const int32 Required = FCraftingIndex::GetRequiredCount(Recipe, ItemID);
+
+		const bool bWasCovered = OldCount >= Required;
+		const bool bIsCovered = NewCount >= Required;
+		if (bWasCovered == bIsCovered)
+		{
+			continue;
+		}
+
+		NumCovered[RecipeIndex] += bIsCovered ? 1 : -1;
+
+		const bool bCraftable = NumCovered[RecipeIndex] == Recipe.Ingredients.Num();
+		int32& Position = CraftablePositions[RecipeIndex];
+		if (bCraftable && Position == INDEX_NONE)
+		{
+			Position = Craftable.Add(RecipeIndex);
+		}
+		else if (!bCraftable && Position != INDEX_NONE)
+		{
+			//swap the last entry into the gap so removal stays constant time
+			const int32 Last = Craftable.Last();
+			Craftable[Position] = Last;
+			CraftablePositions[Last] = Position;
+			Craftable.Pop(false);
+			Position = INDEX_NONE;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemStack.h"
+
+struct FCraftingRecipe;
+
+//a crafting grid reduced to what matters for matching, used as the key recipes are looked up by
+//shaped patterns are trimmed to the bounds of their non empty cells, shapeless ones are the sorted list of their items
+struct MCUE_API FCraftingPattern
+{
+	//0 by 0 for shapeless patterns
+	uint8 Width;
+	uint8 Height;
+
+	TArray<FItemID, TInlineAllocator<9>> Items;
+
+	uint32 Hash;
+
+	//Grid is GridWidth cells per row, returns an empty pattern if every cell is empty
+	static FCraftingPattern MakeShaped(const FItemID* Grid, int32 GridWidth, int32 GridHeight);
+	static FCraftingPattern MakeShapeless(const FItemID* Grid, int32 NumCells);
+
+	//the same shape flipped left to right
+	FCraftingPattern Mirrored() const;
+
+	bool IsEmpty() const { return Items.Num() == 0; }
+
+	bool operator==(const FCraftingPattern& Other) const { return Hash == Other.Hash && Width == Other.Width && Height == Other.Height && Items == Other.Items; }
+
+	friend uint32 GetTypeHash(const FCraftingPattern& Pattern) { return Pattern.Hash; }
+
+private:
+	void UpdateHash();
+};
+
+//every known recipe, looked up by the hash of the normalised grid instead of by trying each one
+//also knows which recipes use each item, so the craftable set can be kept up to date one item at a time
+class MCUE_API FCraftingIndex
+{
+public:
+	//the crafting grid is always this size, smaller recipes fit anywhere on it
+	static constexpr int32 GridSize = 3;
+	static constexpr int32 GridCells = GridSize * GridSize;
+
+	struct FRecipe
+	{
+		FName Name;
+
+		FItemID Result;
+		uint8 ResultCount;
+
+		//each distinct ingredient with how many of it one craft uses
+		TArray<TPair<FItemID, int32>, TInlineAllocator<GridCells>> Ingredients;
+	};
+
+	//false if the row is malformed, a later recipe with the same pattern replaces an earlier one
+	bool Add(FName Name, const FCraftingRecipe& Row);
+
+	//recipe matching the grid, GridCells ids row by row, or INDEX_NONE
+	int32 Find(const FItemID* Grid) const;
+
+	int32 Num() const { return Recipes.Num(); }
+
+	const FRecipe& GetRecipe(int32 RecipeIndex) const { return Recipes[RecipeIndex]; }
+
+	//how many of the item one craft of the recipe uses
+	static int32 GetRequiredCount(const FRecipe& Recipe, FItemID ItemID);
+
+	//recipes with the item among their ingredients
+	const TArray<int32>& GetRecipesUsing(FItemID ItemID) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	TArray<FRecipe> Recipes;
+
+	TMap<FCraftingPattern, int32> ShapedRecipes;
+
+	//every shaped recipe flipped left to right
+	TMap<FCraftingPattern, int32> MirroredRecipes;
+	TMap<FCraftingPattern, int32> ShapelessRecipes;
+
+	TMap<FItemID, TArray<int32>> RecipesByIngredient;
+};
+
+//the recipes an inventory holds enough ingredients for
+//every recipe counts how many of its ingredients are covered, when an item's total changes only the recipes using it are touched
+class MCUE_API FCraftableRecipes
+{
+public:
+	FCraftableRecipes();
+
+	//brings the set up to date, does nothing if the inventory hasn't changed since the last call
+	void Update(const FCraftingIndex& Index, const FInventory& Inventory);
+
+	//recipe indices, in no particular order
+	const TArray<int32>& GetRecipes() const { return Craftable; }
+
+private:
+	void SetItemCount(const FCraftingIndex& Index, FItemID ItemID, int32 NewCount);
+
+	const FCraftingIndex* BuiltFor;
+	uint32 InventoryRevision;
+
+	//what the inventory held at the last update
+	TMap<FItemID, int32> ItemCounts;
+
+	//per recipe, ingredients the inventory has enough of
+	TArray<uint8> NumCovered;
+
+	//per recipe, its position in Craftable or INDEX_NONE
+	TArray<int32> CraftablePositions;
+
+	TArray<int32> Craftable;
+};
@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "CraftingRecipe.generated.h"
+
+//one recipe as a data table row, any number of tables can be listed in the crafting subsystem's config
+USTRUCT(BlueprintType)
+struct FCraftingRecipe : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	//shaped recipes need the ingredients in this layout, anywhere on the grid and either way round
+	//shapeless ones only need the right items somewhere on it
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Recipe")
+	bool bShaped = true;
+
+	//cells per row of Ingredients, shaped recipes only
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Recipe", meta = (ClampMin = "1", ClampMax = "3"))
+	int32 Width = 3;
+
+	//FItemID per cell row by row from the top, 0 for an empty cell
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Recipe")
+	TArray<int32> Ingredients;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Result")
+	int32 ResultItemID = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Result", meta = (ClampMin = "1", ClampMax = "255"))
+	int32 ResultCount = 1;
+};
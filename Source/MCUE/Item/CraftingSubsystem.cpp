@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CraftingSubsystem.h"
+#include "CraftingRecipe.h"
+#include "Engine/DataTable.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCrafting, Log, All);
+
+void UCraftingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const double StartTime = FPlatformTime::Seconds();
+	int32 NumRejected = 0;
+
+	for (const FString& File : RecipeFiles)
+	{
+		FString Json;
+		TArray<TSharedPtr<FJsonValue>> Rows;
+		if (!FFileHelper::LoadFileToString(Json, *FPaths::Combine(FPaths::ProjectContentDir(), File))
+			|| !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Rows))
+		{
+			UE_LOG(LogCrafting, Warning, TEXT("Couldn't read recipe file %s"), *File);
+			continue;
+		}
+
+		//the same layout the editor exports data tables to json with, one object per row named by its Name field
+		for (const TSharedPtr<FJsonValue>& Value : Rows)
+		{
+			const TSharedPtr<FJsonObject>* Object = nullptr;
+			FCraftingRecipe Row;
+			FString Name;
+			if (!Value->TryGetObject(Object) || !(*Object)->TryGetStringField(TEXT("Name"), Name)
+				|| !FJsonObjectConverter::JsonObjectToUStruct(Object->ToSharedRef(), &Row) || !Index.Add(*Name, Row))
+			{
+				UE_LOG(LogCrafting, Warning, TEXT("%s: ignoring malformed recipe %s"), *File, *Name);
+				++NumRejected;
+			}
+		}
+	}
+
+	for (const TSoftObjectPtr<UDataTable>& TablePtr : RecipeTables)
+	{
+		const UDataTable* Table = TablePtr.LoadSynchronous();
+		if (Table == nullptr || Table->GetRowStruct() == nullptr || !Table->GetRowStruct()->IsChildOf(FCraftingRecipe::StaticStruct()))
+		{
+			UE_LOG(LogCrafting, Warning, TEXT("%s is not a table of crafting recipes"), *TablePtr.ToString());
+			continue;
+		}
+		NumRejected += AddTable(*Table);
+	}
+
+	UE_LOG(LogCrafting, Log, TEXT("Indexed %d recipes (%d rejected) in %.2f ms, %d KB"),
+		Index.Num(), NumRejected, (FPlatformTime::Seconds() - StartTime) * 1000.0, (int32)(Index.GetAllocatedSize() / 1024));
+}
+
+int32 UCraftingSubsystem::AddTable(const UDataTable& Table)
+{
+	int32 NumRejected = 0;
+	Table.ForeachRow<FCraftingRecipe>(TEXT("UCraftingSubsystem::AddTable"), [this, &Table, &NumRejected](const FName& Key, const FCraftingRecipe& Row)
+	{
+		if (!Index.Add(Key, Row))
+		{
+			UE_LOG(LogCrafting, Warning, TEXT("%s: ignoring malformed recipe %s"), *Table.GetName(), *Key.ToString());
+			++NumRejected;
+		}
+	});
+	return NumRejected;
+}
+
+UCraftingSubsystem* UCraftingSubsystem::Get(const UObject* WorldContextObject)
+{
+	const UWorld* World = WorldContextObject != nullptr ? WorldContextObject->GetWorld() : nullptr;
+	const UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+	return GameInstance != nullptr ? GameInstance->GetSubsystem<UCraftingSubsystem>() : nullptr;
+}
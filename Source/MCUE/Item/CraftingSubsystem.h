@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "CraftingIndex.h"
+#include "CraftingSubsystem.generated.h"
+
+class UDataTable;
+
+//holds the recipe index for the whole game, built once from the recipe files and tables named in config
+//files are read first and tables after them, later ones override recipes with the same pattern, so mods can append their own
+UCLASS(config=Game)
+class MCUE_API UCraftingSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static UCraftingSubsystem* Get(const UObject* WorldContextObject);
+
+	const FCraftingIndex& GetIndex() const { return Index; }
+
+private:
+	//adds every row of a table of FCraftingRecipe rows, returns the number rejected
+	int32 AddTable(const UDataTable& Table);
+
+	FCraftingIndex Index;
+
+	//json arrays of FCraftingRecipe rows, relative to the content directory and staged as plain files
+	//the base recipes live in Data/Recipes/DefaultRecipes.json, so the game has recipes without any table assets
+	UPROPERTY(config)
+	TArray<FString> RecipeFiles;
+
+	//data tables of FCraftingRecipe rows
+	UPROPERTY(config)
+	TArray<TSoftObjectPtr<UDataTable>> RecipeTables;
+};
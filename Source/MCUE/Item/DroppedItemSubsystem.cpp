@@ -0,0 +1,282 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DroppedItemSubsystem.h"
+#include "ItemRegistry.h"
+#include "MCUECharacter.h"
+#include "MCUEStats.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "World/VoxelWorldRenderer.h"
+#include "World/VoxelWorldSubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dropped Item Update"), STAT_DroppedItemUpdate, STATGROUP_VoxelWorld);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dropped Items"), STAT_DroppedItems, STATGROUP_VoxelWorld);
+
+UDroppedItemSubsystem::UDroppedItemSubsystem()
+{
+	MergeTimer = 0.0f;
+	InstanceOwner = nullptr;
+	InstanceRevision = 0;
+	InstanceLayoutRevision = 0;
+
+	DropLifetime = 300.0f;
+	PickupRadius = 150.0f;
+	MinedPickupDelay = 0.5f;
+	ThrownPickupDelay = 2.0f;
+	MergeRadius = 50.0f;
+	MergeInterval = 0.5f;
+}
+
+bool UDroppedItemSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UDroppedItemSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	InstanceOwner = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+
+	USceneComponent* Root = NewObject<USceneComponent>(InstanceOwner, TEXT("Root"));
+	InstanceOwner->SetRootComponent(Root);
+	Root->RegisterComponent();
+}
+
+void UDroppedItemSubsystem::Tick(float DeltaTime)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_DroppedItemUpdate, MCUEGameplay);
+
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
+
+	Items.Update(*VoxelWorld, DeltaTime, DropLifetime);
+
+	MergeTimer -= DeltaTime;
+	if (MergeTimer <= 0.0f)
+	{
+		MergeTimer = MergeInterval;
+
+		const UItemRegistrySubsystem* Registry = UItemRegistrySubsystem::Get(this);
+		Items.Merge(MergeRadius, [Registry](FItemID ItemID) { return Registry != nullptr ? Registry->GetMaxStackSize(ItemID) : 1; });
+	}
+
+	Collectors.RemoveAll([](const TWeakObjectPtr<AMCUECharacter>& Collector) { return !Collector.IsValid(); });
+	for (const TWeakObjectPtr<AMCUECharacter>& Collector : Collectors)
+	{
+		AMCUECharacter* Character = Collector.Get();
+		Items.Collect(Character->GetActorLocation(), PickupRadius, [Character](const FItemStack& Stack) { return Stack.Count - Character->CollectItemStack(Stack); });
+	}
+
+	UpdateInstances();
+
+	SET_DWORD_STAT(STAT_DroppedItems, Items.Num());
+}
+
+bool UDroppedItemSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UDroppedItemSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDroppedItemSubsystem, STATGROUP_Tickables);
+}
+
+void UDroppedItemSubsystem::SpawnItem(const FItemStack& Stack, const FVector& Location, const FVector& Velocity, bool bThrown)
+{
+	Items.Add(Stack, Location, Velocity, bThrown ? ThrownPickupDelay : MinedPickupDelay);
+}
+
+void UDroppedItemSubsystem::AddCollector(AMCUECharacter* Collector)
+{
+	Collectors.AddUnique(Collector);
+}
+
+void UDroppedItemSubsystem::RemoveCollector(AMCUECharacter* Collector)
+{
+	Collectors.Remove(Collector);
+}
+
+void UDroppedItemSubsystem::RemoveCollected(const FItemStack& Stack, const FVector& Location)
+{
+	//the client has moved on by the time the pickup arrives, so it looks a little further out
+	int32 Remaining = Stack.Count;
+	Items.Collect(Location, PickupRadius * 2.0f, [&Stack, &Remaining](const FItemStack& Dropped)
+	{
+		const int32 Taken = Dropped.CanStackWith(Stack) ? FMath::Min((int32)Dropped.Count, Remaining) : 0;
+		Remaining -= Taken;
+		return Taken;
+	});
+}
+
+void UDroppedItemSubsystem::UpdateInstances()
+{
+	if (InstanceOwner == nullptr || Items.GetRevision() == InstanceRevision)
+	{
+		return;
+	}
+	InstanceRevision = Items.GetRevision();
+
+	const TArray<FItemStack>& Stacks = Items.GetStacks();
+
+	//items were added or removed, so every batch is laid out again
+	if (Items.GetLayoutRevision() != InstanceLayoutRevision)
+	{
+		InstanceLayoutRevision = Items.GetLayoutRevision();
+
+		for (TPair<int32, FInstanceBatch>& Pair : Batches)
+		{
+			Pair.Value.Items.Reset();
+		}
+
+		InstanceOfItem.SetNumUninitialized(Stacks.Num());
+		for (int32 Index = 0; Index < Stacks.Num(); ++Index)
+		{
+			InstanceOfItem[Index] = Batches.FindOrAdd(Stacks[Index].ItemID).Items.Add(Index);
+		}
+
+		const TArray<float>& Phases = Items.GetPhases();
+		for (TPair<int32, FInstanceBatch>& Pair : Batches)
+		{
+			FInstanceBatch& Batch = Pair.Value;
+			UInstancedStaticMeshComponent* Instances = WriteInstances((FItemID)Pair.Key, Batch, 0, FMath::Max(Batch.Items.Num(), Batch.NumVisible));
+			if (Instances != nullptr)
+			{
+				for (int32 Instance = 0; Instance < Batch.Items.Num(); ++Instance)
+				{
+					Instances->SetCustomDataValue(Instance, 0, Phases[Batch.Items[Instance]], false);
+				}
+			}
+			Batch.NumVisible = Batch.Items.Num();
+		}
+
+		Items.ClearMoved();
+		return;
+	}
+
+	//only the instances of items that moved are written, as one range per batch
+	for (TPair<int32, FInstanceBatch>& Pair : Batches)
+	{
+		Pair.Value.FirstMoved = MAX_int32;
+		Pair.Value.LastMoved = INDEX_NONE;
+	}
+
+	for (TConstSetBitIterator<> It(Items.GetMoved()); It; ++It)
+	{
+		FInstanceBatch& Batch = Batches.FindChecked(Stacks[It.GetIndex()].ItemID);
+		const int32 Instance = InstanceOfItem[It.GetIndex()];
+		Batch.FirstMoved = FMath::Min(Batch.FirstMoved, Instance);
+		Batch.LastMoved = FMath::Max(Batch.LastMoved, Instance);
+	}
+
+	for (TPair<int32, FInstanceBatch>& Pair : Batches)
+	{
+		if (Pair.Value.LastMoved != INDEX_NONE)
+		{
+			WriteInstances((FItemID)Pair.Key, Pair.Value, Pair.Value.FirstMoved, Pair.Value.LastMoved + 1);
+		}
+	}
+
+	Items.ClearMoved();
+}
+
+UInstancedStaticMeshComponent* UDroppedItemSubsystem::WriteInstances(FItemID ItemID, const FInstanceBatch& Batch, int32 First, int32 End)
+{
+	UInstancedStaticMeshComponent* Instances = GetOrCreateInstances(ItemID);
+	if (Instances == nullptr || First >= End)
+	{
+		return Instances;
+	}
+
+	//every mesh is shrunk or grown to the size items are simulated at
+	const float MeshExtent = Instances->GetStaticMesh()->GetBounds().BoxExtent.GetMax();
+	const FVector Scale(MeshExtent > 0.0f ? FDroppedItems::HalfSize / MeshExtent : 1.0f);
+
+	//instances past the batch's items are spares, kept and shrunk to nothing
+	const TArray<FVector>& Locations = Items.GetLocations();
+	Transforms.Reset(End - First);
+	for (int32 Instance = First; Instance < End; ++Instance)
+	{
+		if (Instance < Batch.Items.Num())
+		{
+			Transforms.Emplace(FQuat::Identity, Locations[Batch.Items[Instance]], Scale);
+		}
+		else
+		{
+			Transforms.Emplace(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+		}
+	}
+
+	const int32 NumExisting = Instances->GetInstanceCount();
+	const int32 NumToUpdate = FMath::Clamp(NumExisting - First, 0, Transforms.Num());
+	if (NumToUpdate == Transforms.Num())
+	{
+		Instances->BatchUpdateInstancesTransforms(First, Transforms, true, false, true);
+	}
+	else
+	{
+		if (NumToUpdate > 0)
+		{
+			Instances->BatchUpdateInstancesTransforms(First, TArray<FTransform>(Transforms.GetData(), NumToUpdate), true, false, true);
+		}
+		for (int32 Index = NumToUpdate; Index < Transforms.Num(); ++Index)
+		{
+			Instances->AddInstanceWorldSpace(Transforms[Index]);
+		}
+	}
+
+	Instances->MarkRenderStateDirty();
+	return Instances;
+}
+
+UInstancedStaticMeshComponent* UDroppedItemSubsystem::GetOrCreateInstances(FItemID ItemID)
+{
+	if (UInstancedStaticMeshComponent** Existing = ItemInstances.Find(ItemID))
+	{
+		return *Existing;
+	}
+
+	const UItemRegistrySubsystem* Registry = UItemRegistrySubsystem::Get(this);
+	const FItemDefinition* Item = Registry != nullptr ? Registry->Find(ItemID) : nullptr;
+
+	//items without a mesh of their own are small cubes, in their block's material if they are a block
+	UStaticMesh* Mesh = Item != nullptr ? Item->DroppedMesh.LoadSynchronous() : nullptr;
+	UMaterialInterface* Material = nullptr;
+	if (Mesh == nullptr)
+	{
+		Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+
+		const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+		if (ItemID < EItemID::FirstNonBlockItem && VoxelWorld != nullptr && VoxelWorld->GetRenderer() != nullptr)
+		{
+			Material = VoxelWorld->GetRenderer()->GetBlockMaterial(ItemID);
+		}
+	}
+	if (Mesh == nullptr)
+	{
+		return nullptr;
+	}
+
+	UInstancedStaticMeshComponent* Instances = NewObject<UInstancedStaticMeshComponent>(InstanceOwner);
+	Instances->SetupAttachment(InstanceOwner->GetRootComponent());
+	Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Instances->SetCastShadow(false);
+	Instances->NumCustomDataFloats = 1;
+	Instances->SetStaticMesh(Mesh);
+	if (Material != nullptr)
+	{
+		Instances->SetMaterial(0, Material);
+	}
+	Instances->RegisterComponent();
+
+	ItemInstances.Add(ItemID, Instances);
+	return Instances;
+}
@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DroppedItems.h"
+#include "DroppedItemSubsystem.generated.h"
+
+class AMCUECharacter;
+class UInstancedStaticMeshComponent;
+
+//owns every item lying in the world, moves them in one batch and hands them to characters that walk over them
+//each item type is drawn by one instanced mesh, per instance custom data 0 holds a random phase the material can spin items with
+UCLASS(config=Game)
+class MCUE_API UDroppedItemSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UDroppedItemSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	//FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//thrown items wait longer before they can be picked up, so the thrower doesn't take them straight back
+	void SpawnItem(const FItemStack& Stack, const FVector& Location, const FVector& Velocity, bool bThrown = false);
+
+	//characters pick up items within PickupRadius of them, only registered where the inventory is authoritative
+	void AddCollector(AMCUECharacter* Collector);
+	void RemoveCollector(AMCUECharacter* Collector);
+
+	//takes a stack the server says was picked up near Location out of this side's copy of the drops
+	void RemoveCollected(const FItemStack& Stack, const FVector& Location);
+
+	const FDroppedItems& GetItems() const { return Items; }
+
+private:
+	//instances of one item type, in the order of the items they draw
+	struct FInstanceBatch
+	{
+		TArray<int32> Items;
+
+		//instances showing an item when the batch was last laid out, the ones past it are already shrunk
+		int32 NumVisible = 0;
+
+		//range of instances whose items moved this frame
+		int32 FirstMoved = 0;
+		int32 LastMoved = 0;
+	};
+
+	//lays every batch out again when items were added or removed, otherwise only rewrites the instances of items that moved
+	void UpdateInstances();
+
+	//writes instances First up to End of the batch, adding any the component doesn't have yet
+	UInstancedStaticMeshComponent* WriteInstances(FItemID ItemID, const FInstanceBatch& Batch, int32 First, int32 End);
+
+	UInstancedStaticMeshComponent* GetOrCreateInstances(FItemID ItemID);
+
+	FDroppedItems Items;
+
+	TArray<TWeakObjectPtr<AMCUECharacter>> Collectors;
+
+	//seconds until the next merge pass
+	float MergeTimer;
+
+	//holds the instanced meshes
+	UPROPERTY(Transient)
+	AActor* InstanceOwner;
+
+	//indexed by item id
+	UPROPERTY(Transient)
+	TMap<int32, UInstancedStaticMeshComponent*> ItemInstances;
+
+	//dropped item revision the instances were last written for, and the layout they were last laid out for
+	uint32 InstanceRevision;
+	uint32 InstanceLayoutRevision;
+
+	//indexed by item id
+	TMap<int32, FInstanceBatch> Batches;
+
+	//per dropped item, its instance in its type's batch
+	TArray<int32> InstanceOfItem;
+
+	TArray<FTransform> Transforms;
+
+	//seconds an item lies in the world before it despawns
+	UPROPERTY(config)
+	float DropLifetime;
+
+	UPROPERTY(config)
+	float PickupRadius;
+
+	//seconds before a mined or thrown item can be picked up
+	UPROPERTY(config)
+	float MinedPickupDelay;
+
+	UPROPERTY(config)
+	float ThrownPickupDelay;
+
+	//identical stacks this close together become one
+	UPROPERTY(config)
+	float MergeRadius;
+
+	UPROPERTY(config)
+	float MergeInterval;
+};
@@ -0,0 +1,345 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DroppedItems.h"
+#include "World/VoxelWorldSubsystem.h"
+
+namespace
+{
+	constexpr float GravityZ = -980.0f;
+	constexpr float TerminalSpeed = 1000.0f;
+
+	//fraction of sideways speed lost per second
+	constexpr float Drag = 2.0f;
+
+	//the simulation always steps this long, short enough that a falling item never skips a block between two checks
+	constexpr float StepSeconds = 1.0f / 60.0f;
+
+	//time owed to the simulation is capped, so a very long hitch can't turn into a burst of catching up
+	constexpr float MaxBacklogSeconds = 0.25f;
+
+	bool IsSolidAt(const UVoxelWorldSubsystem& VoxelWorld, const FVector& Location, FIntVector& OutBlock)
+	{
+		OutBlock = VoxelWorld.WorldToBlock(Location);
+		if (OutBlock.Z < 0)
+		{
+			return true;
+		}
+		if (OutBlock.Z >= FChunk::Height)
+		{
+			return false;
+		}
+
+		//a chunk that isn't there yet, or is only a placeholder, is a wall rather than a hole to fall into
+		const FIntPoint ChunkCoord = UVoxelWorldSubsystem::BlockToChunk(OutBlock);
+		const FChunk* Chunk = VoxelWorld.IsChunkTickable(ChunkCoord) ? VoxelWorld.FindChunk(ChunkCoord) : nullptr;
+		return Chunk == nullptr || FBlockRegistry::IsSolid(Chunk->GetBlock(OutBlock.X & 15, OutBlock.Y & 15, OutBlock.Z));
+	}
+
+	//true if the chunk the location is in has its terrain
+	bool IsLoadedAt(const UVoxelWorldSubsystem& VoxelWorld, const FVector& Location)
+	{
+		return VoxelWorld.IsChunkTickable(UVoxelWorldSubsystem::BlockToChunk(VoxelWorld.WorldToBlock(Location)));
+	}
+
+	bool IsSolidAt(const UVoxelWorldSubsystem& VoxelWorld, const FVector& Location)
+	{
+		FIntVector Block;
+		return IsSolidAt(VoxelWorld, Location, Block);
+	}
+}
+
+FDroppedItems::FDroppedItems()
+	: StepBacklog(0.0f)
+	, bHashValid(false)
+	, Revision(0)
+	, LayoutRevision(0)
+{
+}
+
+template<typename FunctionType>
+void FDroppedItems::ForEachNear(const FVector& Location, float Radius, FunctionType Visit) const
+{
+	check(bHashValid);
+
+	const FIntVector Min = GetCell(Location - FVector(Radius));
+	const FIntVector Max = GetCell(Location + FVector(Radius));
+
+	for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				const int32 Bucket = GetBucket(FIntVector(X, Y, Z));
+				for (int32 Slot = HashStarts[Bucket]; Slot < HashStarts[Bucket + 1]; ++Slot)
+				{
+					Visit(HashItems[Slot]);
+				}
+			}
+		}
+	}
+}
+
+void FDroppedItems::Add(const FItemStack& Stack, const FVector& Location, const FVector& Velocity, float PickupDelay)
+{
+	if (Stack.IsEmpty())
+	{
+		return;
+	}
+
+	Locations.Add(Location);
+	Velocities.Add(Velocity);
+	Stacks.Add(Stack);
+	Ages.Add(-FMath::Max(0.0f, PickupDelay));
+	Phases.Add(FMath::FRand());
+	Settled.Add(false);
+	Moved.Add(true);
+
+	bHashValid = false;
+	++Revision;
+	++LayoutRevision;
+}
+
+void FDroppedItems::Update(const UVoxelWorldSubsystem& VoxelWorld, float DeltaTime, float Lifetime)
+{
+	bool bChanged = false;
+
+	//backwards so a removed item is replaced by one that was already aged
+	for (int32 Index = Stacks.Num() - 1; Index >= 0; --Index)
+	{
+		Ages[Index] += DeltaTime;
+		if (Ages[Index] > Lifetime)
+		{
+			RemoveAt(Index);
+			bChanged = true;
+		}
+	}
+
+	//whole steps only, whatever is left over is carried into the next frame rather than dropped
+	StepBacklog = FMath::Min(StepBacklog + DeltaTime, MaxBacklogSeconds);
+	for (; StepBacklog >= StepSeconds; StepBacklog -= StepSeconds)
+	{
+		bChanged |= Step(VoxelWorld);
+	}
+
+	if (bChanged)
+	{
+		bHashValid = false;
+		++Revision;
+	}
+}
+
+bool FDroppedItems::Step(const UVoxelWorldSubsystem& VoxelWorld)
+{
+	const FVector Down(0.0f, 0.0f, HalfSize + 1.0f);
+	bool bChanged = false;
+
+	for (int32 Index = 0; Index < Stacks.Num(); ++Index)
+	{
+		FVector& Location = Locations[Index];
+		FVector& Velocity = Velocities[Index];
+
+		//items in a chunk that was unloaded hold still until it comes back, the push out below would lift them to the sky
+		if (!IsLoadedAt(VoxelWorld, Location))
+		{
+			continue;
+		}
+
+		//a block placed on top of the item pushes it out the top
+		FIntVector Block;
+		if (IsSolidAt(VoxelWorld, Location, Block))
+		{
+			Location.Z = VoxelWorld.BlockToWorld(Block).Z + UVoxelWorldSubsystem::BlockSize + HalfSize;
+			Velocity = FVector::ZeroVector;
+			Settled[Index] = false;
+			Moved[Index] = true;
+			bChanged = true;
+			continue;
+		}
+
+		if (Settled[Index])
+		{
+			if (IsSolidAt(VoxelWorld, Location - Down))
+			{
+				continue;
+			}
+			Settled[Index] = false;
+		}
+
+		Velocity.Z = FMath::Max(Velocity.Z + GravityZ * StepSeconds, -TerminalSpeed);
+		Velocity.X *= FMath::Max(0.0f, 1.0f - Drag * StepSeconds);
+		Velocity.Y *= FMath::Max(0.0f, 1.0f - Drag * StepSeconds);
+
+		FVector NewLocation = Location + Velocity * StepSeconds;
+
+		//running into a wall stops that axis only
+		for (int32 Axis = 0; Axis < 2; ++Axis)
+		{
+			FVector Probe = Location;
+			Probe[Axis] = NewLocation[Axis] + FMath::Sign(Velocity[Axis]) * HalfSize;
+			if (Velocity[Axis] != 0.0f && IsSolidAt(VoxelWorld, Probe))
+			{
+				NewLocation[Axis] = Location[Axis];
+				Velocity[Axis] = 0.0f;
+			}
+		}
+
+		if (Velocity.Z > 0.0f && IsSolidAt(VoxelWorld, NewLocation + FVector(0.0f, 0.0f, HalfSize)))
+		{
+			NewLocation.Z = Location.Z;
+			Velocity.Z = 0.0f;
+		}
+		else if (Velocity.Z <= 0.0f && IsSolidAt(VoxelWorld, NewLocation - FVector(0.0f, 0.0f, HalfSize), Block))
+		{
+			NewLocation.Z = VoxelWorld.BlockToWorld(Block).Z + UVoxelWorldSubsystem::BlockSize + HalfSize;
+			Velocity = FVector::ZeroVector;
+			Settled[Index] = true;
+		}
+
+		Location = NewLocation;
+		Moved[Index] = true;
+		bChanged = true;
+	}
+	return bChanged;
+}
+
+void FDroppedItems::ClearMoved()
+{
+	Moved.Init(false, Moved.Num());
+}
+
+void FDroppedItems::Merge(float Radius, TFunctionRef<int32(FItemID)> GetMaxStackSize)
+{
+	if (Stacks.Num() < 2)
+	{
+		return;
+	}
+
+	BuildHash();
+
+	bool bMerged = false;
+	for (int32 Index = 0; Index < Stacks.Num(); ++Index)
+	{
+		FItemStack& Stack = Stacks[Index];
+		const int32 MaxStackSize = Stack.IsEmpty() ? 0 : FMath::Min(GetMaxStackSize(Stack.ItemID), (int32)MAX_uint8);
+		if (Stack.Count >= MaxStackSize)
+		{
+			continue;
+		}
+
+		ForEachNear(Locations[Index], Radius, [&](int32 Other)
+		{
+			FItemStack& OtherStack = Stacks[Other];
+			if (Other <= Index || OtherStack.IsEmpty() || !Stack.CanStackWith(OtherStack) || Stack.Count >= MaxStackSize
+				|| FVector::DistSquared(Locations[Index], Locations[Other]) > FMath::Square(Radius))
+			{
+				return;
+			}
+
+			const uint8 Moved = (uint8)FMath::Min<int32>(OtherStack.Count, MaxStackSize - Stack.Count);
+			Stack.Count += Moved;
+			OtherStack.Count -= Moved;
+
+			//the pile lives as long as its newest part would have
+			Ages[Index] = FMath::Min(Ages[Index], Ages[Other]);
+			bMerged = true;
+		});
+	}
+
+	if (bMerged)
+	{
+		RemoveEmpty();
+	}
+}
+
+void FDroppedItems::Collect(const FVector& Location, float Radius, TFunctionRef<int32(const FItemStack&)> CollectStack)
+{
+	if (Stacks.Num() == 0)
+	{
+		return;
+	}
+
+	BuildHash();
+
+	bool bCollected = false;
+	ForEachNear(Location, Radius, [&](int32 Index)
+	{
+		FItemStack& Stack = Stacks[Index];
+		if (Stack.IsEmpty() || Ages[Index] < 0.0f || FVector::DistSquared(Location, Locations[Index]) > FMath::Square(Radius))
+		{
+			return;
+		}
+
+		const int32 Taken = FMath::Clamp(CollectStack(Stack), 0, (int32)Stack.Count);
+		Stack.Count -= (uint8)Taken;
+		bCollected |= Taken > 0;
+	});
+
+	if (bCollected)
+	{
+		RemoveEmpty();
+	}
+}
+
+SIZE_T FDroppedItems::GetAllocatedSize() const
+{
+	return Locations.GetAllocatedSize() + Velocities.GetAllocatedSize() + Stacks.GetAllocatedSize() + Ages.GetAllocatedSize() + Phases.GetAllocatedSize()
+		+ Settled.GetAllocatedSize() + Moved.GetAllocatedSize() + HashStarts.GetAllocatedSize() + HashItems.GetAllocatedSize() + HashCursor.GetAllocatedSize();
+}
+
+void FDroppedItems::RemoveAt(int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	Stacks.RemoveAtSwap(Index, 1, false);
+	Ages.RemoveAtSwap(Index, 1, false);
+	Phases.RemoveAtSwap(Index, 1, false);
+	Settled.RemoveAtSwap(Index);
+	Moved.RemoveAtSwap(Index);
+
+	++LayoutRevision;
+}
+
+void FDroppedItems::RemoveEmpty()
+{
+	for (int32 Index = Stacks.Num() - 1; Index >= 0; --Index)
+	{
+		if (Stacks[Index].IsEmpty())
+		{
+			RemoveAt(Index);
+		}
+	}
+
+	bHashValid = false;
+	++Revision;
+}
+
+void FDroppedItems::BuildHash()
+{
+	if (bHashValid)
+	{
+		return;
+	}
+	bHashValid = true;
+
+	//about two buckets per item keeps unrelated cells from sharing one
+	const int32 NumBuckets = (int32)FMath::RoundUpToPowerOfTwo(FMath::Max(64, Stacks.Num() * 2));
+	HashStarts.Reset();
+	HashStarts.SetNumZeroed(NumBuckets + 1);
+	HashItems.SetNumUninitialized(Stacks.Num(), false);
+
+	for (const FVector& Location : Locations)
+	{
+		++HashStarts[GetBucket(GetCell(Location)) + 1];
+	}
+	for (int32 Bucket = 1; Bucket <= NumBuckets; ++Bucket)
+	{
+		HashStarts[Bucket] += HashStarts[Bucket - 1];
+	}
+
+	HashCursor = HashStarts;
+	for (int32 Index = 0; Index < Locations.Num(); ++Index)
+	{
+		HashItems[HashCursor[GetBucket(GetCell(Locations[Index]))]++] = Index;
+	}
+}
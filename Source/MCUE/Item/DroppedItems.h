@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/BitArray.h"
+#include "ItemStack.h"
+
+class UVoxelWorldSubsystem;
+
+//every item stack lying in the world, kept as parallel arrays and advanced in one pass
+//items fall, settle on solid blocks and despawn, there is no actor, component or physics body per item
+//nearby items are found through a uniform grid hash that is only rebuilt after something moved
+class MCUE_API FDroppedItems
+{
+public:
+	//half the edge of the cube an item is treated as, in world units
+	static constexpr float HalfSize = 12.5f;
+
+	FDroppedItems();
+
+	int32 Num() const { return Stacks.Num(); }
+
+	//the item can't be collected for the first PickupDelay seconds
+	void Add(const FItemStack& Stack, const FVector& Location, const FVector& Velocity, float PickupDelay);
+
+	//falls, settles on solid blocks and removes items older than Lifetime seconds
+	//movement advances in fixed steps, a frame shorter than a step moves nothing and a long one takes several
+	//chunks that aren't loaded count as solid, so items never fall out of the world while it streams
+	void Update(const UVoxelWorldSubsystem& VoxelWorld, float DeltaTime, float Lifetime);
+
+	//folds identical stacks within Radius of each other together, never past the item's max stack size
+	void Merge(float Radius, TFunctionRef<int32(FItemID)> GetMaxStackSize);
+
+	//offers every collectable item within Radius of Location to Collect, which returns how many it took
+	void Collect(const FVector& Location, float Radius, TFunctionRef<int32(const FItemStack&)> CollectStack);
+
+	const TArray<FVector>& GetLocations() const { return Locations; }
+	const TArray<FItemStack>& GetStacks() const { return Stacks; }
+
+	//random per item, lets the material spin and bob items out of step with each other
+	const TArray<float>& GetPhases() const { return Phases; }
+
+	//bumped whenever an item is added, moved or removed, lets the instanced meshes skip frames where nothing changed
+	uint32 GetRevision() const { return Revision; }
+
+	//bumped only when items are added or removed, so indices stay the same for as long as it does
+	uint32 GetLayoutRevision() const { return LayoutRevision; }
+
+	//per item, set when it was added or moved since the last ClearMoved
+	const TBitArray<>& GetMoved() const { return Moved; }
+	void ClearMoved();
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	//moves every item StepSeconds on, returns true if any moved
+	//items in chunks that aren't loaded are frozen where they are
+	bool Step(const UVoxelWorldSubsystem& VoxelWorld);
+
+	void RemoveAt(int32 Index);
+
+	//drops every item whose stack has been emptied
+	void RemoveEmpty();
+
+	void BuildHash();
+
+	static FIntVector GetCell(const FVector& Location) { return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize)); }
+
+	int32 GetBucket(const FIntVector& Cell) const { return (int32)(((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u) ^ ((uint32)Cell.Z * 83492791u)) & (HashStarts.Num() - 2); }
+
+	//calls Visit with the index of every item in a hash cell overlapping the sphere, callers still check the distance
+	template<typename FunctionType>
+	void ForEachNear(const FVector& Location, float Radius, FunctionType Visit) const;
+
+	//world units per hash cell, a block
+	static constexpr float CellSize = 100.0f;
+
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+	TArray<FItemStack> Stacks;
+
+	//seconds since the item was dropped, starts negative while it can't be picked up yet
+	TArray<float> Ages;
+
+	TArray<float> Phases;
+
+	//items resting on a block only check that it is still there
+	TBitArray<> Settled;
+
+	TBitArray<> Moved;
+
+	//seconds of simulation not stepped yet
+	float StepBacklog;
+
+	//counting sort of the items by bucket: bucket B holds HashItems[HashStarts[B]] up to HashItems[HashStarts[B + 1]]
+	TArray<int32> HashStarts;
+	TArray<int32> HashItems;
+	TArray<int32> HashCursor;
+	bool bHashValid;
+
+	uint32 Revision;
+	uint32 LayoutRevision;
+};
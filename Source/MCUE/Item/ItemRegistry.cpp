@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ItemRegistry.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/GameInstance.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
+#include "Wieldable/Wieldable.h"
+#include "World/BlockTypes.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogItemRegistry, Log, All);
+
+namespace
+{
+	const TCHAR* const BlockItemNames[] = { TEXT("Air"), TEXT("Grass"), TEXT("Rock"), TEXT("Cobble"), TEXT("IronOre"), TEXT("Water"), TEXT("Lava"), TEXT("Dirt") };
+	static_assert(UE_ARRAY_COUNT(BlockItemNames) == EBlockID::Num, "every block type needs an item name");
+
+	//uses a tool of each material lasts when it comes from a pickup class with no authored durability
+	int32 GetDefaultDurability(uint8 Material)
+	{
+		switch (Material)
+		{
+		case AWieldable::Wooden: return 59;
+		case AWieldable::Stone: return 131;
+		case AWieldable::Iron: return 250;
+		case AWieldable::Diamod: return 1561;
+		case AWieldable::Golden: return 32;
+		default: return 0;
+		}
+	}
+}
+
+void UItemRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	BlockItems.SetNum(EBlockID::Num);
+	for (int32 Type = 1; Type < EBlockID::Num; ++Type)
+	{
+		FItemDefinition& Item = BlockItems[Type];
+		Item.ItemID = Type;
+		Item.Name = BlockItemNames[Type];
+	}
+
+	if (const UItemRegistryAsset* RegistryAsset = ItemRegistry.LoadSynchronous())
+	{
+		for (const FItemDefinition& Definition : RegistryAsset->Items)
+		{
+			const bool bIsBlockItem = Definition.ItemID > EItemID::None && Definition.ItemID < EBlockID::Num;
+			if (!bIsBlockItem && (Definition.ItemID < EItemID::FirstNonBlockItem || Definition.ItemID >= PickupItemBase))
+			{
+				UE_LOG(LogItemRegistry, Warning, TEXT("%s: ignoring item id %d, block items run from 1 to %d and other items from %d to %d"),
+					*RegistryAsset->GetName(), Definition.ItemID, EBlockID::Num - 1, EItemID::FirstNonBlockItem, PickupItemBase - 1);
+				continue;
+			}
+			Register(Definition);
+
+			if (UClass* PickupClass = Definition.PickupClass.LoadSynchronous())
+			{
+				PickupItems.Add(PickupClass, Definition.ItemID);
+			}
+		}
+	}
+
+	//an authored item naming a listed class wins, the class's id is left unused
+	for (int32 Index = 0; Index < PickupClasses.Num(); ++Index)
+	{
+		UClass* PickupClass = PickupClasses[Index].LoadSynchronous();
+		if (PickupClass == nullptr)
+		{
+			UE_LOG(LogItemRegistry, Warning, TEXT("Pickup class %s can't be loaded, item %d stays empty"), *PickupClasses[Index].ToString(), PickupItemBase + Index);
+			continue;
+		}
+		if (PickupItems.Contains(PickupClass) || PickupItemBase + Index > MAX_uint16)
+		{
+			continue;
+		}
+
+		const AWieldable* Defaults = PickupClass->GetDefaultObject<AWieldable>();
+
+		FItemDefinition Item;
+		Item.ItemID = PickupItemBase + Index;
+		Item.Name = PickupClass->GetFName();
+		Item.ToolType = Defaults->ToolType;
+		Item.MaterialType = Defaults->MaterialType;
+		Item.MaxStackSize = Defaults->ToolType != AWieldable::Unarmed ? 1 : 64;
+		Item.MaxDurability = Defaults->ToolType != AWieldable::Unarmed ? GetDefaultDurability(Defaults->MaterialType) : 0;
+		Item.WieldedMesh = Defaults->WieldableMesh != nullptr ? Defaults->WieldableMesh->SkeletalMesh : nullptr;
+		Item.Thumbnail = Defaults->PickupThumbnail;
+		Item.PickupClass = PickupClass;
+		Register(Item);
+
+		PickupItems.Add(PickupClass, Item.ItemID);
+	}
+}
+
+UItemRegistrySubsystem* UItemRegistrySubsystem::Get(const UObject* WorldContextObject)
+{
+	const UWorld* World = WorldContextObject != nullptr ? WorldContextObject->GetWorld() : nullptr;
+	const UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+	return GameInstance != nullptr ? GameInstance->GetSubsystem<UItemRegistrySubsystem>() : nullptr;
+}
+
+const FItemDefinition* UItemRegistrySubsystem::Find(FItemID ItemID) const
+{
+	return const_cast<UItemRegistrySubsystem*>(this)->FindMutable(ItemID);
+}
+
+FItemDefinition* UItemRegistrySubsystem::FindMutable(FItemID ItemID)
+{
+	if (ItemID == EItemID::None)
+	{
+		return nullptr;
+	}
+	if (ItemID < EItemID::FirstNonBlockItem)
+	{
+		return ItemID < BlockItems.Num() ? &BlockItems[ItemID] : nullptr;
+	}
+
+	const int32 Index = ItemID - EItemID::FirstNonBlockItem;
+	return OtherItems.IsValidIndex(Index) && !OtherItems[Index].Name.IsNone() ? &OtherItems[Index] : nullptr;
+}
+
+int32 UItemRegistrySubsystem::GetMaxStackSize(FItemID ItemID) const
+{
+	const FItemDefinition* Item = Find(ItemID);
+	return Item != nullptr ? FMath::Clamp(Item->MaxStackSize, 1, (int32)MAX_uint8) : 1;
+}
+
+FItemStack UItemRegistrySubsystem::MakeStack(FItemID ItemID, int32 Count) const
+{
+	const FItemDefinition* Item = Find(ItemID);
+	if (Item == nullptr || Count <= 0)
+	{
+		return FItemStack();
+	}
+	return FItemStack(ItemID, (uint8)FMath::Min(Count, GetMaxStackSize(ItemID)), (uint16)FMath::Clamp(Item->MaxDurability, 0, (int32)MAX_uint16));
+}
+
+FItemID UItemRegistrySubsystem::GetPickupItem(const AWieldable& Pickup) const
+{
+	if (const int32* ItemID = PickupItems.Find(Pickup.GetClass()))
+	{
+		return (FItemID)*ItemID;
+	}
+
+	UE_LOG(LogItemRegistry, Warning, TEXT("%s is neither authored in the item registry nor in its PickupClasses, it can't be picked up"), *Pickup.GetClass()->GetName());
+	return EItemID::None;
+}
+
+USkeletalMesh* UItemRegistrySubsystem::LoadWieldedMesh(FItemID ItemID) const
+{
+	const FItemDefinition* Item = Find(ItemID);
+	return Item != nullptr ? Item->WieldedMesh.LoadSynchronous() : nullptr;
+}
+
+UTexture2D* UItemRegistrySubsystem::GetThumbnail(FItemID ItemID) const
+{
+	const FItemDefinition* Item = Find(ItemID);
+	return Item != nullptr ? Item->Thumbnail : nullptr;
+}
+
+void UItemRegistrySubsystem::Register(const FItemDefinition& Definition)
+{
+	FItemDefinition Item = Definition;
+	if (Item.Name.IsNone())
+	{
+		Item.Name = *FString::Printf(TEXT("Item_%d"), Item.ItemID);
+	}
+
+	if (Item.ItemID < EItemID::FirstNonBlockItem)
+	{
+		BlockItems[Item.ItemID] = Item;
+		return;
+	}
+
+	const int32 Index = Item.ItemID - EItemID::FirstNonBlockItem;
+	if (Index >= OtherItems.Num())
+	{
+		OtherItems.SetNum(Index + 1);
+	}
+	OtherItems[Index] = Item;
+}
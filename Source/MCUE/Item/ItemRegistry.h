@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "ItemRegistryAsset.h"
+#include "ItemStack.h"
+#include "ItemRegistry.generated.h"
+
+//looks up item types by id for the whole game
+//every block type has an item with the same id, other items come from a UItemRegistryAsset
+//pickup classes in PickupClasses that the asset doesn't know about get an item built from the class defaults, its id is
+//PickupItemBase plus the class's place in the list, so ids are the same on every run and on both ends of a connection
+UCLASS(config=Game)
+class MCUE_API UItemRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static UItemRegistrySubsystem* Get(const UObject* WorldContextObject);
+
+	//nullptr for unknown ids
+	const FItemDefinition* Find(FItemID ItemID) const;
+
+	int32 GetMaxStackSize(FItemID ItemID) const;
+
+	//a new stack of Count items, tools start at full durability
+	FItemStack MakeStack(FItemID ItemID, int32 Count) const;
+
+	//the item a pickup actor stands for, EItemID::None if its class has no item
+	FItemID GetPickupItem(const AWieldable& Pickup) const;
+
+	//loads the mesh on first use, keep calls out of per frame code
+	USkeletalMesh* LoadWieldedMesh(FItemID ItemID) const;
+
+	UTexture2D* GetThumbnail(FItemID ItemID) const;
+
+private:
+	FItemDefinition* FindMutable(FItemID ItemID);
+
+	//adds a definition at its ItemID, replacing anything already there
+	void Register(const FItemDefinition& Definition);
+
+	//ids of listed pickup classes start here, authored items stay below it
+	static constexpr int32 PickupItemBase = EItemID::FirstNonBlockItem + 256;
+
+	//item types authored as data, nothing but the block items if empty
+	UPROPERTY(config)
+	TSoftObjectPtr<UItemRegistryAsset> ItemRegistry;
+
+	//pickup actor classes that are items without being authored, only ever append to it, a class's place is its id
+	UPROPERTY(config)
+	TArray<TSoftClassPtr<AWieldable>> PickupClasses;
+
+	//indexed by block type
+	UPROPERTY()
+	TArray<FItemDefinition> BlockItems;
+
+	//indexed by id - EItemID::FirstNonBlockItem, gaps have no name
+	UPROPERTY()
+	TArray<FItemDefinition> OtherItems;
+
+	//pickup class to the item it gives
+	UPROPERTY()
+	TMap<UClass*, int32> PickupItems;
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ItemRegistryAsset.generated.h"
+
+class AWieldable;
+class USkeletalMesh;
+class UStaticMesh;
+class UTexture2D;
+
+//one item type as authored in the editor
+USTRUCT(BlueprintType)
+struct FItemDefinition
+{
+	GENERATED_BODY()
+
+	//FItemID the definition applies to, a block type to dress up that block's item, otherwise EItemID::FirstNonBlockItem or above
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Item")
+	int32 ItemID = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Item")
+	FName Name;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Item", meta = (ClampMin = "1", ClampMax = "255"))
+	int32 MaxStackSize = 64;
+
+	//AWieldable::ETool
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tool")
+	uint8 ToolType = 0;
+
+	//AWieldable::EMaterial
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tool")
+	uint8 MaterialType = 1;
+
+	//blocks the tool breaks before it is used up, 0 if it never wears out
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tool", meta = (ClampMin = "0", ClampMax = "65535"))
+	int32 MaxDurability = 0;
+
+	//only loaded when the item is put in the character's hand
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+	TSoftObjectPtr<USkeletalMesh> WieldedMesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+	UTexture2D* Thumbnail = nullptr;
+
+	//drawn for the item lying in the world, scaled to fit a quarter block, a cube if not set
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+	TSoftObjectPtr<UStaticMesh> DroppedMesh;
+
+	//actor placed in the world to stand for the item, picking one up gives this item
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pickup")
+	TSoftClassPtr<AWieldable> PickupClass;
+};
+
+//item types authored as data, the item registry loads the one named in its config when the game starts
+UCLASS(BlueprintType)
+class MCUE_API UItemRegistryAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Items")
+	TArray<FItemDefinition> Items;
+};
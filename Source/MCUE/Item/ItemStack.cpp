@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ItemStack.h"
+
+int32 FInventory::Add(const FItemStack& Stack, int32 MaxStackSize)
+{
+	if (Stack.IsEmpty())
+	{
+		return 0;
+	}
+
+	MaxStackSize = FMath::Clamp(MaxStackSize, 1, (int32)MAX_uint8);
+	int32 Remaining = Stack.Count;
+
+	//top up what is already there first so the same item doesn't spread over several slots
+	for (int32 Slot = 0; Slot < NumSlots && Remaining > 0; ++Slot)
+	{
+		FItemStack& Existing = Slots[Slot];
+		if (!Existing.IsEmpty() && Existing.CanStackWith(Stack) && Existing.Count < MaxStackSize)
+		{
+			const int32 Moved = FMath::Min(Remaining, MaxStackSize - Existing.Count);
+			Existing.Count += Moved;
+			Remaining -= Moved;
+			DirtySlots |= 1u << Slot;
+		}
+	}
+
+	for (int32 Slot = 0; Slot < NumSlots && Remaining > 0; ++Slot)
+	{
+		FItemStack& Empty = Slots[Slot];
+		if (Empty.IsEmpty())
+		{
+			const int32 Moved = FMath::Min(Remaining, MaxStackSize);
+			Empty = Stack;
+			Empty.Count = (uint8)Moved;
+			Remaining -= Moved;
+			DirtySlots |= 1u << Slot;
+		}
+	}
+
+	if (Remaining != Stack.Count)
+	{
+		++Revision;
+	}
+	return Remaining;
+}
+
+FItemStack FInventory::Remove(int32 Slot, int32 Count)
+{
+	FItemStack& Existing = Slots[Slot];
+	if (Existing.IsEmpty() || Count <= 0)
+	{
+		return FItemStack();
+	}
+
+	FItemStack Taken = Existing;
+	Taken.Count = (uint8)FMath::Min<int32>(Count, Existing.Count);
+
+	Existing.Count -= Taken.Count;
+	if (Existing.Count == 0)
+	{
+		Existing = FItemStack();
+	}
+
+	DirtySlots |= 1u << Slot;
+	++Revision;
+	return Taken;
+}
+
+int32 FInventory::RemoveItem(FItemID ItemID, int32 Count)
+{
+	int32 Removed = 0;
+	for (int32 Slot = 0; Slot < NumSlots && Removed < Count; ++Slot)
+	{
+		if (!Slots[Slot].IsEmpty() && Slots[Slot].ItemID == ItemID)
+		{
+			Removed += Remove(Slot, Count - Removed).Count;
+		}
+	}
+	return Removed;
+}
+
+int32 FInventory::CountItem(FItemID ItemID) const
+{
+	int32 Count = 0;
+	for (const FItemStack& Stack : Slots)
+	{
+		if (!Stack.IsEmpty() && Stack.ItemID == ItemID)
+		{
+			Count += Stack.Count;
+		}
+	}
+	return Count;
+}
+
+void FInventory::Set(int32 Slot, const FItemStack& Stack)
+{
+	Slots[Slot] = Stack.IsEmpty() ? FItemStack() : Stack;
+	DirtySlots |= 1u << Slot;
+	++Revision;
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemStack.generated.h"
+
+//compact item id, 0 is always nothing
+//ids below FirstNonBlockItem are the block item of the block type with the same value, see UItemRegistrySubsystem
+typedef uint16 FItemID;
+
+namespace EItemID
+{
+	constexpr FItemID None = 0;
+
+	//one past the largest block type, everything from here on is defined by the item registry
+	constexpr FItemID FirstNonBlockItem = 1 << 12;
+}
+
+//a number of identical items in one inventory slot, plain data with no actor behind it
+USTRUCT()
+struct MCUE_API FItemStack
+{
+	GENERATED_BODY()
+
+	FItemStack() = default;
+	FItemStack(FItemID InItemID, uint8 InCount, uint16 InDurability = 0, uint32 InMetadata = 0)
+		: ItemID(InItemID), Durability(InDurability), Metadata(InMetadata), Count(InCount)
+	{
+	}
+
+	UPROPERTY()
+	uint16 ItemID = EItemID::None;
+
+	//uses left before a tool breaks, 0 for items that don't wear out
+	UPROPERTY()
+	uint16 Durability = 0;
+
+	//free for the item type to use, stacks only merge when it matches
+	UPROPERTY()
+	uint32 Metadata = 0;
+
+	UPROPERTY()
+	uint8 Count = 0;
+
+	bool IsEmpty() const { return Count == 0 || ItemID == EItemID::None; }
+
+	bool CanStackWith(const FItemStack& Other) const { return ItemID == Other.ItemID && Durability == Other.Durability && Metadata == Other.Metadata; }
+};
+
+//a fixed row of item stacks, the character's hotbar
+USTRUCT()
+struct MCUE_API FInventory
+{
+	GENERATED_BODY()
+
+	static constexpr int32 NumSlots = 10;
+
+	const FItemStack& GetSlot(int32 Slot) const { return Slots[Slot]; }
+
+	//puts as much of Stack in as fits, topping up matching stacks before using empty slots
+	//returns how many items were left over
+	int32 Add(const FItemStack& Stack, int32 MaxStackSize);
+
+	//takes up to Count items out of a slot and returns them
+	FItemStack Remove(int32 Slot, int32 Count);
+
+	//takes up to Count items of a type out of whichever slots hold them, returns how many were taken
+	int32 RemoveItem(FItemID ItemID, int32 Count);
+
+	//total of an item type across all slots
+	int32 CountItem(FItemID ItemID) const;
+
+	//overwrites a slot, an empty stack clears it
+	void Set(int32 Slot, const FItemStack& Stack);
+
+	//bumped on every change, lets anything drawing the inventory skip frames where nothing happened
+	uint32 GetRevision() const { return Revision; }
+
+	//one bit per slot changed since the last call
+	uint32 ConsumeDirtySlots() { const uint32 Dirty = DirtySlots; DirtySlots = 0; return Dirty; }
+
+private:
+	UPROPERTY()
+	FItemStack Slots[NumSlots];
+
+	uint32 Revision = 0;
+
+	uint32 DirtySlots = 0;
+	static_assert(NumSlots <= 32, "DirtySlots has one bit per slot");
+};
@@ -8,8 +8,8 @@ public class MCUE : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "UMG" });
-        PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "UMG", "ProceduralMeshComponent", "PhysicsCore" });
+        PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore", "RenderCore", "Json", "JsonUtilities" });
 
     }
 }
@@ -1,7 +1,25 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
 #include "MCUE.h"
+#include "MCUEStats.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, MCUE, "MCUE" );
- 
\ No newline at end of file
+class FMCUEGameModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+#if !UE_BUILD_SHIPPING
+		FMCUEHitchWatchdog::Startup();
+#endif
+	}
+
+	virtual void ShutdownModule() override
+	{
+#if !UE_BUILD_SHIPPING
+		FMCUEHitchWatchdog::Shutdown();
+#endif
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FMCUEGameModule, MCUE, "MCUE" );
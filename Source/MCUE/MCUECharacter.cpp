@@ -6,21 +6,50 @@
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Engine/NetConnection.h"
 #include "GameFramework/InputSettings.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
+#include "Item/CraftingSubsystem.h"
+#include "Item/DroppedItemSubsystem.h"
+#include "Item/ItemRegistry.h"
 #include "Kismet/GameplayStatics.h"
+#include "MCUEStats.h"
+#include "Projectile/ProjectileSubsystem.h"
 #include "MotionControllerComponent.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
-#include "Block/Block.h"
 #include "TimerManager.h"
 #include "Wieldable/Wieldable.h"
+#include "World/ChunkReplicatorComponent.h"
+#include "World/VoxelMovementComponent.h"
+#include "World/VoxelWorldSubsystem.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
 
+DECLARE_CYCLE_STAT(TEXT("Character Tick"), STAT_MCUECharacterTick, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Check For Blocks"), STAT_MCUECheckForBlocks, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Break Block"), STAT_MCUEBreakBlock, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Block Broken"), STAT_MCUEBlockBroken, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Update Wielded Item"), STAT_MCUEUpdateWieldedItem, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Inventory Changed"), STAT_MCUEInventoryChanged, STATGROUP_MCUE);
+DECLARE_CYCLE_STAT(TEXT("Add Item To Inventory"), STAT_MCUEAddItemToInventory, STATGROUP_MCUE);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Target Traces"), STAT_MCUETargetTraces, STATGROUP_MCUE);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Inventory Items"), STAT_MCUEInventoryItems, STATGROUP_MCUE);
+
+namespace
+{
+	//extra reach the server allows a remote player, its view of the player lags behind the client's
+	constexpr float MiningReachTolerance = UVoxelWorldSubsystem::BlockSize;
+
+	//speed a thrown item leaves the hand at
+	constexpr float ThrowSpeed = 200.0f;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // AMCUECharacter
 
-AMCUECharacter::AMCUECharacter()
+AMCUECharacter::AMCUECharacter(const FObjectInitializer& ObjectInitializer)
+	//movement resolves against block data directly instead of sweeping the physics scene
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UVoxelMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(55.0f, 96.0f);
@@ -56,6 +85,8 @@ AMCUECharacter::AMCUECharacter()
 	FP_MuzzleLocation->SetupAttachment(FP_WieldedItem);
 	FP_MuzzleLocation->SetRelativeLocation(FVector(0.2f, 48.4f, -10.6f));
 
+	ChunkReplicator = CreateDefaultSubobject<UChunkReplicatorComponent>(TEXT("ChunkReplicator"));
+
 	// Default offset from the character location for projectiles to spawn
 	GunOffset = FVector(100.0f, 0.0f, 10.0f);
 
@@ -64,6 +95,16 @@ AMCUECharacter::AMCUECharacter()
 
 	Reach = 250.0f;
 
+	CurrentInventorySlots = 0;
+	WieldedItemID = EItemID::None;
+	MiningItem = EItemID::None;
+	CraftingResult = INDEX_NONE;
+
+	bIsBreaking = false;
+	bHasTargetBlock = false;
+	LastTraceStart = FVector::ZeroVector;
+	LastTraceDirection = FVector::ZeroVector;
+
 }
 
 void AMCUECharacter::BeginPlay()
@@ -74,13 +115,46 @@ void AMCUECharacter::BeginPlay()
 	//Attach gun mesh component to Skeleton, doing it here because the skeleton is not yet created in the constructor
 	FP_WieldedItem->AttachToComponent(Mesh1P, FAttachmentTransformRules(EAttachmentRule::SnapToTarget, true), TEXT("GripPoint"));
 
+	//chunks load around every character and unload once all of them have moved away
+	if (UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>())
+	{
+		VoxelWorld->AddStreamingSource(this);
+	}
+
+	//pickups happen on the server, the owning client hears about them
+	UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+	if (Drops != nullptr && HasAuthority())
+	{
+		Drops->AddCollector(this);
+	}
+}
+
+void AMCUECharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>())
+	{
+		VoxelWorld->RemoveStreamingSource(this);
+	}
+
+	if (UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>())
+	{
+		Drops->RemoveCollector(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AMCUECharacter::Tick(float DeltaTime)
 {
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUECharacterTick, MCUEGameplay);
+
 	Super::Tick(DeltaTime);
 
-	CheckForBlocks();
+	//other players' pawns don't target anything here, the server hears about their targets from their clients
+	if (IsLocallyControlled())
+	{
+		CheckForBlocks();
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -120,81 +194,152 @@ void AMCUECharacter::SetupPlayerInputComponent(class UInputComponent* PlayerInpu
 
 void AMCUECharacter::UpdateWieldedItem()
 {
-	Inventory[CurrentInventorySlots] != NULL ? FP_WieldedItem->SetSkeletalMesh(Inventory[CurrentInventorySlots]->WieldableMesh->SkeletalMesh) : FP_WieldedItem->SetSkeletalMesh(NULL);
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEUpdateWieldedItem, MCUEGameplay);
+
+	const FItemID ItemID = GetWieldedStack().IsEmpty() ? EItemID::None : GetWieldedStack().ItemID;
+	if (ItemID == WieldedItemID)
+	{
+		return;
+	}
+	WieldedItemID = ItemID;
+
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	FP_WieldedItem->SetSkeletalMesh(Items != nullptr ? Items->LoadWieldedMesh(ItemID) : nullptr);
 }
 
-AWieldable * AMCUECharacter::GetCurrentlyWieldedItem()
+void AMCUECharacter::OnInventoryChanged()
 {
-	return Inventory[CurrentInventorySlots] != NULL ? Inventory[CurrentInventorySlots] : nullptr;
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEInventoryChanged, MCUEGameplay);
+
+	UpdateWieldedItem();
+
+	//the local player's items, other pawns' inventories would overwrite it
+	if (IsLocallyControlled())
+	{
+		int32 NumItems = 0;
+		for (int32 Slot = 0; Slot < FInventory::NumSlots; ++Slot)
+		{
+			NumItems += Inventory.GetSlot(Slot).IsEmpty() ? 0 : Inventory.GetSlot(Slot).Count;
+		}
+		SET_DWORD_STAT(STAT_MCUEInventoryItems, NumItems);
+		CSV_CUSTOM_STAT(MCUEGameplay, InventoryItems, NumItems, ECsvCustomStatOp::Set);
+	}
+
+	//only recipes using items whose count changed are looked at
+	if (const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this))
+	{
+		CraftableRecipes.Update(Crafting->GetIndex(), Inventory);
+	}
+
+	for (uint32 Dirty = Inventory.ConsumeDirtySlots(); Dirty != 0; Dirty &= Dirty - 1)
+	{
+		OnInventorySlotChanged.Broadcast((int32)FMath::CountTrailingZeros(Dirty));
+	}
 }
 
 void AMCUECharacter::Throw()
 {
-	//get the currently wielded item
-	AWieldable* ItemToThrow = GetCurrentlyWieldedItem();
-
-	//raycast to find drop location
-	FHitResult LinetraceHit;
-
-	FVector StartTrace = FirstPersonCameraComponent->GetComponentLocation();
-	FVector EndTrace = (FirstPersonCameraComponent->GetForwardVector() * Reach) + StartTrace;
+	if (GetWieldedStack().IsEmpty())
+	{
+		return;
+	}
 
-	FCollisionQueryParams CQP;
-	CQP.AddIgnoredActor(this);
+	//drop it just in front of the targeted block, or at the end of our reach
+	FVector DropLocation = (FirstPersonCameraComponent->GetForwardVector() * Reach) + FirstPersonCameraComponent->GetComponentLocation();
 
-	GetWorld()->LineTraceSingleByChannel(LinetraceHit, StartTrace, EndTrace, ECollisionChannel::ECC_WorldDynamic, CQP);
+	if (bHasTargetBlock)
+	{
+		DropLocation = CurrentBlockHitLocation + FVector(CurrentBlockHitNormal) * 20.0f;
+	}
 
-	FVector DropLocation = EndTrace;
+	//one item at a time, tossed a little way forward
+	const FVector Velocity = FirstPersonCameraComponent->GetForwardVector() * ThrowSpeed;
 
-	if (LinetraceHit.GetActor() != NULL)
+	if (!HasAuthority())
 	{
-		DropLocation = (LinetraceHit.ImpactPoint + 20.0f);
+		ServerThrow((uint8)CurrentInventorySlots, DropLocation, Velocity);
 	}
 
-	if (ItemToThrow != NULL)
+	ThrowWielded(DropLocation, Velocity);
+}
+
+void AMCUECharacter::ThrowWielded(const FVector& DropLocation, const FVector& Velocity)
+{
+	UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+	if (GetWieldedStack().IsEmpty() || Drops == nullptr)
 	{
-		UWorld* const World = GetWorld();
-		if (World != NULL)
-		{
-			ItemToThrow->SetActorLocationAndRotation(DropLocation, FRotator::ZeroRotator);
-			ItemToThrow->Hide(false);
-			Inventory[CurrentInventorySlots] = NULL;
-		}
+		return;
 	}
 
-	UpdateWieldedItem();
+	Drops->SpawnItem(Inventory.Remove(CurrentInventorySlots, 1), DropLocation, Velocity, true);
+	OnInventoryChanged();
 }
 
 void AMCUECharacter::MoveUpInventorySlots()
 {
-	CurrentInventorySlots = FMath::Abs((CurrentInventorySlots + 1) % NUM_OF_INVENTORY_SLOTS);
-	UpdateWieldedItem();
+	SelectInventorySlot((CurrentInventorySlots + 1) % FInventory::NumSlots);
 }
 
 void AMCUECharacter::MoveDownInventorySlots()
 {
-	if (CurrentInventorySlots == 0)
+	SelectInventorySlot((CurrentInventorySlots + FInventory::NumSlots - 1) % FInventory::NumSlots);
+}
+
+void AMCUECharacter::SelectInventorySlot(int32 Slot)
+{
+	if (!HasAuthority())
 	{
-		CurrentInventorySlots = 9; 
-		UpdateWieldedItem();
-		return;
+		ServerSetInventorySlot((uint8)Slot);
 	}
-	CurrentInventorySlots = FMath::Abs((CurrentInventorySlots + 1) % NUM_OF_INVENTORY_SLOTS);
+
+	CurrentInventorySlots = Slot;
+	UpdateWieldedItem();
+	OnCurrentInventorySlotChanged.Broadcast(CurrentInventorySlots);
+}
+
+bool AMCUECharacter::ServerSetInventorySlot_Validate(uint8 Slot)
+{
+	return Slot < FInventory::NumSlots;
+}
+
+void AMCUECharacter::ServerSetInventorySlot_Implementation(uint8 Slot)
+{
+	CurrentInventorySlots = Slot;
+	UpdateWieldedItem();
+}
+
+bool AMCUECharacter::ServerThrow_Validate(uint8 Slot, FVector DropLocation, FVector Velocity)
+{
+	return Slot < FInventory::NumSlots && !DropLocation.ContainsNaN() && !Velocity.ContainsNaN();
+}
+
+void AMCUECharacter::ServerThrow_Implementation(uint8 Slot, FVector DropLocation, FVector Velocity)
+{
+	CurrentInventorySlots = Slot;
 	UpdateWieldedItem();
+
+	//the client picks where it lands, but not further than it could reach or faster than a throw
+	const FVector ViewLocation = GetPawnViewLocation();
+	const FVector ClampedLocation = ViewLocation + (DropLocation - ViewLocation).GetClampedToMaxSize(Reach + MiningReachTolerance);
+	ThrowWielded(ClampedLocation, Velocity.GetClampedToMaxSize(ThrowSpeed));
 }
 
 void AMCUECharacter::OnHit()
 {
 	PlayHitAnim();
 
-	if (CurrentBlock != nullptr)
+	if (bHasTargetBlock)
 	{
 		bIsBreaking = true;
+		MiningItem = GetWieldedStack().IsEmpty() ? EItemID::None : GetWieldedStack().ItemID;
 
-		float TimeBetweenBreaks = ((CurrentBlock->Resistance) / 100.f) / 2;
-
-		GetWorld()->GetTimerManager().SetTimer(BlockBreakingHandle, this, &AMCUECharacter::BreakBlock, TimeBetweenBreaks, true);
+		StartBreakTimer();
 		GetWorld()->GetTimerManager().SetTimer(HitAnimHandle, this, &AMCUECharacter::PlayHitAnim, 0.4f, true);
+
+		if (!HasAuthority())
+		{
+			ServerStartMining(CurrentBlockCoord, (uint8)CurrentInventorySlots, MiningItem);
+		}
 	}
 }
 
@@ -203,12 +348,27 @@ void AMCUECharacter::EndHit()
 	GetWorld()->GetTimerManager().ClearTimer(BlockBreakingHandle);
 	GetWorld()->GetTimerManager().ClearTimer(HitAnimHandle);
 
-	bIsBreaking = false;
-
-	if (CurrentBlock != nullptr)
+	if (bIsBreaking && !HasAuthority())
 	{
-		CurrentBlock->ResetBlock();
+		ServerStopMining();
 	}
+
+	//the damage stays on the block and decays in the world
+	bIsBreaking = false;
+}
+
+void AMCUECharacter::StartBreakTimer()
+{
+	//bare hands unless the item is a tool
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	const FItemDefinition* Wielded = Items != nullptr ? Items->Find(MiningItem) : nullptr;
+	const uint8 Tool = Wielded != nullptr ? Wielded->ToolType : (uint8)AWieldable::Unarmed;
+	const uint8 Material = Wielded != nullptr ? Wielded->MaterialType : (uint8)AWieldable::None;
+
+	//one hit per damage stage, spread over the whole break time
+	const float TimeBetweenBreaks = FMath::Max(FBlockRegistry::GetBreakTime(CurrentBlockID, Tool, Material) / FBlockDamageMap::NumStages, 0.05f);
+
+	GetWorld()->GetTimerManager().SetTimer(BlockBreakingHandle, this, &AMCUECharacter::BreakBlock, TimeBetweenBreaks, true);
 }
 
 void AMCUECharacter::PlayHitAnim()
@@ -227,45 +387,283 @@ void AMCUECharacter::PlayHitAnim()
 
 void AMCUECharacter::BreakBlock()
 {
-	if (bIsBreaking && CurrentBlock != nullptr && !CurrentBlock->IsPendingKill())
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEBreakBlock, MCUEGameplay);
+
+	if (!bIsBreaking || !bHasTargetBlock)
+	{
+		return;
+	}
+
+	const FBlockID BrokenBlock = CurrentBlockID;
+	if (!GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->DamageBlock(CurrentBlockCoord, this))
+	{
+		return;
+	}
+
+	//a remote client's break is only a prediction until the server agrees, the drop and the tool wear wait for that
+	if (!HasAuthority())
+	{
+		PredictedBreaks.Add(FPredictedBreak{ CurrentBlockCoord, BrokenBlock, MiningItem });
+		ServerClaimBreak(CurrentBlockCoord);
+		return;
+	}
+
+	//the client will claim this one, it gets the drop when it does
+	if (!IsLocallyControlled())
+	{
+		UnclaimedBreaks.Add(CurrentBlockCoord);
+	}
+
+	OnBlockBroken(CurrentBlockCoord, BrokenBlock, MiningItem);
+}
+
+void AMCUECharacter::OnBlockBroken(const FIntVector& BlockCoord, FBlockID BrokenBlock, FItemID ToolItem)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEBlockBroken, MCUEGameplay);
+
+	UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Items == nullptr)
+	{
+		return;
+	}
+
+	const FItemDefinition* Tool = Items->Find(ToolItem);
+	const uint8 Material = Tool != nullptr ? Tool->MaterialType : (uint8)AWieldable::None;
+
+	//the block item with the same id as the drop pops out of the broken block
+	const FBlockProperties& Properties = FBlockRegistry::Get(BrokenBlock);
+	UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+	if (Drops != nullptr && Properties.Drop != EBlockID::Air && FBlockRegistry::CanHarvest(BrokenBlock, Material))
 	{
-		CurrentBlock->Break();
+		const FVector Center = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->GetBlockCenter(BlockCoord);
+		const FVector Velocity(FMath::FRandRange(-50.0f, 50.0f), FMath::FRandRange(-50.0f, 50.0f), 150.0f);
+		Drops->SpawnItem(Items->MakeStack(EBlockID::GetType(Properties.Drop), Properties.DropCount), Center, Velocity);
+	}
+
+	//tools wear by one use per block, a worn out one is gone
+	FItemStack Wielded = GetWieldedStack();
+	if (!Wielded.IsEmpty() && Wielded.ItemID == ToolItem && Wielded.Durability > 0)
+	{
+		--Wielded.Durability;
+		if (Wielded.Durability == 0)
+		{
+			Wielded = FItemStack();
+			MiningItem = EItemID::None;
+		}
+		Inventory.Set(CurrentInventorySlots, Wielded);
+		OnInventoryChanged();
 	}
 }
 
 void AMCUECharacter::CheckForBlocks()
 {
-	FHitResult LinetraceHit;
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUECheckForBlocks, MCUEGameplay);
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
 
 	FVector StartTrace = FirstPersonCameraComponent->GetComponentLocation();
-	FVector EndTrace = (FirstPersonCameraComponent->GetForwardVector() * Reach) + StartTrace;
+	FVector Direction = FirstPersonCameraComponent->GetForwardVector();
 
-	FCollisionQueryParams CQP;
-	CQP.AddIgnoredActor(this);
+	//nothing the ray could have seen has moved or changed, the cached target is still right
+	if (StartTrace == LastTraceStart && Direction == LastTraceDirection && !HaveTracedChunksChanged())
+	{
+		return;
+	}
 
-	GetWorld()->LineTraceSingleByChannel(LinetraceHit, StartTrace, EndTrace, ECollisionChannel::ECC_WorldDynamic, CQP);
+	LastTraceStart = StartTrace;
+	LastTraceDirection = Direction;
+	INC_DWORD_STAT(STAT_MCUETargetTraces);
 
-	ABlock* PotentialBlock = Cast<ABlock>(LinetraceHit.GetActor());
+	FVoxelHit Hit;
+	TArray<FIntPoint, TInlineAllocator<4>> TracedChunks;
+	const bool bHit = VoxelWorld->Raycast(StartTrace, Direction, Reach, Hit, &TracedChunks);
 
-	if (PotentialBlock != CurrentBlock && CurrentBlock != nullptr)
+	TracedChunkRevisions.Reset();
+	for (const FIntPoint& ChunkCoord : TracedChunks)
 	{
-		CurrentBlock->ResetBlock();
+		const FChunk* Chunk = VoxelWorld->FindChunk(ChunkCoord);
+		TracedChunkRevisions.Emplace(ChunkCoord, Chunk != nullptr ? Chunk->GetRevision() : MAX_uint32);
 	}
 
-	if (PotentialBlock == NULL)
+	const bool bTargetChanged = bHit != bHasTargetBlock || (bHit && Hit.BlockCoord != CurrentBlockCoord);
+	bHasTargetBlock = bHit;
+
+	if (bHit)
+	{
+		CurrentBlockCoord = Hit.BlockCoord;
+		CurrentBlockID = Hit.Block;
+		CurrentBlockHitLocation = Hit.Location;
+		CurrentBlockHitNormal = Hit.Normal;
+	}
+
+	//the server's break timer has to hit the same block ours does
+	if (bTargetChanged && bIsBreaking && !HasAuthority())
 	{
-		CurrentBlock = nullptr;
+		ServerSetMiningTarget(bHasTargetBlock, CurrentBlockCoord);
+	}
+}
+
+bool AMCUECharacter::ServerStartMining_Validate(FIntVector BlockCoord, uint8 InventorySlot, int32 ToolItem)
+{
+	return UVoxelWorldSubsystem::IsValidHeight(BlockCoord.Z) && InventorySlot < FInventory::NumSlots && ToolItem >= 0 && ToolItem <= MAX_uint16;
+}
+
+void AMCUECharacter::ServerStartMining_Implementation(FIntVector BlockCoord, uint8 InventorySlot, int32 ToolItem)
+{
+	//the slot decides which stack wears, the break is timed with what the server has in it
+	CurrentInventorySlots = InventorySlot;
+	UpdateWieldedItem();
+
+	bIsBreaking = false;
+	UnclaimedBreaks.Reset();
+
+	MiningItem = GetWieldedStack().IsEmpty() ? EItemID::None : GetWieldedStack().ItemID;
+	if (MiningItem != (FItemID)ToolItem)
+	{
+		//every break the client claims for this is rejected, which puts its blocks back
+		UE_LOG(LogFPChar, Log, TEXT("Rejected mining with item %d by %s, slot %d holds %d"), ToolItem, *GetName(), InventorySlot, (int32)MiningItem);
+		GetWorld()->GetTimerManager().ClearTimer(BlockBreakingHandle);
 		return;
 	}
-	else
+
+	SetMiningTarget(true, BlockCoord);
+	if (!bHasTargetBlock)
+	{
+		return;
+	}
+
+	bIsBreaking = true;
+	StartBreakTimer();
+}
+
+bool AMCUECharacter::ServerSetMiningTarget_Validate(bool bHasTarget, FIntVector BlockCoord)
+{
+	return !bHasTarget || UVoxelWorldSubsystem::IsValidHeight(BlockCoord.Z);
+}
+
+void AMCUECharacter::ServerSetMiningTarget_Implementation(bool bHasTarget, FIntVector BlockCoord)
+{
+	SetMiningTarget(bHasTarget, BlockCoord);
+}
+
+bool AMCUECharacter::ServerStopMining_Validate()
+{
+	return true;
+}
+
+void AMCUECharacter::ServerStopMining_Implementation()
+{
+	EndHit();
+}
+
+bool AMCUECharacter::ServerClaimBreak_Validate(FIntVector BlockCoord)
+{
+	return UVoxelWorldSubsystem::IsValidHeight(BlockCoord.Z);
+}
+
+void AMCUECharacter::ServerClaimBreak_Implementation(FIntVector BlockCoord)
+{
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
 	{
-		if (CurrentBlock != nullptr && !bIsBreaking)
+		return;
+	}
+
+	//our own timer got there first, the change is already on its way to the client
+	const FBlockID Block = VoxelWorld->GetBlock(BlockCoord);
+	if (Block == EBlockID::Air && UnclaimedBreaks.RemoveSwap(BlockCoord) > 0)
+	{
+		ClientConfirmBreak(BlockCoord);
+		return;
+	}
+
+	//the client started the timer half a round trip before we did, so we may be that many hits behind it, plus one for timer jitter
+	bool bAccepted = bIsBreaking && bHasTargetBlock && CurrentBlockCoord == BlockCoord && FBlockRegistry::IsSolid(Block);
+	if (bAccepted)
+	{
+		const float TimeBetweenBreaks = GetWorld()->GetTimerManager().GetTimerRate(BlockBreakingHandle);
+		const UNetConnection* Connection = GetNetConnection();
+		const float OneWayLatency = Connection != nullptr ? Connection->AvgLag * 0.5f : 0.0f;
+		const int32 StagesBehind = 1 + (TimeBetweenBreaks > 0.0f ? FMath::CeilToInt(OneWayLatency / TimeBetweenBreaks) : 0);
+
+		bAccepted = VoxelWorld->GetBlockDamage().GetStage(BlockCoord) + StagesBehind >= FBlockDamageMap::NumStages;
+	}
+
+	if (!bAccepted)
+	{
+		UE_LOG(LogFPChar, Log, TEXT("Rejected break of (%d, %d, %d) by %s"), BlockCoord.X, BlockCoord.Y, BlockCoord.Z, *GetName());
+		ClientRejectBreak(BlockCoord, Block);
+		return;
+	}
+
+	VoxelWorld->SetBlock(BlockCoord, EBlockID::Air);
+	OnBlockBroken(BlockCoord, Block, MiningItem);
+	ClientConfirmBreak(BlockCoord);
+}
+
+void AMCUECharacter::ClientConfirmBreak_Implementation(FIntVector BlockCoord)
+{
+	const int32 Index = PredictedBreaks.IndexOfByPredicate([&BlockCoord](const FPredictedBreak& Break) { return Break.BlockCoord == BlockCoord; });
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FPredictedBreak Break = PredictedBreaks[Index];
+	PredictedBreaks.RemoveAt(Index);
+	OnBlockBroken(Break.BlockCoord, Break.Block, Break.ToolItem);
+}
+
+void AMCUECharacter::ClientRejectBreak_Implementation(FIntVector BlockCoord, int32 ServerBlock)
+{
+	//rolls the prediction back, the cracks go with it, nothing was dropped or worn for it yet
+	PredictedBreaks.RemoveAll([&BlockCoord](const FPredictedBreak& Break) { return Break.BlockCoord == BlockCoord; });
+
+	if (UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>())
+	{
+		VoxelWorld->SetBlock(BlockCoord, (FBlockID)ServerBlock);
+	}
+}
+
+void AMCUECharacter::SetMiningTarget(bool bHasTarget, const FIntVector& BlockCoord)
+{
+	bHasTargetBlock = bHasTarget && CanMineBlock(BlockCoord);
+	if (bHasTargetBlock)
+	{
+		CurrentBlockCoord = BlockCoord;
+		CurrentBlockID = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->GetBlock(BlockCoord);
+	}
+}
+
+bool AMCUECharacter::CanMineBlock(const FIntVector& BlockCoord) const
+{
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr || !FBlockRegistry::IsSolid(VoxelWorld->GetBlock(BlockCoord)))
+	{
+		return false;
+	}
+
+	const FBox BlockBox(VoxelWorld->BlockToWorld(BlockCoord), VoxelWorld->BlockToWorld(BlockCoord + FIntVector(1, 1, 1)));
+	return BlockBox.ComputeSquaredDistanceToPoint(GetPawnViewLocation()) <= FMath::Square(Reach + MiningReachTolerance);
+}
+
+bool AMCUECharacter::HaveTracedChunksChanged() const
+{
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+
+	for (const TPair<FIntPoint, uint32>& Traced : TracedChunkRevisions)
+	{
+		const FChunk* Chunk = VoxelWorld->FindChunk(Traced.Key);
+		if ((Chunk != nullptr ? Chunk->GetRevision() : MAX_uint32) != Traced.Value)
 		{
-			CurrentBlock->ResetBlock();
+			return true;
 		}
-		CurrentBlock = PotentialBlock;
-		//GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, *CurrentBlock->GetName());
 	}
+	return false;
 }
 
 int32 AMCUECharacter::GetCurrentInventorySlot()
@@ -275,40 +673,312 @@ int32 AMCUECharacter::GetCurrentInventorySlot()
 
 bool AMCUECharacter::AddItemToInventory(AWieldable * Item)
 {
-	if (Item != NULL)
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEAddItemToInventory, MCUEGameplay);
+
+	UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Item == nullptr || Items == nullptr)
 	{
-		const int32 AvailableSlot = Inventory.Find(nullptr);
+		return false;
+	}
 
-		if (AvailableSlot != INDEX_NONE)
-		{
-			Inventory[AvailableSlot] = Item;
-			return true;
-		}
-		else
-		{
-			return false;
-		}
+	//only the item id is kept, the actor is destroyed by the caller
+	const FItemID ItemID = Items->GetPickupItem(*Item);
+	return ItemID != EItemID::None && AddItemStack(Items->MakeStack(ItemID, 1)) == 0;
+}
+
+int32 AMCUECharacter::AddItemStack(const FItemStack& Stack)
+{
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Items == nullptr || Stack.IsEmpty())
+	{
+		return Stack.Count;
 	}
-	else
+
+	const int32 Remaining = Inventory.Add(Stack, Items->GetMaxStackSize(Stack.ItemID));
+
+	//the slot in hand may have just been filled
+	OnInventoryChanged();
+	return Remaining;
+}
+
+int32 AMCUECharacter::CollectItemStack(const FItemStack& Stack)
+{
+	const int32 Remaining = AddItemStack(Stack);
+
+	if (Remaining < Stack.Count && !IsLocallyControlled())
 	{
-		return false;
+		FItemStack Taken = Stack;
+		Taken.Count = (uint8)(Stack.Count - Remaining);
+		ClientReceivePickup(Taken);
+	}
+	return Remaining;
+}
+
+void AMCUECharacter::ClientReceivePickup_Implementation(FItemStack Stack)
+{
+	AddItemStack(Stack);
+
+	if (UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>())
+	{
+		Drops->RemoveCollected(Stack, GetActorLocation());
 	}
 }
 
 UTexture2D * AMCUECharacter::GetThumbnailAtInventorySlot(uint8 Slot)
 {
-	if (Inventory[Slot] != NULL)
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Slot >= FInventory::NumSlots || Items == nullptr || Inventory.GetSlot(Slot).IsEmpty())
+	{
+		return nullptr;
+	}
+	return Items->GetThumbnail(Inventory.GetSlot(Slot).ItemID);
+}
+
+int32 AMCUECharacter::GetItemCountAtInventorySlot(uint8 Slot) const
+{
+	return Slot < FInventory::NumSlots ? Inventory.GetSlot(Slot).Count : 0;
+}
+
+bool AMCUECharacter::MoveItemToCraftingGrid(uint8 InventorySlot, uint8 GridCell)
+{
+	if (InventorySlot >= FInventory::NumSlots || GridCell >= FCraftingIndex::GridCells || Inventory.GetSlot(InventorySlot).IsEmpty())
+	{
+		return false;
+	}
+
+	FItemStack& Cell = CraftingGrid[GridCell];
+	if (!Cell.IsEmpty() && (!Cell.CanStackWith(Inventory.GetSlot(InventorySlot)) || Cell.Count == MAX_uint8))
+	{
+		return false;
+	}
+
+	if (!HasAuthority())
+	{
+		ServerMoveItemToCraftingGrid(InventorySlot, GridCell);
+	}
+
+	const FItemStack Moved = Inventory.Remove(InventorySlot, 1);
+	if (Cell.IsEmpty())
 	{
-		return Inventory[Slot]->PickupThumbnail;
+		Cell = Moved;
 	}
 	else
+	{
+		++Cell.Count;
+	}
+
+	OnInventoryChanged();
+	UpdateCraftingResult();
+	return true;
+}
+
+void AMCUECharacter::ReturnCraftingGridCell(uint8 GridCell)
+{
+	if (GridCell >= FCraftingIndex::GridCells || CraftingGrid[GridCell].IsEmpty())
+	{
+		return;
+	}
+
+	if (!HasAuthority())
+	{
+		ServerReturnCraftingGridCell(GridCell);
+	}
+
+	const int32 Remaining = AddItemStack(CraftingGrid[GridCell]);
+	CraftingGrid[GridCell].Count = (uint8)Remaining;
+	if (Remaining == 0)
+	{
+		CraftingGrid[GridCell] = FItemStack();
+	}
+
+	UpdateCraftingResult();
+}
+
+UTexture2D* AMCUECharacter::GetThumbnailAtCraftingCell(uint8 GridCell)
+{
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (GridCell >= FCraftingIndex::GridCells || Items == nullptr || CraftingGrid[GridCell].IsEmpty())
+	{
+		return nullptr;
+	}
+	return Items->GetThumbnail(CraftingGrid[GridCell].ItemID);
+}
+
+UTexture2D* AMCUECharacter::GetCraftingResultThumbnail()
+{
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this);
+	if (CraftingResult == INDEX_NONE || Items == nullptr || Crafting == nullptr)
+	{
+		return nullptr;
+	}
+	return Items->GetThumbnail(Crafting->GetIndex().GetRecipe(CraftingResult).Result);
+}
+
+bool AMCUECharacter::CraftFromGrid()
+{
+	const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this);
+	if (CraftingResult == INDEX_NONE || Crafting == nullptr)
+	{
+		return false;
+	}
+
+	if (!HasAuthority())
+	{
+		ServerCraftFromGrid();
+	}
+
+	for (FItemStack& Cell : CraftingGrid)
+	{
+		if (!Cell.IsEmpty() && --Cell.Count == 0)
+		{
+			Cell = FItemStack();
+		}
+	}
+
+	GiveCraftingResult(Crafting->GetIndex().GetRecipe(CraftingResult));
+	UpdateCraftingResult();
+	return true;
+}
+
+UTexture2D* AMCUECharacter::GetCraftableRecipeThumbnail(int32 Index)
+{
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this);
+	if (Items == nullptr || Crafting == nullptr || !CraftableRecipes.GetRecipes().IsValidIndex(Index))
+	{
+		return nullptr;
+	}
+	return Items->GetThumbnail(Crafting->GetIndex().GetRecipe(CraftableRecipes.GetRecipes()[Index]).Result);
+}
+
+bool AMCUECharacter::CraftFromInventory(int32 Index)
+{
+	if (!CraftableRecipes.GetRecipes().IsValidIndex(Index))
 	{
 		return false;
 	}
+
+	const int32 RecipeIndex = CraftableRecipes.GetRecipes()[Index];
+	if (!HasAuthority())
+	{
+		ServerCraftFromInventory(RecipeIndex);
+	}
+	return CraftRecipeFromInventory(RecipeIndex);
+}
+
+bool AMCUECharacter::CraftRecipeFromInventory(int32 RecipeIndex)
+{
+	const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this);
+	if (Crafting == nullptr || !CraftableRecipes.GetRecipes().Contains(RecipeIndex))
+	{
+		return false;
+	}
+
+	const FCraftingIndex::FRecipe& Recipe = Crafting->GetIndex().GetRecipe(RecipeIndex);
+	for (const TPair<FItemID, int32>& Ingredient : Recipe.Ingredients)
+	{
+		Inventory.RemoveItem(Ingredient.Key, Ingredient.Value);
+	}
+
+	GiveCraftingResult(Recipe);
+	OnInventoryChanged();
+	return true;
+}
+
+bool AMCUECharacter::ServerMoveItemToCraftingGrid_Validate(uint8 InventorySlot, uint8 GridCell)
+{
+	return InventorySlot < FInventory::NumSlots && GridCell < FCraftingIndex::GridCells;
+}
+
+void AMCUECharacter::ServerMoveItemToCraftingGrid_Implementation(uint8 InventorySlot, uint8 GridCell)
+{
+	MoveItemToCraftingGrid(InventorySlot, GridCell);
+}
+
+bool AMCUECharacter::ServerReturnCraftingGridCell_Validate(uint8 GridCell)
+{
+	return GridCell < FCraftingIndex::GridCells;
+}
+
+void AMCUECharacter::ServerReturnCraftingGridCell_Implementation(uint8 GridCell)
+{
+	ReturnCraftingGridCell(GridCell);
+}
+
+bool AMCUECharacter::ServerCraftFromGrid_Validate()
+{
+	return true;
+}
+
+void AMCUECharacter::ServerCraftFromGrid_Implementation()
+{
+	CraftFromGrid();
+}
+
+bool AMCUECharacter::ServerCraftFromInventory_Validate(int32 RecipeIndex)
+{
+	return RecipeIndex >= 0;
+}
+
+void AMCUECharacter::ServerCraftFromInventory_Implementation(int32 RecipeIndex)
+{
+	//checked against what the server's copy of the inventory can make, not the client's
+	CraftRecipeFromInventory(RecipeIndex);
+}
+
+void AMCUECharacter::GiveCraftingResult(const FCraftingIndex::FRecipe& Recipe)
+{
+	const UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Items == nullptr)
+	{
+		return;
+	}
+
+	FItemStack Result = Items->MakeStack(Recipe.Result, Recipe.ResultCount);
+	Result.Count = (uint8)AddItemStack(Result);
+
+	UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+	if (!Result.IsEmpty() && Drops != nullptr)
+	{
+		Drops->SpawnItem(Result, GetActorLocation(), FVector::ZeroVector, true);
+	}
+}
+
+void AMCUECharacter::UpdateCraftingResult()
+{
+	const UCraftingSubsystem* Crafting = UCraftingSubsystem::Get(this);
+	if (Crafting == nullptr)
+	{
+		CraftingResult = INDEX_NONE;
+		return;
+	}
+
+	FItemID Grid[FCraftingIndex::GridCells];
+	for (int32 Cell = 0; Cell < FCraftingIndex::GridCells; ++Cell)
+	{
+		Grid[Cell] = CraftingGrid[Cell].IsEmpty() ? EItemID::None : CraftingGrid[Cell].ItemID;
+	}
+	CraftingResult = Crafting->GetIndex().Find(Grid);
 }
 
 void AMCUECharacter::OnFire()
 {
+	//projectiles are pooled and moved together by the projectile subsystem, there is no actor per shot
+	if (UProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UProjectileSubsystem>())
+	{
+		const FRotator SpawnRotation = GetControlRotation();
+		// MuzzleOffset is in camera space, so transform it to world space before offsetting from the character location to find the final muzzle position
+		const FVector SpawnLocation = ((FP_MuzzleLocation != nullptr) ? FP_MuzzleLocation->GetComponentLocation() : GetActorLocation()) + SpawnRotation.RotateVector(GunOffset);
+		Projectiles->Fire(SpawnLocation, SpawnRotation.Vector(), this);
+	}
+
+	// try and play the sound if specified
+	if (FireSound != NULL)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation());
+	}
+
 	// try and play a firing animation if specified
 	if (FireAnimation != NULL)
 	{
@@ -4,12 +4,16 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Item/CraftingIndex.h"
+#include "Item/ItemStack.h"
+#include "World/BlockTypes.h"
 #include "MCUECharacter.generated.h"
 
 class UInputComponent;
-class ABlock;
 class AWieldable;
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FInventorySlotSignature, int32, Slot);
+
 UCLASS(config=Game)
 class AMCUECharacter : public ACharacter
 {
@@ -26,11 +30,16 @@ class AMCUECharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FirstPersonCameraComponent;
 
+	//benchmark scenarios drive the input handlers directly
+	friend class FBenchmarkScenario;
+
 public:
-	AMCUECharacter();
+	AMCUECharacter(const FObjectInitializer& ObjectInitializer);
 
 	virtual void BeginPlay();
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void Tick(float DeltaTime) override;
 
 	/** Pawn mesh: 1st person view (arms; seen only by self) */
@@ -41,6 +50,10 @@ public:
 	UPROPERTY(VisibleDefaultsOnly, Category = Mesh)
 	class USkeletalMeshComponent* FP_WieldedItem;
 
+	//carries the block data of the chunks around this player to its client
+	UPROPERTY(VisibleDefaultsOnly, Category = Voxel)
+	class UChunkReplicatorComponent* ChunkReplicator;
+
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
 	float BaseTurnRate;
@@ -69,14 +82,67 @@ public:
 	UFUNCTION(BlueprintPure, Category = "HUD")
 	int32 GetCurrentInventorySlot();
 
-	//adds an item to our inventory
+	//broadcast once for every slot whose contents changed, so the hud only redraws that slot
+	UPROPERTY(BlueprintAssignable, Category = "Inventory")
+	FInventorySlotSignature OnInventorySlotChanged;
+
+	//broadcast when a different slot is selected
+	UPROPERTY(BlueprintAssignable, Category = "HUD")
+	FInventorySlotSignature OnCurrentInventorySlotChanged;
+
+	//turns a pickup into an item in our inventory, false if there was no room for it
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	bool AddItemToInventory(AWieldable* Item);
 
+	//puts items in our inventory, returns how many didn't fit
+	int32 AddItemStack(const FItemStack& Stack);
+
+	//a dropped item picked up on the server, the owning client is told what it got
+	int32 CollectItemStack(const FItemStack& Stack);
+
 	//gets the thumball for a given item
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	UTexture2D* GetThumbnailAtInventorySlot(uint8 Slot);
 
+	//number of items in a slot, 0 if it is empty
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	int32 GetItemCountAtInventorySlot(uint8 Slot) const;
+
+	const FInventory& GetInventory() const { return Inventory; }
+
+	//crafting runs straight away on the owning client and again on the server with its own copy of the inventory,
+	//the same way mining does, so the server never takes the client's word for what an inventory holds
+
+	//moves one item from an inventory slot onto the crafting grid, false if the cell holds something else
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	bool MoveItemToCraftingGrid(uint8 InventorySlot, uint8 GridCell);
+
+	//puts everything in a grid cell back in the inventory
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	void ReturnCraftingGridCell(uint8 GridCell);
+
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+	UTexture2D* GetThumbnailAtCraftingCell(uint8 GridCell);
+
+	//what the grid makes right now, nullptr if it matches no recipe
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+	UTexture2D* GetCraftingResultThumbnail();
+
+	//uses one item from every grid cell, false if the grid matches no recipe
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	bool CraftFromGrid();
+
+	//recipes the inventory holds every ingredient for, kept up to date as the inventory changes
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+	int32 GetNumCraftableRecipes() const { return CraftableRecipes.GetRecipes().Num(); }
+
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+	UTexture2D* GetCraftableRecipeThumbnail(int32 Index);
+
+	//crafts one of the craftable recipes straight from the inventory
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	bool CraftFromInventory(int32 Index);
+
 	//the type of tool and tool material of the currently wielded item
 	uint8 ToolType;
 	uint8 MaterialType;
@@ -106,25 +172,45 @@ protected:
 
 private:
 
-	//number of inventory slots
-	const int32 NUM_OF_INVENTORY_SLOTS = 10;
-
 	//current inv slots
 	int32 CurrentInventorySlots;
 
-	//update the wielded item
+	//update the wielded item, the mesh is only looked up when the item in hand changes
 	void UpdateWieldedItem();
 
-	//gets the current wielded item
-	AWieldable* GetCurrentlyWieldedItem();
+	//called after anything changes the inventory, tells the hud which slots changed
+	void OnInventoryChanged();
+
+	//item the wielded mesh was last resolved for
+	FItemID WieldedItemID;
+
+	//gets the current wielded item, empty for bare hands
+	const FItemStack& GetWieldedStack() const { return Inventory.GetSlot(CurrentInventorySlots); }
 
 	//throws the current wielded item
 	void Throw();
 
+	//drops one of the wielded item, on the client that threw it and on the server
+	void ThrowWielded(const FVector& DropLocation, const FVector& Velocity);
+
 	//increment and decrement inventory slots
 	void MoveUpInventorySlots();
 	void MoveDownInventorySlots();
 
+	//selects a slot, the server selects it in its copy too
+	void SelectInventorySlot(int32 Slot);
+
+	//the owning client's inventory changes that aren't crafting, run again on the server's copy
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetInventorySlot(uint8 Slot);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerThrow(uint8 Slot, FVector DropLocation, FVector Velocity);
+
+	//only the server picks items up, the owning client adds what it got and removes its own copy of the drop
+	UFUNCTION(Client, Reliable)
+	void ClientReceivePickup(FItemStack Stack);
+
 	//true if player is breaking, false otherwise
 	bool bIsBreaking;
 
@@ -138,11 +224,77 @@ private:
 	//called when we want to break a block
 	void BreakBlock();
 
+	//starts hitting the current target once per damage stage with MiningItem, the same rules on the client and the server
+	void StartBreakTimer();
+
+	//drops the block's item and wears the tool it was mined with, on whichever side broke it
+	void OnBlockBroken(const FIntVector& BlockCoord, FBlockID BrokenBlock, FItemID ToolItem);
+
+	//item the current mining started with
+	FItemID MiningItem;
+
+	//mining for players on remote clients:
+	//the client runs its own break timer and removes blocks straight away, the server runs the same timer on the target
+	//with the item in its own copy of the slot the client mines from, and checks every block the client claims to have broken against its own progress
+	//the drop and the tool wear of a predicted break wait for the server to confirm it
+	//the client's item is only compared with the server's, mining doesn't start if they differ
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerStartMining(FIntVector BlockCoord, uint8 InventorySlot, int32 ToolItem);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetMiningTarget(bool bHasTarget, FIntVector BlockCoord);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerStopMining();
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerClaimBreak(FIntVector BlockCoord);
+
+	//the server broke the block too, the client gets its drop and wears its tool
+	UFUNCTION(Client, Reliable)
+	void ClientConfirmBreak(FIntVector BlockCoord);
+
+	//the server didn't accept a block the client broke, puts back what the server has there
+	UFUNCTION(Client, Reliable)
+	void ClientRejectBreak(FIntVector BlockCoord, int32 ServerBlock);
+
+	//client side, breaks sent to the server and not answered yet
+	struct FPredictedBreak
+	{
+		FIntVector BlockCoord;
+		FBlockID Block;
+		FItemID ToolItem;
+	};
+	TArray<FPredictedBreak> PredictedBreaks;
+
+	//server side, blocks of a remote player the server's own timer broke before the client claimed them
+	TArray<FIntVector> UnclaimedBreaks;
+
+	//server side, points the break timer at what the client is looking at if it is close enough to mine
+	void SetMiningTarget(bool bHasTarget, const FIntVector& BlockCoord);
+
+	//true if the block is solid and within reach of where the server has us
+	bool CanMineBlock(const FIntVector& BlockCoord) const;
+
 	//check if there is a block in front of the player
 	void CheckForBlocks();
 
-	//stores the block currently being looked at by the player
-	ABlock* CurrentBlock;
+	//true if any chunk the last targeting ray passed through has changed since
+	bool HaveTracedChunksChanged() const;
+
+	//the block currently being looked at by the player
+	bool bHasTargetBlock;
+	FIntVector CurrentBlockCoord;
+	FBlockID CurrentBlockID;
+
+	//where the targeted block is drawn from, used as the drop location when throwing
+	FVector CurrentBlockHitLocation;
+	FIntVector CurrentBlockHitNormal;
+
+	//camera transform and chunk revisions the cached target was computed from
+	FVector LastTraceStart;
+	FVector LastTraceDirection;
+	TArray<TPair<FIntPoint, uint32>, TInlineAllocator<4>> TracedChunkRevisions;
 
 	//the character reach
 	float Reach;
@@ -151,8 +303,39 @@ private:
 	FTimerHandle BlockBreakingHandle;
 	FTimerHandle HitAnimHandle;
 
-	UPROPERTY(EditAnywhere)
-	TArray<AWieldable*> Inventory;
+	UPROPERTY()
+	FInventory Inventory;
+
+	//gives the result of a recipe, whatever doesn't fit in the inventory is dropped at our feet
+	void GiveCraftingResult(const FCraftingIndex::FRecipe& Recipe);
+
+	//looks the grid up again, only called when a cell changes
+	void UpdateCraftingResult();
+
+	UPROPERTY()
+	FItemStack CraftingGrid[FCraftingIndex::GridCells];
+
+	//recipe the grid matches, INDEX_NONE if none
+	int32 CraftingResult;
+
+	//crafts the recipe with the ingredients in the inventory, false if it doesn't hold them all
+	bool CraftRecipeFromInventory(int32 RecipeIndex);
+
+	//the owning client's crafting, run again on the server's copy of the inventory
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerMoveItemToCraftingGrid(uint8 InventorySlot, uint8 GridCell);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerReturnCraftingGridCell(uint8 GridCell);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerCraftFromGrid();
+
+	//sends the recipe rather than its place in the craftable list, which isn't in the same order on the server
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerCraftFromInventory(int32 RecipeIndex);
+
+	FCraftableRecipes CraftableRecipes;
 
 };
 
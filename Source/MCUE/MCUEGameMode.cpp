@@ -3,10 +3,15 @@
 #include "MCUEGameMode.h"
 #include "MCUEHUD.h"
 #include "MCUECharacter.h"
+#include "MCUEInventoryWidget.h"
+#include "MCUEStats.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Blueprint/UserWidget.h"
 #include "Kismet/GameplayStatics.h"
 
+DECLARE_CYCLE_STAT(TEXT("Apply HUD Changes"), STAT_MCUEApplyHUDChanges, STATGROUP_MCUE);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Widgets Created"), STAT_MCUEWidgetsCreated, STATGROUP_MCUE);
+
 AMCUEGameMode::AMCUEGameMode()
 	: Super()
 {
@@ -18,41 +23,43 @@ AMCUEGameMode::AMCUEGameMode()
 	HUDClass = AMCUEHUD::StaticClass();
 
 	HUDState = EHUDState::HS_Ingame;
+	CurrentWidget = nullptr;
 }
 
 void AMCUEGameMode::BeginPlay()
 {
 	Super::BeginPlay();
 
+	//every hud is built up front, so opening one later is only a visibility change
+	GetOrCreateHUD(IngameHUDClass);
+	GetOrCreateHUD(InventoryHUDClass);
+	GetOrCreateHUD(CraftMenuHUDClass);
+
 	ApplyHUDChanges();
 }
 
 void AMCUEGameMode::ApplyHUDChanges()
 {
-	//remove the previous hud, since we're applying a new one
-	if (CurrentWidget != nullptr)
-	{
-		CurrentWidget->RemoveFromParent();
-	}
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEApplyHUDChanges, MCUEGameplay);
 
 	/*check hudstate, and apply the hud corresponding to whatever hud should be open*/
 	switch (HUDState)
 	{
-		case EHUDState::HS_Ingame:
-		{
-			ApplyHUD(IngameHUDClass, false, false);
-		}
 		case EHUDState::HS_Inventory:
 		{
 			ApplyHUD(InventoryHUDClass, true, true);
+			break;
 		}
 		case EHUDState::HS_Craft_Menu:
 		{
 			ApplyHUD(CraftMenuHUDClass, true, true);
+			break;
 		}
+		case EHUDState::HS_Ingame:
 		default:
 		{
 			ApplyHUD(IngameHUDClass, false, false);
+			break;
 		}
 	}
 }
@@ -64,38 +71,72 @@ uint8 AMCUEGameMode::GetHUDState()
 
 void AMCUEGameMode::ChangeHUDState(uint8 NewState)
 {
+	if (NewState == HUDState && CurrentWidget != nullptr)
+	{
+		return;
+	}
+
 	HUDState = NewState;
 	ApplyHUDChanges();
 }
 
 bool AMCUEGameMode::ApplyHUD(TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents)
 {
-	/*get a reference to the player, and the player controller*/
-	AMCUECharacter* MyCharacter = Cast<AMCUECharacter>(UGameplayStatics::GetPlayerCharacter(this, 0));
+	/*get a reference to the player controller*/
 	APlayerController* MyController = GetWorld()->GetFirstPlayerController();
 
+	UUserWidget* Widget = GetOrCreateHUD(WidgetToApply);
+
 	/*Nullcheck the widget before applying it*/
-	if (WidgetToApply != nullptr)
+	if (Widget == nullptr || MyController == nullptr)
 	{
-		/*set mouse events and visibility according to the parameters taken by the function*/
-		MyController->bShowMouseCursor = ShowMouseCursor;
-		MyController->bEnableClickEvents = EnableClickEvents;
+		return false;
+	}
 
-		/*create the widget*/
-		CurrentWidget = CreateWidget<UUserWidget>(GetWorld(), WidgetToApply);
+	/*set mouse events and visibility according to the parameters taken by the function*/
+	MyController->bShowMouseCursor = ShowMouseCursor;
+	MyController->bEnableClickEvents = EnableClickEvents;
 
-		if (CurrentWidget != nullptr)
-		{
-			CurrentWidget->AddToViewport();
-			return true;
-		}
-		else
-		{
-			return false;
-		}
+	//hide the previous hud, it stays in the viewport for the next time it is needed
+	if (CurrentWidget != nullptr && CurrentWidget != Widget)
+	{
+		CurrentWidget->SetVisibility(ESlateVisibility::Collapsed);
 	}
-	else
+
+	CurrentWidget = Widget;
+	CurrentWidget->SetVisibility(ESlateVisibility::Visible);
+	return true;
+}
+
+UUserWidget* AMCUEGameMode::GetOrCreateHUD(TSubclassOf<UUserWidget> WidgetClass)
+{
+	if (WidgetClass == nullptr)
 	{
-		return false;
+		return nullptr;
+	}
+
+	if (UUserWidget** Existing = CachedWidgets.Find(WidgetClass))
+	{
+		return *Existing;
 	}
+
+	UUserWidget* Widget = CreateWidget<UUserWidget>(GetWorld(), WidgetClass);
+	if (Widget == nullptr)
+	{
+		return nullptr;
+	}
+	INC_DWORD_STAT(STAT_MCUEWidgetsCreated);
+	CSV_CUSTOM_STAT(MCUEGameplay, WidgetsCreated, 1, ECsvCustomStatOp::Accumulate);
+
+	Widget->SetVisibility(ESlateVisibility::Collapsed);
+	Widget->AddToViewport();
+
+	//inventory widgets are fed by the character's delegates instead of polling it
+	if (UMCUEInventoryWidget* InventoryWidget = Cast<UMCUEInventoryWidget>(Widget))
+	{
+		InventoryWidget->SetCharacter(Cast<AMCUECharacter>(UGameplayStatics::GetPlayerCharacter(this, 0)));
+	}
+
+	CachedWidgets.Add(WidgetClass, Widget);
+	return Widget;
 }
@@ -33,7 +33,8 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "HUD Functions")
 	void ChangeHUDState(uint8 NewState);
 
-	//applies a hud to the screen, returns true if successful, false otherwise
+	//shows a hud on the screen and hides the previous one, returns true if successful, false otherwise
+	//each hud class is only created the first time it is shown, after that it is just made visible again
 	bool ApplyHUD(TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents);
 
 protected:
@@ -54,7 +55,16 @@ protected:
 	TSubclassOf<class UUserWidget> CraftMenuHUDClass;
 
 	//the current hud being displayed on the screen
+	UPROPERTY(Transient)
 	class UUserWidget* CurrentWidget;
+
+private:
+	//the widget for a hud class, created and added to the viewport hidden the first time
+	class UUserWidget* GetOrCreateHUD(TSubclassOf<class UUserWidget> WidgetClass);
+
+	//every hud created so far, kept in the viewport and hidden while another one is shown
+	UPROPERTY(Transient)
+	TMap<UClass*, class UUserWidget*> CachedWidgets;
 };
 
 
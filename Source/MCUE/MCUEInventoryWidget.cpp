@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MCUEInventoryWidget.h"
+#include "MCUECharacter.h"
+
+void UMCUEInventoryWidget::SetCharacter(AMCUECharacter* InCharacter)
+{
+	if (Character.Get() == InCharacter)
+	{
+		return;
+	}
+
+	Unbind();
+	Character = InCharacter;
+	if (InCharacter == nullptr)
+	{
+		return;
+	}
+
+	InCharacter->OnInventorySlotChanged.AddDynamic(this, &UMCUEInventoryWidget::HandleSlotChanged);
+	InCharacter->OnCurrentInventorySlotChanged.AddDynamic(this, &UMCUEInventoryWidget::HandleSelectedSlotChanged);
+
+	for (int32 Slot = 0; Slot < FInventory::NumSlots; ++Slot)
+	{
+		HandleSlotChanged(Slot);
+	}
+	HandleSelectedSlotChanged(InCharacter->GetCurrentInventorySlot());
+}
+
+void UMCUEInventoryWidget::NativeConstruct()
+{
+	Super::NativeConstruct();
+
+	SetCharacter(Cast<AMCUECharacter>(GetOwningPlayerPawn()));
+}
+
+void UMCUEInventoryWidget::NativeDestruct()
+{
+	Unbind();
+	Character.Reset();
+
+	Super::NativeDestruct();
+}
+
+void UMCUEInventoryWidget::HandleSlotChanged(int32 Slot)
+{
+	if (AMCUECharacter* Owner = Character.Get())
+	{
+		OnSlotChanged(Slot, Owner->GetThumbnailAtInventorySlot((uint8)Slot), Owner->GetItemCountAtInventorySlot((uint8)Slot));
+	}
+}
+
+void UMCUEInventoryWidget::HandleSelectedSlotChanged(int32 Slot)
+{
+	OnSelectedSlotChanged(Slot);
+}
+
+void UMCUEInventoryWidget::Unbind()
+{
+	if (AMCUECharacter* Owner = Character.Get())
+	{
+		Owner->OnInventorySlotChanged.RemoveDynamic(this, &UMCUEInventoryWidget::HandleSlotChanged);
+		Owner->OnCurrentInventorySlotChanged.RemoveDynamic(this, &UMCUEInventoryWidget::HandleSelectedSlotChanged);
+	}
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "MCUEInventoryWidget.generated.h"
+
+class AMCUECharacter;
+class UTexture2D;
+
+//base for widgets that draw the inventory bar
+//slots are pushed to the blueprint when they change instead of being pulled through property bindings every frame
+UCLASS(Abstract)
+class MCUE_API UMCUEInventoryWidget : public UUserWidget
+{
+	GENERATED_BODY()
+
+public:
+	//listens to the character's inventory from now on, and pushes every slot once so the widget starts out right
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	void SetCharacter(AMCUECharacter* InCharacter);
+
+protected:
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+
+	//redraws one slot, Thumbnail is null and Count 0 for an empty slot
+	UFUNCTION(BlueprintImplementableEvent, Category = "Inventory")
+	void OnSlotChanged(int32 Slot, UTexture2D* Thumbnail, int32 Count);
+
+	UFUNCTION(BlueprintImplementableEvent, Category = "Inventory")
+	void OnSelectedSlotChanged(int32 Slot);
+
+private:
+	UFUNCTION()
+	void HandleSlotChanged(int32 Slot);
+
+	UFUNCTION()
+	void HandleSelectedSlotChanged(int32 Slot);
+
+	void Unbind();
+
+	TWeakObjectPtr<AMCUECharacter> Character;
+};
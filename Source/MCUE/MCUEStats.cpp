@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MCUEStats.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CoreDelegates.h"
+
+UE_TRACE_CHANNEL_DEFINE(MCUEGameplayChannel);
+UE_TRACE_CHANNEL_DEFINE(MCUEWorldChannel);
+UE_TRACE_CHANNEL_DEFINE(MCUENetChannel);
+
+CSV_DEFINE_CATEGORY_MODULE(MCUE_API, MCUEGameplay, true);
+CSV_DEFINE_CATEGORY_MODULE(MCUE_API, MCUEWorld, true);
+CSV_DEFINE_CATEGORY_MODULE(MCUE_API, MCUENet, true);
+
+#if !UE_BUILD_SHIPPING
+
+DEFINE_LOG_CATEGORY_STATIC(LogMCUEHitch, Log, All);
+
+namespace
+{
+	TAutoConsoleVariable<float> CVarHitchThreshold(
+		TEXT("mcue.HitchThreshold"),
+		100.0f,
+		TEXT("Frames longer than this many milliseconds log the MCUE scopes that took longest in them, 0 turns the watchdog off"));
+
+	//scopes listed per hitch
+	constexpr int32 MaxLoggedScopes = 4;
+}
+
+TArray<FMCUEHitchWatchdog::FScopeTime> FMCUEHitchWatchdog::Scopes;
+bool FMCUEHitchWatchdog::bEnabled = false;
+double FMCUEHitchWatchdog::LastFrameEndTime = 0.0;
+FDelegateHandle FMCUEHitchWatchdog::EndFrameHandle;
+
+void FMCUEHitchWatchdog::Startup()
+{
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FMCUEHitchWatchdog::OnEndFrame);
+}
+
+void FMCUEHitchWatchdog::Shutdown()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	bEnabled = false;
+	Scopes.Empty();
+}
+
+void FMCUEHitchWatchdog::AddScope(const TCHAR* Name, uint64 Cycles)
+{
+	//every call site passes its own literal, so the pointer is the key
+	for (FScopeTime& Scope : Scopes)
+	{
+		if (Scope.Name == Name)
+		{
+			Scope.Cycles += Cycles;
+			++Scope.Calls;
+			return;
+		}
+	}
+	Scopes.Add({ Name, Cycles, 1 });
+}
+
+void FMCUEHitchWatchdog::OnEndFrame()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMilliseconds = (Now - LastFrameEndTime) * 1000.0;
+	const float Threshold = CVarHitchThreshold.GetValueOnGameThread();
+
+	//the first frame after turning it on has nothing to compare against
+	const bool bWasEnabled = bEnabled && LastFrameEndTime > 0.0;
+	LastFrameEndTime = Now;
+	bEnabled = Threshold > 0.0f;
+
+	if (bWasEnabled && FrameMilliseconds > Threshold)
+	{
+		//times are inclusive, a scope inside another is counted in both
+		Scopes.Sort([](const FScopeTime& A, const FScopeTime& B) { return A.Cycles > B.Cycles; });
+
+		FString Longest;
+		for (int32 i = 0; i < FMath::Min(Scopes.Num(), MaxLoggedScopes); ++i)
+		{
+			Longest += FString::Printf(TEXT("%s%s %.2f ms x%d"), i > 0 ? TEXT(", ") : TEXT(""), Scopes[i].Name, FPlatformTime::ToMilliseconds64(Scopes[i].Cycles), Scopes[i].Calls);
+		}
+
+		UE_LOG(LogMCUEHitch, Warning, TEXT("Hitch: %.1f ms frame (threshold %.0f ms), longest MCUE scopes: %s"),
+			FrameMilliseconds, Threshold, Scopes.Num() > 0 ? *Longest : TEXT("none ran"));
+	}
+
+	Scopes.Reset();
+}
+
+#endif
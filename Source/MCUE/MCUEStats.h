@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+//the gameplay side of the module, the character, wieldables, inventory and hud, the voxel world has STATGROUP_VoxelWorld
+DECLARE_STATS_GROUP(TEXT("MCUE"), STATGROUP_MCUE, STATCAT_Advanced);
+
+//insights channels, e.g. -trace=cpu,frame,MCUEGameplay,MCUEWorld,MCUENet
+UE_TRACE_CHANNEL_EXTERN(MCUEGameplayChannel, MCUE_API);
+UE_TRACE_CHANNEL_EXTERN(MCUEWorldChannel, MCUE_API);
+UE_TRACE_CHANNEL_EXTERN(MCUENetChannel, MCUE_API);
+
+//csv profiler categories with the same names, captured with csvprofile start/stop
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(MCUE_API, MCUEGameplay);
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(MCUE_API, MCUEWorld);
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(MCUE_API, MCUENet);
+
+#if !UE_BUILD_SHIPPING
+
+//remembers how long the module's scopes took on the game thread this frame
+//when a frame takes longer than mcue.HitchThreshold milliseconds it logs the scopes that took longest, so a hitch
+//in the log says whether it was ours and where
+class MCUE_API FMCUEHitchWatchdog
+{
+public:
+	static void Startup();
+	static void Shutdown();
+
+	static bool IsEnabled() { return bEnabled; }
+
+	static void AddScope(const TCHAR* Name, uint64 Cycles);
+
+private:
+	static void OnEndFrame();
+
+	struct FScopeTime
+	{
+		const TCHAR* Name;
+		uint64 Cycles;
+		int32 Calls;
+	};
+
+	//every scope that ran this frame, few enough that a linear search beats hashing
+	static TArray<FScopeTime> Scopes;
+
+	static bool bEnabled;
+	static double LastFrameEndTime;
+	static FDelegateHandle EndFrameHandle;
+};
+
+//times one scope for the watchdog, only on the game thread and only while the watchdog is on
+class FMCUEHitchScope
+{
+public:
+	explicit FMCUEHitchScope(const TCHAR* InName)
+		: Name(FMCUEHitchWatchdog::IsEnabled() && IsInGameThread() ? InName : nullptr)
+		, StartCycles(Name != nullptr ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FMCUEHitchScope()
+	{
+		if (Name != nullptr)
+		{
+			FMCUEHitchWatchdog::AddScope(Name, FPlatformTime::Cycles64() - StartCycles);
+		}
+	}
+
+private:
+	const TCHAR* Name;
+	uint64 StartCycles;
+};
+
+#define MCUE_HITCH_SCOPE(Stat) FMCUEHitchScope MCUEHitchScope_##Stat(TEXT(#Stat))
+
+#else
+
+#define MCUE_HITCH_SCOPE(Stat)
+
+#endif
+
+//one scope for every profiler: the stat, an insights event on the category's channel, a csv timing and the hitch watchdog
+//the category is one of MCUEGameplay, MCUEWorld or MCUENet
+#define MCUE_SCOPE_CYCLE_COUNTER(Stat, Category) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, Category##Channel); \
+	CSV_SCOPED_TIMING_STAT(Category, Stat); \
+	MCUE_HITCH_SCOPE(Stat)
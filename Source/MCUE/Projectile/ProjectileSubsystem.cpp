@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ProjectileSubsystem.h"
+#include "MCUEStats.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "World/VoxelWorldSubsystem.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogProjectiles, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Update"), STAT_ProjectileUpdate, STATGROUP_MCUE);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectiles"), STAT_Projectiles, STATGROUP_MCUE);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Impacts"), STAT_ProjectileImpacts, STATGROUP_MCUE);
+
+namespace
+{
+	//the engine sphere is a block across
+	constexpr float SphereMeshRadius = 50.0f;
+
+	//mcue.FireProjectiles
+	void FireProjectiles(const TArray<FString>& Args, UWorld* World)
+	{
+		UProjectileSubsystem* Projectiles = World != nullptr ? World->GetSubsystem<UProjectileSubsystem>() : nullptr;
+		const APlayerController* Player = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+		APawn* Pawn = Player != nullptr ? Player->GetPawn() : nullptr;
+		if (Projectiles == nullptr || Pawn == nullptr)
+		{
+			UE_LOG(LogProjectiles, Warning, TEXT("mcue.FireProjectiles needs a game world with a player pawn"));
+			return;
+		}
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const float SpreadDegrees = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+
+		FVector Eye;
+		FRotator View;
+		Pawn->GetActorEyesViewPoint(Eye, View);
+
+		int32 NumFired = 0;
+		for (int32 i = 0; i < Count; ++i)
+		{
+			NumFired += Projectiles->Fire(Eye, FMath::VRandCone(View.Vector(), FMath::DegreesToRadians(SpreadDegrees)), Pawn) ? 1 : 0;
+		}
+		UE_LOG(LogProjectiles, Display, TEXT("Fired %d projectiles, %d in flight"), NumFired, Projectiles->GetProjectiles().Num());
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs FireProjectilesCommand(
+		TEXT("mcue.FireProjectiles"),
+		TEXT("Fires a volley of projectiles from the player's view. Args: [Count=1000] [SpreadDegrees=10]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FireProjectiles));
+}
+
+UProjectileSubsystem::UProjectileSubsystem()
+{
+	NumImpacts = 0;
+	InstanceOwner = nullptr;
+	Instances = nullptr;
+	NumVisibleInstances = 0;
+
+	InitialSpeed = 3000.0f;
+	Lifetime = 3.0f;
+	MaxBounces = 2;
+	Bounciness = 0.6f;
+	GravityScale = 1.0f;
+	MaxProjectiles = 16384;
+	Radius = 5.0f;
+}
+
+bool UProjectileSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UProjectileSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	InstanceOwner = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+
+	USceneComponent* Root = NewObject<USceneComponent>(InstanceOwner, TEXT("Root"));
+	InstanceOwner->SetRootComponent(Root);
+	Root->RegisterComponent();
+
+	UStaticMesh* Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Sphere.Sphere"));
+	if (Mesh == nullptr)
+	{
+		return;
+	}
+
+	Instances = NewObject<UInstancedStaticMeshComponent>(InstanceOwner);
+	Instances->SetupAttachment(Root);
+	Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Instances->SetCastShadow(false);
+	Instances->SetStaticMesh(Mesh);
+	Instances->RegisterComponent();
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_ProjectileUpdate, MCUEGameplay);
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
+
+	Impacts.Reset();
+	Projectiles.Update(*VoxelWorld, DeltaTime, GetWorld()->GetGravityZ() * GravityScale, Lifetime, MaxBounces, Bounciness, Impacts);
+	NumImpacts += Impacts.Num();
+
+	//the same damage mining does, so projectiles and picks wear down the same blocks
+	if (!VoxelWorld->IsNetClient())
+	{
+		for (const FProjectileImpact& Impact : Impacts)
+		{
+			VoxelWorld->DamageBlock(Impact.BlockCoord, Impact.Instigator.Get());
+		}
+	}
+
+	UpdateInstances();
+
+	SET_DWORD_STAT(STAT_Projectiles, Projectiles.Num());
+	INC_DWORD_STAT_BY(STAT_ProjectileImpacts, Impacts.Num());
+	CSV_CUSTOM_STAT(MCUEGameplay, Projectiles, Projectiles.Num(), ECsvCustomStatOp::Set);
+}
+
+bool UProjectileSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables);
+}
+
+bool UProjectileSubsystem::Fire(const FVector& Location, const FVector& Direction, AActor* Instigator)
+{
+	if (Projectiles.Num() >= MaxProjectiles)
+	{
+		return false;
+	}
+
+	Projectiles.Add(Location, Direction.GetSafeNormal() * InitialSpeed, Instigator);
+	return true;
+}
+
+void UProjectileSubsystem::Clear()
+{
+	Projectiles.Empty();
+	UpdateInstances();
+}
+
+void UProjectileSubsystem::UpdateInstances()
+{
+	const int32 NumProjectiles = Projectiles.Num();
+	if (Instances == nullptr || (NumProjectiles == 0 && NumVisibleInstances == 0))
+	{
+		return;
+	}
+
+	//instances past the ones still showing a projectile from last frame are already shrunk, and stay that way
+	const int32 NumToWrite = FMath::Max(NumProjectiles, NumVisibleInstances);
+	const int32 NumExisting = Instances->GetInstanceCount();
+	const FVector Scale(Radius / SphereMeshRadius);
+
+	const TArray<FVector>& Locations = Projectiles.GetLocations();
+	Transforms.Reset(NumToWrite);
+	for (int32 Index = 0; Index < NumToWrite; ++Index)
+	{
+		if (Index < NumProjectiles)
+		{
+			Transforms.Emplace(FQuat::Identity, Locations[Index], Scale);
+		}
+		else
+		{
+			Transforms.Emplace(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+		}
+	}
+
+	const int32 NumToUpdate = FMath::Min(NumToWrite, NumExisting);
+	if (NumToUpdate == NumToWrite)
+	{
+		Instances->BatchUpdateInstancesTransforms(0, Transforms, true, false, true);
+	}
+	else
+	{
+		if (NumToUpdate > 0)
+		{
+			Instances->BatchUpdateInstancesTransforms(0, TArray<FTransform>(Transforms.GetData(), NumToUpdate), true, false, true);
+		}
+		for (int32 Instance = NumExisting; Instance < NumToWrite; ++Instance)
+		{
+			Instances->AddInstanceWorldSpace(Transforms[Instance]);
+		}
+	}
+
+	Instances->MarkRenderStateDirty();
+	NumVisibleInstances = NumProjectiles;
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Projectiles.h"
+#include "ProjectileSubsystem.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+//owns every projectile in flight, moves them in one batch and damages the blocks they hit
+//projectiles are drawn by one instanced mesh whose instances are reused from frame to frame, spare ones are shrunk to nothing
+//only the server and standalone games damage blocks, a client's projectiles are just for show
+UCLASS(config=Game)
+class MCUE_API UProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UProjectileSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	//FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//launches a projectile at InitialSpeed, returns false if MaxProjectiles are already in flight
+	bool Fire(const FVector& Location, const FVector& Direction, AActor* Instigator);
+
+	//drops every projectile in flight
+	void Clear();
+
+	const FProjectiles& GetProjectiles() const { return Projectiles; }
+
+	//blocks hit since the world started
+	int32 GetNumImpacts() const { return NumImpacts; }
+
+private:
+	void UpdateInstances();
+
+	FProjectiles Projectiles;
+
+	//impacts of the current update, kept so it doesn't reallocate
+	TArray<FProjectileImpact> Impacts;
+
+	int32 NumImpacts;
+
+	//holds the instanced mesh
+	UPROPERTY(Transient)
+	AActor* InstanceOwner;
+
+	UPROPERTY(Transient)
+	UInstancedStaticMeshComponent* Instances;
+
+	//instances showing a projectile last frame, the rest are already shrunk
+	int32 NumVisibleInstances;
+
+	//instance transforms written every frame, kept so they don't reallocate
+	TArray<FTransform> Transforms;
+
+	UPROPERTY(config)
+	float InitialSpeed;
+
+	//seconds a projectile flies before it is dropped
+	UPROPERTY(config)
+	float Lifetime;
+
+	//blocks a projectile bounces off before the next one stops it, each of them takes one stage of damage
+	UPROPERTY(config)
+	int32 MaxBounces;
+
+	//fraction of its speed a projectile keeps after a bounce
+	UPROPERTY(config)
+	float Bounciness;
+
+	UPROPERTY(config)
+	float GravityScale;
+
+	//projectiles in flight at once, firing fails past this
+	UPROPERTY(config)
+	int32 MaxProjectiles;
+
+	//size projectiles are drawn at, in world units
+	UPROPERTY(config)
+	float Radius;
+};
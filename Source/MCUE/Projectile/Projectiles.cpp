@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Projectiles.h"
+#include "Async/ParallelFor.h"
+#include "World/VoxelWorldSubsystem.h"
+
+namespace
+{
+	//projectiles one worker advances at a time, a batch is a few microseconds of work
+	constexpr int32 BatchSize = 256;
+}
+
+void FProjectiles::Add(const FVector& Location, const FVector& Velocity, AActor* Instigator)
+{
+	Locations.Add(Location);
+	Velocities.Add(Velocity);
+	Ages.Add(0.0f);
+	NumBounces.Add(0);
+	Instigators.Add(Instigator);
+}
+
+void FProjectiles::Update(const UVoxelWorldSubsystem& VoxelWorld, float DeltaTime, float GravityZ, float Lifetime, int32 MaxBounces, float Bounciness, TArray<FProjectileImpact>& OutImpacts)
+{
+	const int32 NumProjectiles = Num();
+	if (NumProjectiles == 0)
+	{
+		return;
+	}
+
+	Outcomes.SetNumUninitialized(NumProjectiles, false);
+	Hits.SetNum(NumProjectiles, false);
+
+	//projectiles only read the block grid, so they can all move at once, what they hit is applied afterwards in order
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumProjectiles, BatchSize);
+	ParallelFor(NumBatches, [&](int32 Batch)
+	{
+		const int32 End = FMath::Min((Batch + 1) * BatchSize, NumProjectiles);
+		for (int32 Index = Batch * BatchSize; Index < End; ++Index)
+		{
+			FVector& Location = Locations[Index];
+			FVector& Velocity = Velocities[Index];
+			EOutcome Outcome = EOutcome::Flying;
+
+			Velocity.Z += GravityZ * DeltaTime;
+
+			const FVector Delta = Velocity * DeltaTime;
+			const float Distance = Delta.Size();
+
+			FVoxelHit Hit;
+			if (Distance > KINDA_SMALL_NUMBER && VoxelWorld.Raycast(Location, Delta / Distance, Distance, Hit))
+			{
+				FProjectileImpact& Impact = Hits[Index];
+				Impact.BlockCoord = Hit.BlockCoord;
+				Impact.Location = Hit.Location;
+				Impact.Velocity = Velocity;
+
+				//a projectile that starts inside a block has no face to bounce off
+				if (NumBounces[Index] < MaxBounces && Hit.Normal != FIntVector::ZeroValue)
+				{
+					const FVector Normal(Hit.Normal);
+					Velocity = (Velocity - 2.0f * (Velocity | Normal) * Normal) * Bounciness;
+					Location = Hit.Location + Normal * BounceOffset;
+					Outcome = EOutcome::Bounced;
+				}
+				else
+				{
+					Location = Hit.Location;
+					Outcome = EOutcome::Stopped;
+				}
+			}
+			else
+			{
+				Location += Delta;
+			}
+
+			Ages[Index] += DeltaTime;
+			if (Outcome != EOutcome::Stopped)
+			{
+				const FIntVector Block = VoxelWorld.WorldToBlock(Location);
+				if (Ages[Index] >= Lifetime || Block.Z < 0 || VoxelWorld.FindChunk(UVoxelWorldSubsystem::BlockToChunk(Block)) == nullptr)
+				{
+					Outcome = EOutcome::Expired;
+				}
+			}
+
+			Outcomes[Index] = Outcome;
+		}
+	}, NumBatches < 2);
+
+	//backwards, so the projectile swapped into a removed one's place has already been handled
+	for (int32 Index = NumProjectiles - 1; Index >= 0; --Index)
+	{
+		const EOutcome Outcome = Outcomes[Index];
+		if (Outcome == EOutcome::Flying)
+		{
+			continue;
+		}
+
+		if (Outcome == EOutcome::Bounced || Outcome == EOutcome::Stopped)
+		{
+			FProjectileImpact& Impact = OutImpacts.Add_GetRef(Hits[Index]);
+			Impact.Instigator = Instigators[Index];
+		}
+
+		if (Outcome == EOutcome::Bounced)
+		{
+			++NumBounces[Index];
+		}
+		else
+		{
+			RemoveAt(Index);
+		}
+	}
+}
+
+void FProjectiles::Empty()
+{
+	//keeps the memory, the next volley reuses it
+	Locations.Reset();
+	Velocities.Reset();
+	Ages.Reset();
+	NumBounces.Reset();
+	Instigators.Reset();
+}
+
+void FProjectiles::RemoveAt(int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	Ages.RemoveAtSwap(Index, 1, false);
+	NumBounces.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+}
+
+SIZE_T FProjectiles::GetAllocatedSize() const
+{
+	return Locations.GetAllocatedSize() + Velocities.GetAllocatedSize() + Ages.GetAllocatedSize() + NumBounces.GetAllocatedSize()
+		+ Instigators.GetAllocatedSize() + Outcomes.GetAllocatedSize() + Hits.GetAllocatedSize();
+}
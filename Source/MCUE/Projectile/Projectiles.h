@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UVoxelWorldSubsystem;
+
+//a projectile running into a block in the last update
+struct FProjectileImpact
+{
+	FIntVector BlockCoord;
+
+	//where it entered the block, and how fast it was going then
+	FVector Location;
+	FVector Velocity;
+
+	TWeakObjectPtr<AActor> Instigator;
+};
+
+//every projectile in flight, kept as parallel arrays and advanced in one pass
+//a projectile is a point, each update sweeps the segment it moves along through the block grid with the world's dda,
+//there is no actor, component or physics body per projectile
+//the arrays only grow, so once the most projectiles there have ever been are in flight nothing allocates again
+class MCUE_API FProjectiles
+{
+public:
+	//world units a bouncing projectile is pushed off the face it hit, so the next sweep doesn't start inside the block
+	static constexpr float BounceOffset = 1.0f;
+
+	int32 Num() const { return Locations.Num(); }
+
+	void Add(const FVector& Location, const FVector& Velocity, AActor* Instigator);
+
+	//moves every projectile under gravity and adds a hit for every block one ran into to OutImpacts
+	//a projectile bounces off the first MaxBounces blocks it hits, keeping Bounciness of its speed, and stops at the next one
+	//projectiles older than Lifetime seconds, or in chunks that aren't loaded, are dropped
+	void Update(const UVoxelWorldSubsystem& VoxelWorld, float DeltaTime, float GravityZ, float Lifetime, int32 MaxBounces, float Bounciness, TArray<FProjectileImpact>& OutImpacts);
+
+	void Empty();
+
+	const TArray<FVector>& GetLocations() const { return Locations; }
+	const TArray<FVector>& GetVelocities() const { return Velocities; }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void RemoveAt(int32 Index);
+
+	//what happened to a projectile in the parallel part of the update
+	enum class EOutcome : uint8
+	{
+		Flying,
+		Bounced,
+		//hit a block and stopped there
+		Stopped,
+		//ran out of lifetime or left the loaded world
+		Expired
+	};
+
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+
+	//seconds in flight
+	TArray<float> Ages;
+
+	TArray<uint8> NumBounces;
+	TArray<TWeakObjectPtr<AActor>> Instigators;
+
+	//written per projectile by the parallel part of the update and read back in order afterwards
+	TArray<EOutcome> Outcomes;
+	TArray<FProjectileImpact> Hits;
+};
@@ -5,8 +5,12 @@
 #include "Components/PrimitiveComponent.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "MCUECharacter.h"
+#include "MCUEStats.h"
+#include "Item/DroppedItemSubsystem.h"
+#include "Item/ItemRegistry.h"
 #include "Kismet/GameplayStatics.h"
 
+DECLARE_CYCLE_STAT(TEXT("Wieldable Tick"), STAT_MCUEWieldableTick, STATGROUP_MCUE);
 
 // Sets default values
 AWieldable::AWieldable()
@@ -34,12 +38,26 @@ AWieldable::AWieldable()
 void AWieldable::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	//hand the item over to the dropped item batch, it draws and collects it without this actor
+	UDroppedItemSubsystem* Drops = GetWorld()->GetSubsystem<UDroppedItemSubsystem>();
+	UItemRegistrySubsystem* Items = UItemRegistrySubsystem::Get(this);
+	if (Drops != nullptr && Items != nullptr)
+	{
+		const FItemID ItemID = Items->GetPickupItem(*this);
+		if (ItemID != EItemID::None)
+		{
+			Drops->SpawnItem(Items->MakeStack(ItemID, 1), GetActorLocation(), FVector::ZeroVector);
+			OnUsed();
+		}
+	}
 }
 
 // Called every frame
 void AWieldable::Tick(float DeltaTime)
 {
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEWieldableTick, MCUEGameplay);
+
 	Super::Tick(DeltaTime);
 
 	FRotator Rotation = WieldableMesh->GetComponentRotation();
@@ -52,11 +70,12 @@ void AWieldable::OnRadiusEnter(class UPrimitiveComponent* HitComp, class AActor*
 {
 	if (bIsActive)
 	{
+		//the inventory keeps an item stack, not this actor
 		AMCUECharacter* Character = Cast<AMCUECharacter>(OtherActor);
-		//Character->FP_WieldedItem->SetSkeletalMesh(WieldableMesh->SkeletalMesh);
-		Character->AddItemToInventory(this);
-
-		Hide(true);		
+		if (Character != nullptr && Character->AddItemToInventory(this))
+		{
+			OnUsed();
+		}
 	}
 }
 
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlockDamage.h"
+
+FBlockDamageMap::FBlockDamageMap()
+	: Revision(0)
+{
+}
+
+int32 FBlockDamageMap::AddDamage(const FIntVector& BlockCoord, AActor* Owner, float Time)
+{
+	FBlockDamage* Damage = Entries.Find(BlockCoord);
+	if (Damage == nullptr)
+	{
+		Damage = &Entries.Add(BlockCoord, FBlockDamage{ 0, nullptr, Time });
+	}
+
+	Damage->Stage = FMath::Min(Damage->Stage + 1, NumStages);
+	Damage->Owner = Owner;
+	Damage->LastHitTime = Time;
+
+	++Revision;
+	return Damage->Stage;
+}
+
+int32 FBlockDamageMap::GetStage(const FIntVector& BlockCoord) const
+{
+	const FBlockDamage* Damage = Entries.Find(BlockCoord);
+	return Damage != nullptr ? Damage->Stage : 0;
+}
+
+void FBlockDamageMap::Remove(const FIntVector& BlockCoord)
+{
+	if (Entries.Remove(BlockCoord) > 0)
+	{
+		++Revision;
+	}
+}
+
+void FBlockDamageMap::Decay(float Time, float Delay, float Interval)
+{
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		FBlockDamage& Damage = It.Value();
+
+		const float Idle = Time - Damage.LastHitTime - Delay;
+		if (Idle < Interval)
+		{
+			continue;
+		}
+
+		//restart the clock for the next stage, so a long hitch drops progress one stage at a time
+		--Damage.Stage;
+		Damage.LastHitTime = Time - Delay;
+		++Revision;
+
+		if (Damage.Stage <= 0)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
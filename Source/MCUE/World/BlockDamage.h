@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//breaking progress on one block
+struct FBlockDamage
+{
+	//hits taken so far, the block breaks when it reaches FBlockDamageMap::NumStages
+	int32 Stage;
+
+	//whoever hit it last
+	TWeakObjectPtr<AActor> Owner;
+
+	//world time of the last hit, decay starts from here
+	float LastHitTime;
+};
+
+//sparse breaking progress for the whole world, only blocks someone is mining have an entry
+//shared by everyone, so several players hitting the same block add to the same progress
+class MCUE_API FBlockDamageMap
+{
+public:
+	static constexpr int32 NumStages = 5;
+
+	FBlockDamageMap();
+
+	//adds one stage of damage, returns the new stage
+	int32 AddDamage(const FIntVector& BlockCoord, AActor* Owner, float Time);
+
+	//0 if the block is undamaged
+	int32 GetStage(const FIntVector& BlockCoord) const;
+
+	void Remove(const FIntVector& BlockCoord);
+
+	//once a block has gone Delay seconds without a hit it loses a stage every Interval seconds
+	void Decay(float Time, float Delay, float Interval);
+
+	const TMap<FIntVector, FBlockDamage>& GetEntries() const { return Entries; }
+
+	//bumped on every change, lets the crack overlay skip frames where nothing changed
+	uint32 GetRevision() const { return Revision; }
+
+private:
+	TMap<FIntVector, FBlockDamage> Entries;
+
+	uint32 Revision;
+};
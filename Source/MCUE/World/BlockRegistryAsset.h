@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "BlockRegistryAsset.generated.h"
+
+//one block type as authored in the editor, see FBlockProperties
+USTRUCT(BlueprintType)
+struct FBlockDefinition
+{
+	GENERATED_BODY()
+
+	//EBlockID value the definition applies to
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	int32 BlockID = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "0"))
+	float Resistance = 0.0f;
+
+	//AWieldable::ETool
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	uint8 PreferredTool = 0;
+
+	//AWieldable::EMaterial
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	uint8 MinimumMaterial = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drops")
+	int32 DropBlockID = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drops")
+	uint8 DropCount = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+	bool bIsSolid = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+	bool bIsOpaque = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering", meta = (ClampMin = "0", ClampMax = "15"))
+	uint8 LightEmission = 0;
+
+	//levels a fluid loses per block it flows sideways, 0 if the block isn't a fluid
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Fluid")
+	uint8 FluidFlowStep = 0;
+
+	//block tick steps between a fluid's updates, higher flows slower
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Fluid", meta = (ClampMin = "1"))
+	uint8 FluidTickSteps = 5;
+};
+
+//block properties authored as data, the voxel world loads the one named in its config before any chunk exists
+//blocks the asset doesn't list keep their built in defaults
+UCLASS(BlueprintType)
+class MCUE_API UBlockRegistryAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Blocks")
+	TArray<FBlockDefinition> Blocks;
+};
@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlockTicks.h"
+#include "VoxelWorldSubsystem.h"
+#include "VoxelFluids.h"
+#include "MCUEStats.h"
+#include "HAL/PlatformTime.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Block Tick Step"), STAT_VoxelBlockTickStep, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Block Ticks Scheduled"), STAT_VoxelBlockTicksScheduled, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Block Tick Writes"), STAT_VoxelBlockTickWrites, STATGROUP_VoxelWorld);
+
+namespace
+{
+	typedef void (*FBlockTickFunction)(FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block);
+
+	//the terrain lays grass over dirt, grass only spreads onto and turns back into that, never a block the player placed
+	constexpr FBlockID GrassSoil = EBlockID::Dirt;
+
+	void RandomTickGrass(FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block)
+	{
+		//smothered grass dies
+		if (FBlockRegistry::IsOpaque(Context.GetBlock(BlockCoord + FIntVector(0, 0, 1))))
+		{
+			Context.SetBlock(BlockCoord, GrassSoil);
+			return;
+		}
+
+		//and living grass creeps onto uncovered soil next to it, a little further down than up
+		FRandomStream& Random = Context.GetRandom();
+		const FIntVector Target = BlockCoord + FIntVector(Random.RandRange(-1, 1), Random.RandRange(-1, 1), Random.RandRange(-3, 1));
+		if (Context.GetBlock(Target) == GrassSoil && !FBlockRegistry::IsOpaque(Context.GetBlock(Target + FIntVector(0, 0, 1))))
+		{
+			Context.SetBlock(Target, EBlockID::Grass);
+		}
+	}
+
+	const FBlockTickFunction RandomTickFunctions[EBlockID::Num] =
+	{
+		/* Air     */ nullptr,
+		/* Grass   */ &RandomTickGrass,
+		/* Rock    */ nullptr,
+		/* Cobble  */ nullptr,
+		/* IronOre */ nullptr,
+		/* Water   */ nullptr,
+		/* Lava    */ nullptr,
+		/* Dirt    */ nullptr,
+	};
+
+	const FBlockTickFunction ScheduledTickFunctions[EBlockID::Num] =
+	{
+		/* Air     */ nullptr,
+		/* Grass   */ nullptr,
+		/* Rock    */ nullptr,
+		/* Cobble  */ nullptr,
+		/* IronOre */ nullptr,
+		/* Water   */ &FVoxelFluids::Tick,
+		/* Lava    */ &FVoxelFluids::Tick,
+		/* Dirt    */ nullptr,
+	};
+
+	//everything one chunk does in a step
+	struct FChunkTickJob
+	{
+		const FChunk* Chunk;
+
+		TArray<FIntVector> DueTicks;
+
+		TArray<FBlockTickWrite> Writes;
+		TArray<FBlockTickRequest> Requests;
+	};
+}
+
+FBlockID FBlockTickContext::GetBlock(const FIntVector& BlockCoord) const
+{
+	return VoxelWorld.GetBlock(BlockCoord);
+}
+
+FBlockTickScheduler::FBlockTickScheduler()
+	: NextSequence(0)
+	, Step(0)
+	, Accumulator(0.0f)
+	, StepSeconds(1.0f / 20.0f)
+	, MaxStepsPerFrame(2)
+	, RandomTicksPerSection(3)
+	, MaxScheduledTicksPerStep(1024)
+	, Seed(0)
+{
+	FMemory::Memzero(Stats);
+}
+
+void FBlockTickScheduler::Configure(float InStepsPerSecond, int32 InMaxStepsPerFrame, int32 InRandomTicksPerSection, int32 InMaxScheduledTicksPerStep, int32 InSeed)
+{
+	StepSeconds = InStepsPerSecond > 0.0f ? 1.0f / InStepsPerSecond : 0.0f;
+	MaxStepsPerFrame = FMath::Max(1, InMaxStepsPerFrame);
+	RandomTicksPerSection = FMath::Max(0, InRandomTicksPerSection);
+	MaxScheduledTicksPerStep = FMath::Max(1, InMaxScheduledTicksPerStep);
+	Seed = InSeed;
+}
+
+void FBlockTickScheduler::Advance(UVoxelWorldSubsystem& VoxelWorld, float DeltaTime)
+{
+	//a rate of zero turns block ticks off
+	if (StepSeconds <= 0.0f)
+	{
+		return;
+	}
+
+	Accumulator += DeltaTime;
+
+	int32 NumSteps = 0;
+	while (Accumulator >= StepSeconds && NumSteps < MaxStepsPerFrame)
+	{
+		RunStep(VoxelWorld);
+		Accumulator -= StepSeconds;
+		++NumSteps;
+	}
+
+	//after a hitch the world runs slow for a moment instead of trying to catch up all at once
+	Accumulator = FMath::Min(Accumulator, StepSeconds);
+
+	SET_DWORD_STAT(STAT_VoxelBlockTicksScheduled, Scheduled.Num());
+}
+
+void FBlockTickScheduler::ScheduleTick(const FIntVector& BlockCoord, int32 DelaySteps)
+{
+	if (!UVoxelWorldSubsystem::IsValidHeight(BlockCoord.Z))
+	{
+		return;
+	}
+
+	bool bAlreadyScheduled = false;
+	ScheduledBlocks.Add(BlockCoord, &bAlreadyScheduled);
+	if (bAlreadyScheduled)
+	{
+		return;
+	}
+
+	//never the current step, a tick scheduling itself again must not run twice in one step
+	Scheduled.HeapPush(FScheduledTick{ Step + FMath::Max(1, DelaySteps), NextSequence++, BlockCoord });
+}
+
+bool FBlockTickScheduler::HasRandomTick(FBlockID Block)
+{
+	const FBlockID Type = EBlockID::GetType(Block);
+	return Type < EBlockID::Num && RandomTickFunctions[Type] != nullptr;
+}
+
+void FBlockTickScheduler::RunStep(UVoxelWorldSubsystem& VoxelWorld)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_VoxelBlockTickStep, MCUEWorld);
+
+	const double StartTime = FPlatformTime::Seconds();
+	++Step;
+
+	TArray<const FChunk*> Chunks;
+	VoxelWorld.GetTickableChunks(Chunks);
+
+	TArray<FChunkTickJob> Jobs;
+	Jobs.SetNum(Chunks.Num());
+
+	TMap<FIntPoint, int32> JobIndices;
+	JobIndices.Reserve(Chunks.Num());
+	for (int32 Index = 0; Index < Chunks.Num(); ++Index)
+	{
+		Jobs[Index].Chunk = Chunks[Index];
+		JobIndices.Add(Chunks[Index]->GetCoord(), Index);
+	}
+
+	//hand the due ticks to the jobs of their chunks, whatever is over the cap waits for the next step
+	int32 NumDue = 0;
+	while (Scheduled.Num() > 0 && Scheduled.HeapTop().Step <= Step && NumDue < MaxScheduledTicksPerStep)
+	{
+		FScheduledTick Tick;
+		Scheduled.HeapPop(Tick, false);
+		ScheduledBlocks.Remove(Tick.BlockCoord);
+
+		if (const int32* JobIndex = JobIndices.Find(UVoxelWorldSubsystem::BlockToChunk(Tick.BlockCoord)))
+		{
+			Jobs[*JobIndex].DueTicks.Add(Tick.BlockCoord);
+			++NumDue;
+		}
+	}
+
+	const UVoxelWorldSubsystem& ReadOnlyWorld = VoxelWorld;
+	ParallelFor(Jobs.Num(), [this, &Jobs, &ReadOnlyWorld](int32 JobIndex)
+	{
+		FChunkTickJob& Job = Jobs[JobIndex];
+		const FIntPoint ChunkCoord = Job.Chunk->GetCoord();
+
+		const uint32 JobSeed = HashCombine(HashCombine((uint32)Seed, GetTypeHash(Step)), GetTypeHash(ChunkCoord));
+		FBlockTickContext Context(ReadOnlyWorld, Step, (int32)JobSeed);
+
+		for (const FIntVector& BlockCoord : Job.DueTicks)
+		{
+			const FBlockID Block = Context.GetBlock(BlockCoord);
+			const FBlockID Type = EBlockID::GetType(Block);
+			if (Type < EBlockID::Num && ScheduledTickFunctions[Type] != nullptr)
+			{
+				ScheduledTickFunctions[Type](Context, BlockCoord, Block);
+			}
+		}
+
+		const FIntVector ChunkOrigin(ChunkCoord.X * FChunkSection::Size, ChunkCoord.Y * FChunkSection::Size, 0);
+		for (int32 SectionIndex = 0; SectionIndex < FChunk::NumSections && RandomTicksPerSection > 0; ++SectionIndex)
+		{
+			const FChunkSection& Section = Job.Chunk->GetSection(SectionIndex);
+			if (Section.IsEmpty())
+			{
+				continue;
+			}
+
+			for (int32 Tick = 0; Tick < RandomTicksPerSection; ++Tick)
+			{
+				const int32 Index = Context.GetRandom().RandHelper(FChunkSection::Volume);
+				const int32 X = Index & (FChunkSection::Size - 1);
+				const int32 Y = (Index >> 4) & (FChunkSection::Size - 1);
+				const int32 Z = Index >> 8;
+
+				const FBlockID Block = Section.Get(X, Y, Z);
+				if (HasRandomTick(Block))
+				{
+					RandomTickFunctions[EBlockID::GetType(Block)](Context, ChunkOrigin + FIntVector(X, Y, SectionIndex * FChunkSection::Size + Z), Block);
+				}
+			}
+		}
+
+		Job.Writes = MoveTemp(Context.Writes);
+		Job.Requests = MoveTemp(Context.Requests);
+	});
+
+	//merge in chunk order, a write whose block was already changed by an earlier one is dropped
+	//the sections they change are remeshed at a throttled rate, a spreading flood would otherwise remesh them every step
+	int32 NumWrites = 0;
+	for (const FChunkTickJob& Job : Jobs)
+	{
+		for (const FBlockTickWrite& Write : Job.Writes)
+		{
+			if (VoxelWorld.IsChunkTickable(UVoxelWorldSubsystem::BlockToChunk(Write.BlockCoord)) && VoxelWorld.GetBlock(Write.BlockCoord) == Write.Expected)
+			{
+				NumWrites += VoxelWorld.SetBlock(Write.BlockCoord, Write.Block, EBlockWriteFlags::ThrottleRemesh) ? 1 : 0;
+			}
+		}
+
+		for (const FBlockTickRequest& Request : Job.Requests)
+		{
+			ScheduleTick(Request.BlockCoord, Request.DelaySteps);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_VoxelBlockTickWrites, NumWrites);
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	++Stats.NumSteps;
+	Stats.Seconds += Seconds;
+	Stats.MaxStepMicroseconds = FMath::Max(Stats.MaxStepMicroseconds, (float)(Seconds * 1.0e6));
+	Stats.NumScheduledTicks += NumDue;
+	Stats.NumWrites += NumWrites;
+}
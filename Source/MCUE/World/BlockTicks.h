@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlockTypes.h"
+#include "Math/RandomStream.h"
+
+class UVoxelWorldSubsystem;
+
+//a block change made by a tick, only applied if the block is still what the tick saw
+struct FBlockTickWrite
+{
+	FIntVector BlockCoord;
+	FBlockID Expected;
+	FBlockID Block;
+};
+
+//a tick a handler asked for, DelaySteps after the current step
+struct FBlockTickRequest
+{
+	FIntVector BlockCoord;
+	int32 DelaySteps;
+};
+
+//what a tick handler can see and do while chunks are ticked in parallel
+//reads see the world as it was when the step started, writes and new ticks are collected and merged afterwards
+class MCUE_API FBlockTickContext
+{
+public:
+	FBlockTickContext(const UVoxelWorldSubsystem& InVoxelWorld, int64 InStep, int32 InSeed)
+		: VoxelWorld(InVoxelWorld)
+		, Step(InStep)
+		, Random(InSeed)
+	{
+	}
+
+	FBlockID GetBlock(const FIntVector& BlockCoord) const;
+
+	void SetBlock(const FIntVector& BlockCoord, FBlockID Block) { Writes.Add(FBlockTickWrite{ BlockCoord, GetBlock(BlockCoord), Block }); }
+
+	void ScheduleTick(const FIntVector& BlockCoord, int32 DelaySteps) { Requests.Add(FBlockTickRequest{ BlockCoord, DelaySteps }); }
+
+	int64 GetStep() const { return Step; }
+
+	//seeded from the world seed, the step and the chunk, so a step always plays out the same way
+	FRandomStream& GetRandom() { return Random; }
+
+	TArray<FBlockTickWrite> Writes;
+	TArray<FBlockTickRequest> Requests;
+
+private:
+	const UVoxelWorldSubsystem& VoxelWorld;
+
+	int64 Step;
+
+	FRandomStream Random;
+};
+
+//what block ticks cost since the stats were last reset
+struct FBlockTickStats
+{
+	int32 NumSteps;
+	double Seconds;
+	float MaxStepMicroseconds;
+
+	//scheduled ticks run and block writes applied
+	int32 NumScheduledTicks;
+	int32 NumWrites;
+};
+
+//runs block behaviour at a fixed rate
+//scheduled ticks are asked for by position and run in order once their step comes, at most one pending per block
+//random ticks pick a few cells in every non empty section of every loaded chunk each step, e.g. for grass spreading
+//each chunk is ticked as its own job, their writes are merged on the game thread in chunk order so the result is deterministic
+//scheduled ticks are not saved with the chunks, any left in a chunk that unloads are dropped
+class MCUE_API FBlockTickScheduler
+{
+public:
+	FBlockTickScheduler();
+
+	void Configure(float InStepsPerSecond, int32 InMaxStepsPerFrame, int32 InRandomTicksPerSection, int32 InMaxScheduledTicksPerStep, int32 InSeed);
+
+	//runs however many whole steps DeltaTime adds up to, up to the per frame cap
+	void Advance(UVoxelWorldSubsystem& VoxelWorld, float DeltaTime);
+
+	//ticks the block DelaySteps from now, ignored if the block already has a tick pending
+	void ScheduleTick(const FIntVector& BlockCoord, int32 DelaySteps);
+
+	int64 GetStep() const { return Step; }
+
+	int32 GetNumScheduled() const { return Scheduled.Num(); }
+
+	const FBlockTickStats& GetStats() const { return Stats; }
+	void ResetStats() { FMemory::Memzero(Stats); }
+
+	//true if the block type reacts to random ticks
+	static bool HasRandomTick(FBlockID Block);
+
+private:
+	struct FScheduledTick
+	{
+		int64 Step;
+
+		//order the tick was asked for in, breaks ties between ticks due on the same step
+		uint32 Sequence;
+
+		FIntVector BlockCoord;
+
+		bool operator<(const FScheduledTick& Other) const { return Step != Other.Step ? Step < Other.Step : Sequence < Other.Sequence; }
+	};
+
+	void RunStep(UVoxelWorldSubsystem& VoxelWorld);
+
+	//heap ordered by due step
+	TArray<FScheduledTick> Scheduled;
+
+	//blocks with a tick in Scheduled
+	TSet<FIntVector> ScheduledBlocks;
+
+	uint32 NextSequence;
+
+	int64 Step;
+
+	//simulated time not yet used up by a whole step
+	float Accumulator;
+
+	float StepSeconds;
+	int32 MaxStepsPerFrame;
+	int32 RandomTicksPerSection;
+	int32 MaxScheduledTicksPerStep;
+	int32 Seed;
+
+	FBlockTickStats Stats;
+};
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlockTypes.h"
+#include "BlockRegistryAsset.h"
+#include "Wieldable/Wieldable.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogBlockRegistry, Log, All);
+
+namespace
+{
+	constexpr int32 NumTools = AWieldable::Sword + 1;
+
+	//materials are indexed by their value, which is also how much faster than a bare hand they mine
+	constexpr int32 NumMaterials = AWieldable::Golden + 1;
+
+	//whole block, five hits at the old (resistance / 100) / 2 seconds apart
+	constexpr float SecondsPerResistance = 5.0f / 200.0f;
+
+	//mining a block too hard for the tool's material takes this much longer, like it does without the right tool in minecraft
+	constexpr float UnharvestablePenalty = 5.0f / 1.5f;
+
+	struct FBlockTable
+	{
+		FBlockProperties Blocks[EBlockID::Num];
+	};
+
+	struct FBreakTimeTable
+	{
+		float Seconds[EBlockID::Num][NumTools][NumMaterials];
+	};
+
+	constexpr FBlockTable DefaultBlocks =
+	{{
+		/* Air     */ { 0.0f,  AWieldable::Unarmed, AWieldable::None,   EBlockID::Air,     0, false, false, 0,  0, 0 },
+		/* Grass   */ { 20.0f, AWieldable::Shovel,  AWieldable::None,   EBlockID::Grass,   1, true,  true,  0,  0, 0 },
+		/* Rock    */ { 60.0f, AWieldable::Pickaxe, AWieldable::Wooden, EBlockID::Cobble,  1, true,  true,  0,  0, 0 },
+		/* Cobble  */ { 60.0f, AWieldable::Pickaxe, AWieldable::Wooden, EBlockID::Cobble,  1, true,  true,  0,  0, 0 },
+		/* IronOre */ { 90.0f, AWieldable::Pickaxe, AWieldable::Stone,  EBlockID::IronOre, 1, true,  true,  0,  0, 0 },
+		/* Water   */ { 0.0f,  AWieldable::Unarmed, AWieldable::None,   EBlockID::Air,     0, false, false, 0,  1, 5 },
+		/* Lava    */ { 0.0f,  AWieldable::Unarmed, AWieldable::None,   EBlockID::Air,     0, false, false, 15, 2, 30 },
+		/* Dirt    */ { 20.0f, AWieldable::Shovel,  AWieldable::None,   EBlockID::Dirt,    1, true,  true,  0,  0, 0 },
+	}};
+
+	constexpr float ComputeBreakTime(const FBlockProperties& Block, int32 Tool, int32 Material)
+	{
+		float Seconds = Block.Resistance * SecondsPerResistance;
+
+		//tools only help on the blocks they are made for, anything held counts as a bare hand otherwise
+		if (Block.PreferredTool != AWieldable::Unarmed && Tool == Block.PreferredTool && Material > AWieldable::None)
+		{
+			Seconds /= (float)Material;
+		}
+
+		if (Material < Block.MinimumMaterial)
+		{
+			Seconds *= UnharvestablePenalty;
+		}
+
+		return Seconds;
+	}
+
+	constexpr FBreakTimeTable BuildBreakTimes(const FBlockTable& Table)
+	{
+		FBreakTimeTable BreakTimes = {};
+		for (int32 Block = 0; Block < EBlockID::Num; ++Block)
+		{
+			for (int32 Tool = 0; Tool < NumTools; ++Tool)
+			{
+				for (int32 Material = 0; Material < NumMaterials; ++Material)
+				{
+					BreakTimes.Seconds[Block][Tool][Material] = ComputeBreakTime(Table.Blocks[Block], Tool, Material);
+				}
+			}
+		}
+		return BreakTimes;
+	}
+
+	constexpr FBreakTimeTable DefaultBreakTimes = BuildBreakTimes(DefaultBlocks);
+
+	//what lookups read, copies of the defaults until an asset replaces them
+	FBlockTable Blocks = DefaultBlocks;
+	FBreakTimeTable BreakTimes = DefaultBreakTimes;
+}
+
+const FBlockProperties& FBlockRegistry::Get(FBlockID Block)
+{
+	//unknown ids behave like air so corrupt data can't crash a lookup
+	const FBlockID Type = EBlockID::GetType(Block);
+	return Type < EBlockID::Num ? Blocks.Blocks[Type] : Blocks.Blocks[EBlockID::Air];
+}
+
+float FBlockRegistry::GetBreakTime(FBlockID Block, uint8 Tool, uint8 Material)
+{
+	const FBlockID Type = EBlockID::GetType(Block);
+	if (Type >= EBlockID::Num)
+	{
+		return 0.0f;
+	}
+	return BreakTimes.Seconds[Type][FMath::Min<int32>(Tool, NumTools - 1)][FMath::Min<int32>(Material, NumMaterials - 1)];
+}
+
+void FBlockRegistry::Initialize(const UBlockRegistryAsset& Asset)
+{
+	FBlockTable Table = DefaultBlocks;
+
+	for (const FBlockDefinition& Definition : Asset.Blocks)
+	{
+		//ids are fixed by the chunk data on disk, an asset can describe them but not add new ones
+		if (Definition.BlockID <= EBlockID::Air || Definition.BlockID >= EBlockID::Num)
+		{
+			UE_LOG(LogBlockRegistry, Warning, TEXT("%s: ignoring block id %d, ids run from 1 to %d"), *Asset.GetName(), Definition.BlockID, EBlockID::Num - 1);
+			continue;
+		}
+
+		FBlockProperties& Properties = Table.Blocks[Definition.BlockID];
+		Properties.Resistance = FMath::Max(0.0f, Definition.Resistance);
+		Properties.PreferredTool = FMath::Min<uint8>(Definition.PreferredTool, NumTools - 1);
+		Properties.MinimumMaterial = Definition.MinimumMaterial;
+		Properties.Drop = Definition.DropBlockID >= 0 && Definition.DropBlockID < EBlockID::Num ? (FBlockID)Definition.DropBlockID : (FBlockID)EBlockID::Air;
+		Properties.DropCount = Definition.DropCount;
+		Properties.bIsSolid = Definition.bIsSolid;
+		Properties.bIsOpaque = Definition.bIsSolid && Definition.bIsOpaque;
+		Properties.LightEmission = FMath::Min<uint8>(Definition.LightEmission, 15);
+		Properties.FluidFlowStep = Definition.FluidFlowStep;
+		Properties.FluidTickSteps = FMath::Max<uint8>(Definition.FluidTickSteps, 1);
+	}
+
+	Blocks = Table;
+	BreakTimes = BuildBreakTimes(Table);
+}
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UBlockRegistryAsset;
+
+//compact block id stored in chunk data, 0 is always air
+//the low 12 bits are the block type, the high 4 bits are state that only some types use, e.g. a fluid's level
+typedef uint16 FBlockID;
+
+namespace EBlockID
+{
+	enum Type : FBlockID
+	{
+		Air = 0,
+		Grass,
+		Rock,
+		Cobble,
+		IronOre,
+		Water,
+		Lava,
+		Dirt,
+
+		Num
+	};
+
+	constexpr int32 StateShift = 12;
+	constexpr FBlockID TypeMask = (1 << StateShift) - 1;
+
+	constexpr FBlockID GetType(FBlockID Block) { return Block & TypeMask; }
+	constexpr uint8 GetState(FBlockID Block) { return (uint8)(Block >> StateShift); }
+	constexpr FBlockID Make(FBlockID Type, uint8 State) { return (FBlockID)(Type | (State << StateShift)); }
+}
+
+//per block type properties, shared by every block of that type
+struct FBlockProperties
+{
+	//how long the block takes to break
+	float Resistance;
+
+	//AWieldable::ETool that mines the block faster, Unarmed if none does
+	uint8 PreferredTool;
+
+	//the lowest tool material that gets a drop from this block
+	uint8 MinimumMaterial;
+
+	//what breaking the block gives, air if nothing
+	FBlockID Drop;
+	uint8 DropCount;
+
+	//true if the block fills its cell
+	bool bIsSolid;
+
+	//true if nothing behind the block can be seen through it, faces against it are never meshed
+	//opaque blocks also stop light
+	bool bIsOpaque;
+
+	//block light level the block gives off, 0 to 15
+	uint8 LightEmission;
+
+	//fluids only, 0 for anything else: levels lost per block of sideways flow, and block tick steps between updates
+	uint8 FluidFlowStep;
+	uint8 FluidTickSteps;
+};
+
+//looks up the properties of a block type by id, the state bits of the id are ignored
+//starts out with the built in defaults, a UBlockRegistryAsset can replace them before the world loads
+class MCUE_API FBlockRegistry
+{
+public:
+	static const FBlockProperties& Get(FBlockID Block);
+
+	static bool IsSolid(FBlockID Block) { return Get(Block).bIsSolid; }
+
+	static bool IsOpaque(FBlockID Block) { return Get(Block).bIsOpaque; }
+
+	static uint8 GetLightEmission(FBlockID Block) { return Get(Block).LightEmission; }
+
+	static bool IsFluid(FBlockID Block) { return Get(Block).FluidFlowStep > 0; }
+
+	//seconds to break a block with the given AWieldable tool and material, a single table lookup
+	static float GetBreakTime(FBlockID Block, uint8 Tool, uint8 Material);
+
+	//true if mining the block with this material gives its drop
+	static bool CanHarvest(FBlockID Block, uint8 Material) { return Material >= Get(Block).MinimumMaterial; }
+
+	//replaces the properties of every block the asset lists and rebuilds the break times
+	//must not run while workers are meshing or generating, they read the registry without locking
+	static void Initialize(const UBlockRegistryAsset& Asset);
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Chunk.h"
+
+FChunk::FChunk(const FIntPoint& InCoord)
+	: Coord(InCoord)
+	, Revision(0)
+	, SavedRevision(MAX_uint32)
+	, bHasLevelBlocks(false)
+	, bSavedLevelBlocks(false)
+{
+}
+
+bool FChunk::SetBlock(int32 X, int32 Y, int32 Z, FBlockID Block)
+{
+	if (Sections[Z >> 4].Set(X, Y, Z & (FChunkSection::Size - 1), Block))
+	{
+		++Revision;
+		return true;
+	}
+	return false;
+}
+
+bool FChunk::Serialize(FArchive& Ar)
+{
+	//bump when the layout changes, older data is then refused rather than misread
+	//version 1 had no level blocks flag, those chunks read as never having had them applied
+	uint8 Version = 2;
+	Ar << Version;
+
+	if (Version != 1 && Version != 2)
+	{
+		Ar.SetError();
+		return false;
+	}
+
+	if (Version >= 2)
+	{
+		Ar << bHasLevelBlocks;
+	}
+
+	bool bValid = true;
+	for (FChunkSection& Section : Sections)
+	{
+		bValid &= Section.Serialize(Ar);
+	}
+	return bValid && !Ar.IsError();
+}
+
+void FChunk::MarkLevelBlocks()
+{
+	if (!bHasLevelBlocks)
+	{
+		bHasLevelBlocks = true;
+		++Revision;
+	}
+}
+
+SIZE_T FChunk::GetAllocatedSize() const
+{
+	SIZE_T Size = sizeof(FChunk);
+	for (const FChunkSection& Section : Sections)
+	{
+		Size += Section.GetAllocatedSize();
+	}
+	return Size + Light.GetAllocatedSize();
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkSection.h"
+#include "ChunkLight.h"
+
+//a vertical column of chunk sections, the unit the world loads and unloads
+class MCUE_API FChunk
+{
+public:
+	static constexpr int32 NumSections = 16;
+	static constexpr int32 Height = NumSections * FChunkSection::Size;
+
+	static_assert(FChunkLight::NumSections == NumSections, "light has to cover the whole column");
+
+	explicit FChunk(const FIntPoint& InCoord);
+
+	const FIntPoint& GetCoord() const { return Coord; }
+
+	//local x/y in [0, 16), z in [0, Height)
+	FBlockID GetBlock(int32 X, int32 Y, int32 Z) const
+	{
+		return Sections[Z >> 4].Get(X, Y, Z & (FChunkSection::Size - 1));
+	}
+
+	//returns true if the block actually changed
+	bool SetBlock(int32 X, int32 Y, int32 Z, FBlockID Block);
+
+	FChunkSection& GetSection(int32 Index) { return Sections[Index]; }
+	const FChunkSection& GetSection(int32 Index) const { return Sections[Index]; }
+
+	//filled in by FVoxelLighting, doesn't count as a change to the chunk
+	FChunkLight& GetLight() { return Light; }
+	const FChunkLight& GetLight() const { return Light; }
+
+	//bumped on every change, lets caches tell if the chunk is still the one they saw
+	uint32 GetRevision() const { return Revision; }
+	void MarkModified() { ++Revision; }
+
+	//used when this chunk replaces another one at the same coordinate, so old revisions never match it
+	void InheritRevision(const FChunk& Previous) { Revision = FMath::Max(Revision, Previous.Revision) + 1; }
+
+	//true if the chunk changed since it was last written to or read from disk
+	bool NeedsSave() const { return Revision != SavedRevision; }
+	void MarkSaved() { SavedRevision = Revision; }
+
+	//true once the blocks placed in the level were written into this chunk, saved with it
+	bool HasLevelBlocks() const { return bHasLevelBlocks; }
+	void MarkLevelBlocks();
+
+	//true if this chunk was read back from a region file that already had the level blocks, not saved
+	bool HasSavedLevelBlocks() const { return bSavedLevelBlocks; }
+	void MarkSavedLevelBlocks() { bSavedLevelBlocks = bHasLevelBlocks; }
+
+	//every section in order, returns false if the data couldn't be read
+	bool Serialize(FArchive& Ar);
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	FIntPoint Coord;
+
+	FChunkSection Sections[NumSections];
+
+	FChunkLight Light;
+
+	uint32 Revision;
+
+	//revision at the last save or load, a new chunk has never been saved
+	uint32 SavedRevision;
+
+	bool bHasLevelBlocks;
+
+	bool bSavedLevelBlocks;
+};
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkCollision.h"
+#include "VoxelWorldSubsystem.h"
+
+void FChunkCollisionBuilder::Build(const FChunkMeshInput& Input, TArray<FBox>& OutBoxes)
+{
+	const int32 Size = FChunkSection::Size;
+
+	OutBoxes.Reset();
+
+	//cells that still need a box, cleared as boxes claim them
+	TBitArray<> Open(false, FChunkSection::Volume);
+	for (int32 Z = 0; Z < Size; ++Z)
+	{
+		for (int32 Y = 0; Y < Size; ++Y)
+		{
+			for (int32 X = 0; X < Size; ++X)
+			{
+				if (FBlockRegistry::IsSolid(Input.Get(X, Y, Z)))
+				{
+					Open[FChunkSection::ToIndex(X, Y, Z)] = true;
+				}
+			}
+		}
+	}
+
+	auto IsRowOpen = [&](int32 X, int32 Y, int32 Z, int32 Width)
+	{
+		for (int32 K = 0; K < Width; ++K)
+		{
+			if (!Open[FChunkSection::ToIndex(X + K, Y, Z)])
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	for (int32 Z = 0; Z < Size; ++Z)
+	{
+		for (int32 Y = 0; Y < Size; ++Y)
+		{
+			for (int32 X = 0; X < Size; ++X)
+			{
+				if (!Open[FChunkSection::ToIndex(X, Y, Z)])
+				{
+					continue;
+				}
+
+				//grow along x, then y a whole row at a time, then z a whole layer at a time
+				int32 Width = 1;
+				while (X + Width < Size && Open[FChunkSection::ToIndex(X + Width, Y, Z)])
+				{
+					++Width;
+				}
+
+				int32 Depth = 1;
+				while (Y + Depth < Size && IsRowOpen(X, Y + Depth, Z, Width))
+				{
+					++Depth;
+				}
+
+				int32 Height = 1;
+				for (; Z + Height < Size; ++Height)
+				{
+					bool bLayerOpen = true;
+					for (int32 J = 0; J < Depth && bLayerOpen; ++J)
+					{
+						bLayerOpen = IsRowOpen(X, Y + J, Z + Height, Width);
+					}
+					if (!bLayerOpen)
+					{
+						break;
+					}
+				}
+
+				for (int32 H = 0; H < Height; ++H)
+				{
+					for (int32 J = 0; J < Depth; ++J)
+					{
+						for (int32 K = 0; K < Width; ++K)
+						{
+							Open[FChunkSection::ToIndex(X + K, Y + J, Z + H)] = false;
+						}
+					}
+				}
+
+				const FVector Min = FVector(X, Y, Z) * UVoxelWorldSubsystem::BlockSize;
+				const FVector Max = FVector(X + Width, Y + Depth, Z + Height) * UVoxelWorldSubsystem::BlockSize;
+				OutBoxes.Add(FBox(Min, Max));
+
+				X += Width - 1;
+			}
+		}
+	}
+}
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkMesher.h"
+
+//merges the solid cells of a section into as few boxes as it can find greedily, safe to run off the game thread
+//boxes are in world units relative to the section's min corner, ready to be used as simple collision
+class MCUE_API FChunkCollisionBuilder
+{
+public:
+	static void Build(const FChunkMeshInput& Input, TArray<FBox>& OutBoxes);
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkLight.h"
+
+FChunkLight::FChunkLight()
+{
+	for (FSection& Section : Sections)
+	{
+		Section.Uniform = 0;
+	}
+}
+
+void FChunkLight::Set(int32 X, int32 Y, int32 Z, uint8 Packed)
+{
+	FSection& Section = Sections[Z >> 4];
+	if (Section.Levels.Num() == 0)
+	{
+		if (Section.Uniform == Packed)
+		{
+			return;
+		}
+		Section.Levels.Init(Section.Uniform, FChunkSection::Volume);
+	}
+
+	Section.Levels[FChunkSection::ToIndex(X, Y, Z & (FChunkSection::Size - 1))] = Packed;
+}
+
+void FChunkLight::FillSection(int32 Index, uint8 Packed)
+{
+	Sections[Index].Levels.Empty();
+	Sections[Index].Uniform = Packed;
+}
+
+bool FChunkLight::IsSectionUniform(int32 Index, uint8& OutPacked) const
+{
+	OutPacked = Sections[Index].Uniform;
+	return Sections[Index].Levels.Num() == 0;
+}
+
+SIZE_T FChunkLight::GetAllocatedSize() const
+{
+	SIZE_T Size = 0;
+	for (const FSection& Section : Sections)
+	{
+		Size += Section.Levels.GetAllocatedSize();
+	}
+	return Size;
+}
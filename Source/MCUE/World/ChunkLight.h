@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkSection.h"
+
+//light levels of a chunk column, one byte per block with the sky light in the high nibble and block light in the low one
+//a section where every block has the same value stores only that value, so open sky and solid rock cost nothing
+//light is worked out again whenever a chunk loads, it is never saved
+class MCUE_API FChunkLight
+{
+public:
+	static constexpr uint8 MaxLevel = 15;
+
+	static constexpr uint8 Pack(uint8 Sky, uint8 Block) { return (uint8)((Sky << 4) | Block); }
+	static constexpr uint8 GetSky(uint8 Packed) { return Packed >> 4; }
+	static constexpr uint8 GetBlock(uint8 Packed) { return Packed & 15; }
+
+	//everything dark
+	FChunkLight();
+
+	//packed value, local x/y in [0, 16), z in [0, Height)
+	uint8 Get(int32 X, int32 Y, int32 Z) const
+	{
+		const FSection& Section = Sections[Z >> 4];
+		return Section.Levels.Num() > 0 ? Section.Levels[FChunkSection::ToIndex(X, Y, Z & (FChunkSection::Size - 1))] : Section.Uniform;
+	}
+
+	void Set(int32 X, int32 Y, int32 Z, uint8 Packed);
+
+	//gives every block in the section the same value and frees its storage
+	void FillSection(int32 Index, uint8 Packed);
+
+	//true if the section has a single value for all of its blocks
+	bool IsSectionUniform(int32 Index, uint8& OutPacked) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+	static constexpr int32 NumSections = 16;
+
+private:
+	struct FSection
+	{
+		//empty while every block has the Uniform value
+		TArray<uint8> Levels;
+
+		uint8 Uniform;
+	};
+
+	FSection Sections[NumSections];
+};
@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkMesher.h"
+#include "VoxelWorldSubsystem.h"
+
+void FChunkMeshInput::Gather(const UVoxelWorldSubsystem& VoxelWorld, const FIntVector& InSectionCoord)
+{
+	SectionCoord = InSectionCoord;
+	Blocks.SetNumUninitialized(PaddedSize * PaddedSize * PaddedSize);
+	Light.SetNumUninitialized(PaddedSize * PaddedSize * PaddedSize);
+
+	//open sky above the world and beside it where nothing is loaded, darkness below
+	const uint8 FullSky = FChunkLight::Pack(FChunkLight::MaxLevel, 0);
+
+	//look every neighbouring chunk up once instead of once per block
+	const FChunk* Neighbours[3][3];
+	for (int32 DY = 0; DY < 3; ++DY)
+	{
+		for (int32 DX = 0; DX < 3; ++DX)
+		{
+			Neighbours[DY][DX] = VoxelWorld.FindChunk(FIntPoint(SectionCoord.X + DX - 1, SectionCoord.Y + DY - 1));
+		}
+	}
+
+	const int32 BaseZ = SectionCoord.Z * FChunkSection::Size;
+
+	int32 Index = 0;
+	for (int32 Z = -1; Z <= FChunkSection::Size; ++Z)
+	{
+		const int32 WorldZ = BaseZ + Z;
+		const bool bValidZ = UVoxelWorldSubsystem::IsValidHeight(WorldZ);
+
+		for (int32 Y = -1; Y <= FChunkSection::Size; ++Y)
+		{
+			const int32 ChunkDY = Y < 0 ? 0 : (Y < FChunkSection::Size ? 1 : 2);
+
+			for (int32 X = -1; X <= FChunkSection::Size; ++X, ++Index)
+			{
+				const int32 ChunkDX = X < 0 ? 0 : (X < FChunkSection::Size ? 1 : 2);
+				const FChunk* Chunk = Neighbours[ChunkDY][ChunkDX];
+
+				Blocks[Index] = (bValidZ && Chunk != nullptr) ? Chunk->GetBlock(X & 15, Y & 15, WorldZ) : (FBlockID)EBlockID::Air;
+				Light[Index] = (bValidZ && Chunk != nullptr) ? Chunk->GetLight().Get(X & 15, Y & 15, WorldZ) : (WorldZ < 0 ? 0 : FullSky);
+			}
+		}
+	}
+}
+
+int32 FChunkMeshData::GetNumQuads() const
+{
+	int32 NumQuads = 0;
+	for (const FChunkMeshBatch& Batch : Batches)
+	{
+		NumQuads += Batch.Vertices.Num() / 4;
+	}
+	return NumQuads;
+}
+
+namespace
+{
+	FChunkMeshBatch& FindOrAddBatch(FChunkMeshData& Mesh, FBlockID Block)
+	{
+		for (FChunkMeshBatch& Batch : Mesh.Batches)
+		{
+			if (Batch.Block == Block)
+			{
+				return Batch;
+			}
+		}
+
+		FChunkMeshBatch& Batch = Mesh.Batches.AddDefaulted_GetRef();
+		Batch.Block = Block;
+		return Batch;
+	}
+
+	//faces only merge if both the block and the light in front of them match
+	FORCEINLINE uint32 MakeFaceKey(FBlockID Block, uint8 Light) { return (uint32)Block | ((uint32)Light << 16); }
+	FORCEINLINE FBlockID GetFaceBlock(uint32 Key) { return (FBlockID)(Key & 0xffff); }
+	FORCEINLINE uint8 GetFaceLight(uint32 Key) { return (uint8)(Key >> 16); }
+
+	FColor GetLightColor(uint8 Light)
+	{
+		return FColor(FChunkLight::GetSky(Light) * 17, FChunkLight::GetBlock(Light) * 17, 0, 255);
+	}
+
+	void AddQuad(FChunkMeshBatch& Batch, const FVector& Origin, const FVector& AxisU, const FVector& AxisV, const FVector& Normal, float Width, float Height, bool bFlipWinding, const FColor& Color)
+	{
+		const float BlockSize = UVoxelWorldSubsystem::BlockSize;
+		const int32 First = Batch.Vertices.Num();
+
+		Batch.Vertices.Add(Origin * BlockSize);
+		Batch.Vertices.Add((Origin + AxisU * Width) * BlockSize);
+		Batch.Vertices.Add((Origin + AxisU * Width + AxisV * Height) * BlockSize);
+		Batch.Vertices.Add((Origin + AxisV * Height) * BlockSize);
+
+		//uvs are in blocks so the texture tiles once per merged cell
+		Batch.UVs.Add(FVector2D(0.0f, 0.0f));
+		Batch.UVs.Add(FVector2D(Width, 0.0f));
+		Batch.UVs.Add(FVector2D(Width, Height));
+		Batch.UVs.Add(FVector2D(0.0f, Height));
+
+		for (int32 i = 0; i < 4; ++i)
+		{
+			Batch.Normals.Add(Normal);
+			Batch.Colors.Add(Color);
+		}
+
+		//u x v points along the positive axis, so faces looking down it use the other winding
+		if (bFlipWinding)
+		{
+			Batch.Triangles.Append({ First, First + 2, First + 1, First, First + 3, First + 2 });
+		}
+		else
+		{
+			Batch.Triangles.Append({ First, First + 1, First + 2, First, First + 2, First + 3 });
+		}
+	}
+}
+
+void FChunkMesher::Build(const FChunkMeshInput& Input, FChunkMeshData& OutMesh)
+{
+	const int32 Size = FChunkSection::Size;
+
+	OutMesh.SectionCoord = Input.SectionCoord;
+	OutMesh.Generation = Input.Generation;
+	OutMesh.Batches.Reset();
+
+	uint32 Mask[FChunkSection::Size * FChunkSection::Size];
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		const int32 U = (Axis + 1) % 3;
+		const int32 V = (Axis + 2) % 3;
+
+		FIntVector AxisStep(0, 0, 0);
+		AxisStep[Axis] = 1;
+
+		FVector AxisU(0.0f), AxisV(0.0f);
+		AxisU[U] = 1.0f;
+		AxisV[V] = 1.0f;
+
+		for (int32 Direction = -1; Direction <= 1; Direction += 2)
+		{
+			FVector Normal(0.0f);
+			Normal[Axis] = (float)Direction;
+
+			for (int32 Slice = 0; Slice < Size; ++Slice)
+			{
+				//mark every visible face in this slice with the block type that owns it
+				FIntVector Cell;
+				Cell[Axis] = Slice;
+				for (int32 J = 0; J < Size; ++J)
+				{
+					Cell[V] = J;
+					for (int32 I = 0; I < Size; ++I)
+					{
+						Cell[U] = I;
+						const FBlockID Block = EBlockID::GetType(Input.Get(Cell.X, Cell.Y, Cell.Z));
+						const FIntVector Neighbour = Cell + AxisStep * Direction;
+						const FBlockID NeighbourBlock = EBlockID::GetType(Input.Get(Neighbour.X, Neighbour.Y, Neighbour.Z));
+
+						//fluids are drawn as whole blocks whatever their level, with no faces between two blocks of the same fluid
+						const bool bDrawn = FBlockRegistry::IsSolid(Block) || FBlockRegistry::IsFluid(Block);
+						const bool bVisible = bDrawn && !FBlockRegistry::IsOpaque(NeighbourBlock) && NeighbourBlock != Block;
+						Mask[I + J * Size] = bVisible ? MakeFaceKey(Block, Input.GetLight(Neighbour.X, Neighbour.Y, Neighbour.Z)) : 0u;
+					}
+				}
+
+				//grow each face as wide as possible, then as tall as the whole row allows
+				for (int32 J = 0; J < Size; ++J)
+				{
+					for (int32 I = 0; I < Size;)
+					{
+						const uint32 Face = Mask[I + J * Size];
+						if (Face == 0)
+						{
+							++I;
+							continue;
+						}
+
+						int32 Width = 1;
+						while (I + Width < Size && Mask[I + Width + J * Size] == Face)
+						{
+							++Width;
+						}
+
+						int32 Height = 1;
+						for (; J + Height < Size; ++Height)
+						{
+							bool bRowMatches = true;
+							for (int32 K = 0; K < Width; ++K)
+							{
+								if (Mask[I + K + (J + Height) * Size] != Face)
+								{
+									bRowMatches = false;
+									break;
+								}
+							}
+							if (!bRowMatches)
+							{
+								break;
+							}
+						}
+
+						FVector Origin(0.0f);
+						Origin[Axis] = (float)(Slice + (Direction > 0 ? 1 : 0));
+						Origin[U] = (float)I;
+						Origin[V] = (float)J;
+
+						AddQuad(FindOrAddBatch(OutMesh, GetFaceBlock(Face)), Origin, AxisU, AxisV, Normal, (float)Width, (float)Height, Direction < 0, GetLightColor(GetFaceLight(Face)));
+
+						for (int32 H = 0; H < Height; ++H)
+						{
+							for (int32 K = 0; K < Width; ++K)
+							{
+								Mask[I + K + (J + H) * Size] = 0u;
+							}
+						}
+
+						I += Width;
+					}
+				}
+			}
+		}
+	}
+}
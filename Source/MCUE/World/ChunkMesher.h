@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlockTypes.h"
+
+class UVoxelWorldSubsystem;
+
+//copy of one section plus a one block border from its neighbours, safe to mesh off the game thread
+struct FChunkMeshInput
+{
+	static constexpr int32 PaddedSize = 18;
+
+	//chunk x, chunk y, section index
+	FIntVector SectionCoord;
+
+	//bumped each time the section is dispatched, stale results are thrown away
+	uint32 Generation;
+
+	TArray<FBlockID> Blocks;
+
+	//packed light levels of the same blocks, see FChunkLight
+	TArray<uint8> Light;
+
+	static int32 ToIndex(int32 X, int32 Y, int32 Z) { return (X + 1) + (Y + 1) * PaddedSize + (Z + 1) * PaddedSize * PaddedSize; }
+
+	FBlockID Get(int32 X, int32 Y, int32 Z) const { return Blocks[ToIndex(X, Y, Z)]; }
+
+	uint8 GetLight(int32 X, int32 Y, int32 Z) const { return Light[ToIndex(X, Y, Z)]; }
+
+	//copies the section and its border out of the world, must run on the game thread
+	void Gather(const UVoxelWorldSubsystem& VoxelWorld, const FIntVector& InSectionCoord);
+};
+
+//vertex buffers for every face of one block type in a section
+struct FChunkMeshBatch
+{
+	FBlockID Block;
+
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UVs;
+	TArray<FColor> Colors;
+};
+
+struct FChunkMeshData
+{
+	FIntVector SectionCoord;
+	uint32 Generation;
+
+	//one batch per block type, so each can use its own material
+	TArray<FChunkMeshBatch> Batches;
+
+	//simple collision for the section, see FChunkCollisionBuilder
+	TArray<FBox> CollisionBoxes;
+	float CollisionBuildMicroseconds;
+
+	int32 GetNumQuads() const;
+};
+
+//builds section meshes with hidden faces removed and coplanar faces of the same type and light merged
+//each face takes the light of the block in front of it, as vertex colour: sky light in red, block light in green, 0 to 255
+//block materials are expected to shade with it
+class MCUE_API FChunkMesher
+{
+public:
+	static void Build(const FChunkMeshInput& Input, FChunkMeshData& OutMesh);
+};
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkReplicatorComponent.h"
+#include "VoxelReplicationSubsystem.h"
+#include "Engine/ChildConnection.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+UChunkReplicatorComponent::UChunkReplicatorComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	//only the client rpcs need the component to replicate, it has no replicated properties
+	SetIsReplicatedByDefault(true);
+}
+
+void UChunkReplicatorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (GetOwnerRole() == ROLE_Authority && GetNetMode() != NM_Standalone)
+	{
+		if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+		{
+			Replication->AddReplicator(this);
+		}
+	}
+}
+
+void UChunkReplicatorComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->RemoveReplicator(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+UNetConnection* UChunkReplicatorComponent::GetClientConnection() const
+{
+	UNetConnection* Connection = GetOwner()->GetNetConnection();
+
+	//split screen players share their parent's connection and world, so they share one interest set too
+	if (Connection != nullptr && Connection->GetUChildConnection() != nullptr)
+	{
+		Connection = Connection->GetUChildConnection()->Parent;
+	}
+	return Connection;
+}
+
+void UChunkReplicatorComponent::GetView(FVector& OutLocation, FRotator& OutRotation) const
+{
+	GetOwner()->GetActorEyesViewPoint(OutLocation, OutRotation);
+}
+
+void UChunkReplicatorComponent::ClientBeginChunk_Implementation(FIntPoint ChunkCoord, int32 UncompressedSize, int32 CompressedSize, float RelevantTime)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->BeginChunk(*this, ChunkCoord, UncompressedSize, CompressedSize, RelevantTime);
+	}
+}
+
+void UChunkReplicatorComponent::ClientReceiveChunkData_Implementation(FIntPoint ChunkCoord, const TArray<uint8>& Data)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->ReceiveChunkData(*this, ChunkCoord, Data);
+	}
+}
+
+void UChunkReplicatorComponent::ClientReceiveBlockDeltas_Implementation(FIntPoint ChunkCoord, const TArray<uint32>& Deltas)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->ReceiveBlockDeltas(ChunkCoord, Deltas);
+	}
+}
+
+void UChunkReplicatorComponent::ClientForgetChunk_Implementation(FIntPoint ChunkCoord)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->ForgetChunk(ChunkCoord);
+	}
+}
+
+bool UChunkReplicatorComponent::ServerRequestChunk_Validate(FIntPoint ChunkCoord)
+{
+	return true;
+}
+
+void UChunkReplicatorComponent::ServerRequestChunk_Implementation(FIntPoint ChunkCoord)
+{
+	if (UVoxelReplicationSubsystem* Replication = GetWorld()->GetSubsystem<UVoxelReplicationSubsystem>())
+	{
+		Replication->ResendChunk(this, ChunkCoord);
+	}
+}
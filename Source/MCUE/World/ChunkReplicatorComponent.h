@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ChunkReplicatorComponent.generated.h"
+
+class UNetConnection;
+
+//the channel block data travels to one player's client on, lives on the player's pawn
+//it holds no state itself: the server side UVoxelReplicationSubsystem decides what to send through it,
+//and the client side hands everything it receives to the subsystem of its own world
+UCLASS(ClassGroup=(Voxel), meta=(BlueprintSpawnableComponent))
+class MCUE_API UChunkReplicatorComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UChunkReplicatorComponent();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//the connection to the client that owns the pawn, the parent connection for split screen guests
+	//nullptr while the pawn isn't possessed by a remote player
+	UNetConnection* GetClientConnection() const;
+
+	//where the owning player looks from, interest and priorities are measured from here
+	void GetView(FVector& OutLocation, FRotator& OutRotation) const;
+
+	//a full chunk follows in CompressedSize bytes of ClientReceiveChunkData, RelevantTime is when the server started wanting the client to have it
+	UFUNCTION(Client, Reliable)
+	void ClientBeginChunk(FIntPoint ChunkCoord, int32 UncompressedSize, int32 CompressedSize, float RelevantTime);
+
+	UFUNCTION(Client, Reliable)
+	void ClientReceiveChunkData(FIntPoint ChunkCoord, const TArray<uint8>& Data);
+
+	//blocks changed in a chunk the client already has, packed by UVoxelReplicationSubsystem::PackBlockDelta
+	UFUNCTION(Client, Reliable)
+	void ClientReceiveBlockDeltas(FIntPoint ChunkCoord, const TArray<uint32>& Deltas);
+
+	//the chunk left the client's interest, it can unload it
+	UFUNCTION(Client, Reliable)
+	void ClientForgetChunk(FIntPoint ChunkCoord);
+
+	//the client couldn't install a chunk it was sent, the server sends it whole again
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRequestChunk(FIntPoint ChunkCoord);
+};
@@ -0,0 +1,237 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkSection.h"
+
+namespace
+{
+	//smallest power of two bit width (as log2) that can index NumEntries palette entries
+	int32 GetBitsLog2ForPaletteSize(int32 NumEntries)
+	{
+		if (NumEntries <= 1)
+		{
+			return -1;
+		}
+
+		int32 BitsLog2 = 0;
+		while ((1 << (1 << BitsLog2)) < NumEntries)
+		{
+			++BitsLog2;
+		}
+		return BitsLog2;
+	}
+}
+
+FChunkSection::FChunkSection()
+	: BitsLog2(-1)
+	, NonAirCount(0)
+{
+	Palette.Add(EBlockID::Air);
+	PaletteRefCounts.Add(Volume);
+}
+
+bool FChunkSection::Set(int32 X, int32 Y, int32 Z, FBlockID Block)
+{
+	const int32 Index = ToIndex(X, Y, Z);
+	const int32 OldPaletteIndex = GetPaletteIndex(Index);
+	const FBlockID OldBlock = Palette[OldPaletteIndex];
+
+	if (OldBlock == Block)
+	{
+		return false;
+	}
+
+	//release the old entry first so its slot can be reused by the new block
+	--PaletteRefCounts[OldPaletteIndex];
+
+	const int32 NewPaletteIndex = FindOrAddPaletteEntry(Block);
+	SetPaletteIndex(Index, NewPaletteIndex);
+	++PaletteRefCounts[NewPaletteIndex];
+
+	NonAirCount += (Block != EBlockID::Air) - (OldBlock != EBlockID::Air);
+	return true;
+}
+
+void FChunkSection::Fill(FBlockID Block)
+{
+	Palette.Reset();
+	Palette.Add(Block);
+	PaletteRefCounts.Reset();
+	PaletteRefCounts.Add(Volume);
+	Data.Empty();
+	BitsLog2 = -1;
+	NonAirCount = Block != EBlockID::Air ? Volume : 0;
+}
+
+void FChunkSection::Compact()
+{
+	int32 NumUsed = 0;
+	for (uint16 RefCount : PaletteRefCounts)
+	{
+		NumUsed += RefCount > 0;
+	}
+
+	const int32 NewBitsLog2 = GetBitsLog2ForPaletteSize(NumUsed);
+	if (NumUsed == Palette.Num() && NewBitsLog2 == BitsLog2)
+	{
+		return;
+	}
+
+	//map every used entry to its new slot, then rebuild the indices with the new width
+	TArray<int32, TInlineAllocator<16>> Remap;
+	Remap.SetNumUninitialized(Palette.Num());
+
+	TArray<FBlockID, TInlineAllocator<4>> NewPalette;
+	TArray<uint16, TInlineAllocator<4>> NewRefCounts;
+	for (int32 i = 0; i < Palette.Num(); ++i)
+	{
+		if (PaletteRefCounts[i] > 0)
+		{
+			Remap[i] = NewPalette.Add(Palette[i]);
+			NewRefCounts.Add(PaletteRefCounts[i]);
+		}
+		else
+		{
+			Remap[i] = INDEX_NONE;
+		}
+	}
+
+	TArray<uint16> Indices;
+	Indices.SetNumUninitialized(Volume);
+	for (int32 i = 0; i < Volume; ++i)
+	{
+		Indices[i] = (uint16)Remap[GetPaletteIndex(i)];
+	}
+
+	Palette = MoveTemp(NewPalette);
+	PaletteRefCounts = MoveTemp(NewRefCounts);
+	BitsLog2 = NewBitsLog2;
+	Data.Empty();
+
+	if (BitsLog2 >= 0)
+	{
+		Data.SetNumZeroed(Volume >> (6 - BitsLog2));
+		for (int32 i = 0; i < Volume; ++i)
+		{
+			SetPaletteIndex(i, Indices[i]);
+		}
+	}
+}
+
+bool FChunkSection::Serialize(FArchive& Ar)
+{
+	int8 SerializedBitsLog2 = (int8)BitsLog2;
+	Ar << SerializedBitsLog2;
+	Ar << Palette;
+	Ar << Data;
+
+	if (!Ar.IsLoading())
+	{
+		return true;
+	}
+
+	BitsLog2 = SerializedBitsLog2;
+
+	const bool bValidWidth = BitsLog2 >= -1 && BitsLog2 <= 4;
+	const int32 ExpectedWords = BitsLog2 >= 0 ? Volume >> (6 - BitsLog2) : 0;
+	const int32 MaxPaletteSize = BitsLog2 >= 0 ? 1 << (1 << BitsLog2) : 1;
+
+	if (Ar.IsError() || !bValidWidth || Data.Num() != ExpectedWords || Palette.Num() == 0 || Palette.Num() > MaxPaletteSize)
+	{
+		Fill(EBlockID::Air);
+		return false;
+	}
+
+	PaletteRefCounts.Reset();
+	PaletteRefCounts.AddZeroed(Palette.Num());
+	for (int32 i = 0; i < Volume; ++i)
+	{
+		const int32 PaletteIndex = GetPaletteIndex(i);
+		if (PaletteIndex >= Palette.Num())
+		{
+			Fill(EBlockID::Air);
+			return false;
+		}
+		++PaletteRefCounts[PaletteIndex];
+	}
+
+	NonAirCount = 0;
+	for (int32 i = 0; i < Palette.Num(); ++i)
+	{
+		if (Palette[i] != EBlockID::Air)
+		{
+			NonAirCount += PaletteRefCounts[i];
+		}
+	}
+	return true;
+}
+
+void FChunkSection::SetPaletteIndex(int32 Index, int32 PaletteIndex)
+{
+	if (BitsLog2 < 0)
+	{
+		check(PaletteIndex == 0);
+		return;
+	}
+
+	const int32 Shift = 6 - BitsLog2;
+	const int32 Bit = (Index & ((1 << Shift) - 1)) << BitsLog2;
+	const uint64 Mask = ((1ull << (1 << BitsLog2)) - 1) << Bit;
+
+	uint64& Word = Data[Index >> Shift];
+	Word = (Word & ~Mask) | (((uint64)PaletteIndex << Bit) & Mask);
+}
+
+int32 FChunkSection::FindOrAddPaletteEntry(FBlockID Block)
+{
+	int32 FreeSlot = INDEX_NONE;
+	for (int32 i = 0; i < Palette.Num(); ++i)
+	{
+		if (Palette[i] == Block)
+		{
+			return i;
+		}
+		if (FreeSlot == INDEX_NONE && PaletteRefCounts[i] == 0)
+		{
+			FreeSlot = i;
+		}
+	}
+
+	if (FreeSlot != INDEX_NONE)
+	{
+		Palette[FreeSlot] = Block;
+		return FreeSlot;
+	}
+
+	const int32 NewIndex = Palette.Add(Block);
+	PaletteRefCounts.Add(0);
+
+	const int32 NeededBitsLog2 = GetBitsLog2ForPaletteSize(Palette.Num());
+	if (NeededBitsLog2 > BitsLog2)
+	{
+		Repack(NeededBitsLog2);
+	}
+	return NewIndex;
+}
+
+void FChunkSection::Repack(int32 NewBitsLog2)
+{
+	TArray<uint64> OldData = MoveTemp(Data);
+	const int32 OldBitsLog2 = BitsLog2;
+
+	Data.SetNumZeroed(Volume >> (6 - NewBitsLog2));
+	BitsLog2 = NewBitsLog2;
+
+	if (OldBitsLog2 < 0)
+	{
+		//every block pointed at entry 0, which the zeroed words already encode
+		return;
+	}
+
+	const int32 OldShift = 6 - OldBitsLog2;
+	const uint64 OldMask = (1ull << (1 << OldBitsLog2)) - 1;
+	for (int32 i = 0; i < Volume; ++i)
+	{
+		const int32 OldBit = (i & ((1 << OldShift) - 1)) << OldBitsLog2;
+		SetPaletteIndex(i, (int32)((OldData[i >> OldShift] >> OldBit) & OldMask));
+	}
+}
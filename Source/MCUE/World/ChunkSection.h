@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlockTypes.h"
+
+//a 16x16x16 cube of blocks, stored as indices into a small palette of block ids
+//an all air section owns no index storage at all
+class MCUE_API FChunkSection
+{
+public:
+	static constexpr int32 Size = 16;
+	static constexpr int32 Volume = Size * Size * Size;
+
+	FChunkSection();
+
+	FBlockID Get(int32 X, int32 Y, int32 Z) const { return Palette[GetPaletteIndex(ToIndex(X, Y, Z))]; }
+
+	//returns true if the block actually changed
+	bool Set(int32 X, int32 Y, int32 Z, FBlockID Block);
+
+	//fills the whole section with one block id
+	void Fill(FBlockID Block);
+
+	//true if every block in the section is air
+	bool IsEmpty() const { return NonAirCount == 0; }
+
+	int32 GetNonAirCount() const { return NonAirCount; }
+
+	int32 GetPaletteSize() const { return Palette.Num(); }
+
+	//true if any block type in use in the section passes the predicate, without looking at single blocks
+	template<typename PredicateType>
+	bool AnyBlockType(PredicateType Predicate) const
+	{
+		for (int32 Index = 0; Index < Palette.Num(); ++Index)
+		{
+			if (PaletteRefCounts[Index] > 0 && Predicate(Palette[Index]))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//drops unused palette entries and shrinks the index storage to fit
+	void Compact();
+
+	//writes or reads the palette and packed indices as they are, reference counts are rebuilt on load
+	//returns false and leaves the section empty if the loaded data doesn't make sense
+	bool Serialize(FArchive& Ar);
+
+	SIZE_T GetAllocatedSize() const { return Palette.GetAllocatedSize() + PaletteRefCounts.GetAllocatedSize() + Data.GetAllocatedSize(); }
+
+	//x is the fastest moving axis, then y, then z
+	static FORCEINLINE int32 ToIndex(int32 X, int32 Y, int32 Z) { return X | (Y << 4) | (Z << 8); }
+
+private:
+	FORCEINLINE int32 GetPaletteIndex(int32 Index) const
+	{
+		if (BitsLog2 < 0)
+		{
+			return 0;
+		}
+		const int32 Shift = 6 - BitsLog2;
+		const uint64 Word = Data[Index >> Shift];
+		const int32 Bit = (Index & ((1 << Shift) - 1)) << BitsLog2;
+		return (int32)((Word >> Bit) & ((1ull << (1 << BitsLog2)) - 1));
+	}
+
+	void SetPaletteIndex(int32 Index, int32 PaletteIndex);
+
+	//finds or adds a palette entry for the block, growing the index storage if needed
+	int32 FindOrAddPaletteEntry(FBlockID Block);
+
+	//repacks every index using 2^NewBitsLog2 bits per entry (-1 means zero bits)
+	void Repack(int32 NewBitsLog2);
+
+	//distinct block ids in this section
+	TArray<FBlockID, TInlineAllocator<4>> Palette;
+
+	//number of blocks using each palette entry, entries at zero are reused
+	TArray<uint16, TInlineAllocator<4>> PaletteRefCounts;
+
+	//packed palette indices, entries never straddle two words
+	TArray<uint64> Data;
+
+	//log2 of the bits per entry, -1 while the palette has a single entry
+	int32 BitsLog2;
+
+	int32 NonAirCount;
+};
@@ -0,0 +1,455 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Noise.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+	#define MCUE_NOISE_SIMD 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#else
+	#define MCUE_NOISE_SIMD 0
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelNoise, Log, All);
+
+//scalar path, also the reference the wider paths must match bit for bit
+namespace NoiseScalar
+{
+	struct FOps
+	{
+		typedef float F;
+		typedef uint32 I;
+		typedef bool M;
+
+		static constexpr int32 Width = 1;
+
+		static FORCEINLINE F Load(const float* Src) { return *Src; }
+		static FORCEINLINE void Store(float* Dst, F V) { *Dst = V; }
+		static FORCEINLINE F Set(float V) { return V; }
+		static FORCEINLINE I SetI(uint32 V) { return V; }
+
+		static FORCEINLINE F Add(F A, F B) { return A + B; }
+		static FORCEINLINE F Sub(F A, F B) { return A - B; }
+		static FORCEINLINE F Mul(F A, F B) { return A * B; }
+		static FORCEINLINE F Div(F A, F B) { return A / B; }
+		static FORCEINLINE F Neg(F A) { return -A; }
+
+		static FORCEINLINE I FloorToInt(F A) { return (uint32)(int32)FMath::FloorToFloat(A); }
+		static FORCEINLINE F ToFloat(I A) { return (float)(int32)A; }
+
+		static FORCEINLINE I AddI(I A, I B) { return A + B; }
+		static FORCEINLINE I SubI(I A, I B) { return A - B; }
+		static FORCEINLINE I MulI(I A, I B) { return A * B; }
+		static FORCEINLINE I AndI(I A, I B) { return A & B; }
+		static FORCEINLINE I Xor(I A, I B) { return A ^ B; }
+		static FORCEINLINE I Shr(I A, int32 Bits) { return A >> Bits; }
+
+		static FORCEINLINE M CmpGt(F A, F B) { return A > B; }
+		static FORCEINLINE M CmpGe(F A, F B) { return A >= B; }
+		static FORCEINLINE M CmpLtI(I A, I B) { return (int32)A < (int32)B; }
+		static FORCEINLINE M CmpEqI(I A, I B) { return A == B; }
+		static FORCEINLINE M TestBit(I A, uint32 Bit) { return (A & Bit) != 0; }
+
+		static FORCEINLINE M And(M A, M B) { return A && B; }
+		static FORCEINLINE M Or(M A, M B) { return A || B; }
+		static FORCEINLINE M Not(M A) { return !A; }
+
+		static FORCEINLINE F Select(M Mask, F A, F B) { return Mask ? A : B; }
+		static FORCEINLINE I MaskToOne(M Mask) { return Mask ? 1u : 0u; }
+	};
+
+	#include "NoiseKernels.inl"
+}
+
+#if MCUE_NOISE_SIMD
+
+//clang only allows these intrinsics in functions targeting the instruction set, msvc allows them anywhere
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#endif
+
+namespace NoiseSSE41
+{
+	struct FOps
+	{
+		typedef __m128 F;
+		typedef __m128i I;
+		typedef __m128 M;
+
+		static constexpr int32 Width = 4;
+
+		static FORCEINLINE F Load(const float* Src) { return _mm_loadu_ps(Src); }
+		static FORCEINLINE void Store(float* Dst, F V) { _mm_storeu_ps(Dst, V); }
+		static FORCEINLINE F Set(float V) { return _mm_set1_ps(V); }
+		static FORCEINLINE I SetI(uint32 V) { return _mm_set1_epi32((int32)V); }
+
+		static FORCEINLINE F Add(F A, F B) { return _mm_add_ps(A, B); }
+		static FORCEINLINE F Sub(F A, F B) { return _mm_sub_ps(A, B); }
+		static FORCEINLINE F Mul(F A, F B) { return _mm_mul_ps(A, B); }
+		static FORCEINLINE F Div(F A, F B) { return _mm_div_ps(A, B); }
+		static FORCEINLINE F Neg(F A) { return _mm_xor_ps(A, _mm_set1_ps(-0.0f)); }
+
+		static FORCEINLINE I FloorToInt(F A) { return _mm_cvttps_epi32(_mm_floor_ps(A)); }
+		static FORCEINLINE F ToFloat(I A) { return _mm_cvtepi32_ps(A); }
+
+		static FORCEINLINE I AddI(I A, I B) { return _mm_add_epi32(A, B); }
+		static FORCEINLINE I SubI(I A, I B) { return _mm_sub_epi32(A, B); }
+		static FORCEINLINE I MulI(I A, I B) { return _mm_mullo_epi32(A, B); }
+		static FORCEINLINE I AndI(I A, I B) { return _mm_and_si128(A, B); }
+		static FORCEINLINE I Xor(I A, I B) { return _mm_xor_si128(A, B); }
+		static FORCEINLINE I Shr(I A, int32 Bits) { return _mm_srl_epi32(A, _mm_cvtsi32_si128(Bits)); }
+
+		static FORCEINLINE M CmpGt(F A, F B) { return _mm_cmpgt_ps(A, B); }
+		static FORCEINLINE M CmpGe(F A, F B) { return _mm_cmpge_ps(A, B); }
+		static FORCEINLINE M CmpLtI(I A, I B) { return _mm_castsi128_ps(_mm_cmplt_epi32(A, B)); }
+		static FORCEINLINE M CmpEqI(I A, I B) { return _mm_castsi128_ps(_mm_cmpeq_epi32(A, B)); }
+		static FORCEINLINE M TestBit(I A, uint32 Bit) { return CmpEqI(AndI(A, SetI(Bit)), SetI(Bit)); }
+
+		static FORCEINLINE M And(M A, M B) { return _mm_and_ps(A, B); }
+		static FORCEINLINE M Or(M A, M B) { return _mm_or_ps(A, B); }
+		static FORCEINLINE M Not(M A) { return _mm_xor_ps(A, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+
+		static FORCEINLINE F Select(M Mask, F A, F B) { return _mm_blendv_ps(B, A, Mask); }
+		static FORCEINLINE I MaskToOne(M Mask) { return _mm_and_si128(_mm_castps_si128(Mask), _mm_set1_epi32(1)); }
+	};
+
+	#include "NoiseKernels.inl"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#endif
+
+namespace NoiseAVX2
+{
+	//avx2 without fma, a fused multiply-add would round differently from the other paths
+	struct FOps
+	{
+		typedef __m256 F;
+		typedef __m256i I;
+		typedef __m256 M;
+
+		static constexpr int32 Width = 8;
+
+		static FORCEINLINE F Load(const float* Src) { return _mm256_loadu_ps(Src); }
+		static FORCEINLINE void Store(float* Dst, F V) { _mm256_storeu_ps(Dst, V); }
+		static FORCEINLINE F Set(float V) { return _mm256_set1_ps(V); }
+		static FORCEINLINE I SetI(uint32 V) { return _mm256_set1_epi32((int32)V); }
+
+		static FORCEINLINE F Add(F A, F B) { return _mm256_add_ps(A, B); }
+		static FORCEINLINE F Sub(F A, F B) { return _mm256_sub_ps(A, B); }
+		static FORCEINLINE F Mul(F A, F B) { return _mm256_mul_ps(A, B); }
+		static FORCEINLINE F Div(F A, F B) { return _mm256_div_ps(A, B); }
+		static FORCEINLINE F Neg(F A) { return _mm256_xor_ps(A, _mm256_set1_ps(-0.0f)); }
+
+		static FORCEINLINE I FloorToInt(F A) { return _mm256_cvttps_epi32(_mm256_floor_ps(A)); }
+		static FORCEINLINE F ToFloat(I A) { return _mm256_cvtepi32_ps(A); }
+
+		static FORCEINLINE I AddI(I A, I B) { return _mm256_add_epi32(A, B); }
+		static FORCEINLINE I SubI(I A, I B) { return _mm256_sub_epi32(A, B); }
+		static FORCEINLINE I MulI(I A, I B) { return _mm256_mullo_epi32(A, B); }
+		static FORCEINLINE I AndI(I A, I B) { return _mm256_and_si256(A, B); }
+		static FORCEINLINE I Xor(I A, I B) { return _mm256_xor_si256(A, B); }
+		static FORCEINLINE I Shr(I A, int32 Bits) { return _mm256_srl_epi32(A, _mm_cvtsi32_si128(Bits)); }
+
+		static FORCEINLINE M CmpGt(F A, F B) { return _mm256_cmp_ps(A, B, _CMP_GT_OQ); }
+		static FORCEINLINE M CmpGe(F A, F B) { return _mm256_cmp_ps(A, B, _CMP_GE_OQ); }
+		static FORCEINLINE M CmpLtI(I A, I B) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(B, A)); }
+		static FORCEINLINE M CmpEqI(I A, I B) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(A, B)); }
+		static FORCEINLINE M TestBit(I A, uint32 Bit) { return CmpEqI(AndI(A, SetI(Bit)), SetI(Bit)); }
+
+		static FORCEINLINE M And(M A, M B) { return _mm256_and_ps(A, B); }
+		static FORCEINLINE M Or(M A, M B) { return _mm256_or_ps(A, B); }
+		static FORCEINLINE M Not(M A) { return _mm256_xor_ps(A, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+
+		static FORCEINLINE F Select(M Mask, F A, F B) { return _mm256_blendv_ps(B, A, Mask); }
+		static FORCEINLINE I MaskToOne(M Mask) { return _mm256_and_si256(_mm256_castps_si256(Mask), _mm256_set1_epi32(1)); }
+	};
+
+	#include "NoiseKernels.inl"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif // MCUE_NOISE_SIMD
+
+namespace
+{
+	struct FNoiseKernels
+	{
+		void (*Simplex2D)(uint32, const float*, const float*, float*, int32);
+		void (*Simplex3D)(uint32, const float*, const float*, const float*, float*, int32);
+		void (*Fbm2D)(uint32, const float*, const float*, float*, int32, int32, float, float);
+		void (*Fbm3D)(uint32, const float*, const float*, const float*, float*, int32, int32, float, float);
+		void (*DomainWarp2D)(uint32, float*, float*, int32, float, float);
+	};
+
+	#define NOISE_KERNEL_TABLE(Namespace) { &Namespace::Simplex2DBatch, &Namespace::Simplex3DBatch, &Namespace::Fbm2DBatch, &Namespace::Fbm3DBatch, &Namespace::DomainWarp2DBatch }
+
+	const FNoiseKernels ScalarKernels = NOISE_KERNEL_TABLE(NoiseScalar);
+#if MCUE_NOISE_SIMD
+	const FNoiseKernels SSE41Kernels = NOISE_KERNEL_TABLE(NoiseSSE41);
+	const FNoiseKernels AVX2Kernels = NOISE_KERNEL_TABLE(NoiseAVX2);
+#endif
+
+	#undef NOISE_KERNEL_TABLE
+
+	bool DetectCpuSupport(ENoisePath Path)
+	{
+#if MCUE_NOISE_SIMD
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int32 Info[4];
+		__cpuid(Info, 1);
+		const bool bSSE41 = (Info[2] & (1 << 19)) != 0;
+		const bool bOSXSave = (Info[2] & (1 << 27)) != 0;
+		const bool bAVX = (Info[2] & (1 << 28)) != 0;
+
+		//the os has to save the ymm registers too, not just the cpu support them
+		const bool bYmmEnabled = bOSXSave && bAVX && (_xgetbv(0) & 6) == 6;
+
+		__cpuidex(Info, 7, 0);
+		const bool bAVX2 = bYmmEnabled && (Info[1] & (1 << 5)) != 0;
+	#else
+		const bool bSSE41 = __builtin_cpu_supports("sse4.1") != 0;
+		const bool bAVX2 = __builtin_cpu_supports("avx2") != 0;
+	#endif
+
+		switch (Path)
+		{
+			case ENoisePath::SSE41:
+				return bSSE41;
+			case ENoisePath::AVX2:
+				return bAVX2;
+			default:
+				return true;
+		}
+#else
+		return Path == ENoisePath::Best || Path == ENoisePath::Scalar;
+#endif
+	}
+
+	ENoisePath DetectBestPath()
+	{
+		if (DetectCpuSupport(ENoisePath::AVX2))
+		{
+			return ENoisePath::AVX2;
+		}
+		if (DetectCpuSupport(ENoisePath::SSE41))
+		{
+			return ENoisePath::SSE41;
+		}
+		return ENoisePath::Scalar;
+	}
+
+	const FNoiseKernels& GetKernels(ENoisePath Path)
+	{
+		if (Path == ENoisePath::Best)
+		{
+			Path = FVoxelNoise::GetBestPath();
+		}
+
+#if MCUE_NOISE_SIMD
+		//an unsupported path asked for explicitly falls back to scalar rather than faulting
+		if (FVoxelNoise::IsPathSupported(Path))
+		{
+			if (Path == ENoisePath::AVX2)
+			{
+				return AVX2Kernels;
+			}
+			if (Path == ENoisePath::SSE41)
+			{
+				return SSE41Kernels;
+			}
+		}
+#endif
+		return ScalarKernels;
+	}
+}
+
+float FVoxelNoise::Simplex2D(uint32 Seed, float X, float Y)
+{
+	return NoiseScalar::Simplex2D(Seed, X, Y);
+}
+
+float FVoxelNoise::Simplex3D(uint32 Seed, float X, float Y, float Z)
+{
+	return NoiseScalar::Simplex3D(Seed, X, Y, Z);
+}
+
+float FVoxelNoise::Fbm2D(uint32 Seed, float X, float Y, int32 Octaves, float Lacunarity, float Gain)
+{
+	return NoiseScalar::Fbm2D(Seed, X, Y, Octaves, Lacunarity, Gain);
+}
+
+float FVoxelNoise::Fbm3D(uint32 Seed, float X, float Y, float Z, int32 Octaves, float Lacunarity, float Gain)
+{
+	return NoiseScalar::Fbm3D(Seed, X, Y, Z, Octaves, Lacunarity, Gain);
+}
+
+void FVoxelNoise::Simplex2D(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count, ENoisePath Path)
+{
+	GetKernels(Path).Simplex2D(Seed, X, Y, Out, Count);
+}
+
+void FVoxelNoise::Simplex3D(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count, ENoisePath Path)
+{
+	GetKernels(Path).Simplex3D(Seed, X, Y, Z, Out, Count);
+}
+
+void FVoxelNoise::Fbm2D(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count, int32 Octaves, float Lacunarity, float Gain, ENoisePath Path)
+{
+	GetKernels(Path).Fbm2D(Seed, X, Y, Out, Count, Octaves, Lacunarity, Gain);
+}
+
+void FVoxelNoise::Fbm3D(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count, int32 Octaves, float Lacunarity, float Gain, ENoisePath Path)
+{
+	GetKernels(Path).Fbm3D(Seed, X, Y, Z, Out, Count, Octaves, Lacunarity, Gain);
+}
+
+void FVoxelNoise::DomainWarp2D(uint32 Seed, float* X, float* Y, int32 Count, float Amplitude, float Frequency, ENoisePath Path)
+{
+	GetKernels(Path).DomainWarp2D(Seed, X, Y, Count, Amplitude, Frequency);
+}
+
+bool FVoxelNoise::IsPathSupported(ENoisePath Path)
+{
+	static const bool bSupported[] =
+	{
+		true,
+		true,
+		DetectCpuSupport(ENoisePath::SSE41),
+		DetectCpuSupport(ENoisePath::AVX2)
+	};
+	return bSupported[(int32)Path];
+}
+
+ENoisePath FVoxelNoise::GetBestPath()
+{
+	static const ENoisePath BestPath = DetectBestPath();
+	return BestPath;
+}
+
+const TCHAR* FVoxelNoise::GetPathName(ENoisePath Path)
+{
+	switch (Path)
+	{
+		case ENoisePath::Best:
+			return TEXT("Best");
+		case ENoisePath::Scalar:
+			return TEXT("Scalar");
+		case ENoisePath::SSE41:
+			return TEXT("SSE4.1");
+		case ENoisePath::AVX2:
+			return TEXT("AVX2");
+		default:
+			return TEXT("Unknown");
+	}
+}
+
+namespace
+{
+	//mcue.NoiseBenchmark [NumSamples] [Iterations]
+	//times every kernel on every supported path and checks the output matches the scalar path exactly
+	void RunNoiseBenchmark(const TArray<FString>& Args)
+	{
+		const int32 NumSamples = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 65536;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 20;
+		const uint32 Seed = 1337;
+
+		FRandomStream Random(Seed);
+		TArray<float> X, Y, Z;
+		X.SetNumUninitialized(NumSamples);
+		Y.SetNumUninitialized(NumSamples);
+		Z.SetNumUninitialized(NumSamples);
+		for (int32 i = 0; i < NumSamples; ++i)
+		{
+			X[i] = Random.FRandRange(-4096.0f, 4096.0f);
+			Y[i] = Random.FRandRange(-4096.0f, 4096.0f);
+			Z[i] = Random.FRandRange(-256.0f, 256.0f);
+		}
+
+		//the warp writes over its inputs, so they are restored from this before every run
+		TArray<float> WarpY;
+		WarpY.SetNumUninitialized(NumSamples);
+
+		struct FBenchmark
+		{
+			const TCHAR* Name;
+			TFunction<void(ENoisePath, float*)> Run;
+
+			//resets the inputs before each run, outside of the timing, empty if the kernel leaves them alone
+			TFunction<void(float*)> Prepare;
+		};
+
+		const FBenchmark Benchmarks[] =
+		{
+			{ TEXT("Simplex2D"), [&](ENoisePath Path, float* Out) { FVoxelNoise::Simplex2D(Seed, X.GetData(), Y.GetData(), Out, NumSamples, Path); } },
+			{ TEXT("Simplex3D"), [&](ENoisePath Path, float* Out) { FVoxelNoise::Simplex3D(Seed, X.GetData(), Y.GetData(), Z.GetData(), Out, NumSamples, Path); } },
+			{ TEXT("Fbm2D x4"), [&](ENoisePath Path, float* Out) { FVoxelNoise::Fbm2D(Seed, X.GetData(), Y.GetData(), Out, NumSamples, 4, 2.0f, 0.5f, Path); } },
+			{ TEXT("Fbm3D x4"), [&](ENoisePath Path, float* Out) { FVoxelNoise::Fbm3D(Seed, X.GetData(), Y.GetData(), Z.GetData(), Out, NumSamples, 4, 2.0f, 0.5f, Path); } },
+			{ TEXT("DomainWarp2D"), [&](ENoisePath Path, float* Out) { FVoxelNoise::DomainWarp2D(Seed, Out, WarpY.GetData(), NumSamples, 8.0f, 0.05f, Path); },
+				[&](float* Out)
+				{
+					FMemory::Memcpy(Out, X.GetData(), NumSamples * sizeof(float));
+					FMemory::Memcpy(WarpY.GetData(), Y.GetData(), NumSamples * sizeof(float));
+				} },
+		};
+
+		const ENoisePath Paths[] = { ENoisePath::Scalar, ENoisePath::SSE41, ENoisePath::AVX2 };
+
+		UE_LOG(LogVoxelNoise, Display, TEXT("Noise benchmark: %d samples x %d iterations, best path %s"), NumSamples, Iterations, FVoxelNoise::GetPathName(FVoxelNoise::GetBestPath()));
+
+		TArray<float> Reference, Output;
+		Reference.SetNumUninitialized(NumSamples);
+		Output.SetNumUninitialized(NumSamples);
+
+		for (const FBenchmark& Benchmark : Benchmarks)
+		{
+			if (Benchmark.Prepare)
+			{
+				Benchmark.Prepare(Reference.GetData());
+			}
+			Benchmark.Run(ENoisePath::Scalar, Reference.GetData());
+
+			for (ENoisePath Path : Paths)
+			{
+				if (!FVoxelNoise::IsPathSupported(Path))
+				{
+					UE_LOG(LogVoxelNoise, Display, TEXT("  %-13s %-7s unsupported on this cpu"), Benchmark.Name, FVoxelNoise::GetPathName(Path));
+					continue;
+				}
+
+				double Elapsed = 0.0;
+				for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+				{
+					if (Benchmark.Prepare)
+					{
+						Benchmark.Prepare(Output.GetData());
+					}
+
+					const double StartTime = FPlatformTime::Seconds();
+					Benchmark.Run(Path, Output.GetData());
+					Elapsed += FPlatformTime::Seconds() - StartTime;
+				}
+
+				const bool bIdentical = FMemory::Memcmp(Reference.GetData(), Output.GetData(), NumSamples * sizeof(float)) == 0;
+				const double SamplesPerSecond = Elapsed > 0.0 ? (double)NumSamples * Iterations / Elapsed : 0.0;
+
+				UE_LOG(LogVoxelNoise, Display, TEXT("  %-13s %-7s %10.2f Msamples/s  %s"), Benchmark.Name, FVoxelNoise::GetPathName(Path), SamplesPerSecond / 1.0e6, bIdentical ? TEXT("bit-identical") : TEXT("MISMATCH vs scalar"));
+			}
+		}
+	}
+
+	FAutoConsoleCommand NoiseBenchmarkCommand(
+		TEXT("mcue.NoiseBenchmark"),
+		TEXT("Times the terrain noise kernels on every supported instruction set. Args: [NumSamples] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunNoiseBenchmark));
+}
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//instruction set a batch of noise is evaluated with
+enum class ENoisePath : uint8
+{
+	//widest path the cpu supports, picked once at startup
+	Best,
+	Scalar,
+	SSE41,
+	AVX2
+};
+
+//seeded gradient noise used by terrain generation, results are roughly in [-1, 1]
+//every path runs the same operations in the same order, so a seed gives bit-identical output on all of them
+class MCUE_API FVoxelNoise
+{
+public:
+	//single samples, evaluated with the scalar path
+	static float Simplex2D(uint32 Seed, float X, float Y);
+	static float Simplex3D(uint32 Seed, float X, float Y, float Z);
+
+	//sums octaves of simplex noise, each at Lacunarity times the frequency and Gain times the amplitude
+	static float Fbm2D(uint32 Seed, float X, float Y, int32 Octaves, float Lacunarity = 2.0f, float Gain = 0.5f);
+	static float Fbm3D(uint32 Seed, float X, float Y, float Z, int32 Octaves, float Lacunarity = 2.0f, float Gain = 0.5f);
+
+	//batches over structure of arrays input, Out may alias none of the inputs
+	static void Simplex2D(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count, ENoisePath Path = ENoisePath::Best);
+	static void Simplex3D(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count, ENoisePath Path = ENoisePath::Best);
+	static void Fbm2D(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count, int32 Octaves, float Lacunarity = 2.0f, float Gain = 0.5f, ENoisePath Path = ENoisePath::Best);
+	static void Fbm3D(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count, int32 Octaves, float Lacunarity = 2.0f, float Gain = 0.5f, ENoisePath Path = ENoisePath::Best);
+
+	//offsets every coordinate in place by Amplitude times a noise field sampled at Frequency
+	static void DomainWarp2D(uint32 Seed, float* X, float* Y, int32 Count, float Amplitude, float Frequency, ENoisePath Path = ENoisePath::Best);
+
+	static bool IsPathSupported(ENoisePath Path);
+
+	//the path ENoisePath::Best resolves to on this cpu
+	static ENoisePath GetBestPath();
+
+	static const TCHAR* GetPathName(ENoisePath Path);
+
+	//integer hash of a lattice point, also used to seed per chunk random streams
+	static FORCEINLINE uint32 Hash(uint32 Seed, int32 X, int32 Y)
+	{
+		uint32 H = Seed ^ ((uint32)X * 0x27d4eb2du) ^ ((uint32)Y * 0x165667b1u);
+		H ^= H >> 15;
+		H *= 0x2c1b3c6du;
+		H ^= H >> 12;
+		H *= 0x297a2d39u;
+		H ^= H >> 15;
+		return H;
+	}
+};
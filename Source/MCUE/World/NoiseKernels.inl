@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+//noise kernels written once against an FOps instruction set wrapper
+//Noise.cpp includes this file once per instruction set, inside a namespace that defines FOps
+//keep every operation an explicit FOps call so all paths evaluate in exactly the same order
+
+typedef FOps::F F;
+typedef FOps::I I;
+typedef FOps::M M;
+
+//skew and unskew factors between the square/cube grid and the simplex grid
+static const float F2 = 0.36602540378f;
+static const float G2 = 0.21132486541f;
+static const float F3 = 0.33333333333f;
+static const float G3 = 0.16666666667f;
+
+static FORCEINLINE I Hash2(I Seed, I X, I Y)
+{
+	I H = FOps::Xor(FOps::Xor(Seed, FOps::MulI(X, FOps::SetI(0x27d4eb2du))), FOps::MulI(Y, FOps::SetI(0x165667b1u)));
+	H = FOps::Xor(H, FOps::Shr(H, 15));
+	H = FOps::MulI(H, FOps::SetI(0x2c1b3c6du));
+	H = FOps::Xor(H, FOps::Shr(H, 12));
+	H = FOps::MulI(H, FOps::SetI(0x297a2d39u));
+	H = FOps::Xor(H, FOps::Shr(H, 15));
+	return H;
+}
+
+static FORCEINLINE I Hash3(I Seed, I X, I Y, I Z)
+{
+	return Hash2(FOps::Xor(Seed, FOps::MulI(Z, FOps::SetI(0x1b873593u))), X, Y);
+}
+
+static FORCEINLINE F Gradient2D(I Hash, F X, F Y)
+{
+	//8 gradient directions along (1, 2) and (2, 1)
+	const I H = FOps::AndI(Hash, FOps::SetI(7));
+	const M bLow = FOps::CmpLtI(H, FOps::SetI(4));
+	const F U = FOps::Select(bLow, X, Y);
+	const F V = FOps::Mul(FOps::Set(2.0f), FOps::Select(bLow, Y, X));
+	return FOps::Add(FOps::Select(FOps::TestBit(H, 1), FOps::Neg(U), U), FOps::Select(FOps::TestBit(H, 2), FOps::Neg(V), V));
+}
+
+static FORCEINLINE F Gradient3D(I Hash, F X, F Y, F Z)
+{
+	//12 cube edge directions, 4 of them repeated to fill 16 slots
+	const I H = FOps::AndI(Hash, FOps::SetI(15));
+	const F U = FOps::Select(FOps::CmpLtI(H, FOps::SetI(8)), X, Y);
+	const M bXorZ = FOps::Or(FOps::CmpEqI(H, FOps::SetI(12)), FOps::CmpEqI(H, FOps::SetI(14)));
+	const F V = FOps::Select(FOps::CmpLtI(H, FOps::SetI(4)), Y, FOps::Select(bXorZ, X, Z));
+	return FOps::Add(FOps::Select(FOps::TestBit(H, 1), FOps::Neg(U), U), FOps::Select(FOps::TestBit(H, 2), FOps::Neg(V), V));
+}
+
+static FORCEINLINE F Corner2D(I Seed, I CellX, I CellY, F X, F Y)
+{
+	const F T = FOps::Sub(FOps::Sub(FOps::Set(0.5f), FOps::Mul(X, X)), FOps::Mul(Y, Y));
+	const F T2 = FOps::Mul(T, T);
+	const F N = FOps::Mul(FOps::Mul(T2, T2), Gradient2D(Hash2(Seed, CellX, CellY), X, Y));
+	return FOps::Select(FOps::CmpGe(T, FOps::Set(0.0f)), N, FOps::Set(0.0f));
+}
+
+static FORCEINLINE F Corner3D(I Seed, I CellX, I CellY, I CellZ, F X, F Y, F Z)
+{
+	const F T = FOps::Sub(FOps::Sub(FOps::Sub(FOps::Set(0.6f), FOps::Mul(X, X)), FOps::Mul(Y, Y)), FOps::Mul(Z, Z));
+	const F T2 = FOps::Mul(T, T);
+	const F N = FOps::Mul(FOps::Mul(T2, T2), Gradient3D(Hash3(Seed, CellX, CellY, CellZ), X, Y, Z));
+	return FOps::Select(FOps::CmpGe(T, FOps::Set(0.0f)), N, FOps::Set(0.0f));
+}
+
+static FORCEINLINE F Simplex2D(I Seed, F X, F Y)
+{
+	//find the simplex cell the point is in
+	const F S = FOps::Mul(FOps::Add(X, Y), FOps::Set(F2));
+	const I CellX = FOps::FloorToInt(FOps::Add(X, S));
+	const I CellY = FOps::FloorToInt(FOps::Add(Y, S));
+
+	const F T = FOps::Mul(FOps::ToFloat(FOps::AddI(CellX, CellY)), FOps::Set(G2));
+	const F X0 = FOps::Sub(X, FOps::Sub(FOps::ToFloat(CellX), T));
+	const F Y0 = FOps::Sub(Y, FOps::Sub(FOps::ToFloat(CellY), T));
+
+	//pick the lower or upper triangle of the cell
+	const I I1 = FOps::MaskToOne(FOps::CmpGt(X0, Y0));
+	const I J1 = FOps::SubI(FOps::SetI(1), I1);
+
+	const F X1 = FOps::Add(FOps::Sub(X0, FOps::ToFloat(I1)), FOps::Set(G2));
+	const F Y1 = FOps::Add(FOps::Sub(Y0, FOps::ToFloat(J1)), FOps::Set(G2));
+	const F X2 = FOps::Add(FOps::Sub(X0, FOps::Set(1.0f)), FOps::Set(2.0f * G2));
+	const F Y2 = FOps::Add(FOps::Sub(Y0, FOps::Set(1.0f)), FOps::Set(2.0f * G2));
+
+	const I One = FOps::SetI(1);
+	const F N0 = Corner2D(Seed, CellX, CellY, X0, Y0);
+	const F N1 = Corner2D(Seed, FOps::AddI(CellX, I1), FOps::AddI(CellY, J1), X1, Y1);
+	const F N2 = Corner2D(Seed, FOps::AddI(CellX, One), FOps::AddI(CellY, One), X2, Y2);
+
+	//scales the sum to roughly [-1, 1]
+	return FOps::Mul(FOps::Set(45.23f), FOps::Add(FOps::Add(N0, N1), N2));
+}
+
+static FORCEINLINE F Simplex3D(I Seed, F X, F Y, F Z)
+{
+	const F S = FOps::Mul(FOps::Add(FOps::Add(X, Y), Z), FOps::Set(F3));
+	const I CellX = FOps::FloorToInt(FOps::Add(X, S));
+	const I CellY = FOps::FloorToInt(FOps::Add(Y, S));
+	const I CellZ = FOps::FloorToInt(FOps::Add(Z, S));
+
+	const F T = FOps::Mul(FOps::ToFloat(FOps::AddI(FOps::AddI(CellX, CellY), CellZ)), FOps::Set(G3));
+	const F X0 = FOps::Sub(X, FOps::Sub(FOps::ToFloat(CellX), T));
+	const F Y0 = FOps::Sub(Y, FOps::Sub(FOps::ToFloat(CellY), T));
+	const F Z0 = FOps::Sub(Z, FOps::Sub(FOps::ToFloat(CellZ), T));
+
+	//rank the offsets to find which of the six tetrahedra of the cube the point is in
+	const M bXGeY = FOps::CmpGe(X0, Y0);
+	const M bYGeZ = FOps::CmpGe(Y0, Z0);
+	const M bXGeZ = FOps::CmpGe(X0, Z0);
+
+	const I I1 = FOps::MaskToOne(FOps::And(bXGeY, bXGeZ));
+	const I J1 = FOps::MaskToOne(FOps::And(FOps::Not(bXGeY), bYGeZ));
+	const I K1 = FOps::MaskToOne(FOps::And(FOps::Not(bXGeZ), FOps::Not(bYGeZ)));
+	const I I2 = FOps::MaskToOne(FOps::Or(bXGeY, bXGeZ));
+	const I J2 = FOps::MaskToOne(FOps::Or(FOps::Not(bXGeY), bYGeZ));
+	const I K2 = FOps::MaskToOne(FOps::Not(FOps::And(bXGeZ, bYGeZ)));
+
+	const F X1 = FOps::Add(FOps::Sub(X0, FOps::ToFloat(I1)), FOps::Set(G3));
+	const F Y1 = FOps::Add(FOps::Sub(Y0, FOps::ToFloat(J1)), FOps::Set(G3));
+	const F Z1 = FOps::Add(FOps::Sub(Z0, FOps::ToFloat(K1)), FOps::Set(G3));
+	const F X2 = FOps::Add(FOps::Sub(X0, FOps::ToFloat(I2)), FOps::Set(2.0f * G3));
+	const F Y2 = FOps::Add(FOps::Sub(Y0, FOps::ToFloat(J2)), FOps::Set(2.0f * G3));
+	const F Z2 = FOps::Add(FOps::Sub(Z0, FOps::ToFloat(K2)), FOps::Set(2.0f * G3));
+	const F X3 = FOps::Add(FOps::Sub(X0, FOps::Set(1.0f)), FOps::Set(3.0f * G3));
+	const F Y3 = FOps::Add(FOps::Sub(Y0, FOps::Set(1.0f)), FOps::Set(3.0f * G3));
+	const F Z3 = FOps::Add(FOps::Sub(Z0, FOps::Set(1.0f)), FOps::Set(3.0f * G3));
+
+	const I One = FOps::SetI(1);
+	const F N0 = Corner3D(Seed, CellX, CellY, CellZ, X0, Y0, Z0);
+	const F N1 = Corner3D(Seed, FOps::AddI(CellX, I1), FOps::AddI(CellY, J1), FOps::AddI(CellZ, K1), X1, Y1, Z1);
+	const F N2 = Corner3D(Seed, FOps::AddI(CellX, I2), FOps::AddI(CellY, J2), FOps::AddI(CellZ, K2), X2, Y2, Z2);
+	const F N3 = Corner3D(Seed, FOps::AddI(CellX, One), FOps::AddI(CellY, One), FOps::AddI(CellZ, One), X3, Y3, Z3);
+
+	return FOps::Mul(FOps::Set(32.0f), FOps::Add(FOps::Add(FOps::Add(N0, N1), N2), N3));
+}
+
+static FORCEINLINE uint32 OctaveSeed(uint32 Seed, int32 Octave)
+{
+	//give every octave its own seed so they don't line up at the origin
+	return Seed + (uint32)Octave * 0x9e3779b9u;
+}
+
+static FORCEINLINE F Fbm2D(uint32 Seed, F X, F Y, int32 Octaves, float Lacunarity, float Gain)
+{
+	F Sum = FOps::Set(0.0f);
+	float Amplitude = 1.0f;
+	float Frequency = 1.0f;
+	float AmplitudeSum = 0.0f;
+
+	for (int32 Octave = 0; Octave < Octaves; ++Octave)
+	{
+		const F Scale = FOps::Set(Frequency);
+		const F Noise = Simplex2D(FOps::SetI(OctaveSeed(Seed, Octave)), FOps::Mul(X, Scale), FOps::Mul(Y, Scale));
+		Sum = FOps::Add(Sum, FOps::Mul(FOps::Set(Amplitude), Noise));
+		AmplitudeSum += Amplitude;
+		Amplitude *= Gain;
+		Frequency *= Lacunarity;
+	}
+
+	return AmplitudeSum > 0.0f ? FOps::Div(Sum, FOps::Set(AmplitudeSum)) : FOps::Set(0.0f);
+}
+
+static FORCEINLINE F Fbm3D(uint32 Seed, F X, F Y, F Z, int32 Octaves, float Lacunarity, float Gain)
+{
+	F Sum = FOps::Set(0.0f);
+	float Amplitude = 1.0f;
+	float Frequency = 1.0f;
+	float AmplitudeSum = 0.0f;
+
+	for (int32 Octave = 0; Octave < Octaves; ++Octave)
+	{
+		const F Scale = FOps::Set(Frequency);
+		const F Noise = Simplex3D(FOps::SetI(OctaveSeed(Seed, Octave)), FOps::Mul(X, Scale), FOps::Mul(Y, Scale), FOps::Mul(Z, Scale));
+		Sum = FOps::Add(Sum, FOps::Mul(FOps::Set(Amplitude), Noise));
+		AmplitudeSum += Amplitude;
+		Amplitude *= Gain;
+		Frequency *= Lacunarity;
+	}
+
+	return AmplitudeSum > 0.0f ? FOps::Div(Sum, FOps::Set(AmplitudeSum)) : FOps::Set(0.0f);
+}
+
+//runs Kernel over full vectors, then pads the tail out to one more vector so no lane reads past the end
+template<int32 NumInputs, typename KernelType>
+static FORCEINLINE void ForEachBatch(const float* const* Inputs, float* Out, int32 Count, KernelType Kernel)
+{
+	int32 Index = 0;
+	for (; Index + FOps::Width <= Count; Index += FOps::Width)
+	{
+		F Values[NumInputs];
+		for (int32 Input = 0; Input < NumInputs; ++Input)
+		{
+			Values[Input] = FOps::Load(Inputs[Input] + Index);
+		}
+		FOps::Store(Out + Index, Kernel(Values));
+	}
+
+	const int32 Remaining = Count - Index;
+	if (Remaining > 0)
+	{
+		float Padded[NumInputs][FOps::Width] = {};
+		float PaddedOut[FOps::Width];
+
+		F Values[NumInputs];
+		for (int32 Input = 0; Input < NumInputs; ++Input)
+		{
+			FMemory::Memcpy(Padded[Input], Inputs[Input] + Index, Remaining * sizeof(float));
+			Values[Input] = FOps::Load(Padded[Input]);
+		}
+		FOps::Store(PaddedOut, Kernel(Values));
+		FMemory::Memcpy(Out + Index, PaddedOut, Remaining * sizeof(float));
+	}
+}
+
+//kernels are plain functors rather than lambdas, so they pick up the instruction set target of this file
+struct FSimplex2DKernel
+{
+	I Seed;
+	FORCEINLINE F operator()(const F* V) const { return Simplex2D(Seed, V[0], V[1]); }
+};
+
+struct FSimplex3DKernel
+{
+	I Seed;
+	FORCEINLINE F operator()(const F* V) const { return Simplex3D(Seed, V[0], V[1], V[2]); }
+};
+
+struct FFbm2DKernel
+{
+	uint32 Seed;
+	int32 Octaves;
+	float Lacunarity;
+	float Gain;
+	FORCEINLINE F operator()(const F* V) const { return Fbm2D(Seed, V[0], V[1], Octaves, Lacunarity, Gain); }
+};
+
+struct FFbm3DKernel
+{
+	uint32 Seed;
+	int32 Octaves;
+	float Lacunarity;
+	float Gain;
+	FORCEINLINE F operator()(const F* V) const { return Fbm3D(Seed, V[0], V[1], V[2], Octaves, Lacunarity, Gain); }
+};
+
+//returns the coordinate on Axis moved by Strength times a noise field sampled at Scale
+struct FWarpKernel
+{
+	I Seed;
+	F Scale;
+	F Strength;
+	int32 Axis;
+	FORCEINLINE F operator()(const F* V) const
+	{
+		return FOps::Add(V[Axis], FOps::Mul(Strength, Simplex2D(Seed, FOps::Mul(V[0], Scale), FOps::Mul(V[1], Scale))));
+	}
+};
+
+static void Simplex2DBatch(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count)
+{
+	const float* Inputs[] = { X, Y };
+	ForEachBatch<2>(Inputs, Out, Count, FSimplex2DKernel{ FOps::SetI(Seed) });
+}
+
+static void Simplex3DBatch(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count)
+{
+	const float* Inputs[] = { X, Y, Z };
+	ForEachBatch<3>(Inputs, Out, Count, FSimplex3DKernel{ FOps::SetI(Seed) });
+}
+
+static void Fbm2DBatch(uint32 Seed, const float* X, const float* Y, float* Out, int32 Count, int32 Octaves, float Lacunarity, float Gain)
+{
+	const float* Inputs[] = { X, Y };
+	ForEachBatch<2>(Inputs, Out, Count, FFbm2DKernel{ Seed, Octaves, Lacunarity, Gain });
+}
+
+static void Fbm3DBatch(uint32 Seed, const float* X, const float* Y, const float* Z, float* Out, int32 Count, int32 Octaves, float Lacunarity, float Gain)
+{
+	const float* Inputs[] = { X, Y, Z };
+	ForEachBatch<3>(Inputs, Out, Count, FFbm3DKernel{ Seed, Octaves, Lacunarity, Gain });
+}
+
+static void DomainWarp2DBatch(uint32 Seed, float* X, float* Y, int32 Count, float Amplitude, float Frequency)
+{
+	const FWarpKernel WarpX{ FOps::SetI(Seed ^ 0x68e31da4u), FOps::Set(Frequency), FOps::Set(Amplitude), 0 };
+	const FWarpKernel WarpY{ FOps::SetI(Seed ^ 0xb5297a4du), FOps::Set(Frequency), FOps::Set(Amplitude), 1 };
+
+	//sample both offsets from the unwarped position before writing either back
+	float WarpedX[256];
+	float WarpedY[256];
+	for (int32 Start = 0; Start < Count; Start += 256)
+	{
+		const int32 Num = FMath::Min(256, Count - Start);
+		const float* Inputs[] = { X + Start, Y + Start };
+
+		ForEachBatch<2>(Inputs, WarpedX, Num, WarpX);
+		ForEachBatch<2>(Inputs, WarpedY, Num, WarpY);
+
+		FMemory::Memcpy(X + Start, WarpedX, Num * sizeof(float));
+		FMemory::Memcpy(Y + Start, WarpedY, Num * sizeof(float));
+	}
+}
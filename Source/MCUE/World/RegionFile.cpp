@@ -0,0 +1,525 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RegionFile.h"
+#include "Noise.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/PlatformTime.h"
+#include "Async/MappedFileHandle.h"
+#include "Math/RandomStream.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRegionFile, Log, All);
+
+namespace
+{
+	//every chunk starts with its compressed size, uncompressed size and compression format
+	constexpr int32 ChunkHeaderSize = 9;
+
+	enum class EChunkCompression : uint8
+	{
+		None = 0,
+		Zlib = 1
+	};
+}
+
+FRegionFile::FRegionFile(const FString& InFilename)
+	: Filename(InFilename)
+	, bIsValid(false)
+	, MappedHandle(nullptr)
+	, MappedRegion(nullptr)
+	, Writer(nullptr)
+{
+	FMemory::Memzero(OffsetTable);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const int64 FileSize = PlatformFile.FileSize(*Filename);
+
+	if (FileSize < 0)
+	{
+		//new region, write an empty table so the file is never shorter than one sector
+		PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+		if (!OpenWriter() || !Writer->Write((const uint8*)OffsetTable, sizeof(OffsetTable)))
+		{
+			UE_LOG(LogRegionFile, Warning, TEXT("Couldn't create region file %s"), *Filename);
+			return;
+		}
+
+		UsedSectors.Add(true);
+		bIsValid = true;
+		return;
+	}
+
+	if (FileSize < SectorSize || !ReadBytes(0, sizeof(OffsetTable), OffsetTable))
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Region file %s is damaged, its chunks won't be loaded"), *Filename);
+		return;
+	}
+
+	UsedSectors.Init(false, (int32)FMath::DivideAndRoundUp(FileSize, (int64)SectorSize));
+	UsedSectors[0] = true;
+
+	for (uint32& Entry : OffsetTable)
+	{
+		if (Entry == 0)
+		{
+			continue;
+		}
+
+		const int32 FirstSector = Entry >> 8;
+		const int32 NumSectors = Entry & 0xff;
+
+		//an entry pointing into the table, past the end or at sectors another chunk owns is dropped
+		bool bValid = FirstSector > 0 && NumSectors > 0 && FirstSector + NumSectors <= UsedSectors.Num();
+		for (int32 Sector = FirstSector; bValid && Sector < FirstSector + NumSectors; ++Sector)
+		{
+			bValid = !UsedSectors[Sector];
+		}
+
+		if (!bValid)
+		{
+			UE_LOG(LogRegionFile, Warning, TEXT("Region file %s has a bad table entry, dropping that chunk"), *Filename);
+			Entry = 0;
+			continue;
+		}
+
+		UsedSectors.SetRange(FirstSector, NumSectors, true);
+	}
+
+	bIsValid = true;
+}
+
+FRegionFile::~FRegionFile()
+{
+	CloseMapping();
+	CloseWriter();
+}
+
+TUniquePtr<FChunk> FRegionFile::ReadChunk(const FIntPoint& ChunkCoord)
+{
+	const uint32 Entry = bIsValid ? OffsetTable[GetTableIndex(ChunkCoord)] : 0;
+	if (Entry == 0)
+	{
+		return nullptr;
+	}
+
+	const int64 Offset = (int64)(Entry >> 8) * SectorSize;
+	const int64 MaxSize = (int64)(Entry & 0xff) * SectorSize;
+
+	//with a mapping the chunk decompresses straight out of the page cache, otherwise it is read into a buffer first
+	TArray<uint8> ReadBuffer;
+	const uint8* Data = nullptr;
+	if (OpenMapping())
+	{
+		if (Offset + MaxSize > MappedRegion->GetMappedSize())
+		{
+			return nullptr;
+		}
+		Data = MappedRegion->GetMappedPtr() + Offset;
+	}
+	else
+	{
+		ReadBuffer.SetNumUninitialized(MaxSize);
+		if (!ReadBytes(Offset, MaxSize, ReadBuffer.GetData()))
+		{
+			return nullptr;
+		}
+		Data = ReadBuffer.GetData();
+	}
+
+	uint32 CompressedSize;
+	uint32 UncompressedSize;
+	FMemory::Memcpy(&CompressedSize, Data, sizeof(uint32));
+	FMemory::Memcpy(&UncompressedSize, Data + 4, sizeof(uint32));
+	const EChunkCompression Compression = (EChunkCompression)Data[8];
+
+	if (ChunkHeaderSize + (int64)CompressedSize > MaxSize || UncompressedSize > 16 * 1024 * 1024)
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Chunk (%d, %d) in %s is damaged"), ChunkCoord.X, ChunkCoord.Y, *Filename);
+		return nullptr;
+	}
+
+	TArray<uint8> Uncompressed;
+	Uncompressed.SetNumUninitialized(UncompressedSize);
+
+	bool bDecompressed = false;
+	if (Compression == EChunkCompression::Zlib)
+	{
+		bDecompressed = FCompression::UncompressMemory(NAME_Zlib, Uncompressed.GetData(), UncompressedSize, Data + ChunkHeaderSize, CompressedSize);
+	}
+	else if (Compression == EChunkCompression::None && CompressedSize == UncompressedSize)
+	{
+		FMemory::Memcpy(Uncompressed.GetData(), Data + ChunkHeaderSize, UncompressedSize);
+		bDecompressed = true;
+	}
+
+	TUniquePtr<FChunk> Chunk = MakeUnique<FChunk>(ChunkCoord);
+
+	FMemoryReader Reader(Uncompressed);
+	if (!bDecompressed || !Chunk->Serialize(Reader))
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Chunk (%d, %d) in %s is damaged"), ChunkCoord.X, ChunkCoord.Y, *Filename);
+		return nullptr;
+	}
+
+	Chunk->MarkSaved();
+	return Chunk;
+}
+
+bool FRegionFile::WriteChunk(const FChunk& Chunk)
+{
+	TArray<uint8> Buffer;
+	return bIsValid && EncodeChunk(Chunk, Buffer) && WriteEncodedChunk(Chunk.GetCoord(), Buffer);
+}
+
+bool FRegionFile::EncodeChunk(const FChunk& Chunk, TArray<uint8>& OutBuffer)
+{
+	TArray<uint8> Uncompressed;
+	FMemoryWriter MemoryWriter(Uncompressed);
+	const_cast<FChunk&>(Chunk).Serialize(MemoryWriter);
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Uncompressed.Num());
+
+	OutBuffer.SetNumUninitialized(ChunkHeaderSize + CompressedSize);
+
+	EChunkCompression Compression = EChunkCompression::Zlib;
+	if (!FCompression::CompressMemory(NAME_Zlib, OutBuffer.GetData() + ChunkHeaderSize, CompressedSize, Uncompressed.GetData(), Uncompressed.Num()))
+	{
+		Compression = EChunkCompression::None;
+		CompressedSize = Uncompressed.Num();
+		OutBuffer.SetNumUninitialized(ChunkHeaderSize + CompressedSize);
+		FMemory::Memcpy(OutBuffer.GetData() + ChunkHeaderSize, Uncompressed.GetData(), CompressedSize);
+	}
+
+	const uint32 UncompressedSize = Uncompressed.Num();
+	FMemory::Memcpy(OutBuffer.GetData(), &CompressedSize, sizeof(uint32));
+	FMemory::Memcpy(OutBuffer.GetData() + 4, &UncompressedSize, sizeof(uint32));
+	OutBuffer[8] = (uint8)Compression;
+
+	//pad to whole sectors, the file always ends on a sector boundary
+	const int32 NumSectors = FMath::DivideAndRoundUp(ChunkHeaderSize + CompressedSize, SectorSize);
+	if (NumSectors > MaxSectorsPerChunk)
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Chunk (%d, %d) is too large to save (%d sectors)"), Chunk.GetCoord().X, Chunk.GetCoord().Y, NumSectors);
+		return false;
+	}
+	OutBuffer.SetNumZeroed(NumSectors * SectorSize);
+	return true;
+}
+
+bool FRegionFile::WriteEncodedChunk(const FIntPoint& ChunkCoord, const TArray<uint8>& Buffer)
+{
+	if (!bIsValid || Buffer.Num() == 0 || Buffer.Num() % SectorSize != 0)
+	{
+		return false;
+	}
+
+	const int32 NumSectors = Buffer.Num() / SectorSize;
+	const int32 TableIndex = GetTableIndex(ChunkCoord);
+	const int32 OldFirstSector = OffsetTable[TableIndex] >> 8;
+	const int32 OldNumSectors = OffsetTable[TableIndex] & 0xff;
+
+	//rewrite in place when it still fits, otherwise write the new copy before giving up the old one
+	const int32 FirstSector = NumSectors <= OldNumSectors ? OldFirstSector : FindFreeSectors(NumSectors);
+
+	if (!OpenWriter())
+	{
+		return false;
+	}
+
+	if (!Writer->Seek((int64)FirstSector * SectorSize) || !Writer->Write(Buffer.GetData(), Buffer.Num()))
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Couldn't write chunk (%d, %d) to %s"), ChunkCoord.X, ChunkCoord.Y, *Filename);
+		return false;
+	}
+
+	const uint32 NewEntry = ((uint32)FirstSector << 8) | (uint32)NumSectors;
+	if (!Writer->Seek(TableIndex * sizeof(uint32)) || !Writer->Write((const uint8*)&NewEntry, sizeof(uint32)))
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Couldn't update the table of %s"), *Filename);
+		return false;
+	}
+
+	if (OldNumSectors > 0)
+	{
+		UsedSectors.SetRange(OldFirstSector, OldNumSectors, false);
+	}
+	if (FirstSector + NumSectors > UsedSectors.Num())
+	{
+		UsedSectors.Add(false, FirstSector + NumSectors - UsedSectors.Num());
+	}
+	UsedSectors.SetRange(FirstSector, NumSectors, true);
+
+	OffsetTable[TableIndex] = NewEntry;
+	return true;
+}
+
+FString FRegionFile::GetRegionFilename(const FString& Directory, const FIntPoint& RegionCoord)
+{
+	return FPaths::Combine(Directory, FString::Printf(TEXT("r.%d.%d.mcr"), RegionCoord.X, RegionCoord.Y));
+}
+
+bool FRegionFile::OpenMapping()
+{
+	if (MappedRegion != nullptr)
+	{
+		return true;
+	}
+
+	CloseWriter();
+
+	MappedHandle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename);
+	if (MappedHandle == nullptr)
+	{
+		return false;
+	}
+
+	MappedRegion = MappedHandle->MapRegion(0, MappedHandle->GetFileSize());
+	if (MappedRegion == nullptr)
+	{
+		CloseMapping();
+		return false;
+	}
+	return true;
+}
+
+bool FRegionFile::OpenWriter()
+{
+	if (Writer != nullptr)
+	{
+		return true;
+	}
+
+	//the file is about to change size, so any mapping of it is out of date
+	CloseMapping();
+
+	Writer = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Filename, true, false);
+	if (Writer == nullptr)
+	{
+		UE_LOG(LogRegionFile, Warning, TEXT("Couldn't open %s for writing"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+void FRegionFile::CloseMapping()
+{
+	delete MappedRegion;
+	MappedRegion = nullptr;
+
+	delete MappedHandle;
+	MappedHandle = nullptr;
+}
+
+void FRegionFile::CloseWriter()
+{
+	if (Writer != nullptr)
+	{
+		Writer->Flush();
+		delete Writer;
+		Writer = nullptr;
+	}
+}
+
+bool FRegionFile::ReadBytes(int64 Offset, int64 Size, void* Dest)
+{
+	if (OpenMapping())
+	{
+		if (Offset + Size > MappedRegion->GetMappedSize())
+		{
+			return false;
+		}
+		FMemory::Memcpy(Dest, MappedRegion->GetMappedPtr() + Offset, Size);
+		return true;
+	}
+
+	//platforms without file mapping fall back to a plain read
+	CloseWriter();
+
+	TUniquePtr<IFileHandle> Reader(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	return Reader.IsValid() && Reader->Seek(Offset) && Reader->Read((uint8*)Dest, Size);
+}
+
+int32 FRegionFile::FindFreeSectors(int32 NumSectors) const
+{
+	int32 RunLength = 0;
+	for (int32 Sector = 1; Sector < UsedSectors.Num(); ++Sector)
+	{
+		RunLength = UsedSectors[Sector] ? 0 : RunLength + 1;
+		if (RunLength == NumSectors)
+		{
+			return Sector - NumSectors + 1;
+		}
+	}
+
+	//a free run at the very end of the file can be extended past it
+	return UsedSectors.Num() - RunLength;
+}
+
+namespace
+{
+	//terrain shaped like the generator's, so the compression ratio is representative
+	void FillBenchmarkChunk(FChunk& Chunk, FRandomStream& Random)
+	{
+		constexpr int32 NumColumns = FChunkSection::Size * FChunkSection::Size;
+		float SampleX[NumColumns];
+		float SampleY[NumColumns];
+		float Noise[NumColumns];
+
+		for (int32 Column = 0; Column < NumColumns; ++Column)
+		{
+			SampleX[Column] = (Chunk.GetCoord().X * FChunkSection::Size + (Column & 15)) / 96.0f;
+			SampleY[Column] = (Chunk.GetCoord().Y * FChunkSection::Size + (Column >> 4)) / 96.0f;
+		}
+		FVoxelNoise::Fbm2D(1337, SampleX, SampleY, Noise, NumColumns, 4);
+
+		for (int32 Section = 0; Section < 3; ++Section)
+		{
+			Chunk.GetSection(Section).Fill(EBlockID::Rock);
+		}
+
+		for (int32 Column = 0; Column < NumColumns; ++Column)
+		{
+			const int32 Height = 64 + FMath::RoundToInt(Noise[Column] * 16.0f);
+			for (int32 Z = 48; Z < Height; ++Z)
+			{
+				Chunk.SetBlock(Column & 15, Column >> 4, Z, Z == Height - 1 ? EBlockID::Grass : Z >= Height - 4 ? EBlockID::Dirt : EBlockID::Rock);
+			}
+		}
+
+		for (int32 i = 0; i < 40; ++i)
+		{
+			Chunk.SetBlock(Random.RandRange(0, 15), Random.RandRange(0, 15), Random.RandRange(1, 40), EBlockID::IronOre);
+		}
+	}
+
+	TArray<uint8> SerializeForCompare(const FChunk& Chunk)
+	{
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+		const_cast<FChunk&>(Chunk).Serialize(Writer);
+		return Bytes;
+	}
+
+	//mcue.RegionBenchmark [NumChunks] [Iterations]
+	//writes, reads back and rewrites a region file in Saved/Benchmark and logs the throughput of each pass
+	void RunRegionBenchmark(const TArray<FString>& Args)
+	{
+		const int32 NumChunks = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : FRegionFile::ChunksPerRegion, 1, FRegionFile::ChunksPerRegion);
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 3;
+
+		const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmark"));
+		const FString Filename = FRegionFile::GetRegionFilename(Directory, FIntPoint(0, 0));
+
+		FRandomStream Random(1337);
+		TArray<TUniquePtr<FChunk>> Chunks;
+		int64 UncompressedBytes = 0;
+		for (int32 i = 0; i < NumChunks; ++i)
+		{
+			Chunks.Add(MakeUnique<FChunk>(FIntPoint(i % FRegionFile::ChunksPerSide, i / FRegionFile::ChunksPerSide)));
+			FillBenchmarkChunk(*Chunks.Last(), Random);
+			UncompressedBytes += SerializeForCompare(*Chunks.Last()).Num();
+		}
+
+		auto LogPass = [&](const TCHAR* Pass, double Seconds)
+		{
+			const double ChunksPerSecond = Seconds > 0.0 ? NumChunks * Iterations / Seconds : 0.0;
+			const double MegabytesPerSecond = Seconds > 0.0 ? UncompressedBytes * Iterations / Seconds / (1024.0 * 1024.0) : 0.0;
+			UE_LOG(LogRegionFile, Display, TEXT("  %-18s %10.0f chunks/s  %8.1f MB/s uncompressed"), Pass, ChunksPerSecond, MegabytesPerSecond);
+		};
+
+		UE_LOG(LogRegionFile, Display, TEXT("Region benchmark: %d chunks x %d iterations, %s"), NumChunks, Iterations, *Filename);
+
+		double WriteSeconds = 0.0;
+		double ReadSeconds = 0.0;
+		double RewriteSeconds = 0.0;
+		int32 NumMismatches = 0;
+		int64 FileSize = 0;
+		int32 SectorsAfterWrite = 0;
+		int32 SectorsAfterRewrite = 0;
+
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			IFileManager::Get().Delete(*Filename, false, true, true);
+
+			//fresh file, every chunk is appended
+			{
+				FRegionFile Region(Filename);
+				const double StartTime = FPlatformTime::Seconds();
+				for (const TUniquePtr<FChunk>& Chunk : Chunks)
+				{
+					Region.WriteChunk(*Chunk);
+				}
+				WriteSeconds += FPlatformTime::Seconds() - StartTime;
+				SectorsAfterWrite = Region.GetNumSectors();
+			}
+
+			//reopened, so the table is parsed and the file mapped as it would be on load
+			{
+				const double StartTime = FPlatformTime::Seconds();
+				FRegionFile Region(Filename);
+				TArray<TUniquePtr<FChunk>> Loaded;
+				Loaded.Reserve(NumChunks);
+				for (const TUniquePtr<FChunk>& Chunk : Chunks)
+				{
+					Loaded.Add(Region.ReadChunk(Chunk->GetCoord()));
+				}
+				ReadSeconds += FPlatformTime::Seconds() - StartTime;
+
+				for (int32 i = 0; i < NumChunks; ++i)
+				{
+					NumMismatches += !Loaded[i].IsValid() || SerializeForCompare(*Loaded[i]) != SerializeForCompare(*Chunks[i]);
+				}
+			}
+
+			//scatter blocks through the air above, most chunks outgrow their sectors and have to move
+			FRandomStream EditRandom(Iteration);
+			TArray<TUniquePtr<FChunk>> Edited;
+			for (const TUniquePtr<FChunk>& Chunk : Chunks)
+			{
+				Edited.Add(MakeUnique<FChunk>(Chunk->GetCoord()));
+				FillBenchmarkChunk(*Edited.Last(), Random);
+				for (int32 i = 0; i < 400; ++i)
+				{
+					Edited.Last()->SetBlock(EditRandom.RandRange(0, 15), EditRandom.RandRange(0, 15), EditRandom.RandRange(96, 200), (FBlockID)EditRandom.RandRange(1, EBlockID::Num - 1));
+				}
+			}
+
+			{
+				FRegionFile Region(Filename);
+				const double StartTime = FPlatformTime::Seconds();
+				for (const TUniquePtr<FChunk>& Chunk : Edited)
+				{
+					Region.WriteChunk(*Chunk);
+				}
+				RewriteSeconds += FPlatformTime::Seconds() - StartTime;
+				SectorsAfterRewrite = Region.GetNumSectors();
+			}
+
+			FileSize = IFileManager::Get().FileSize(*Filename);
+		}
+
+		LogPass(TEXT("write (append)"), WriteSeconds);
+		LogPass(TEXT("read (mapped)"), ReadSeconds);
+		LogPass(TEXT("write (relocate)"), RewriteSeconds);
+
+		UE_LOG(LogRegionFile, Display, TEXT("  %d sectors after first write, %d after rewrite, %.2f MB on disk, %.1fx compression"),
+			SectorsAfterWrite, SectorsAfterRewrite, FileSize / (1024.0 * 1024.0), (double)UncompressedBytes / FMath::Max<int64>(1, (int64)SectorsAfterWrite * FRegionFile::SectorSize));
+
+		if (NumMismatches > 0)
+		{
+			UE_LOG(LogRegionFile, Error, TEXT("  %d chunks didn't read back identically"), NumMismatches);
+		}
+
+		IFileManager::Get().Delete(*Filename, false, true, true);
+	}
+
+	FAutoConsoleCommand RegionBenchmarkCommand(
+		TEXT("mcue.RegionBenchmark"),
+		TEXT("Times writing, reading and rewriting one region file. Args: [NumChunks] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunRegionBenchmark));
+}
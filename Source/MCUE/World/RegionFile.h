@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/BitArray.h"
+#include "Chunk.h"
+
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+//one file on disk holding a 32x32 area of chunk columns
+//the file is split into 4KB sectors, the first sector is a table with one entry per chunk:
+//(first sector << 8) | sector count, zero if the chunk was never saved
+//every chunk is stored compressed in a run of whole sectors, so one can be rewritten without touching the others
+//reads go through a memory mapping of the whole file, writes through a normal file handle
+class MCUE_API FRegionFile
+{
+public:
+	static constexpr int32 ChunksPerSide = 32;
+	static constexpr int32 ChunksPerRegion = ChunksPerSide * ChunksPerSide;
+	static constexpr int32 SectorSize = 4096;
+
+	//largest run of sectors a table entry can describe
+	static constexpr int32 MaxSectorsPerChunk = 255;
+
+	explicit FRegionFile(const FString& InFilename);
+	~FRegionFile();
+
+	//false if the file couldn't be opened or created
+	bool IsValid() const { return bIsValid; }
+
+	const FString& GetFilename() const { return Filename; }
+
+	bool HasChunk(const FIntPoint& ChunkCoord) const { return OffsetTable[GetTableIndex(ChunkCoord)] != 0; }
+
+	//returns nullptr if the chunk was never saved or its data is damaged
+	TUniquePtr<FChunk> ReadChunk(const FIntPoint& ChunkCoord);
+
+	//overwrites the chunk's sectors if it still fits in them, otherwise moves it to the first free run
+	bool WriteChunk(const FChunk& Chunk);
+
+	//serializes and compresses the chunk into the whole sectors WriteEncodedChunk stores, touches no file so any thread can run it
+	static bool EncodeChunk(const FChunk& Chunk, TArray<uint8>& OutBuffer);
+
+	//the second half of WriteChunk, for a chunk EncodeChunk already turned into sectors
+	bool WriteEncodedChunk(const FIntPoint& ChunkCoord, const TArray<uint8>& Buffer);
+
+	//size of the file in sectors, including the table and any free sectors
+	int32 GetNumSectors() const { return UsedSectors.Num(); }
+
+	//region a chunk column belongs to, and the file name used for it
+	static FIntPoint ChunkToRegion(const FIntPoint& ChunkCoord) { return FIntPoint(ChunkCoord.X >> 5, ChunkCoord.Y >> 5); }
+	static FString GetRegionFilename(const FString& Directory, const FIntPoint& RegionCoord);
+
+private:
+	static int32 GetTableIndex(const FIntPoint& ChunkCoord) { return (ChunkCoord.X & (ChunksPerSide - 1)) + (ChunkCoord.Y & (ChunksPerSide - 1)) * ChunksPerSide; }
+
+	//the mapping and the write handle are never open together, some platforms don't allow sharing the file that way
+	bool OpenMapping();
+	bool OpenWriter();
+	void CloseMapping();
+	void CloseWriter();
+
+	//copies Size bytes at Offset into Dest, from the mapping if there is one
+	bool ReadBytes(int64 Offset, int64 Size, void* Dest);
+
+	//first run of NumSectors free sectors, or the end of the file
+	int32 FindFreeSectors(int32 NumSectors) const;
+
+	FString Filename;
+
+	bool bIsValid;
+
+	uint32 OffsetTable[ChunksPerRegion];
+
+	//one bit per sector of the file, set while a chunk or the table occupies it
+	TBitArray<> UsedSectors;
+
+	IMappedFileHandle* MappedHandle;
+	IMappedFileRegion* MappedRegion;
+	IFileHandle* Writer;
+};
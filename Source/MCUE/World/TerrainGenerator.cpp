@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainGenerator.h"
+#include "Noise.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+#include "Math/RandomStream.h"
+
+FTerrainGenerator::FTerrainGenerator(const FTerrainSettings& InSettings, int32 NumWorkers, int32 InQueueCapacity)
+	: Settings(InSettings)
+	, QueueCapacity(FMath::Max(1, InQueueCapacity))
+	, bStopping(false)
+{
+	FMemory::Memzero(NumRunning);
+
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+	for (int32 i = 0; i < FMath::Max(1, NumWorkers); ++i)
+	{
+		Workers.Add(MakeUnique<FWorker>(*this));
+		WorkerThreads.Add(FRunnableThread::Create(Workers.Last().Get(), *FString::Printf(TEXT("TerrainGenerator%d"), i), 0, TPri_BelowNormal));
+	}
+}
+
+FTerrainGenerator::~FTerrainGenerator()
+{
+	bStopping = true;
+
+	for (FRunnableThread* Thread : WorkerThreads)
+	{
+		//wake everyone, a single trigger only releases one waiting worker
+		WorkEvent->Trigger();
+		Thread->WaitForCompletion();
+	}
+
+	for (FRunnableThread* Thread : WorkerThreads)
+	{
+		delete Thread;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+}
+
+bool FTerrainGenerator::Request(const FIntPoint& ChunkCoord)
+{
+	{
+		FScopeLock Lock(&QueueLock);
+
+		TArray<TUniquePtr<FJob>>& Queue = StageQueues[(int32)EStage::Heightmap];
+		if (Queue.Num() >= QueueCapacity)
+		{
+			return false;
+		}
+
+		TUniquePtr<FJob> Job = MakeUnique<FJob>();
+		Job->ChunkCoord = ChunkCoord;
+		Job->Stage = EStage::Heightmap;
+		Queue.Add(MoveTemp(Job));
+	}
+
+	WorkEvent->Trigger();
+	return true;
+}
+
+TUniquePtr<FChunk> FTerrainGenerator::PopFinished()
+{
+	TUniquePtr<FChunk> Chunk;
+	{
+		FScopeLock Lock(&QueueLock);
+
+		if (Finished.Num() == 0)
+		{
+			return nullptr;
+		}
+		Chunk = MoveTemp(Finished[0]);
+		Finished.RemoveAt(0, 1, false);
+	}
+
+	//there is room at the end of the pipeline again
+	WorkEvent->Trigger();
+	return Chunk;
+}
+
+int32 FTerrainGenerator::GetNumInFlight() const
+{
+	FScopeLock Lock(&QueueLock);
+
+	int32 Num = 0;
+	for (int32 Stage = 0; Stage < (int32)EStage::Num; ++Stage)
+	{
+		Num += StageQueues[Stage].Num() + NumRunning[Stage];
+	}
+	return Num;
+}
+
+uint32 FTerrainGenerator::FWorker::Run()
+{
+	while (!Owner.bStopping)
+	{
+		TUniquePtr<FJob> Job = Owner.TakeJob();
+		if (!Job.IsValid())
+		{
+			Owner.WorkEvent->Wait(10);
+			continue;
+		}
+
+		switch (Job->Stage)
+		{
+			case EStage::Heightmap:
+			{
+				Owner.RunHeightmap(*Job);
+				break;
+			}
+			case EStage::Fill:
+			{
+				Owner.RunFill(*Job);
+				break;
+			}
+			case EStage::Surface:
+			{
+				Owner.RunSurface(*Job);
+				break;
+			}
+			case EStage::Ores:
+			{
+				Owner.RunOres(*Job);
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		Owner.CompleteStage(MoveTemp(Job));
+	}
+	return 0;
+}
+
+TUniquePtr<FTerrainGenerator::FJob> FTerrainGenerator::TakeJob()
+{
+	FScopeLock Lock(&QueueLock);
+
+	//drain the pipeline from the end, so finished work leaves before new work enters
+	for (int32 Stage = (int32)EStage::Num - 1; Stage >= 0; --Stage)
+	{
+		TArray<TUniquePtr<FJob>>& Queue = StageQueues[Stage];
+		if (Queue.Num() == 0)
+		{
+			continue;
+		}
+
+		//the queue this job lands in must have room for it and everything already heading there
+		const int32 NextQueueSize = Stage + 1 < (int32)EStage::Num ? StageQueues[Stage + 1].Num() : Finished.Num();
+		if (NextQueueSize + NumRunning[Stage] >= QueueCapacity)
+		{
+			continue;
+		}
+
+		TUniquePtr<FJob> Job = MoveTemp(Queue[0]);
+		Queue.RemoveAt(0, 1, false);
+		++NumRunning[Stage];
+		return Job;
+	}
+
+	return nullptr;
+}
+
+void FTerrainGenerator::CompleteStage(TUniquePtr<FJob> Job)
+{
+	{
+		FScopeLock Lock(&QueueLock);
+
+		const int32 Stage = (int32)Job->Stage;
+		--NumRunning[Stage];
+
+		if (Stage + 1 < (int32)EStage::Num)
+		{
+			Job->Stage = (EStage)(Stage + 1);
+			StageQueues[Stage + 1].Add(MoveTemp(Job));
+		}
+		else
+		{
+			Finished.Add(MoveTemp(Job->Chunk));
+		}
+	}
+
+	WorkEvent->Trigger();
+}
+
+void FTerrainGenerator::RunHeightmap(FJob& Job) const
+{
+	const int32 BaseX = Job.ChunkCoord.X * FChunkSection::Size;
+	const int32 BaseY = Job.ChunkCoord.Y * FChunkSection::Size;
+
+	constexpr int32 NumColumns = FChunkSection::Size * FChunkSection::Size;
+	float SampleX[NumColumns];
+	float SampleY[NumColumns];
+	float Noise[NumColumns];
+
+	for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+	{
+		for (int32 X = 0; X < FChunkSection::Size; ++X)
+		{
+			SampleX[X + Y * FChunkSection::Size] = (BaseX + X) / Settings.HillScale;
+			SampleY[X + Y * FChunkSection::Size] = (BaseY + Y) / Settings.HillScale;
+		}
+	}
+
+	//the whole column grid in one batch, so the noise runs on the widest instruction set available
+	FVoxelNoise::Fbm2D(Settings.Seed, SampleX, SampleY, Noise, NumColumns, 4);
+
+	for (int32 Column = 0; Column < NumColumns; ++Column)
+	{
+		const int32 Height = Settings.BaseHeight + FMath::RoundToInt(Noise[Column] * Settings.HeightVariation);
+		Job.Heightmap[Column] = FMath::Clamp(Height, 1, FChunk::Height - 1);
+	}
+}
+
+void FTerrainGenerator::RunFill(FJob& Job) const
+{
+	Job.Chunk = MakeUnique<FChunk>(Job.ChunkCoord);
+	FChunk& Chunk = *Job.Chunk;
+
+	int32 MinHeight = FChunk::Height;
+	int32 MaxHeight = 0;
+	for (int32 Height : Job.Heightmap)
+	{
+		MinHeight = FMath::Min(MinHeight, Height);
+		MaxHeight = FMath::Max(MaxHeight, Height);
+	}
+
+	//sections entirely below the lowest column are solid rock and don't need per block writes
+	const int32 NumSolidSections = MinHeight / FChunkSection::Size;
+	for (int32 Section = 0; Section < NumSolidSections; ++Section)
+	{
+		Chunk.GetSection(Section).Fill(EBlockID::Rock);
+	}
+
+	for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+	{
+		for (int32 X = 0; X < FChunkSection::Size; ++X)
+		{
+			const int32 Height = Job.Heightmap[X + Y * FChunkSection::Size];
+			for (int32 Z = NumSolidSections * FChunkSection::Size; Z < Height; ++Z)
+			{
+				Chunk.SetBlock(X, Y, Z, EBlockID::Rock);
+			}
+		}
+	}
+}
+
+void FTerrainGenerator::RunSurface(FJob& Job) const
+{
+	FChunk& Chunk = *Job.Chunk;
+
+	for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+	{
+		for (int32 X = 0; X < FChunkSection::Size; ++X)
+		{
+			const int32 Top = Job.Heightmap[X + Y * FChunkSection::Size] - 1;
+
+			Chunk.SetBlock(X, Y, Top, EBlockID::Grass);
+
+			for (int32 Z = FMath::Max(0, Top - Settings.SubsoilDepth); Z < Top; ++Z)
+			{
+				Chunk.SetBlock(X, Y, Z, EBlockID::Dirt);
+			}
+
+			//sources that nothing ticks until they are disturbed
+			for (int32 Z = Top + 1; Z < Settings.SeaLevel; ++Z)
+			{
+				Chunk.SetBlock(X, Y, Z, EBlockID::Water);
+			}
+		}
+	}
+}
+
+void FTerrainGenerator::RunOres(FJob& Job) const
+{
+	FChunk& Chunk = *Job.Chunk;
+
+	//seeded from the chunk coordinate so a chunk always gets the same ores
+	FRandomStream Random((int32)FVoxelNoise::Hash(Settings.Seed ^ 0x5bd1e995u, Job.ChunkCoord.X, Job.ChunkCoord.Y));
+
+	for (int32 Vein = 0; Vein < Settings.OreVeinsPerChunk; ++Vein)
+	{
+		FIntVector Cell(Random.RandRange(0, FChunkSection::Size - 1), Random.RandRange(0, FChunkSection::Size - 1), Random.RandRange(1, Settings.OreMaxHeight));
+		const int32 VeinSize = Random.RandRange(3, 8);
+
+		//random walk through the rock, never past the chunk edge so chunks stay independent
+		for (int32 i = 0; i < VeinSize; ++i)
+		{
+			if (Chunk.GetBlock(Cell.X, Cell.Y, Cell.Z) == EBlockID::Rock)
+			{
+				Chunk.SetBlock(Cell.X, Cell.Y, Cell.Z, EBlockID::IronOre);
+			}
+
+			const int32 Axis = Random.RandRange(0, 2);
+			Cell[Axis] += Random.RandBool() ? 1 : -1;
+			Cell.X = FMath::Clamp(Cell.X, 0, FChunkSection::Size - 1);
+			Cell.Y = FMath::Clamp(Cell.Y, 0, FChunkSection::Size - 1);
+			Cell.Z = FMath::Clamp(Cell.Z, 0, FChunk::Height - 1);
+		}
+	}
+}
@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Chunk.h"
+
+class FRunnableThread;
+class FEvent;
+
+//parameters every stage of terrain generation reads, fixed for the lifetime of a generator
+struct FTerrainSettings
+{
+	uint32 Seed;
+
+	//surface height in blocks around which the heightmap varies
+	int32 BaseHeight;
+
+	//how far in blocks the surface moves above or below the base height
+	int32 HeightVariation;
+
+	//horizontal size in blocks of the largest hills
+	float HillScale;
+
+	//layers of dirt between the grass and the rock
+	int32 SubsoilDepth;
+
+	//air below this height is filled with still water, 0 for none
+	int32 SeaLevel;
+
+	//iron ore veins attempted per chunk, and the highest block they may start at
+	int32 OreVeinsPerChunk;
+	int32 OreMaxHeight;
+};
+
+//generates chunk block data on worker threads in a pipeline of stages:
+//heightmap -> fill -> surface -> ores
+//every stage has a bounded queue, workers always advance the furthest along job first and stop
+//when the finished queue is full, so requests are refused instead of piling up
+class MCUE_API FTerrainGenerator
+{
+public:
+	enum class EStage : uint8
+	{
+		Heightmap,
+		Fill,
+		Surface,
+		Ores,
+
+		Num
+	};
+
+	FTerrainGenerator(const FTerrainSettings& InSettings, int32 NumWorkers, int32 InQueueCapacity);
+	~FTerrainGenerator();
+
+	//queues a chunk for generation, returns false if the pipeline is full and the caller should retry later
+	bool Request(const FIntPoint& ChunkCoord);
+
+	//takes one finished chunk, returns nullptr if none is ready
+	TUniquePtr<FChunk> PopFinished();
+
+	//jobs queued or in flight in any stage, not counting finished chunks
+	int32 GetNumInFlight() const;
+
+	const FTerrainSettings& GetSettings() const { return Settings; }
+
+private:
+	class FWorker : public FRunnable
+	{
+	public:
+		explicit FWorker(FTerrainGenerator& InOwner) : Owner(InOwner) {}
+
+		virtual uint32 Run() override;
+
+	private:
+		FTerrainGenerator& Owner;
+	};
+
+	struct FJob
+	{
+		FIntPoint ChunkCoord;
+		EStage Stage;
+		int32 Heightmap[FChunkSection::Size * FChunkSection::Size];
+		TUniquePtr<FChunk> Chunk;
+	};
+
+	//takes the next job a worker can advance without overflowing the queue after it
+	TUniquePtr<FJob> TakeJob();
+
+	//hands a job that finished a stage on to the next queue
+	void CompleteStage(TUniquePtr<FJob> Job);
+
+	void RunHeightmap(FJob& Job) const;
+	void RunFill(FJob& Job) const;
+	void RunSurface(FJob& Job) const;
+	void RunOres(FJob& Job) const;
+
+	const FTerrainSettings Settings;
+	const int32 QueueCapacity;
+
+	mutable FCriticalSection QueueLock;
+
+	//jobs waiting for each stage, and chunks waiting for the game thread
+	TArray<TUniquePtr<FJob>> StageQueues[(int32)EStage::Num];
+	TArray<TUniquePtr<FChunk>> Finished;
+
+	//jobs currently being worked on, counted against the queue they will land in
+	int32 NumRunning[(int32)EStage::Num];
+
+	FEvent* WorkEvent;
+	TArray<TUniquePtr<FWorker>> Workers;
+	TArray<FRunnableThread*> WorkerThreads;
+	FThreadSafeBool bStopping;
+};
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelCollisionComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "PhysicsEngine/BodySetup.h"
+
+UVoxelCollisionComponent::UVoxelCollisionComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	SetGenerateOverlapEvents(false);
+	bHiddenInGame = true;
+
+	BodySetup = nullptr;
+	LocalBounds = FBox(ForceInit);
+	NumBodies = 0;
+	BuildMicroseconds = 0.0f;
+}
+
+void UVoxelCollisionComponent::SetBoxes(const TArray<FBox>& Boxes, float InBuildMicroseconds)
+{
+	//one body setup for the life of the component, a rebuild only swaps its boxes
+	if (BodySetup == nullptr)
+	{
+		BodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transient);
+		BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		BodySetup->bNeverNeedsCookedCollisionData = true;
+	}
+
+	BodySetup->AggGeom.BoxElems.Reset(Boxes.Num());
+
+	FBox NewBounds(ForceInit);
+	for (const FBox& Box : Boxes)
+	{
+		const FVector Size = Box.GetSize();
+		FKBoxElem& Elem = BodySetup->AggGeom.BoxElems.Emplace_GetRef(Size.X, Size.Y, Size.Z);
+		Elem.Center = Box.GetCenter();
+		NewBounds += Box;
+	}
+
+	//the physics shapes were made from the old boxes, they are built again before the body is
+	BodySetup->InvalidatePhysicsData();
+	BodySetup->CreatePhysicsMeshes();
+
+	LocalBounds = NewBounds;
+	NumBodies = Boxes.Num();
+	BuildMicroseconds = InBuildMicroseconds;
+
+	UpdateBounds();
+	RecreatePhysicsState();
+}
+
+FBoxSphereBounds UVoxelCollisionComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!LocalBounds.IsValid)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.0f);
+	}
+	return FBoxSphereBounds(LocalBounds).TransformBy(LocalToWorld);
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "VoxelCollisionComponent.generated.h"
+
+class UBodySetup;
+
+//simple box collision for one chunk section, nothing to cook since it is made of box elements only
+//a new set of boxes replaces the old ones in one call, so the section is never without collision
+UCLASS()
+class MCUE_API UVoxelCollisionComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVoxelCollisionComponent();
+
+	//boxes are relative to the component
+	void SetBoxes(const TArray<FBox>& Boxes, float BuildMicroseconds);
+
+	int32 GetNumBodies() const { return NumBodies; }
+
+	//worker time spent merging the boxes last set
+	float GetBuildMicroseconds() const { return BuildMicroseconds; }
+
+	virtual UBodySetup* GetBodySetup() override { return BodySetup; }
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	UPROPERTY(Transient)
+	UBodySetup* BodySetup;
+
+	FBox LocalBounds;
+
+	int32 NumBodies;
+
+	float BuildMicroseconds;
+};
@@ -0,0 +1,235 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelFluids.h"
+#include "BlockTicks.h"
+#include "VoxelWorldSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelFluids, Log, All);
+
+namespace
+{
+	const FIntVector HorizontalDirections[4] =
+	{
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0)
+	};
+
+	//falling fluid feeds sideways like a source does
+	uint8 GetFeedingLevel(FBlockID Block)
+	{
+		return FVoxelFluids::IsFalling(Block) ? 0 : FVoxelFluids::GetLevel(Block);
+	}
+}
+
+void FVoxelFluids::Tick(FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block)
+{
+	const FBlockID Type = EBlockID::GetType(Block);
+
+	if (!IsSource(Block))
+	{
+		const FBlockID Settled = GetFedState(Context, BlockCoord, Block);
+		if (Settled != Block)
+		{
+			//the write schedules this block again, it flows on from its new state then
+			Context.SetBlock(BlockCoord, Settled);
+			return;
+		}
+	}
+
+	const FIntVector Below = BlockCoord - FIntVector(0, 0, 1);
+	const FBlockID BelowBlock = UVoxelWorldSubsystem::IsValidHeight(Below.Z) ? Context.GetBlock(Below) : (FBlockID)EBlockID::Rock;
+	const bool bCanFall = BelowBlock == EBlockID::Air || (FBlockRegistry::IsFluid(BelowBlock) && !IsSource(BelowBlock) && !IsFalling(BelowBlock));
+	if (bCanFall)
+	{
+		FlowInto(Context, Below, Make(Type, 0, true));
+
+		//flowing fluid pours straight down, only sources also spread out over the drop
+		if (!IsSource(Block))
+		{
+			return;
+		}
+	}
+
+	const uint8 SideLevel = GetFeedingLevel(Block) + FBlockRegistry::Get(Type).FluidFlowStep;
+	if (SideLevel > MaxLevel)
+	{
+		return;
+	}
+
+	for (const FIntVector& Direction : HorizontalDirections)
+	{
+		FlowInto(Context, BlockCoord + Direction, Make(Type, SideLevel, false));
+	}
+}
+
+FBlockID FVoxelFluids::GetFedState(const FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block)
+{
+	const FBlockID Type = EBlockID::GetType(Block);
+
+	//anything of the same fluid above keeps this one falling
+	if (EBlockID::GetType(Context.GetBlock(BlockCoord + FIntVector(0, 0, 1))) == Type)
+	{
+		return Make(Type, 0, true);
+	}
+
+	uint8 BestLevel = MaxLevel + 1;
+	int32 NumSources = 0;
+	for (const FIntVector& Direction : HorizontalDirections)
+	{
+		const FBlockID Neighbour = Context.GetBlock(BlockCoord + Direction);
+		if (EBlockID::GetType(Neighbour) != Type)
+		{
+			continue;
+		}
+
+		NumSources += IsSource(Neighbour) ? 1 : 0;
+		BestLevel = FMath::Min<uint8>(BestLevel, GetFeedingLevel(Neighbour) + FBlockRegistry::Get(Type).FluidFlowStep);
+	}
+
+	//water between two sources becomes a source itself if it rests on something, lava never does
+	if (Type == EBlockID::Water && NumSources >= 2)
+	{
+		const FBlockID Below = Context.GetBlock(BlockCoord - FIntVector(0, 0, 1));
+		if (FBlockRegistry::IsSolid(Below) || (EBlockID::GetType(Below) == Type && IsSource(Below)))
+		{
+			return Make(Type, 0, false);
+		}
+	}
+
+	return BestLevel <= MaxLevel ? Make(Type, BestLevel, false) : (FBlockID)EBlockID::Air;
+}
+
+void FVoxelFluids::FlowInto(FBlockTickContext& Context, const FIntVector& Target, FBlockID Flowing)
+{
+	if (!UVoxelWorldSubsystem::IsValidHeight(Target.Z))
+	{
+		return;
+	}
+
+	const FBlockID Existing = Context.GetBlock(Target);
+	if (Existing == EBlockID::Air)
+	{
+		Context.SetBlock(Target, Flowing);
+		return;
+	}
+
+	if (!FBlockRegistry::IsFluid(Existing))
+	{
+		return;
+	}
+
+	if (EBlockID::GetType(Existing) == EBlockID::GetType(Flowing))
+	{
+		//only ever strengthens flowing fluid, sources and falling columns stay as they are
+		if (!IsSource(Existing) && !IsFalling(Existing) && GetLevel(Flowing) < GetLevel(Existing))
+		{
+			Context.SetBlock(Target, Flowing);
+		}
+		return;
+	}
+
+	//water and lava meeting, a lava source sets into rock and anything else into cobble
+	const bool bLavaSource = EBlockID::GetType(Existing) == EBlockID::Lava && IsSource(Existing);
+	Context.SetBlock(Target, bLavaSource ? EBlockID::Rock : EBlockID::Cobble);
+}
+
+namespace
+{
+	FTimerHandle DamBreakReportHandle;
+
+	//mcue.FluidDamBreak [Size] [Depth] [Seconds]
+	//builds a walled reservoir of water in front of the player, waits for it to settle, knocks a wall down
+	//and logs the block tick cost every second while the flood spreads
+	void RunDamBreak(const TArray<FString>& Args, UWorld* World)
+	{
+		UVoxelWorldSubsystem* VoxelWorld = World != nullptr ? World->GetSubsystem<UVoxelWorldSubsystem>() : nullptr;
+		APlayerController* Player = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+		if (VoxelWorld == nullptr || Player == nullptr || Player->GetPawn() == nullptr)
+		{
+			UE_LOG(LogVoxelFluids, Warning, TEXT("mcue.FluidDamBreak needs a voxel world and a player"));
+			return;
+		}
+
+		const int32 Size = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 24, 4, 64);
+		const int32 Depth = FMath::Clamp(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 8, 2, 32);
+		const int32 Seconds = FMath::Clamp(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 10, 1, 120);
+
+		//a few blocks in front of the player along whichever axis it faces most, raised well above the ground so the flood has somewhere to fall
+		//Ahead points away from the player and Across along the wall facing it
+		const FVector Forward = Player->GetPawn()->GetActorForwardVector();
+		const bool bAlongX = FMath::Abs(Forward.X) >= FMath::Abs(Forward.Y);
+		const int32 Sign = (bAlongX ? Forward.X : Forward.Y) >= 0.0f ? 1 : -1;
+		const FIntVector Ahead = bAlongX ? FIntVector(Sign, 0, 0) : FIntVector(0, Sign, 0);
+		const FIntVector Across = bAlongX ? FIntVector(0, 1, 0) : FIntVector(1, 0, 0);
+		const FIntVector Corner = VoxelWorld->WorldToBlock(Player->GetPawn()->GetActorLocation()) + Ahead * 4 - Across * (Size / 2) + FIntVector(0, 0, 4);
+		if (!UVoxelWorldSubsystem::IsValidHeight(Corner.Z + Depth + 1))
+		{
+			UE_LOG(LogVoxelFluids, Warning, TEXT("Not enough room above the player for the reservoir"));
+			return;
+		}
+
+		for (int32 Z = 0; Z <= Depth; ++Z)
+		{
+			for (int32 B = -1; B <= Size; ++B)
+			{
+				for (int32 A = -1; A <= Size; ++A)
+				{
+					const bool bWall = Z == 0 || A < 0 || B < 0 || A == Size || B == Size;
+					VoxelWorld->SetBlock(Corner + Ahead * A + Across * B + FIntVector(0, 0, Z), bWall ? EBlockID::Cobble : EBlockID::Water);
+				}
+			}
+		}
+
+		//the wall facing the player goes a little later, once the filled reservoir has gone still
+		FTimerHandle BreakHandle;
+		TWeakObjectPtr<UVoxelWorldSubsystem> WeakWorld(VoxelWorld);
+		World->GetTimerManager().SetTimer(BreakHandle, FTimerDelegate::CreateLambda([WeakWorld, Corner, Ahead, Across, Size, Depth, Seconds, World]()
+		{
+			UVoxelWorldSubsystem* DamWorld = WeakWorld.Get();
+			if (DamWorld == nullptr)
+			{
+				return;
+			}
+
+			for (int32 Z = 1; Z <= Depth; ++Z)
+			{
+				for (int32 B = 0; B < Size; ++B)
+				{
+					DamWorld->SetBlock(Corner - Ahead + Across * B + FIntVector(0, 0, Z), EBlockID::Air);
+				}
+			}
+
+			DamWorld->ResetBlockTickStats();
+			UE_LOG(LogVoxelFluids, Display, TEXT("Dam broken: %dx%dx%d blocks of water"), Size, Size, Depth);
+
+			TSharedRef<int32> SecondsLeft = MakeShared<int32>(Seconds);
+			World->GetTimerManager().SetTimer(DamBreakReportHandle, FTimerDelegate::CreateLambda([WeakWorld, SecondsLeft, World]()
+			{
+				UVoxelWorldSubsystem* ReportWorld = WeakWorld.Get();
+				if (ReportWorld == nullptr || --(*SecondsLeft) < 0)
+				{
+					World->GetTimerManager().ClearTimer(DamBreakReportHandle);
+					return;
+				}
+
+				const FBlockTickStats& Stats = ReportWorld->GetBlockTicks().GetStats();
+				UE_LOG(LogVoxelFluids, Display, TEXT("  %3d steps  %8.1f us/step average  %8.1f us worst  %6d ticks pending  %6d writes  %5d sections remeshed"),
+					Stats.NumSteps, Stats.NumSteps > 0 ? Stats.Seconds * 1.0e6 / Stats.NumSteps : 0.0, Stats.MaxStepMicroseconds,
+					ReportWorld->GetBlockTicks().GetNumScheduled(), Stats.NumWrites, ReportWorld->GetNumThrottledRemeshes());
+				ReportWorld->ResetBlockTickStats();
+			}), 1.0f, true);
+		}), 2.0f, false);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs DamBreakCommand(
+		TEXT("mcue.FluidDamBreak"),
+		TEXT("Floods the world from a reservoir in front of the player and logs the block tick cost. Args: [Size] [Depth] [Seconds]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunDamBreak));
+}
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlockTypes.h"
+
+class FBlockTickContext;
+
+//water and lava as a cellular automaton over the block data, driven by scheduled block ticks
+//the state bits of a fluid block hold its level, 0 for a source up to MaxLevel, and whether it is falling
+//a fluid block is only ticked after it or a neighbour changed, so still water costs nothing
+//every tick reads the world as it was at the start of the step and writes through the tick merge, see FBlockTickScheduler
+class MCUE_API FVoxelFluids
+{
+public:
+	static constexpr uint8 MaxLevel = 7;
+	static constexpr uint8 FallingBit = 8;
+
+	static FBlockID Make(FBlockID Type, uint8 Level, bool bFalling) { return EBlockID::Make(Type, Level | (bFalling ? FallingBit : 0)); }
+
+	static uint8 GetLevel(FBlockID Block) { return EBlockID::GetState(Block) & MaxLevel; }
+	static bool IsFalling(FBlockID Block) { return (EBlockID::GetState(Block) & FallingBit) != 0; }
+	static bool IsSource(FBlockID Block) { return EBlockID::GetState(Block) == 0; }
+
+	//settles the block to what its neighbours feed it, then flows down and sideways from it
+	static void Tick(FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block);
+
+private:
+	//the state a flowing block should have given its neighbours, air if nothing feeds it any more
+	static FBlockID GetFedState(const FBlockTickContext& Context, const FIntVector& BlockCoord, FBlockID Block);
+
+	//writes Flowing into Target if the fluid can go there, or what it turns into when two fluids meet
+	static void FlowInto(FBlockTickContext& Context, const FIntVector& Target, FBlockID Flowing);
+};
@@ -0,0 +1,486 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelLighting.h"
+#include "VoxelWorldSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelLighting, Log, All);
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Chunk Light Pass (us)"), STAT_VoxelLightChunkMicroseconds, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Relight Time (us)"), STAT_VoxelRelightMicroseconds, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Relit Cells"), STAT_VoxelRelitCells, STATGROUP_VoxelWorld);
+
+namespace
+{
+	const FIntVector Directions[6] =
+	{
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1),
+		FIntVector(0, 0, -1)
+	};
+
+	constexpr int32 DownDirection = 5;
+
+	constexpr uint8 FullSky = FChunkLight::Pack(FChunkLight::MaxLevel, 0);
+
+	//mcue.LightingStats
+	//logs how long the chunk passes and edits of the current world's lighting have taken
+	void LogLightingStats(UWorld* World)
+	{
+		const UVoxelWorldSubsystem* VoxelWorld = World != nullptr ? World->GetSubsystem<UVoxelWorldSubsystem>() : nullptr;
+		if (VoxelWorld == nullptr)
+		{
+			UE_LOG(LogVoxelLighting, Display, TEXT("No voxel world"));
+			return;
+		}
+
+		const FVoxelLightingStats& Stats = VoxelWorld->GetLighting().GetStats();
+		UE_LOG(LogVoxelLighting, Display, TEXT("Chunk passes: %d, %.1f us average, %.1f us last"),
+			Stats.NumChunkPasses, Stats.NumChunkPasses > 0 ? Stats.ChunkPassSeconds * 1.0e6 / Stats.NumChunkPasses : 0.0, Stats.LastChunkPassMicroseconds);
+		UE_LOG(LogVoxelLighting, Display, TEXT("Edits: %d, %.1f us average, %.1f us worst, %.1f us last (%d cells)"),
+			Stats.NumEdits, Stats.NumEdits > 0 ? Stats.EditSeconds * 1.0e6 / Stats.NumEdits : 0.0, Stats.MaxEditMicroseconds, Stats.LastEditMicroseconds, Stats.LastEditCells);
+	}
+
+	FAutoConsoleCommandWithWorld LightingStatsCommand(
+		TEXT("mcue.LightingStats"),
+		TEXT("Logs the average cost of lighting a chunk and of relighting after an edit."),
+		FConsoleCommandWithWorldDelegate::CreateStatic(&LogLightingStats));
+}
+
+FVoxelLighting::FVoxelLighting()
+	: CachedChunkCoord(0, 0)
+	, CachedChunk(nullptr)
+	, bCacheValid(false)
+	, QuietChunk(nullptr)
+	, NumChangedCells(0)
+{
+	FMemory::Memzero(Stats);
+}
+
+void FVoxelLighting::LightChunk(UVoxelWorldSubsystem& VoxelWorld, FChunk& Chunk)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	ResetCache();
+	QuietChunk = &Chunk;
+
+	const FIntPoint ChunkCoord = Chunk.GetCoord();
+	const FIntVector ChunkOrigin(ChunkCoord.X * FChunkSection::Size, ChunkCoord.Y * FChunkSection::Size, 0);
+	FChunkLight& Light = Chunk.GetLight();
+
+	const FChunk* Neighbours[4] =
+	{
+		VoxelWorld.FindChunk(ChunkCoord + FIntPoint(1, 0)),
+		VoxelWorld.FindChunk(ChunkCoord + FIntPoint(-1, 0)),
+		VoxelWorld.FindChunk(ChunkCoord + FIntPoint(0, 1)),
+		VoxelWorld.FindChunk(ChunkCoord + FIntPoint(0, -1))
+	};
+
+	//column heights of the chunk and of the neighbour columns along its edges, unloaded ones count as 0
+	constexpr int32 Padded = FChunkSection::Size + 2;
+	int32 Heights[Padded][Padded];
+	int32 MinHeight = FChunk::Height;
+	int32 MaxHeight = 0;
+	for (int32 Y = -1; Y <= FChunkSection::Size; ++Y)
+	{
+		for (int32 X = -1; X <= FChunkSection::Size; ++X)
+		{
+			const bool bInsideX = X >= 0 && X < FChunkSection::Size;
+			const bool bInsideY = Y >= 0 && Y < FChunkSection::Size;
+
+			const FChunk* Column = nullptr;
+			if (bInsideX && bInsideY)
+			{
+				Column = &Chunk;
+			}
+			else if (bInsideX != bInsideY)
+			{
+				Column = Neighbours[!bInsideX ? (X < 0 ? 1 : 0) : (Y < 0 ? 3 : 2)];
+			}
+
+			const int32 Height = Column != nullptr ? GetColumnHeight(*Column, X & 15, Y & 15) : 0;
+			Heights[Y + 1][X + 1] = Height;
+
+			if (bInsideX && bInsideY)
+			{
+				MinHeight = FMath::Min(MinHeight, Height);
+				MaxHeight = FMath::Max(MaxHeight, Height);
+			}
+		}
+	}
+
+	//open sky above every column, darkness below, sections entirely one or the other stay unallocated
+	for (int32 Section = 0; Section < FChunk::NumSections; ++Section)
+	{
+		const int32 BaseZ = Section * FChunkSection::Size;
+		if (BaseZ >= MaxHeight)
+		{
+			Light.FillSection(Section, FullSky);
+			continue;
+		}
+
+		Light.FillSection(Section, 0);
+		if (BaseZ + FChunkSection::Size <= MinHeight)
+		{
+			continue;
+		}
+
+		for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+		{
+			for (int32 X = 0; X < FChunkSection::Size; ++X)
+			{
+				for (int32 Z = FMath::Max(BaseZ, Heights[Y + 1][X + 1]); Z < BaseZ + FChunkSection::Size; ++Z)
+				{
+					Light.Set(X, Y, Z, FullSky);
+				}
+			}
+		}
+	}
+
+	//sky light only has to spread sideways where a neighbouring column is taller
+	TArray<FIntVector> SkyQueue;
+	for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+	{
+		for (int32 X = 0; X < FChunkSection::Size; ++X)
+		{
+			const int32 Top = FMath::Max(FMath::Max(Heights[Y + 1][X], Heights[Y + 1][X + 2]), FMath::Max(Heights[Y][X + 1], Heights[Y + 2][X + 1]));
+			for (int32 Z = Heights[Y + 1][X + 1]; Z < Top; ++Z)
+			{
+				SkyQueue.Add(ChunkOrigin + FIntVector(X, Y, Z));
+			}
+		}
+	}
+
+	//blocks that give off light
+	for (int32 Section = 0; Section < FChunk::NumSections; ++Section)
+	{
+		const FChunkSection& Blocks = Chunk.GetSection(Section);
+		if (!Blocks.AnyBlockType([](FBlockID Block) { return FBlockRegistry::GetLightEmission(Block) > 0; }))
+		{
+			continue;
+		}
+
+		for (int32 Index = 0; Index < FChunkSection::Volume; ++Index)
+		{
+			const int32 X = Index & 15;
+			const int32 Y = (Index >> 4) & 15;
+			const int32 Z = Section * FChunkSection::Size + (Index >> 8);
+
+			const uint8 Emission = FBlockRegistry::GetLightEmission(Chunk.GetBlock(X, Y, Z));
+			if (Emission > 0)
+			{
+				Light.Set(X, Y, Z, FChunkLight::Pack(FChunkLight::GetSky(Light.Get(X, Y, Z)), Emission));
+				AddQueue.Add(ChunkOrigin + FIntVector(X, Y, Z));
+			}
+		}
+	}
+
+	//light already in the neighbours flows in across the shared faces
+	for (int32 Side = 0; Side < 4; ++Side)
+	{
+		const FChunk* Neighbour = Neighbours[Side];
+		if (Neighbour == nullptr)
+		{
+			continue;
+		}
+
+		for (int32 Edge = 0; Edge < FChunkSection::Size; ++Edge)
+		{
+			//the neighbour's column along the shared edge, and the column of this chunk next to it
+			const FIntPoint Inside = Side < 2 ? FIntPoint(Side == 0 ? FChunkSection::Size - 1 : 0, Edge) : FIntPoint(Edge, Side == 2 ? FChunkSection::Size - 1 : 0);
+			const FIntPoint Outside(Inside.X + Directions[Side].X, Inside.Y + Directions[Side].Y);
+			const int32 InsideHeight = Heights[Inside.Y + 1][Inside.X + 1];
+
+			for (int32 Z = 0; Z < FChunk::Height; ++Z)
+			{
+				uint8 Uniform;
+				if ((Z & 15) == 0 && Neighbour->GetLight().IsSectionUniform(Z >> 4, Uniform) && FChunkLight::GetBlock(Uniform) == 0 && (FChunkLight::GetSky(Uniform) == 0 || Z >= InsideHeight))
+				{
+					//nothing in this section of the neighbour can light anything here
+					Z |= FChunkSection::Size - 1;
+					continue;
+				}
+
+				const uint8 Packed = Neighbour->GetLight().Get(Outside.X & 15, Outside.Y & 15, Z);
+				const FIntVector BlockCoord = ChunkOrigin + FIntVector(Outside.X, Outside.Y, Z);
+				if (FChunkLight::GetSky(Packed) > 1 && Z < InsideHeight)
+				{
+					SkyQueue.Add(BlockCoord);
+				}
+				if (FChunkLight::GetBlock(Packed) > 1)
+				{
+					AddQueue.Add(BlockCoord);
+				}
+			}
+		}
+	}
+
+	PropagateAdd(VoxelWorld, SkyQueue, true);
+	PropagateAdd(VoxelWorld, AddQueue, false);
+
+	QuietChunk = nullptr;
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	++Stats.NumChunkPasses;
+	Stats.ChunkPassSeconds += Seconds;
+	Stats.LastChunkPassMicroseconds = (float)(Seconds * 1.0e6);
+	INC_FLOAT_STAT_BY(STAT_VoxelLightChunkMicroseconds, Stats.LastChunkPassMicroseconds);
+}
+
+void FVoxelLighting::UpdateBlock(UVoxelWorldSubsystem& VoxelWorld, const FIntVector& BlockCoord, FBlockID OldBlock, FBlockID NewBlock)
+{
+	const FVoxelBlockChange Change{ BlockCoord, OldBlock, NewBlock };
+	UpdateBlocks(VoxelWorld, MakeArrayView(&Change, 1));
+}
+
+void FVoxelLighting::UpdateBlocks(UVoxelWorldSubsystem& VoxelWorld, TArrayView<const FVoxelBlockChange> Changes)
+{
+	RelitChanges.Reset();
+	for (int32 Index = 0; Index < Changes.Num(); ++Index)
+	{
+		const FVoxelBlockChange& Change = Changes[Index];
+		if (FBlockRegistry::IsOpaque(Change.OldBlock) != FBlockRegistry::IsOpaque(Change.NewBlock)
+			|| FBlockRegistry::GetLightEmission(Change.OldBlock) != FBlockRegistry::GetLightEmission(Change.NewBlock))
+		{
+			RelitChanges.Add(Index);
+		}
+	}
+
+	if (RelitChanges.Num() == 0)
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	ResetCache();
+	NumChangedCells = 0;
+
+	for (int32 Channel = 0; Channel < 2; ++Channel)
+	{
+		const bool bSky = Channel == 0;
+
+		//light that went through or came from the old blocks has to be taken back first, all in one fill
+		for (const int32 Index : RelitChanges)
+		{
+			const FVoxelBlockChange& Change = Changes[Index];
+			FChunk* Chunk = FindChunk(VoxelWorld, Change.BlockCoord);
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			const uint8 Level = GetLevel(*Chunk, Change.BlockCoord, bSky);
+			const bool bDimmer = !bSky && FBlockRegistry::GetLightEmission(Change.OldBlock) > FBlockRegistry::GetLightEmission(Change.NewBlock);
+			if (Level > 0 && (FBlockRegistry::IsOpaque(Change.NewBlock) || bDimmer))
+			{
+				SetLevel(VoxelWorld, *Chunk, Change.BlockCoord, bSky, 0);
+				RemoveQueue.Add(FRemovedLight{ Change.BlockCoord, Level });
+			}
+		}
+
+		if (RemoveQueue.Num() > 0)
+		{
+			PropagateRemove(VoxelWorld, RemoveQueue, AddQueue, bSky);
+		}
+
+		for (const int32 Index : RelitChanges)
+		{
+			const FVoxelBlockChange& Change = Changes[Index];
+			FChunk* Chunk = FindChunk(VoxelWorld, Change.BlockCoord);
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			//an open block lets the light around it back in
+			if (!FBlockRegistry::IsOpaque(Change.NewBlock))
+			{
+				for (const FIntVector& Direction : Directions)
+				{
+					const FIntVector Neighbour = Change.BlockCoord + Direction;
+					FChunk* NeighbourChunk = UVoxelWorldSubsystem::IsValidHeight(Neighbour.Z) ? FindChunk(VoxelWorld, Neighbour) : nullptr;
+					if (NeighbourChunk != nullptr && GetLevel(*NeighbourChunk, Neighbour, bSky) > 1)
+					{
+						AddQueue.Add(Neighbour);
+					}
+				}
+			}
+
+			const uint8 NewEmission = FBlockRegistry::GetLightEmission(Change.NewBlock);
+			if (!bSky && NewEmission > GetLevel(*Chunk, Change.BlockCoord, false))
+			{
+				SetLevel(VoxelWorld, *Chunk, Change.BlockCoord, false, NewEmission);
+				AddQueue.Add(Change.BlockCoord);
+			}
+		}
+
+		PropagateAdd(VoxelWorld, AddQueue, bSky);
+	}
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	++Stats.NumEdits;
+	Stats.EditSeconds += Seconds;
+	Stats.LastEditMicroseconds = (float)(Seconds * 1.0e6);
+	Stats.MaxEditMicroseconds = FMath::Max(Stats.MaxEditMicroseconds, Stats.LastEditMicroseconds);
+	Stats.LastEditCells = NumChangedCells;
+	INC_FLOAT_STAT_BY(STAT_VoxelRelightMicroseconds, Stats.LastEditMicroseconds);
+	INC_DWORD_STAT_BY(STAT_VoxelRelitCells, NumChangedCells);
+}
+
+FChunk* FVoxelLighting::FindChunk(UVoxelWorldSubsystem& VoxelWorld, const FIntVector& BlockCoord)
+{
+	const FIntPoint ChunkCoord = UVoxelWorldSubsystem::BlockToChunk(BlockCoord);
+	if (!bCacheValid || ChunkCoord != CachedChunkCoord)
+	{
+		CachedChunk = VoxelWorld.FindChunk(ChunkCoord);
+		CachedChunkCoord = ChunkCoord;
+		bCacheValid = true;
+	}
+	return CachedChunk;
+}
+
+void FVoxelLighting::ResetCache()
+{
+	//chunks come and go between calls
+	bCacheValid = false;
+	CachedChunk = nullptr;
+}
+
+uint8 FVoxelLighting::GetLevel(const FChunk& Chunk, const FIntVector& BlockCoord, bool bSky)
+{
+	const uint8 Packed = Chunk.GetLight().Get(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z);
+	return bSky ? FChunkLight::GetSky(Packed) : FChunkLight::GetBlock(Packed);
+}
+
+void FVoxelLighting::SetLevel(UVoxelWorldSubsystem& VoxelWorld, FChunk& Chunk, const FIntVector& BlockCoord, bool bSky, uint8 Level)
+{
+	FChunkLight& Light = Chunk.GetLight();
+	const uint8 Packed = Light.Get(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z);
+	Light.Set(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z, bSky ? FChunkLight::Pack(Level, FChunkLight::GetBlock(Packed)) : FChunkLight::Pack(FChunkLight::GetSky(Packed), Level));
+
+	++NumChangedCells;
+	if (&Chunk != QuietChunk)
+	{
+		VoxelWorld.MarkBlockDirty(BlockCoord);
+	}
+}
+
+void FVoxelLighting::PropagateAdd(UVoxelWorldSubsystem& VoxelWorld, TArray<FIntVector>& Queue, bool bSky)
+{
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		const FIntVector BlockCoord = Queue[Head];
+		const FChunk* Chunk = FindChunk(VoxelWorld, BlockCoord);
+		if (Chunk == nullptr)
+		{
+			continue;
+		}
+
+		const uint8 Level = GetLevel(*Chunk, BlockCoord, bSky);
+		if (Level <= 1)
+		{
+			continue;
+		}
+
+		for (int32 Direction = 0; Direction < UE_ARRAY_COUNT(Directions); ++Direction)
+		{
+			const FIntVector Neighbour = BlockCoord + Directions[Direction];
+			if (!UVoxelWorldSubsystem::IsValidHeight(Neighbour.Z))
+			{
+				continue;
+			}
+
+			FChunk* NeighbourChunk = FindChunk(VoxelWorld, Neighbour);
+			if (NeighbourChunk == nullptr || FBlockRegistry::IsOpaque(NeighbourChunk->GetBlock(Neighbour.X & 15, Neighbour.Y & 15, Neighbour.Z)))
+			{
+				continue;
+			}
+
+			const uint8 NeighbourLevel = (bSky && Direction == DownDirection && Level == FChunkLight::MaxLevel) ? Level : Level - 1;
+			if (GetLevel(*NeighbourChunk, Neighbour, bSky) < NeighbourLevel)
+			{
+				SetLevel(VoxelWorld, *NeighbourChunk, Neighbour, bSky, NeighbourLevel);
+				Queue.Add(Neighbour);
+			}
+		}
+	}
+
+	Queue.Reset();
+}
+
+void FVoxelLighting::PropagateRemove(UVoxelWorldSubsystem& VoxelWorld, TArray<FRemovedLight>& Queue, TArray<FIntVector>& OutAddQueue, bool bSky)
+{
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		const FRemovedLight Removed = Queue[Head];
+
+		for (int32 Direction = 0; Direction < UE_ARRAY_COUNT(Directions); ++Direction)
+		{
+			const FIntVector Neighbour = Removed.BlockCoord + Directions[Direction];
+			if (!UVoxelWorldSubsystem::IsValidHeight(Neighbour.Z))
+			{
+				continue;
+			}
+
+			FChunk* NeighbourChunk = FindChunk(VoxelWorld, Neighbour);
+			if (NeighbourChunk == nullptr)
+			{
+				continue;
+			}
+
+			const uint8 NeighbourLevel = GetLevel(*NeighbourChunk, Neighbour, bSky);
+			if (NeighbourLevel == 0)
+			{
+				continue;
+			}
+
+			//dimmer light was fed by the removed block, and so was full sky light straight below it
+			const bool bDependent = NeighbourLevel < Removed.Level
+				|| (bSky && Direction == DownDirection && Removed.Level == FChunkLight::MaxLevel && NeighbourLevel == FChunkLight::MaxLevel);
+
+			if (!bDependent)
+			{
+				//lit from somewhere else, it will spread back into the cleared area
+				OutAddQueue.Add(Neighbour);
+				continue;
+			}
+
+			SetLevel(VoxelWorld, *NeighbourChunk, Neighbour, bSky, 0);
+			Queue.Add(FRemovedLight{ Neighbour, NeighbourLevel });
+
+			//light sources keep their own light
+			const uint8 Emission = bSky ? 0 : FBlockRegistry::GetLightEmission(NeighbourChunk->GetBlock(Neighbour.X & 15, Neighbour.Y & 15, Neighbour.Z));
+			if (Emission > 0)
+			{
+				SetLevel(VoxelWorld, *NeighbourChunk, Neighbour, bSky, Emission);
+				OutAddQueue.Add(Neighbour);
+			}
+		}
+	}
+
+	Queue.Reset();
+}
+
+int32 FVoxelLighting::GetColumnHeight(const FChunk& Chunk, int32 X, int32 Y)
+{
+	for (int32 Z = FChunk::Height - 1; Z >= 0; --Z)
+	{
+		if (Chunk.GetSection(Z >> 4).IsEmpty())
+		{
+			Z &= ~(FChunkSection::Size - 1);
+			continue;
+		}
+
+		if (FBlockRegistry::IsOpaque(Chunk.GetBlock(X, Y, Z)))
+		{
+			return Z + 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlockTypes.h"
+
+class FChunk;
+class UVoxelWorldSubsystem;
+struct FVoxelBlockChange;
+
+//how long lighting has taken so far
+struct FVoxelLightingStats
+{
+	int32 NumChunkPasses;
+	double ChunkPassSeconds;
+	float LastChunkPassMicroseconds;
+
+	int32 NumEdits;
+	double EditSeconds;
+	float LastEditMicroseconds;
+	float MaxEditMicroseconds;
+
+	//light values changed by the last edit
+	int32 LastEditCells;
+};
+
+//sky light and block light spread by breadth first flood fill over the block data
+//sky light comes straight down at full strength and loses a level per block everywhere else, block light loses a level per block
+//a freshly loaded chunk gets a full pass, an edit only undoes and redoes the light it affects:
+//a removal fill clears everything that depended on the old light, then an add fill spreads in from what is left
+//chunks that aren't loaded stop light like an opaque block, every change marks the sections that see it for remeshing
+class MCUE_API FVoxelLighting
+{
+public:
+	FVoxelLighting();
+
+	//lights a chunk that was just added, and spreads its light into and out of the loaded neighbours
+	void LightChunk(UVoxelWorldSubsystem& VoxelWorld, FChunk& Chunk);
+
+	//relights around a block that changed from OldBlock to NewBlock
+	void UpdateBlock(UVoxelWorldSubsystem& VoxelWorld, const FIntVector& BlockCoord, FBlockID OldBlock, FBlockID NewBlock);
+
+	//relights around a batch of changed blocks with one removal fill and one add fill per channel, counts as one edit
+	//the blocks have to be written already
+	void UpdateBlocks(UVoxelWorldSubsystem& VoxelWorld, TArrayView<const FVoxelBlockChange> Changes);
+
+	const FVoxelLightingStats& GetStats() const { return Stats; }
+
+private:
+	struct FRemovedLight
+	{
+		FIntVector BlockCoord;
+		uint8 Level;
+	};
+
+	//looks chunks up through a one entry cache, most neighbours are in the same chunk
+	FChunk* FindChunk(UVoxelWorldSubsystem& VoxelWorld, const FIntVector& BlockCoord);
+
+	void ResetCache();
+
+	static uint8 GetLevel(const FChunk& Chunk, const FIntVector& BlockCoord, bool bSky);
+	void SetLevel(UVoxelWorldSubsystem& VoxelWorld, FChunk& Chunk, const FIntVector& BlockCoord, bool bSky, uint8 Level);
+
+	//spreads light out from every queued block, empties the queue
+	void PropagateAdd(UVoxelWorldSubsystem& VoxelWorld, TArray<FIntVector>& Queue, bool bSky);
+
+	//clears the light that came from the queued blocks, whatever borders the cleared area is queued in AddQueue to fill it again
+	void PropagateRemove(UVoxelWorldSubsystem& VoxelWorld, TArray<FRemovedLight>& Queue, TArray<FIntVector>& AddQueue, bool bSky);
+
+	//one past the highest opaque block in the column, 0 if there is none
+	static int32 GetColumnHeight(const FChunk& Chunk, int32 X, int32 Y);
+
+	TArray<FIntVector> AddQueue;
+	TArray<FRemovedLight> RemoveQueue;
+
+	//changes of the current batch that affect light
+	TArray<int32> RelitChanges;
+
+	FIntPoint CachedChunkCoord;
+	FChunk* CachedChunk;
+	bool bCacheValid;
+
+	//changes inside this chunk aren't marked dirty, it is remeshed as a whole anyway
+	FChunk* QuietChunk;
+
+	int32 NumChangedCells;
+
+	FVoxelLightingStats Stats;
+};
@@ -0,0 +1,317 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelMovementComponent.h"
+#include "VoxelWorldSubsystem.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PhysicsVolume.h"
+
+namespace
+{
+	//in block units, keeps a box that is exactly touching a face from counting as inside the block
+	constexpr float CellEpsilon = 1.0e-3f;
+
+	bool IsSolidCell(const UVoxelWorldSubsystem& VoxelWorld, int32 X, int32 Y, int32 Z)
+	{
+		//the bottom of the world is a floor, the sky above the top is open
+		if (Z < 0)
+		{
+			return true;
+		}
+		if (Z >= FChunk::Height)
+		{
+			return false;
+		}
+
+		//walking into a chunk that isn't there yet would drop the character through it
+		const FChunk* Chunk = VoxelWorld.FindChunk(UVoxelWorldSubsystem::BlockToChunk(FIntVector(X, Y, Z)));
+		return Chunk == nullptr || FBlockRegistry::IsSolid(Chunk->GetBlock(X & 15, Y & 15, Z));
+	}
+}
+
+UVoxelMovementComponent::UVoxelMovementComponent()
+{
+	GroundProbeDistance = 2.0f;
+
+	//the stock 45 never clears a block, walking into a one block ledge should climb it
+	MaxStepHeight = UVoxelWorldSubsystem::BlockSize;
+}
+
+void UVoxelMovementComponent::SetDefaultMovementMode()
+{
+	if (GetWorld() == nullptr || GetWorld()->GetSubsystem<UVoxelWorldSubsystem>() == nullptr)
+	{
+		Super::SetDefaultMovementMode();
+		return;
+	}
+
+	//lands on the first frame it finds ground
+	SetMovementMode(MOVE_Custom, CMOVE_VoxelFalling);
+}
+
+float UVoxelMovementComponent::GetMaxSpeed() const
+{
+	if (MovementMode == MOVE_Custom)
+	{
+		return IsCrouching() ? MaxWalkSpeedCrouched : MaxWalkSpeed;
+	}
+	return Super::GetMaxSpeed();
+}
+
+float UVoxelMovementComponent::GetMaxBrakingDeceleration() const
+{
+	if (MovementMode == MOVE_Custom)
+	{
+		return IsVoxelWalking() ? BrakingDecelerationWalking : BrakingDecelerationFalling;
+	}
+	return Super::GetMaxBrakingDeceleration();
+}
+
+bool UVoxelMovementComponent::CanAttemptJump() const
+{
+	if (MovementMode == MOVE_Custom)
+	{
+		return IsJumpAllowed() && !bWantsToCrouch && IsVoxelWalking();
+	}
+	return Super::CanAttemptJump();
+}
+
+bool UVoxelMovementComponent::DoJump(bool bReplayingMoves)
+{
+	if (MovementMode != MOVE_Custom)
+	{
+		return Super::DoJump(bReplayingMoves);
+	}
+
+	if (CharacterOwner == nullptr || !CharacterOwner->CanJump())
+	{
+		return false;
+	}
+
+	Velocity.Z = FMath::Max(Velocity.Z, JumpZVelocity);
+	SetMovementMode(MOVE_Custom, CMOVE_VoxelFalling);
+	return true;
+}
+
+void UVoxelMovementComponent::PhysCustom(float DeltaTime, int32 Iterations)
+{
+	if (DeltaTime < MIN_TICK_TIME || !HasValidData())
+	{
+		return;
+	}
+
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		SetMovementMode(MOVE_Falling);
+		StartNewPhysics(DeltaTime, Iterations);
+		return;
+	}
+
+	//wait in place until the chunk under the character has been loaded
+	const FIntVector FeetBlock = VoxelWorld->WorldToBlock(UpdatedComponent->GetComponentLocation());
+	if (VoxelWorld->FindChunk(UVoxelWorldSubsystem::BlockToChunk(FeetBlock)) == nullptr)
+	{
+		Velocity = FVector::ZeroVector;
+		return;
+	}
+
+	float RemainingTime = DeltaTime;
+	while (RemainingTime >= MIN_TICK_TIME && Iterations < MaxSimulationIterations && MovementMode == MOVE_Custom)
+	{
+		++Iterations;
+		const float TimeTick = GetSimulationTimeStep(RemainingTime, Iterations);
+		RemainingTime -= TimeTick;
+
+		PhysVoxel(TimeTick, *VoxelWorld);
+	}
+}
+
+void UVoxelMovementComponent::PhysVoxel(float DeltaTime, const UVoxelWorldSubsystem& VoxelWorld)
+{
+	const bool bWasWalking = IsVoxelWalking();
+
+	//lateral velocity the same way the stock walking and falling modes work it out
+	const float OldVelocityZ = Velocity.Z;
+	Velocity.Z = 0.0f;
+	if (bWasWalking)
+	{
+		CalcVelocity(DeltaTime, GroundFriction, false, GetMaxBrakingDeceleration());
+		Velocity.Z = 0.0f;
+	}
+	else
+	{
+		TGuardValue<FVector> RestoreAcceleration(Acceleration, GetFallingLateralAcceleration(DeltaTime));
+		CalcVelocity(DeltaTime, FallingLateralFriction, false, GetMaxBrakingDeceleration());
+		Velocity.Z = FMath::Max(OldVelocityZ + GetGravityZ() * DeltaTime, -GetPhysicsVolume()->TerminalVelocity);
+	}
+
+	const FVector Delta = Velocity * DeltaTime;
+	const FBox StartBox = GetCollisionBox();
+	FBox Box = StartBox;
+
+	//vertical first, then each horizontal axis on its own, so sliding along walls falls out naturally
+	const float MovedZ = SweepAxis(VoxelWorld, Box, 2, Delta.Z);
+	Box = Box.ShiftBy(FVector(0.0f, 0.0f, MovedZ));
+	if (MovedZ != Delta.Z)
+	{
+		//landed or bumped a ceiling
+		Velocity.Z = 0.0f;
+	}
+
+	for (int32 Axis = 0; Axis < 2; ++Axis)
+	{
+		if (Delta[Axis] == 0.0f)
+		{
+			continue;
+		}
+
+		const float Moved = SweepAxis(VoxelWorld, Box, Axis, Delta[Axis]);
+		if (Moved == Delta[Axis])
+		{
+			FVector Shift(0.0f);
+			Shift[Axis] = Moved;
+			Box = Box.ShiftBy(Shift);
+			continue;
+		}
+
+		if (!bWasWalking || !TryStepUp(VoxelWorld, Box, Axis, Delta[Axis], Moved))
+		{
+			FVector Shift(0.0f);
+			Shift[Axis] = Moved;
+			Box = Box.ShiftBy(Shift);
+			Velocity[Axis] = 0.0f;
+		}
+	}
+
+	//no sweep, the block grid already decided where the box can go
+	MoveUpdatedComponent(Box.GetCenter() - StartBox.GetCenter(), UpdatedComponent->GetComponentQuat(), false);
+
+	const bool bOnGround = Velocity.Z <= 0.0f && SweepAxis(VoxelWorld, Box, 2, -GroundProbeDistance) > -GroundProbeDistance;
+	if (bWasWalking && !bOnGround)
+	{
+		SetMovementMode(MOVE_Custom, CMOVE_VoxelFalling);
+	}
+	else if (!bWasWalking && bOnGround)
+	{
+		FHitResult Hit(1.0f);
+		Hit.bBlockingHit = true;
+		Hit.Location = UpdatedComponent->GetComponentLocation();
+		Hit.ImpactPoint = FVector(Box.GetCenter().X, Box.GetCenter().Y, Box.Min.Z);
+		Hit.Normal = FVector::UpVector;
+		Hit.ImpactNormal = FVector::UpVector;
+
+		Velocity.Z = 0.0f;
+		SetMovementMode(MOVE_Custom, CMOVE_VoxelWalking);
+		CharacterOwner->Landed(Hit);
+	}
+}
+
+FBox UVoxelMovementComponent::GetCollisionBox() const
+{
+	float Radius;
+	float HalfHeight;
+	CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(Radius, HalfHeight);
+
+	const FVector Extent(Radius * HALF_SQRT_2, Radius * HALF_SQRT_2, HalfHeight);
+	return FBox::BuildAABB(UpdatedComponent->GetComponentLocation(), Extent);
+}
+
+float UVoxelMovementComponent::SweepAxis(const UVoxelWorldSubsystem& VoxelWorld, const FBox& Box, int32 Axis, float Distance) const
+{
+	if (Distance == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	//everything in block units from here on
+	const FVector Origin = VoxelWorld.BlockToWorld(FIntVector::ZeroValue);
+	FVector Min = (Box.Min - Origin) / UVoxelWorldSubsystem::BlockSize;
+	FVector Max = (Box.Max - Origin) / UVoxelWorldSubsystem::BlockSize;
+	const float Move = Distance / UVoxelWorldSubsystem::BlockSize;
+
+	//cells the box covers on the other two axes, a box flush against a face doesn't cover the cell behind it
+	const int32 AxisU = (Axis + 1) % 3;
+	const int32 AxisV = (Axis + 2) % 3;
+	const int32 MinU = FMath::FloorToInt(Min[AxisU] + CellEpsilon);
+	const int32 MaxU = FMath::FloorToInt(Max[AxisU] - CellEpsilon);
+	const int32 MinV = FMath::FloorToInt(Min[AxisV] + CellEpsilon);
+	const int32 MaxV = FMath::FloorToInt(Max[AxisV] - CellEpsilon);
+
+	auto IsLayerSolid = [&](int32 Layer)
+	{
+		for (int32 V = MinV; V <= MaxV; ++V)
+		{
+			for (int32 U = MinU; U <= MaxU; ++U)
+			{
+				FIntVector Cell;
+				Cell[Axis] = Layer;
+				Cell[AxisU] = U;
+				Cell[AxisV] = V;
+				if (IsSolidCell(VoxelWorld, Cell.X, Cell.Y, Cell.Z))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	};
+
+	//walk the layers of cells the leading face enters, the first solid one stops the box at its face
+	if (Move > 0.0f)
+	{
+		const int32 FirstLayer = FMath::CeilToInt(Max[Axis] - CellEpsilon);
+		const int32 LastLayer = FMath::CeilToInt(Max[Axis] + Move - CellEpsilon) - 1;
+		for (int32 Layer = FirstLayer; Layer <= LastLayer; ++Layer)
+		{
+			if (IsLayerSolid(Layer))
+			{
+				return FMath::Max(0.0f, Layer - Max[Axis]) * UVoxelWorldSubsystem::BlockSize;
+			}
+		}
+	}
+	else
+	{
+		const int32 FirstLayer = FMath::FloorToInt(Min[Axis] + CellEpsilon) - 1;
+		const int32 LastLayer = FMath::FloorToInt(Min[Axis] + Move + CellEpsilon);
+		for (int32 Layer = FirstLayer; Layer >= LastLayer; --Layer)
+		{
+			if (IsLayerSolid(Layer))
+			{
+				return FMath::Min(0.0f, Layer + 1 - Min[Axis]) * UVoxelWorldSubsystem::BlockSize;
+			}
+		}
+	}
+
+	return Distance;
+}
+
+bool UVoxelMovementComponent::TryStepUp(const UVoxelWorldSubsystem& VoxelWorld, FBox& Box, int32 Axis, float Distance, float BlockedDistance) const
+{
+	if (MaxStepHeight <= 0.0f)
+	{
+		return false;
+	}
+
+	//lift, move across, then settle back down onto whatever is there
+	const float Up = SweepAxis(VoxelWorld, Box, 2, MaxStepHeight);
+	if (Up <= 0.0f)
+	{
+		return false;
+	}
+	FBox Stepped = Box.ShiftBy(FVector(0.0f, 0.0f, Up));
+
+	const float Across = SweepAxis(VoxelWorld, Stepped, Axis, Distance);
+	if (FMath::Abs(Across) <= FMath::Abs(BlockedDistance))
+	{
+		return false;
+	}
+
+	FVector Shift(0.0f);
+	Shift[Axis] = Across;
+	Stepped = Stepped.ShiftBy(Shift);
+
+	const float Down = SweepAxis(VoxelWorld, Stepped, 2, -Up);
+	Box = Stepped.ShiftBy(FVector(0.0f, 0.0f, Down));
+	return true;
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "VoxelMovementComponent.generated.h"
+
+class UVoxelWorldSubsystem;
+
+//custom movement modes, stored in CustomMovementMode while MovementMode is MOVE_Custom
+enum EVoxelMovementMode : uint8
+{
+	CMOVE_VoxelWalking = 0,
+	CMOVE_VoxelFalling = 1
+};
+
+//moves the character by resolving a box against the block grid instead of sweeping the physics scene
+//the box is the square inscribed in the capsule, so it never reaches outside of it
+//chunks that aren't loaded count as solid, and the character holds still until the chunk it is in arrives
+UCLASS()
+class MCUE_API UVoxelMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVoxelMovementComponent();
+
+	//starts in voxel falling when the world has block data, otherwise behaves like the stock component
+	virtual void SetDefaultMovementMode() override;
+
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxBrakingDeceleration() const override;
+
+	virtual bool CanAttemptJump() const override;
+	virtual bool DoJump(bool bReplayingMoves) override;
+
+	bool IsVoxelWalking() const { return MovementMode == MOVE_Custom && CustomMovementMode == CMOVE_VoxelWalking; }
+	bool IsVoxelFalling() const { return MovementMode == MOVE_Custom && CustomMovementMode == CMOVE_VoxelFalling; }
+
+	//how far below its feet the character looks for ground while walking
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Voxel", meta = (ClampMin = "0", UIMin = "0"))
+	float GroundProbeDistance;
+
+protected:
+	virtual void PhysCustom(float DeltaTime, int32 Iterations) override;
+
+private:
+	void PhysVoxel(float DeltaTime, const UVoxelWorldSubsystem& VoxelWorld);
+
+	//the collision box around the updated component, in world space
+	FBox GetCollisionBox() const;
+
+	//how far the box can move along one axis before it touches a solid block, in world units
+	float SweepAxis(const UVoxelWorldSubsystem& VoxelWorld, const FBox& Box, int32 Axis, float Distance) const;
+
+	//climbs onto a ledge no higher than MaxStepHeight when walking into it, returns false if it can't
+	//MaxStepHeight defaults to one block
+	bool TryStepUp(const UVoxelWorldSubsystem& VoxelWorld, FBox& Box, int32 Axis, float Distance, float BlockedDistance) const;
+};
@@ -0,0 +1,767 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelReplicationSubsystem.h"
+#include "ChunkReplicatorComponent.h"
+#include "VoxelWorldSubsystem.h"
+#include "MCUEStats.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelReplication, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Chunk Replication"), STAT_VoxelReplication, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net Connections"), STAT_VoxelNetConnections, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net Chunks Queued"), STAT_VoxelNetQueued, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Net Bytes Sent/s"), STAT_VoxelNetBytesSent, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Net Bytes Received/s"), STAT_VoxelNetBytesReceived, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Net Time To Visible (ms)"), STAT_VoxelNetTimeToVisible, STATGROUP_VoxelWorld);
+
+namespace
+{
+	//rough cost of an rpc beyond its payload, charged against the budget so small rpcs aren't free
+	constexpr int32 RpcOverheadBytes = 16;
+
+	//payload sizes of the replicator rpcs
+	constexpr int32 ChunkCoordBytes = sizeof(FIntPoint);
+	constexpr int32 BeginChunkBytes = ChunkCoordBytes + 3 * sizeof(int32);
+	constexpr int32 DeltaBytes = sizeof(uint32);
+
+	//same limit the region files use, a bad size from the wire shouldn't allocate without bound
+	constexpr int32 MaxUncompressedChunkSize = 16 * 1024 * 1024;
+
+	//times a client may ask for the same chunk again before the server stops resending it
+	constexpr uint8 MaxResendRequests = 3;
+
+	//mcue.NetStats
+	void LogNetStats(UWorld* World)
+	{
+		const UVoxelReplicationSubsystem* Replication = World != nullptr ? World->GetSubsystem<UVoxelReplicationSubsystem>() : nullptr;
+		if (Replication == nullptr)
+		{
+			UE_LOG(LogVoxelReplication, Display, TEXT("No chunk replication in this world"));
+			return;
+		}
+		Replication->LogStats();
+	}
+
+	FAutoConsoleCommandWithWorld NetStatsCommand(
+		TEXT("mcue.NetStats"),
+		TEXT("Logs the chunk replication bandwidth and time to visible of the current world, and on a server every connection's."),
+		FConsoleCommandWithWorldDelegate::CreateStatic(&LogNetStats));
+}
+
+UVoxelReplicationSubsystem::UVoxelReplicationSubsystem()
+{
+	FMemory::Memzero(Stats);
+
+	StatsTimer = 0.0f;
+	BytesReceivedThisSecond = 0;
+	TimeToVisibleSum = 0.0;
+	LogTimer = 0.0f;
+
+	NetInterestRadius = 6;
+	NetInterestHysteresis = 1;
+	BytesPerSecondPerConnection = 65536.0f;
+	MaxBurstSeconds = 0.25f;
+	MaxDeltasPerChunk = 256;
+	StatsLogInterval = 0.0f;
+}
+
+bool UVoxelReplicationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UVoxelReplicationSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	//only a server has clients to keep up to date
+	UVoxelWorldSubsystem* VoxelWorld = InWorld.GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld != nullptr && !InWorld.IsNetMode(NM_Client))
+	{
+		VoxelWorld->OnBlockChanged().AddUObject(this, &UVoxelReplicationSubsystem::OnBlockChanged);
+		VoxelWorld->OnRegionEdited().AddUObject(this, &UVoxelReplicationSubsystem::OnRegionEdited);
+	}
+}
+
+void UVoxelReplicationSubsystem::Deinitialize()
+{
+	Replicators.Empty();
+	Connections.Empty();
+	CompressedChunks.Empty();
+	IncomingChunks.Empty();
+
+	Super::Deinitialize();
+}
+
+void UVoxelReplicationSubsystem::Tick(float DeltaTime)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_VoxelReplication, MCUENet);
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
+
+	if (!VoxelWorld->IsNetClient())
+	{
+		UpdateConnections();
+		for (FConnectionState& State : Connections)
+		{
+			SendToConnection(State, DeltaTime);
+		}
+	}
+
+	StatsTimer += DeltaTime;
+	if (StatsTimer >= 1.0f)
+	{
+		Stats.NumConnections = Connections.Num();
+		Stats.NumQueuedChunks = 0;
+		Stats.BytesSentPerSecond = 0.0f;
+		for (FConnectionState& State : Connections)
+		{
+			State.BytesPerSecond = State.BytesThisSecond / StatsTimer;
+			State.BytesThisSecond = 0;
+
+			Stats.NumQueuedChunks += State.SendQueue.Num();
+			Stats.BytesSentPerSecond += State.BytesPerSecond;
+		}
+
+		Stats.BytesReceivedPerSecond = BytesReceivedThisSecond / StatsTimer;
+		BytesReceivedThisSecond = 0;
+		StatsTimer = 0.0f;
+
+		//cached chunks that changed or unloaded since and that no connection is still sending
+		for (auto It = CompressedChunks.CreateIterator(); It; ++It)
+		{
+			const FChunk* Chunk = VoxelWorld->FindChunk(It.Key());
+			if (It.Value().IsUnique() && (Chunk == nullptr || Chunk->GetRevision() != It.Value()->Revision))
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		SET_DWORD_STAT(STAT_VoxelNetConnections, Stats.NumConnections);
+		SET_DWORD_STAT(STAT_VoxelNetQueued, Stats.NumQueuedChunks);
+		SET_FLOAT_STAT(STAT_VoxelNetBytesSent, Stats.BytesSentPerSecond);
+		SET_FLOAT_STAT(STAT_VoxelNetBytesReceived, Stats.BytesReceivedPerSecond);
+		SET_FLOAT_STAT(STAT_VoxelNetTimeToVisible, Stats.AverageTimeToVisible * 1000.0f);
+		CSV_CUSTOM_STAT(MCUENet, BytesSentPerSecond, Stats.BytesSentPerSecond, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(MCUENet, BytesReceivedPerSecond, Stats.BytesReceivedPerSecond, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(MCUENet, QueuedChunks, Stats.NumQueuedChunks, ECsvCustomStatOp::Set);
+	}
+
+	if (StatsLogInterval > 0.0f && GetWorld()->GetNetMode() != NM_Standalone)
+	{
+		LogTimer += DeltaTime;
+		if (LogTimer >= StatsLogInterval)
+		{
+			LogTimer = 0.0f;
+			LogStats();
+		}
+	}
+}
+
+bool UVoxelReplicationSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UVoxelReplicationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVoxelReplicationSubsystem, STATGROUP_Tickables);
+}
+
+void UVoxelReplicationSubsystem::AddReplicator(UChunkReplicatorComponent* Replicator)
+{
+	Replicators.AddUnique(Replicator);
+}
+
+void UVoxelReplicationSubsystem::RemoveReplicator(UChunkReplicatorComponent* Replicator)
+{
+	Replicators.Remove(Replicator);
+}
+
+void UVoxelReplicationSubsystem::UpdateConnections()
+{
+	Replicators.RemoveAll([](const TWeakObjectPtr<UChunkReplicatorComponent>& Replicator) { return !Replicator.IsValid(); });
+
+	//a connection keeps its interest set while its players respawn, the client still has those chunks
+	Connections.RemoveAll([](const FConnectionState& State)
+	{
+		const UNetConnection* Connection = State.Connection.Get();
+		return Connection == nullptr || Connection->State == USOCK_Closed;
+	});
+
+	for (FConnectionState& State : Connections)
+	{
+		State.Replicators.Reset();
+	}
+
+	for (const TWeakObjectPtr<UChunkReplicatorComponent>& Replicator : Replicators)
+	{
+		//not possessed yet, or the listen server's own player who shares the server's world
+		UNetConnection* Connection = Replicator->GetClientConnection();
+		if (Connection == nullptr)
+		{
+			continue;
+		}
+
+		FConnectionState* State = Connections.FindByPredicate([Connection](const FConnectionState& Existing) { return Existing.Connection == Connection; });
+		if (State == nullptr)
+		{
+			State = &Connections.AddDefaulted_GetRef();
+			State->Connection = Connection;
+			State->SendingChunk = FIntPoint::ZeroValue;
+			State->SendingOffset = 0;
+			State->ByteAllowance = 0.0f;
+			State->BytesThisSecond = 0;
+			State->BytesPerSecond = 0.0f;
+		}
+		State->Replicators.Add(Replicator);
+	}
+
+	for (FConnectionState& State : Connections)
+	{
+		if (State.Replicators.Num() == 0)
+		{
+			continue;
+		}
+
+		TArray<FVector> Locations;
+		TArray<FRotator> Rotations;
+		for (const TWeakObjectPtr<UChunkReplicatorComponent>& Replicator : State.Replicators)
+		{
+			Replicator->GetView(Locations.AddDefaulted_GetRef(), Rotations.AddDefaulted_GetRef());
+		}
+		UpdateInterest(State, Locations, Rotations);
+	}
+}
+
+void UVoxelReplicationSubsystem::UpdateInterest(FConnectionState& State, const TArray<FVector>& Locations, const TArray<FRotator>& Rotations)
+{
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+
+	TArray<FIntVector> Keys;
+	State.ViewLocations.Reset();
+	State.ViewDirections.Reset();
+	for (int32 i = 0; i < Locations.Num(); ++i)
+	{
+		//in chunk units
+		const FVector Local = FVector(VoxelWorld->WorldToBlock(Locations[i])) / FChunkSection::Size;
+		State.ViewLocations.Add(FVector2D(Local.X, Local.Y));
+		State.ViewDirections.Add(FVector2D(Rotations[i].Vector()).GetSafeNormal());
+		Keys.Add(FIntVector(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y), FMath::FloorToInt(FRotator::ClampAxis(Rotations[i].Yaw) / 45.0f)));
+	}
+
+	//like streaming, the set only changes when a player crosses a chunk border or turns by an eighth
+	if (Keys == State.ViewKeys)
+	{
+		return;
+	}
+	State.ViewKeys = MoveTemp(Keys);
+
+	//a client can't be sent what the server doesn't load
+	const int32 Radius = FMath::Min(NetInterestRadius, VoxelWorld->GetStreamingRadius());
+	const int32 KeepRadius = Radius + NetInterestHysteresis;
+
+	auto IsWithin = [&State](const FIntPoint& ChunkCoord, int32 Within)
+	{
+		for (const FIntVector& Key : State.ViewKeys)
+		{
+			if ((ChunkCoord - FIntPoint(Key.X, Key.Y)).SizeSquared() <= Within * Within)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	TArray<FIntPoint> Left;
+	for (const TPair<FIntPoint, FChunkInterest>& Pair : State.Interest)
+	{
+		if (!IsWithin(Pair.Key, KeepRadius))
+		{
+			Left.Add(Pair.Key);
+		}
+	}
+	for (const FIntPoint& ChunkCoord : Left)
+	{
+		ForgetInterest(State, ChunkCoord);
+	}
+
+	const float Now = GetServerTime();
+	for (const FIntVector& Key : State.ViewKeys)
+	{
+		for (int32 Y = -Radius; Y <= Radius; ++Y)
+		{
+			for (int32 X = -Radius; X <= Radius; ++X)
+			{
+				const FIntPoint ChunkCoord(Key.X + X, Key.Y + Y);
+				if (X * X + Y * Y > Radius * Radius || State.Interest.Contains(ChunkCoord))
+				{
+					continue;
+				}
+
+				FChunkInterest& Interest = State.Interest.Add(ChunkCoord);
+				Interest.State = FChunkInterest::EState::Queued;
+				Interest.RelevantTime = Now;
+				Interest.NumResendRequests = 0;
+				State.SendQueue.Add(ChunkCoord);
+			}
+		}
+	}
+
+	//nearby chunks in front of a player first, chunks behind count as up to twice as far
+	for (const FIntPoint& ChunkCoord : State.SendQueue)
+	{
+		const FVector2D ChunkCenter(ChunkCoord.X + 0.5f, ChunkCoord.Y + 0.5f);
+
+		float Priority = MAX_flt;
+		for (int32 i = 0; i < State.ViewLocations.Num(); ++i)
+		{
+			const FVector2D Offset = ChunkCenter - State.ViewLocations[i];
+			const float Distance = Offset.Size();
+			const float Facing = Distance > KINDA_SMALL_NUMBER ? FVector2D::DotProduct(Offset / Distance, State.ViewDirections[i]) : 1.0f;
+			Priority = FMath::Min(Priority, Distance * (1.5f - 0.5f * Facing));
+		}
+		State.Interest[ChunkCoord].Priority = Priority;
+	}
+	SortSendQueue(State);
+}
+
+void UVoxelReplicationSubsystem::SendToConnection(FConnectionState& State, float DeltaTime)
+{
+	UChunkReplicatorComponent* Sender = State.Replicators.Num() > 0 ? State.Replicators[0].Get() : nullptr;
+	UNetConnection* Connection = State.Connection.Get();
+	if (Sender == nullptr || Connection == nullptr)
+	{
+		return;
+	}
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+
+	State.ByteAllowance = FMath::Min(State.ByteAllowance + BytesPerSecondPerConnection * DeltaTime, BytesPerSecondPerConnection * MaxBurstSeconds);
+
+	auto Charge = [&State](int32 Bytes)
+	{
+		State.ByteAllowance -= Bytes + RpcOverheadBytes;
+		State.BytesThisSecond += Bytes + RpcOverheadBytes;
+	};
+
+	//the reliable buffer overflowing would close the connection, so the net driver's own rate limit is respected too
+	auto CanSend = [&State, Connection]()
+	{
+		return State.ByteAllowance > 0.0f && Connection->IsNetReady(false) != 0;
+	};
+
+	//chunks the server unloaded under the client go back in the queue and are sent whole once they are back
+	bool bRequeued = false;
+	for (TPair<FIntPoint, FChunkInterest>& Pair : State.Interest)
+	{
+		if (Pair.Value.State != FChunkInterest::EState::Queued && !VoxelWorld->IsChunkTickable(Pair.Key))
+		{
+			RequeueChunk(State, Pair.Key, Pair.Value.Priority);
+			bRequeued = true;
+		}
+	}
+
+	//changes to chunks the client can see go before anything new
+	TArray<uint32> Deltas;
+	for (TPair<FIntPoint, FChunkInterest>& Pair : State.Interest)
+	{
+		FChunkInterest& Interest = Pair.Value;
+		if (Interest.State != FChunkInterest::EState::Sent || Interest.PendingDeltas.Num() == 0)
+		{
+			continue;
+		}
+
+		if (Interest.PendingDeltas.Num() > MaxDeltasPerChunk)
+		{
+			//ahead of every other queued chunk
+			RequeueChunk(State, Pair.Key, -1.0f);
+			bRequeued = true;
+			++Stats.NumFullResends;
+			continue;
+		}
+
+		if (!CanSend())
+		{
+			break;
+		}
+
+		Deltas.Reset(Interest.PendingDeltas.Num());
+		for (const TPair<uint16, FBlockID>& Delta : Interest.PendingDeltas)
+		{
+			Deltas.Add(PackBlockDelta(Delta.Key & 15, (Delta.Key >> 4) & 15, Delta.Key >> 8, Delta.Value));
+		}
+		Interest.PendingDeltas.Reset();
+
+		Sender->ClientReceiveBlockDeltas(Pair.Key, Deltas);
+		Charge(ChunkCoordBytes + Deltas.Num() * DeltaBytes);
+		Stats.NumDeltasSent += Deltas.Num();
+	}
+
+	if (bRequeued)
+	{
+		SortSendQueue(State);
+	}
+
+	//then whole chunks, a fragment at a time so one chunk can spread over several frames
+	while (CanSend())
+	{
+		if (!State.SendingData.IsValid())
+		{
+			//the most important queued chunk the server has loaded, the others wait for their terrain
+			const int32 Index = State.SendQueue.IndexOfByPredicate([VoxelWorld](const FIntPoint& ChunkCoord) { return VoxelWorld->IsChunkTickable(ChunkCoord); });
+			if (Index == INDEX_NONE)
+			{
+				break;
+			}
+
+			const FIntPoint ChunkCoord = State.SendQueue[Index];
+			State.SendQueue.RemoveAt(Index);
+
+			FChunkInterest& Interest = State.Interest[ChunkCoord];
+			Interest.State = FChunkInterest::EState::Sending;
+
+			//the capture below already holds every change made so far
+			Interest.PendingDeltas.Reset();
+
+			State.SendingChunk = ChunkCoord;
+			State.SendingData = GetCompressedChunk(ChunkCoord);
+			State.SendingOffset = 0;
+
+			Sender->ClientBeginChunk(ChunkCoord, State.SendingData->UncompressedSize, State.SendingData->Data.Num(), Interest.RelevantTime);
+			Charge(BeginChunkBytes);
+			continue;
+		}
+
+		const TArray<uint8>& Data = State.SendingData->Data;
+		const int32 Size = FMath::Min(MaxFragmentSize, Data.Num() - State.SendingOffset);
+		Sender->ClientReceiveChunkData(State.SendingChunk, TArray<uint8>(Data.GetData() + State.SendingOffset, Size));
+		Charge(ChunkCoordBytes + Size);
+
+		State.SendingOffset += Size;
+		if (State.SendingOffset >= Data.Num())
+		{
+			State.Interest[State.SendingChunk].State = FChunkInterest::EState::Sent;
+			State.SendingData.Reset();
+			++Stats.NumChunksSent;
+		}
+	}
+}
+
+void UVoxelReplicationSubsystem::OnBlockChanged(const FIntVector& BlockCoord, FBlockID Block)
+{
+	const FIntPoint ChunkCoord = UVoxelWorldSubsystem::BlockToChunk(BlockCoord);
+	const uint16 Index = (uint16)((BlockCoord.X & 15) | ((BlockCoord.Y & 15) << 4) | (BlockCoord.Z << 8));
+
+	for (FConnectionState& State : Connections)
+	{
+		//a queued chunk will be captured with the change already in it
+		FChunkInterest* Interest = State.Interest.Find(ChunkCoord);
+		if (Interest != nullptr && Interest->State != FChunkInterest::EState::Queued)
+		{
+			Interest->PendingDeltas.Add(Index, Block);
+		}
+	}
+}
+
+void UVoxelReplicationSubsystem::OnRegionEdited(const FVoxelRegionEdit& Edit)
+{
+	for (FConnectionState& State : Connections)
+	{
+		bool bRequeued = false;
+		for (int32 ChunkIndex = 0; ChunkIndex < Edit.Chunks.Num(); ++ChunkIndex)
+		{
+			const FIntPoint ChunkCoord = Edit.Chunks[ChunkIndex].Key;
+			FChunkInterest* Interest = State.Interest.Find(ChunkCoord);
+			if (Interest == nullptr || Interest->State == FChunkInterest::EState::Queued)
+			{
+				continue;
+			}
+
+			const int32 First = Edit.Chunks[ChunkIndex].Value;
+			const int32 End = Edit.GetChunkEnd(ChunkIndex);
+			if (Interest->PendingDeltas.Num() + End - First > MaxDeltasPerChunk)
+			{
+				RequeueChunk(State, ChunkCoord, -1.0f);
+				bRequeued = true;
+				++Stats.NumFullResends;
+				continue;
+			}
+
+			for (int32 Index = First; Index < End; ++Index)
+			{
+				const FVoxelBlockChange& Change = Edit.Changes[Index];
+				const uint16 BlockIndex = (uint16)((Change.BlockCoord.X & 15) | ((Change.BlockCoord.Y & 15) << 4) | (Change.BlockCoord.Z << 8));
+				Interest->PendingDeltas.Add(BlockIndex, Change.NewBlock);
+			}
+		}
+
+		if (bRequeued)
+		{
+			SortSendQueue(State);
+		}
+	}
+}
+
+void UVoxelReplicationSubsystem::ForgetInterest(FConnectionState& State, const FIntPoint& ChunkCoord)
+{
+	const FChunkInterest* Interest = State.Interest.Find(ChunkCoord);
+	if (Interest == nullptr)
+	{
+		return;
+	}
+
+	if (Interest->State != FChunkInterest::EState::Queued)
+	{
+		if (UChunkReplicatorComponent* Sender = State.Replicators.Num() > 0 ? State.Replicators[0].Get() : nullptr)
+		{
+			Sender->ClientForgetChunk(ChunkCoord);
+		}
+
+		if (State.SendingData.IsValid() && State.SendingChunk == ChunkCoord)
+		{
+			State.SendingData.Reset();
+		}
+	}
+
+	State.Interest.Remove(ChunkCoord);
+	State.SendQueue.Remove(ChunkCoord);
+}
+
+void UVoxelReplicationSubsystem::RequeueChunk(FConnectionState& State, const FIntPoint& ChunkCoord, float Priority)
+{
+	FChunkInterest& Interest = State.Interest[ChunkCoord];
+	Interest.State = FChunkInterest::EState::Queued;
+	Interest.RelevantTime = GetServerTime();
+	Interest.Priority = Priority;
+	Interest.PendingDeltas.Reset();
+
+	//the client drops the fragments it has when the chunk begins again
+	if (State.SendingData.IsValid() && State.SendingChunk == ChunkCoord)
+	{
+		State.SendingData.Reset();
+	}
+
+	State.SendQueue.Add(ChunkCoord);
+}
+
+void UVoxelReplicationSubsystem::ResendChunk(UChunkReplicatorComponent* Replicator, const FIntPoint& ChunkCoord)
+{
+	const UNetConnection* Connection = Replicator != nullptr ? Replicator->GetClientConnection() : nullptr;
+	FConnectionState* State = Connection != nullptr ? Connections.FindByPredicate([Connection](const FConnectionState& Existing) { return Existing.Connection == Connection; }) : nullptr;
+	FChunkInterest* Interest = State != nullptr ? State->Interest.Find(ChunkCoord) : nullptr;
+
+	//already on its way again, or out of interest by now
+	if (Interest == nullptr || Interest->State == FChunkInterest::EState::Queued)
+	{
+		return;
+	}
+
+	if (Interest->NumResendRequests >= MaxResendRequests)
+	{
+		UE_LOG(LogVoxelReplication, Warning, TEXT("Chunk (%d, %d) was asked for again %d times, not resending it"), ChunkCoord.X, ChunkCoord.Y, Interest->NumResendRequests);
+		return;
+	}
+
+	++Interest->NumResendRequests;
+	++Stats.NumFullResends;
+	RequeueChunk(*State, ChunkCoord, Interest->Priority);
+	SortSendQueue(*State);
+}
+
+void UVoxelReplicationSubsystem::SortSendQueue(FConnectionState& State)
+{
+	const TMap<FIntPoint, FChunkInterest>& Interest = State.Interest;
+	State.SendQueue.Sort([&Interest](const FIntPoint& A, const FIntPoint& B)
+	{
+		return Interest[A].Priority < Interest[B].Priority;
+	});
+}
+
+TSharedPtr<const UVoxelReplicationSubsystem::FCompressedChunk> UVoxelReplicationSubsystem::GetCompressedChunk(const FIntPoint& ChunkCoord)
+{
+	FChunk* Chunk = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->FindChunk(ChunkCoord);
+	check(Chunk != nullptr);
+
+	TSharedPtr<const FCompressedChunk>& Cached = CompressedChunks.FindOrAdd(ChunkCoord);
+	if (Cached.IsValid() && Cached->Revision == Chunk->GetRevision())
+	{
+		return Cached;
+	}
+
+	TArray<uint8> Uncompressed;
+	FMemoryWriter Writer(Uncompressed);
+	Chunk->Serialize(Writer);
+
+	TSharedPtr<FCompressedChunk> Compressed = MakeShared<FCompressedChunk>();
+	Compressed->Revision = Chunk->GetRevision();
+	Compressed->UncompressedSize = Uncompressed.Num();
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Uncompressed.Num());
+	Compressed->Data.SetNumUninitialized(CompressedSize);
+
+	//sent as is when compressing doesn't help, the client tells by the two sizes being equal
+	if (FCompression::CompressMemory(NAME_Zlib, Compressed->Data.GetData(), CompressedSize, Uncompressed.GetData(), Uncompressed.Num()) && CompressedSize < Uncompressed.Num())
+	{
+		Compressed->Data.SetNum(CompressedSize, false);
+	}
+	else
+	{
+		Compressed->Data = MoveTemp(Uncompressed);
+	}
+
+	Cached = Compressed;
+	return Cached;
+}
+
+void UVoxelReplicationSubsystem::BeginChunk(UChunkReplicatorComponent& Replicator, const FIntPoint& ChunkCoord, int32 UncompressedSize, int32 CompressedSize, float RelevantTime)
+{
+	BytesReceivedThisSecond += BeginChunkBytes;
+
+	if (UncompressedSize <= 0 || UncompressedSize > MaxUncompressedChunkSize || CompressedSize <= 0 || CompressedSize > UncompressedSize)
+	{
+		UE_LOG(LogVoxelReplication, Warning, TEXT("Chunk (%d, %d) announced with bad sizes %d / %d"), ChunkCoord.X, ChunkCoord.Y, CompressedSize, UncompressedSize);
+		IncomingChunks.Remove(ChunkCoord);
+		Replicator.ServerRequestChunk(ChunkCoord);
+		return;
+	}
+
+	//starts over if an earlier copy of the chunk was cut off
+	FIncomingChunk& Incoming = IncomingChunks.Add(ChunkCoord);
+	Incoming.UncompressedSize = UncompressedSize;
+	Incoming.CompressedSize = CompressedSize;
+	Incoming.RelevantTime = RelevantTime;
+	Incoming.Data.Reserve(CompressedSize);
+}
+
+void UVoxelReplicationSubsystem::ReceiveChunkData(UChunkReplicatorComponent& Replicator, const FIntPoint& ChunkCoord, const TArray<uint8>& Data)
+{
+	BytesReceivedThisSecond += ChunkCoordBytes + Data.Num();
+
+	FIncomingChunk* Incoming = IncomingChunks.Find(ChunkCoord);
+	if (Incoming == nullptr)
+	{
+		return;
+	}
+
+	if (Incoming->Data.Num() + Data.Num() > Incoming->CompressedSize)
+	{
+		UE_LOG(LogVoxelReplication, Warning, TEXT("Chunk (%d, %d) received more data than announced"), ChunkCoord.X, ChunkCoord.Y);
+		IncomingChunks.Remove(ChunkCoord);
+		Replicator.ServerRequestChunk(ChunkCoord);
+		return;
+	}
+
+	Incoming->Data.Append(Data);
+
+	//the server sends it whole again rather than leave a hole in the world
+	if (Incoming->Data.Num() == Incoming->CompressedSize && !FinishChunk(ChunkCoord))
+	{
+		Replicator.ServerRequestChunk(ChunkCoord);
+	}
+}
+
+bool UVoxelReplicationSubsystem::FinishChunk(const FIntPoint& ChunkCoord)
+{
+	FIncomingChunk Incoming = IncomingChunks.FindAndRemoveChecked(ChunkCoord);
+
+	TArray<uint8> Uncompressed;
+	if (Incoming.CompressedSize == Incoming.UncompressedSize)
+	{
+		Uncompressed = MoveTemp(Incoming.Data);
+	}
+	else
+	{
+		Uncompressed.SetNumUninitialized(Incoming.UncompressedSize);
+		if (!FCompression::UncompressMemory(NAME_Zlib, Uncompressed.GetData(), Incoming.UncompressedSize, Incoming.Data.GetData(), Incoming.CompressedSize))
+		{
+			UE_LOG(LogVoxelReplication, Warning, TEXT("Chunk (%d, %d) failed to decompress"), ChunkCoord.X, ChunkCoord.Y);
+			return false;
+		}
+	}
+
+	TUniquePtr<FChunk> Chunk = MakeUnique<FChunk>(ChunkCoord);
+	FMemoryReader Reader(Uncompressed);
+	if (!Chunk->Serialize(Reader))
+	{
+		UE_LOG(LogVoxelReplication, Warning, TEXT("Chunk (%d, %d) couldn't be read"), ChunkCoord.X, ChunkCoord.Y);
+		return false;
+	}
+
+	GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->ApplyReplicatedChunk(MoveTemp(Chunk));
+
+	const float TimeToVisible = FMath::Max(0.0f, GetServerTime() - Incoming.RelevantTime);
+	++Stats.NumChunksReceived;
+	TimeToVisibleSum += TimeToVisible;
+	Stats.AverageTimeToVisible = (float)(TimeToVisibleSum / Stats.NumChunksReceived);
+	Stats.MaxTimeToVisible = FMath::Max(Stats.MaxTimeToVisible, TimeToVisible);
+	return true;
+}
+
+void UVoxelReplicationSubsystem::ReceiveBlockDeltas(const FIntPoint& ChunkCoord, const TArray<uint32>& Deltas)
+{
+	BytesReceivedThisSecond += ChunkCoordBytes + Deltas.Num() * DeltaBytes;
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr || VoxelWorld->FindChunk(ChunkCoord) == nullptr)
+	{
+		return;
+	}
+
+	const FIntVector ChunkOrigin(ChunkCoord.X * FChunkSection::Size, ChunkCoord.Y * FChunkSection::Size, 0);
+	for (uint32 Delta : Deltas)
+	{
+		VoxelWorld->SetBlock(ChunkOrigin + UnpackDeltaCoord(Delta), UnpackDeltaBlock(Delta));
+	}
+	Stats.NumDeltasReceived += Deltas.Num();
+}
+
+void UVoxelReplicationSubsystem::ForgetChunk(const FIntPoint& ChunkCoord)
+{
+	IncomingChunks.Remove(ChunkCoord);
+
+	if (UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>())
+	{
+		VoxelWorld->UnloadChunk(ChunkCoord);
+	}
+}
+
+float UVoxelReplicationSubsystem::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState != nullptr ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void UVoxelReplicationSubsystem::LogStats() const
+{
+	const UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld != nullptr && VoxelWorld->IsNetClient())
+	{
+		UE_LOG(LogVoxelReplication, Display, TEXT("Client: %.1f KB/s received, %d chunks and %d block deltas received, time to visible %.0f ms average, %.0f ms worst, %d chunks arriving"),
+			Stats.BytesReceivedPerSecond / 1024.0f, Stats.NumChunksReceived, Stats.NumDeltasReceived,
+			Stats.AverageTimeToVisible * 1000.0f, Stats.MaxTimeToVisible * 1000.0f, IncomingChunks.Num());
+		return;
+	}
+
+	UE_LOG(LogVoxelReplication, Display, TEXT("Server: %d connections, %.1f KB/s sent, %d chunks queued, %d chunks and %d block deltas sent, %d full resends"),
+		Stats.NumConnections, Stats.BytesSentPerSecond / 1024.0f, Stats.NumQueuedChunks, Stats.NumChunksSent, Stats.NumDeltasSent, Stats.NumFullResends);
+
+	for (const FConnectionState& State : Connections)
+	{
+		UNetConnection* Connection = State.Connection.Get();
+		UE_LOG(LogVoxelReplication, Display, TEXT("  %s: %d players, %d chunks of interest, %d queued, %.1f KB/s"),
+			Connection != nullptr ? *Connection->LowLevelDescribe() : TEXT("closed"), State.Replicators.Num(), State.Interest.Num(), State.SendQueue.Num(), State.BytesPerSecond / 1024.0f);
+	}
+}
@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "BlockTypes.h"
+#include "VoxelReplicationSubsystem.generated.h"
+
+class UChunkReplicatorComponent;
+class UNetConnection;
+struct FVoxelRegionEdit;
+
+//what chunk replication did over the last second
+struct FVoxelNetStats
+{
+	//server side, summed over every connection
+	int32 NumConnections;
+	int32 NumQueuedChunks;
+	float BytesSentPerSecond;
+
+	//client side
+	float BytesReceivedPerSecond;
+
+	//seconds between the server wanting a chunk on the client and the client installing it
+	float AverageTimeToVisible;
+	float MaxTimeToVisible;
+
+	//totals since the world started
+	int32 NumChunksSent;
+	int32 NumChunksReceived;
+	int32 NumDeltasSent;
+	int32 NumDeltasReceived;
+	int32 NumFullResends;
+};
+
+//keeps the block data of every client in sync with the server
+//the server gives each connection an interest set of the chunks within NetInterestRadius of its players,
+//sends each chunk in it once, compressed and split into fragments, then only the blocks that change in it
+//every connection has a byte budget per second, changes to chunks the client has go first,
+//then the missing chunks nearest to and in front of its players
+//clients install what they receive and never load or generate chunks themselves
+UCLASS(config=Game)
+class MCUE_API UVoxelReplicationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	//largest piece of a chunk sent in one rpc
+	static constexpr int32 MaxFragmentSize = 1024;
+
+	UVoxelReplicationSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//server side, every remotely owned pawn's replicator registers itself
+	void AddReplicator(UChunkReplicatorComponent* Replicator);
+	void RemoveReplicator(UChunkReplicatorComponent* Replicator);
+
+	//server side, the client couldn't use a chunk it was sent, it goes back in the queue to be sent whole
+	void ResendChunk(UChunkReplicatorComponent* Replicator, const FIntPoint& ChunkCoord);
+
+	//client side, called by the replicator rpcs
+	//a chunk that arrives broken is asked for again through Replicator
+	void BeginChunk(UChunkReplicatorComponent& Replicator, const FIntPoint& ChunkCoord, int32 UncompressedSize, int32 CompressedSize, float RelevantTime);
+	void ReceiveChunkData(UChunkReplicatorComponent& Replicator, const FIntPoint& ChunkCoord, const TArray<uint8>& Data);
+	void ReceiveBlockDeltas(const FIntPoint& ChunkCoord, const TArray<uint32>& Deltas);
+	void ForgetChunk(const FIntPoint& ChunkCoord);
+
+	const FVoxelNetStats& GetStats() const { return Stats; }
+
+	//writes the stats, and on the server every connection's, to the log
+	void LogStats() const;
+
+	//one block change as it goes over the wire: local x, y and z in the high half, the block in the low half
+	static uint32 PackBlockDelta(int32 X, int32 Y, int32 Z, FBlockID Block) { return (uint32)(X | (Y << 4) | (Z << 8)) << 16 | Block; }
+	static FIntVector UnpackDeltaCoord(uint32 Delta) { return FIntVector((int32)(Delta >> 16) & 15, (int32)(Delta >> 20) & 15, (int32)(Delta >> 24)); }
+	static FBlockID UnpackDeltaBlock(uint32 Delta) { return (FBlockID)(Delta & 0xFFFF); }
+
+private:
+	//one chunk in a connection's interest set
+	struct FChunkInterest
+	{
+		enum class EState : uint8
+		{
+			//waiting for budget, or for the server to load it
+			Queued,
+			//some fragments are out
+			Sending,
+			//the client has it, changes follow as deltas
+			Sent
+		};
+
+		EState State;
+
+		//server time it entered the interest set
+		float RelevantTime;
+
+		//lower goes sooner
+		float Priority;
+
+		//changes since the chunk was captured for sending, by local block index
+		TMap<uint16, FBlockID> PendingDeltas;
+
+		//times the client asked for the chunk again, capped so a chunk that never arrives whole isn't sent forever
+		uint8 NumResendRequests;
+	};
+
+	//a chunk compressed once at a revision and shared by every connection that needs it
+	struct FCompressedChunk
+	{
+		uint32 Revision;
+		int32 UncompressedSize;
+		TArray<uint8> Data;
+	};
+
+	struct FConnectionState
+	{
+		TWeakObjectPtr<UNetConnection> Connection;
+
+		//the pawns of this connection's players, the first one carries the rpcs
+		TArray<TWeakObjectPtr<UChunkReplicatorComponent>> Replicators;
+
+		//view chunk and yaw octant of every player, the interest set is rebuilt when one changes
+		TArray<FIntVector> ViewKeys;
+		TArray<FVector2D> ViewLocations;
+		TArray<FVector2D> ViewDirections;
+
+		TMap<FIntPoint, FChunkInterest> Interest;
+
+		//queued chunks, most important first
+		TArray<FIntPoint> SendQueue;
+
+		//the chunk whose fragments are going out
+		FIntPoint SendingChunk;
+		TSharedPtr<const FCompressedChunk> SendingData;
+		int32 SendingOffset;
+
+		//bytes that may still be sent, refilled every tick and capped so an idle connection can't save up a burst
+		float ByteAllowance;
+
+		int32 BytesThisSecond;
+		float BytesPerSecond;
+	};
+
+	//server side
+	void UpdateConnections();
+	void UpdateInterest(FConnectionState& State, const TArray<FVector>& Locations, const TArray<FRotator>& Rotations);
+	void SendToConnection(FConnectionState& State, float DeltaTime);
+	void OnBlockChanged(const FIntVector& BlockCoord, FBlockID Block);
+
+	//a chunk that changed in too many blocks to send as deltas goes straight back in the queue to be sent whole
+	void OnRegionEdited(const FVoxelRegionEdit& Edit);
+	void ForgetInterest(FConnectionState& State, const FIntPoint& ChunkCoord);
+
+	//puts the chunk back in the queue to be sent whole, replacing whatever the client has
+	void RequeueChunk(FConnectionState& State, const FIntPoint& ChunkCoord, float Priority);
+
+	static void SortSendQueue(FConnectionState& State);
+
+	//the chunk compressed at its current revision, from the cache if it hasn't changed
+	TSharedPtr<const FCompressedChunk> GetCompressedChunk(const FIntPoint& ChunkCoord);
+
+	//client side, returns false if the chunk couldn't be read
+	bool FinishChunk(const FIntPoint& ChunkCoord);
+
+	//server time, the same clock on both sides
+	float GetServerTime() const;
+
+	TArray<TWeakObjectPtr<UChunkReplicatorComponent>> Replicators;
+
+	TArray<FConnectionState> Connections;
+
+	TMap<FIntPoint, TSharedPtr<const FCompressedChunk>> CompressedChunks;
+
+	struct FIncomingChunk
+	{
+		int32 UncompressedSize;
+		int32 CompressedSize;
+		float RelevantTime;
+		TArray<uint8> Data;
+	};
+
+	//chunks whose fragments are still arriving
+	TMap<FIntPoint, FIncomingChunk> IncomingChunks;
+
+	FVoxelNetStats Stats;
+
+	//gathered over the current second, then turned into rates
+	float StatsTimer;
+	int32 BytesReceivedThisSecond;
+	double TimeToVisibleSum;
+	float LogTimer;
+
+	//chunks within this many chunks of a player are sent to its client, capped by the server's streaming radius
+	UPROPERTY(config)
+	int32 NetInterestRadius;
+
+	//extra chunks past the interest radius a chunk may be before the client is told to drop it
+	UPROPERTY(config)
+	int32 NetInterestHysteresis;
+
+	//budget for each connection, every rpc is charged its payload plus a rough header
+	UPROPERTY(config)
+	float BytesPerSecondPerConnection;
+
+	//most seconds of budget a connection can have unspent
+	UPROPERTY(config)
+	float MaxBurstSeconds;
+
+	//a chunk with more pending changes than this is sent whole again, usually smaller than the deltas by then
+	UPROPERTY(config)
+	int32 MaxDeltasPerChunk;
+
+	//seconds between stats lines in the log, zero for none
+	UPROPERTY(config)
+	float StatsLogInterval;
+};
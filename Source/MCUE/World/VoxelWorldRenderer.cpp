@@ -0,0 +1,462 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelWorldRenderer.h"
+#include "VoxelWorldSubsystem.h"
+#include "ChunkCollision.h"
+#include "VoxelCollisionComponent.h"
+#include "MCUEStats.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Materials/Material.h"
+#include "ProceduralMeshComponent.h"
+#include "UObject/ConstructorHelpers.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelRenderer, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Renderer Tick"), STAT_VoxelRendererTick, STATGROUP_VoxelWorld);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Collision Bodies"), STAT_VoxelCollisionBodies, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Collision Build Time (us)"), STAT_VoxelCollisionBuildMicroseconds, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Section Pool Hits"), STAT_VoxelSectionPoolHits, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Section Pool Misses"), STAT_VoxelSectionPoolMisses, STATGROUP_VoxelWorld);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Section Components"), STAT_VoxelPooledSectionComponents, STATGROUP_VoxelWorld);
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarPoolSectionComponents(
+		TEXT("mcue.PoolSectionComponents"),
+		1,
+		TEXT("Reuse chunk section mesh and collision components instead of destroying them. 0 turns the pool off, for comparing."));
+}
+
+AVoxelWorldRenderer::AVoxelWorldRenderer()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	FinishedMeshes = MakeShared<FMeshResultQueue, ESPMode::ThreadSafe>();
+
+	NextGeneration = 0;
+
+	CrackOverlay = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("CrackOverlay"));
+	CrackOverlay->SetupAttachment(RootComponent);
+	CrackOverlay->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	CrackOverlay->SetCastShadow(false);
+	CrackOverlay->NumCustomDataFloats = 1;
+
+	//the engine cube is one block in size with its pivot in the middle
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> CubeMesh(TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (CubeMesh.Succeeded())
+	{
+		CrackOverlay->SetStaticMesh(CubeMesh.Object);
+	}
+
+	CrackMaterial = nullptr;
+	CrackRevision = 0;
+
+	NumPrewarmedSections = 128;
+	MaxPooledSections = 512;
+	PoolStats = FSectionPoolStats();
+}
+
+void AVoxelWorldRenderer::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (CrackMaterial == nullptr)
+	{
+		UE_LOG(LogVoxelRenderer, Warning, TEXT("%s has no CrackMaterial, damaged blocks won't show cracks. Set one on the renderer class or under [/Script/MCUE.VoxelWorldRenderer] in DefaultGame.ini"), *GetClass()->GetName());
+	}
+
+	//a load screen pays for these instead of the first seconds of streaming
+	const int32 NumPrewarmed = FMath::Min(NumPrewarmedSections, MaxPooledSections);
+	FreeMeshes.Reserve(NumPrewarmed);
+	FreeColliders.Reserve(NumPrewarmed);
+	for (int32 i = 0; i < NumPrewarmed; ++i)
+	{
+		FreeMeshes.Add(CreateMeshComponent());
+		FreeColliders.Add(CreateCollider());
+	}
+	SET_DWORD_STAT(STAT_VoxelPooledSectionComponents, FreeMeshes.Num() + FreeColliders.Num());
+}
+
+void AVoxelWorldRenderer::Tick(float DeltaTime)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_VoxelRendererTick, MCUEWorld);
+
+	Super::Tick(DeltaTime);
+
+	UVoxelWorldSubsystem* VoxelWorld = GetWorld()->GetSubsystem<UVoxelWorldSubsystem>();
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
+
+	//gathers and uploads share the streaming budget with the chunks themselves
+	double StartTime = FPlatformTime::Seconds();
+	DispatchDirtySections(*VoxelWorld, VoxelWorld->GetStreamingBudgetLeft());
+	VoxelWorld->AddStreamingTime(FPlatformTime::Seconds() - StartTime);
+
+	UpdateCracks(*VoxelWorld);
+
+	StartTime = FPlatformTime::Seconds();
+	ApplyFinishedMeshes(VoxelWorld->GetStreamingBudgetLeft());
+	VoxelWorld->AddStreamingTime(FPlatformTime::Seconds() - StartTime);
+}
+
+void AVoxelWorldRenderer::RemoveChunk(const FIntPoint& ChunkCoord)
+{
+	for (int32 Section = 0; Section < FChunk::NumSections; ++Section)
+	{
+		const FIntVector SectionCoord(ChunkCoord.X, ChunkCoord.Y, Section);
+
+		UProceduralMeshComponent* MeshComponent = nullptr;
+		if (SectionMeshes.RemoveAndCopyValue(SectionCoord, MeshComponent) && MeshComponent != nullptr)
+		{
+			ReleaseMeshComponent(MeshComponent);
+		}
+
+		UVoxelCollisionComponent* Collider = nullptr;
+		if (SectionColliders.RemoveAndCopyValue(SectionCoord, Collider) && Collider != nullptr)
+		{
+			DEC_DWORD_STAT_BY(STAT_VoxelCollisionBodies, Collider->GetNumBodies());
+			ReleaseCollider(Collider);
+		}
+
+		//without a generation on record any result still in flight counts as stale
+		SectionGenerations.Remove(SectionCoord);
+	}
+}
+
+void AVoxelWorldRenderer::SetDefaultBlockMaterial(FBlockID Block, UMaterialInterface* Material)
+{
+	if (BlockMaterials.Num() <= Block)
+	{
+		BlockMaterials.SetNumZeroed(Block + 1);
+	}
+
+	if (BlockMaterials[Block] == nullptr)
+	{
+		BlockMaterials[Block] = Material;
+	}
+}
+
+int32 AVoxelWorldRenderer::DispatchDirtySections(UVoxelWorldSubsystem& VoxelWorld, double BudgetSeconds)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<FIntVector> DirtySections;
+	VoxelWorld.ConsumeDirtySections(DirtySections);
+	for (const FIntVector& SectionCoord : DirtySections)
+	{
+		bool bAlreadyPending = false;
+		PendingSectionSet.Add(SectionCoord, &bAlreadyPending);
+		if (!bAlreadyPending)
+		{
+			PendingSections.Add(SectionCoord);
+		}
+	}
+
+	int32 NumConsumed = 0;
+	int32 NumDispatched = 0;
+	while (NumConsumed < PendingSections.Num() && (NumDispatched == 0 || FPlatformTime::Seconds() - StartTime < BudgetSeconds))
+	{
+		const FIntVector SectionCoord = PendingSections[NumConsumed++];
+		PendingSectionSet.Remove(SectionCoord);
+
+		//the chunk may have streamed out while the section waited its turn
+		const FChunk* Chunk = VoxelWorld.FindChunk(FIntPoint(SectionCoord.X, SectionCoord.Y));
+		if (Chunk == nullptr)
+		{
+			continue;
+		}
+
+		//faces and boxes only come from blocks inside the section, an empty one builds nothing whatever its neighbours hold
+		//so there is nothing to gather, any components it had are released straight away
+		if (Chunk->GetSection(SectionCoord.Z).IsEmpty())
+		{
+			SectionGenerations.Add(SectionCoord, ++NextGeneration);
+
+			FChunkMeshData Empty;
+			Empty.SectionCoord = SectionCoord;
+			Empty.Generation = NextGeneration;
+			Empty.CollisionBuildMicroseconds = 0.0f;
+			ApplyMesh(Empty);
+			ApplyCollision(Empty);
+			continue;
+		}
+
+		TUniquePtr<FChunkMeshInput> Input = MakeUnique<FChunkMeshInput>();
+		Input->Gather(VoxelWorld, SectionCoord);
+		Input->Generation = ++NextGeneration;
+		SectionGenerations.Add(SectionCoord, Input->Generation);
+		++NumDispatched;
+
+		TSharedPtr<FMeshResultQueue, ESPMode::ThreadSafe> Results = FinishedMeshes;
+		FFunctionGraphTask::CreateAndDispatchWhenReady([Input = MoveTemp(Input), Results]()
+		{
+			FChunkMeshData Mesh;
+			FChunkMesher::Build(*Input, Mesh);
+
+			const double CollisionStartTime = FPlatformTime::Seconds();
+			FChunkCollisionBuilder::Build(*Input, Mesh.CollisionBoxes);
+			Mesh.CollisionBuildMicroseconds = (float)((FPlatformTime::Seconds() - CollisionStartTime) * 1.0e6);
+
+			Results->Enqueue(MoveTemp(Mesh));
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+	PendingSections.RemoveAt(0, NumConsumed, false);
+
+	return NumDispatched;
+}
+
+int32 AVoxelWorldRenderer::ApplyFinishedMeshes(double BudgetSeconds)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	int32 NumApplied = 0;
+	FChunkMeshData Mesh;
+	while ((NumApplied == 0 || FPlatformTime::Seconds() - StartTime < BudgetSeconds) && FinishedMeshes->Dequeue(Mesh))
+	{
+		//a newer snapshot of this section is on its way, this one is already out of date
+		const uint32* LatestGeneration = SectionGenerations.Find(Mesh.SectionCoord);
+		if (LatestGeneration == nullptr || *LatestGeneration != Mesh.Generation)
+		{
+			continue;
+		}
+
+		ApplyMesh(Mesh);
+		ApplyCollision(Mesh);
+		++NumApplied;
+	}
+	return NumApplied;
+}
+
+void AVoxelWorldRenderer::ApplyMesh(const FChunkMeshData& Mesh)
+{
+	UProceduralMeshComponent** Existing = SectionMeshes.Find(Mesh.SectionCoord);
+
+	if (Mesh.Batches.Num() == 0)
+	{
+		if (Existing != nullptr)
+		{
+			ReleaseMeshComponent(*Existing);
+			SectionMeshes.Remove(Mesh.SectionCoord);
+		}
+		return;
+	}
+
+	UProceduralMeshComponent* MeshComponent = Existing != nullptr ? *Existing : nullptr;
+	if (MeshComponent == nullptr)
+	{
+		MeshComponent = AcquireMeshComponent(Mesh.SectionCoord);
+		SectionMeshes.Add(Mesh.SectionCoord, MeshComponent);
+	}
+
+	MeshComponent->ClearAllMeshSections();
+
+	const TArray<FProcMeshTangent> NoTangents;
+	for (int32 i = 0; i < Mesh.Batches.Num(); ++i)
+	{
+		const FChunkMeshBatch& Batch = Mesh.Batches[i];
+		MeshComponent->CreateMeshSection(i, Batch.Vertices, Batch.Triangles, Batch.Normals, Batch.UVs, Batch.Colors, NoTangents, false);
+		MeshComponent->SetMaterial(i, GetBlockMaterial(Batch.Block));
+	}
+}
+
+void AVoxelWorldRenderer::ApplyCollision(const FChunkMeshData& Mesh)
+{
+	UVoxelCollisionComponent** Existing = SectionColliders.Find(Mesh.SectionCoord);
+	UVoxelCollisionComponent* Collider = Existing != nullptr ? *Existing : nullptr;
+
+	if (Collider != nullptr)
+	{
+		DEC_DWORD_STAT_BY(STAT_VoxelCollisionBodies, Collider->GetNumBodies());
+	}
+
+	if (Mesh.CollisionBoxes.Num() == 0)
+	{
+		if (Collider != nullptr)
+		{
+			ReleaseCollider(Collider);
+			SectionColliders.Remove(Mesh.SectionCoord);
+		}
+		return;
+	}
+
+	if (Collider == nullptr)
+	{
+		Collider = AcquireCollider(Mesh.SectionCoord);
+		SectionColliders.Add(Mesh.SectionCoord, Collider);
+	}
+
+	Collider->SetBoxes(Mesh.CollisionBoxes, Mesh.CollisionBuildMicroseconds);
+
+	INC_DWORD_STAT_BY(STAT_VoxelCollisionBodies, Mesh.CollisionBoxes.Num());
+	SET_FLOAT_STAT(STAT_VoxelCollisionBuildMicroseconds, Mesh.CollisionBuildMicroseconds);
+
+	UE_LOG(LogVoxelRenderer, Verbose, TEXT("Section (%d, %d, %d): %d collision boxes, merged in %.1f us"),
+		Mesh.SectionCoord.X, Mesh.SectionCoord.Y, Mesh.SectionCoord.Z, Mesh.CollisionBoxes.Num(), Mesh.CollisionBuildMicroseconds);
+}
+
+UProceduralMeshComponent* AVoxelWorldRenderer::AcquireMeshComponent(const FIntVector& SectionCoord)
+{
+	UProceduralMeshComponent* MeshComponent = nullptr;
+	if (FreeMeshes.Num() > 0 && CVarPoolSectionComponents.GetValueOnGameThread() != 0)
+	{
+		MeshComponent = FreeMeshes.Pop(false);
+		MeshComponent->SetVisibility(true);
+		++PoolStats.Hits;
+		INC_DWORD_STAT(STAT_VoxelSectionPoolHits);
+		DEC_DWORD_STAT(STAT_VoxelPooledSectionComponents);
+	}
+	else
+	{
+		MeshComponent = CreateMeshComponent();
+		++PoolStats.Misses;
+		INC_DWORD_STAT(STAT_VoxelSectionPoolMisses);
+	}
+
+	const FIntVector BlockOrigin(SectionCoord.X * FChunkSection::Size, SectionCoord.Y * FChunkSection::Size, SectionCoord.Z * FChunkSection::Size);
+	MeshComponent->SetWorldLocation(GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->BlockToWorld(BlockOrigin));
+	return MeshComponent;
+}
+
+UVoxelCollisionComponent* AVoxelWorldRenderer::AcquireCollider(const FIntVector& SectionCoord)
+{
+	UVoxelCollisionComponent* Collider = nullptr;
+	if (FreeColliders.Num() > 0 && CVarPoolSectionComponents.GetValueOnGameThread() != 0)
+	{
+		Collider = FreeColliders.Pop(false);
+		++PoolStats.Hits;
+		INC_DWORD_STAT(STAT_VoxelSectionPoolHits);
+		DEC_DWORD_STAT(STAT_VoxelPooledSectionComponents);
+	}
+	else
+	{
+		Collider = CreateCollider();
+		++PoolStats.Misses;
+		INC_DWORD_STAT(STAT_VoxelSectionPoolMisses);
+	}
+
+	//the boxes set right after this move with it, it has no body until then
+	const FIntVector BlockOrigin(SectionCoord.X * FChunkSection::Size, SectionCoord.Y * FChunkSection::Size, SectionCoord.Z * FChunkSection::Size);
+	Collider->SetWorldLocation(GetWorld()->GetSubsystem<UVoxelWorldSubsystem>()->BlockToWorld(BlockOrigin));
+	return Collider;
+}
+
+void AVoxelWorldRenderer::ReleaseMeshComponent(UProceduralMeshComponent* MeshComponent)
+{
+	if (FreeMeshes.Num() >= MaxPooledSections || CVarPoolSectionComponents.GetValueOnGameThread() == 0)
+	{
+		++PoolStats.Overflows;
+		MeshComponent->DestroyComponent();
+		return;
+	}
+
+	//drops the vertex buffers, an empty component costs no draw calls
+	MeshComponent->ClearAllMeshSections();
+	MeshComponent->SetVisibility(false);
+	FreeMeshes.Add(MeshComponent);
+	INC_DWORD_STAT(STAT_VoxelPooledSectionComponents);
+}
+
+void AVoxelWorldRenderer::ReleaseCollider(UVoxelCollisionComponent* Collider)
+{
+	if (FreeColliders.Num() >= MaxPooledSections || CVarPoolSectionComponents.GetValueOnGameThread() == 0)
+	{
+		++PoolStats.Overflows;
+		Collider->DestroyComponent();
+		return;
+	}
+
+	//an empty body keeps the physics scene from holding on to the old boxes
+	Collider->SetBoxes(TArray<FBox>(), 0.0f);
+	FreeColliders.Add(Collider);
+	INC_DWORD_STAT(STAT_VoxelPooledSectionComponents);
+}
+
+UProceduralMeshComponent* AVoxelWorldRenderer::CreateMeshComponent()
+{
+	//collision lives on a separate component made of merged boxes, the mesh itself never cooks any
+	UProceduralMeshComponent* MeshComponent = NewObject<UProceduralMeshComponent>(this);
+	MeshComponent->SetupAttachment(RootComponent);
+	MeshComponent->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	MeshComponent->RegisterComponent();
+	return MeshComponent;
+}
+
+UVoxelCollisionComponent* AVoxelWorldRenderer::CreateCollider()
+{
+	UVoxelCollisionComponent* Collider = NewObject<UVoxelCollisionComponent>(this);
+	Collider->SetupAttachment(RootComponent);
+	Collider->RegisterComponent();
+	return Collider;
+}
+
+void AVoxelWorldRenderer::GetChunkCollisionStats(const FIntPoint& ChunkCoord, int32& OutNumBodies, float& OutBuildMicroseconds) const
+{
+	OutNumBodies = 0;
+	OutBuildMicroseconds = 0.0f;
+
+	for (int32 Section = 0; Section < FChunk::NumSections; ++Section)
+	{
+		UVoxelCollisionComponent* const* Collider = SectionColliders.Find(FIntVector(ChunkCoord.X, ChunkCoord.Y, Section));
+		if (Collider != nullptr && *Collider != nullptr)
+		{
+			OutNumBodies += (*Collider)->GetNumBodies();
+			OutBuildMicroseconds += (*Collider)->GetBuildMicroseconds();
+		}
+	}
+}
+
+UMaterialInterface* AVoxelWorldRenderer::GetBlockMaterial(FBlockID Block) const
+{
+	UMaterialInterface* Material = BlockMaterials.IsValidIndex(Block) ? BlockMaterials[Block] : nullptr;
+	return Material != nullptr ? Material : UMaterial::GetDefaultMaterial(MD_Surface);
+}
+
+void AVoxelWorldRenderer::UpdateCracks(const UVoxelWorldSubsystem& VoxelWorld)
+{
+	const FBlockDamageMap& Damage = VoxelWorld.GetBlockDamage();
+	if (CrackMaterial == nullptr || Damage.GetRevision() == CrackRevision)
+	{
+		return;
+	}
+	CrackRevision = Damage.GetRevision();
+
+	CrackOverlay->SetMaterial(0, CrackMaterial);
+
+	//slightly larger than a block so the overlay never fights the block faces for depth
+	const FVector Scale(1.01f);
+
+	int32 Instance = 0;
+	for (const TPair<FIntVector, FBlockDamage>& Entry : Damage.GetEntries())
+	{
+		const FTransform Transform(FQuat::Identity, VoxelWorld.GetBlockCenter(Entry.Key), Scale);
+		if (Instance < CrackOverlay->GetInstanceCount())
+		{
+			CrackOverlay->UpdateInstanceTransform(Instance, Transform, true, false, true);
+		}
+		else
+		{
+			CrackOverlay->AddInstanceWorldSpace(Transform);
+		}
+
+		CrackOverlay->SetCustomDataValue(Instance, 0, (float)Entry.Value.Stage / FBlockDamageMap::NumStages, false);
+		++Instance;
+	}
+
+	//spare instances stay in the pool, shrunk to nothing
+	const FTransform Hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	for (; Instance < CrackOverlay->GetInstanceCount(); ++Instance)
+	{
+		CrackOverlay->UpdateInstanceTransform(Instance, Hidden, true, false, true);
+	}
+
+	CrackOverlay->MarkRenderStateDirty();
+}
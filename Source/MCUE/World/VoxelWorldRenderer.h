@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Containers/Queue.h"
+#include "ChunkMesher.h"
+#include "VoxelWorldRenderer.generated.h"
+
+class UMaterialInterface;
+class UInstancedStaticMeshComponent;
+class UProceduralMeshComponent;
+class UVoxelCollisionComponent;
+class UVoxelWorldSubsystem;
+
+//how well the section component pool has been doing since the last reset
+struct FSectionPoolStats
+{
+	//components handed out from the pool and ones that had to be created
+	int32 Hits;
+	int32 Misses;
+
+	//components destroyed because the pool was full or turned off
+	int32 Overflows;
+};
+
+//draws the voxel world with one procedural mesh per non empty chunk section, and gives each one merged box collision
+//meshes and collision are built on the task graph, this actor only uploads finished buffers
+UCLASS(config=Game)
+class MCUE_API AVoxelWorldRenderer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AVoxelWorldRenderer();
+
+	virtual void BeginPlay() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	//material to use for a block type, indexed by block id
+	UPROPERTY(EditAnywhere, Category = "Voxel")
+	TArray<UMaterialInterface*> BlockMaterials;
+
+	//drawn over damaged blocks by CrackOverlay, reads the breaking progress in [0, 1] from PerInstanceCustomData 0
+	//meant to mask T_Break the way the old per block CrackingValue parameter did
+	//set on a renderer blueprint or in config, there are no cracks without it and begin play warns about that
+	UPROPERTY(EditAnywhere, config, Category = "Voxel")
+	UMaterialInterface* CrackMaterial;
+
+	//section meshes and colliders created up front, so the first chunks to stream in don't register components
+	UPROPERTY(EditAnywhere, Category = "Voxel", meta = (ClampMin = "0"))
+	int32 NumPrewarmedSections;
+
+	//most unused components of each kind kept around, anything past this is destroyed
+	UPROPERTY(EditAnywhere, Category = "Voxel", meta = (ClampMin = "0"))
+	int32 MaxPooledSections;
+
+	//only fills the slot if nothing was assigned yet, lets placed blocks donate their material
+	void SetDefaultBlockMaterial(FBlockID Block, UMaterialInterface* Material);
+
+	//destroys the meshes of every section of the chunk, results still being built for it are dropped
+	void RemoveChunk(const FIntPoint& ChunkCoord);
+
+	//the material assigned to the block type, the engine default if there is none
+	UMaterialInterface* GetBlockMaterial(FBlockID Block) const;
+
+	//number of section meshes currently alive, roughly the number of draw calls per material
+	int32 GetNumSectionMeshes() const { return SectionMeshes.Num(); }
+
+	const FSectionPoolStats& GetSectionPoolStats() const { return PoolStats; }
+	void ResetSectionPoolStats() { PoolStats = FSectionPoolStats(); }
+
+	//collision boxes across the chunk's sections and the worker time it took to merge them
+	void GetChunkCollisionStats(const FIntPoint& ChunkCoord, int32& OutNumBodies, float& OutBuildMicroseconds) const;
+
+private:
+	//snapshots dirty sections and hands them to worker threads until the budget runs out, at least one per call
+	//sections left over wait for the next frame, returns the number dispatched
+	int32 DispatchDirtySections(UVoxelWorldSubsystem& VoxelWorld, double BudgetSeconds);
+
+	//uploads finished meshes that are still current until the budget runs out, at least one per call
+	//returns the number uploaded
+	int32 ApplyFinishedMeshes(double BudgetSeconds);
+
+	void ApplyMesh(const FChunkMeshData& Mesh);
+
+	void ApplyCollision(const FChunkMeshData& Mesh);
+
+	//section components come from the free lists when there are any, and go back to them instead of being destroyed
+	//a pooled component stays registered, it is only emptied and moved
+	UProceduralMeshComponent* AcquireMeshComponent(const FIntVector& SectionCoord);
+	UVoxelCollisionComponent* AcquireCollider(const FIntVector& SectionCoord);
+	void ReleaseMeshComponent(UProceduralMeshComponent* MeshComponent);
+	void ReleaseCollider(UVoxelCollisionComponent* Collider);
+
+	UProceduralMeshComponent* CreateMeshComponent();
+	UVoxelCollisionComponent* CreateCollider();
+
+	//moves the overlay instances onto the damaged blocks, instances are reused rather than added and removed
+	void UpdateCracks(const UVoxelWorldSubsystem& VoxelWorld);
+
+	typedef TQueue<FChunkMeshData, EQueueMode::Mpsc> FMeshResultQueue;
+
+	//shared with in flight tasks so they can finish safely after this actor is gone
+	TSharedPtr<FMeshResultQueue, ESPMode::ThreadSafe> FinishedMeshes;
+
+	//dirty sections not gathered yet, oldest first, the set keeps a section from being queued twice
+	TArray<FIntVector> PendingSections;
+	TSet<FIntVector> PendingSectionSet;
+
+	//latest generation dispatched per section
+	TMap<FIntVector, uint32> SectionGenerations;
+
+	//shared by all sections, so a section that is removed and built again never reuses a number
+	uint32 NextGeneration;
+
+	UPROPERTY(Transient)
+	TMap<FIntVector, UProceduralMeshComponent*> SectionMeshes;
+
+	UPROPERTY(Transient)
+	TMap<FIntVector, UVoxelCollisionComponent*> SectionColliders;
+
+	UPROPERTY(Transient)
+	TArray<UProceduralMeshComponent*> FreeMeshes;
+
+	UPROPERTY(Transient)
+	TArray<UVoxelCollisionComponent*> FreeColliders;
+
+	FSectionPoolStats PoolStats;
+
+	//one instance per damaged block, a single draw call and material however many blocks are being mined
+	UPROPERTY(VisibleAnywhere, Category = "Voxel")
+	UInstancedStaticMeshComponent* CrackOverlay;
+
+	//damage revision the overlay was last built for
+	uint32 CrackRevision;
+};
@@ -0,0 +1,1201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelWorldSubsystem.h"
+#include "VoxelWorldRenderer.h"
+#include "BlockRegistryAsset.h"
+#include "MCUEStats.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelWorld, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Voxel World Tick"), STAT_VoxelWorldTick, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Loaded Chunks"), STAT_VoxelLoadedChunks, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Damage Block"), STAT_MCUEDamageBlock, STATGROUP_MCUE);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Breaking Blocks"), STAT_MCUEBreakingBlocks, STATGROUP_MCUE);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streaming Pending"), STAT_VoxelStreamingPending, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streaming In Flight"), STAT_VoxelStreamingInFlight, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunks Applied"), STAT_VoxelStreamingApplied, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunks Unloaded"), STAT_VoxelStreamingUnloaded, STATGROUP_VoxelWorld);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Streaming Time (us)"), STAT_VoxelStreamingMicroseconds, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Region Edit"), STAT_VoxelRegionEdit, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Edit Blocks"), STAT_VoxelRegionEditBlocks, STATGROUP_VoxelWorld);
+
+namespace
+{
+	//how far mcue.Explode and mcue.FillSphere look for the block they center on
+	constexpr float EditReach = 100.0f * UVoxelWorldSubsystem::BlockSize;
+
+	//finds the block the first player is looking at, for the world edit commands
+	bool GetViewTarget(UWorld* World, const TCHAR* Command, UVoxelWorldSubsystem*& OutVoxelWorld, FVoxelHit& OutHit)
+	{
+		OutVoxelWorld = World != nullptr ? World->GetSubsystem<UVoxelWorldSubsystem>() : nullptr;
+		const APlayerController* Player = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+		const APawn* Pawn = Player != nullptr ? Player->GetPawn() : nullptr;
+		if (OutVoxelWorld == nullptr || Pawn == nullptr || OutVoxelWorld->IsNetClient())
+		{
+			UE_LOG(LogVoxelWorld, Warning, TEXT("%s needs a voxel world and a player, on a server or in a standalone game"), Command);
+			return false;
+		}
+
+		FVector Eye;
+		FRotator View;
+		Pawn->GetActorEyesViewPoint(Eye, View);
+		if (!OutVoxelWorld->Raycast(Eye, View.Vector(), EditReach, OutHit))
+		{
+			UE_LOG(LogVoxelWorld, Warning, TEXT("%s: no block in view"), Command);
+			return false;
+		}
+		return true;
+	}
+
+	//mcue.Explode [Radius] [Power]
+	//blows a crater where the player is looking and logs what it cost
+	void RunExplode(const TArray<FString>& Args, UWorld* World)
+	{
+		UVoxelWorldSubsystem* VoxelWorld;
+		FVoxelHit Hit;
+		if (!GetViewTarget(World, TEXT("mcue.Explode"), VoxelWorld, Hit))
+		{
+			return;
+		}
+
+		const float Radius = FMath::Clamp(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 8.0f, 1.0f, 64.0f);
+		const float Power = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 150.0f;
+
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 NumChanged = VoxelWorld->CarveExplosion(Hit.Location, Radius, Power);
+		UE_LOG(LogVoxelWorld, Display, TEXT("Explosion of radius %.0f removed %d blocks in %.2f ms"), Radius, NumChanged, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ExplodeCommand(
+		TEXT("mcue.Explode"),
+		TEXT("Carves an explosion crater where the player is looking. Args: [Radius=8] [Power=150]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunExplode));
+
+	//mcue.FillSphere [Radius] [Block]
+	//fills a ball around the block the player is looking at, air by default, and logs what it cost
+	void RunFillSphere(const TArray<FString>& Args, UWorld* World)
+	{
+		UVoxelWorldSubsystem* VoxelWorld;
+		FVoxelHit Hit;
+		if (!GetViewTarget(World, TEXT("mcue.FillSphere"), VoxelWorld, Hit))
+		{
+			return;
+		}
+
+		const int32 Radius = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 8, 0, 64);
+		const int32 Type = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : (int32)EBlockID::Air;
+		if (Type < 0 || Type >= EBlockID::Num)
+		{
+			UE_LOG(LogVoxelWorld, Warning, TEXT("mcue.FillSphere: no block type %d"), Type);
+			return;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 NumChanged = VoxelWorld->FillSphere(Hit.BlockCoord, Radius, (FBlockID)Type);
+		UE_LOG(LogVoxelWorld, Display, TEXT("Sphere of radius %d changed %d blocks in %.2f ms"), Radius, NumChanged, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs FillSphereCommand(
+		TEXT("mcue.FillSphere"),
+		TEXT("Fills a sphere around the block the player is looking at. Args: [Radius=8] [BlockType=0 (air)]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunFillSphere));
+}
+
+UVoxelWorldSubsystem::UVoxelWorldSubsystem()
+{
+	WorldOrigin = FVector::ZeroVector;
+
+	EncodedChunks = MakeShared<FEncodedChunkQueue, ESPMode::ThreadSafe>();
+
+	DamageDecayDelay = 1.0f;
+	DamageDecayInterval = 0.5f;
+
+	BlockTicksPerSecond = 20.0f;
+	MaxBlockTickStepsPerFrame = 2;
+	RandomTicksPerSection = 3;
+	MaxScheduledTicksPerStep = 1024;
+
+	bIsNetClient = false;
+
+	LastThrottledRemeshTime = 0.0f;
+	NumThrottledRemeshes = 0;
+	bThrottlingRemesh = false;
+	TickRemeshInterval = 0.25f;
+
+	bBulkEditing = false;
+	LastDirtySection = FIntVector(MAX_int32);
+
+	bSaveWorld = false;
+	WorldName = TEXT("World");
+
+	bGenerateTerrain = false;
+	TerrainSeed = 1337;
+	TerrainBaseHeight = 64;
+	TerrainHeightVariation = 16;
+	TerrainHillScale = 96.0f;
+	TerrainSeaLevel = 0;
+	NumTerrainWorkers = 2;
+	TerrainQueueCapacity = 8;
+
+	StreamingRadius = 6;
+	UnloadHysteresis = 2;
+	StreamingBudgetMicroseconds = 2000.0f;
+	StreamingSecondsThisFrame = 0.0;
+
+	FMemory::Memzero(StreamingStats);
+}
+
+bool UVoxelWorldSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	//only game worlds hold block data, the editor preview worlds don't need it
+	UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UVoxelWorldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	//the terrain workers below read the registry, so it has to be final before they start
+	if (const UBlockRegistryAsset* RegistryAsset = BlockRegistry.LoadSynchronous())
+	{
+		FBlockRegistry::Initialize(*RegistryAsset);
+	}
+
+	BlockTicks.Configure(BlockTicksPerSecond, MaxBlockTickStepsPerFrame, RandomTicksPerSection, MaxScheduledTicksPerStep, TerrainSeed);
+
+	if (bGenerateTerrain)
+	{
+		FTerrainSettings Settings;
+		Settings.Seed = (uint32)TerrainSeed;
+		Settings.BaseHeight = TerrainBaseHeight;
+		Settings.HeightVariation = TerrainHeightVariation;
+		Settings.HillScale = FMath::Max(1.0f, TerrainHillScale);
+		Settings.SubsoilDepth = 3;
+		Settings.SeaLevel = FMath::Clamp(TerrainSeaLevel, 0, FChunk::Height - 1);
+		Settings.OreVeinsPerChunk = 6;
+		Settings.OreMaxHeight = FMath::Max(1, TerrainBaseHeight - TerrainHeightVariation - 4);
+
+		TerrainGenerator = MakeUnique<FTerrainGenerator>(Settings, NumTerrainWorkers, TerrainQueueCapacity);
+	}
+}
+
+void UVoxelWorldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	bIsNetClient = InWorld.IsNetMode(NM_Client);
+
+	UClass* Class = RendererClass.LoadSynchronous();
+	if (Class == nullptr)
+	{
+		Class = AVoxelWorldRenderer::StaticClass();
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	Renderer = InWorld.SpawnActor<AVoxelWorldRenderer>(Class, FTransform::Identity, SpawnParams);
+}
+
+void UVoxelWorldSubsystem::Deinitialize()
+{
+	//stops and joins the workers before the chunk map goes away
+	TerrainGenerator.Reset();
+	RequestedChunks.Empty();
+
+	StreamingSources.Empty();
+	StreamingViews.Empty();
+	PendingChunks.Empty();
+	PendingUnloads.Empty();
+
+	//unloaded chunks still being compressed go to disk before the region files close
+	FTaskGraphInterface::Get().WaitUntilTasksComplete(SaveTasks);
+	SaveTasks.Empty();
+	WriteEncodedChunks([]() { return false; });
+
+	if (!bIsNetClient)
+	{
+		SaveModifiedChunks();
+	}
+	RegionFiles.Empty();
+
+	Chunks.Empty();
+	PlaceholderChunks.Empty();
+	DirtySections.Empty();
+	ThrottledSections.Empty();
+	Renderer = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UVoxelWorldSubsystem::Tick(float DeltaTime)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_VoxelWorldTick, MCUEWorld);
+
+	BlockDamage.Decay(GetWorld()->GetTimeSeconds(), DamageDecayDelay, DamageDecayInterval);
+
+	SET_DWORD_STAT(STAT_MCUEBreakingBlocks, BlockDamage.GetEntries().Num());
+	SET_DWORD_STAT(STAT_VoxelLoadedChunks, Chunks.Num());
+	CSV_CUSTOM_STAT(MCUEWorld, BreakingBlocks, BlockDamage.GetEntries().Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(MCUEWorld, LoadedChunks, Chunks.Num(), ECsvCustomStatOp::Set);
+
+	//clients get chunks and the blocks ticks changed in them from the server
+	if (bIsNetClient)
+	{
+		return;
+	}
+
+	BlockTicks.Advance(*this, DeltaTime);
+
+	UpdateStreaming();
+	PumpStreaming();
+}
+
+bool UVoxelWorldSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UVoxelWorldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVoxelWorldSubsystem, STATGROUP_Tickables);
+}
+
+FBlockID UVoxelWorldSubsystem::GetBlock(const FIntVector& BlockCoord) const
+{
+	if (!IsValidHeight(BlockCoord.Z))
+	{
+		return EBlockID::Air;
+	}
+
+	const FChunk* Chunk = FindChunk(BlockToChunk(BlockCoord));
+	return Chunk != nullptr ? Chunk->GetBlock(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z) : (FBlockID)EBlockID::Air;
+}
+
+bool UVoxelWorldSubsystem::SetBlock(const FIntVector& BlockCoord, FBlockID Block, EBlockWriteFlags Flags)
+{
+	if (!IsValidHeight(BlockCoord.Z))
+	{
+		return false;
+	}
+
+	FChunk& Chunk = GetOrCreateChunk(BlockToChunk(BlockCoord));
+	const FBlockID OldBlock = Chunk.GetBlock(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z);
+	if (!Chunk.SetBlock(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z, Block))
+	{
+		return false;
+	}
+
+	TGuardValue<bool> ThrottleGuard(bThrottlingRemesh, EnumHasAnyFlags(Flags, EBlockWriteFlags::ThrottleRemesh));
+
+	Lighting.UpdateBlock(*this, BlockCoord, OldBlock, Block);
+
+	//whatever is there now starts undamaged
+	BlockDamage.Remove(BlockCoord);
+
+	MarkBlockDirty(BlockCoord);
+
+	BlockChangedEvent.Broadcast(BlockCoord, Block);
+
+	if (bIsNetClient)
+	{
+		return true;
+	}
+
+	//fluids only move when something near them changed
+	ScheduleFluidTicksAround(BlockCoord);
+	return true;
+}
+
+int32 UVoxelWorldSubsystem::EditRegion(const FIntVector& Corner, const FIntVector& OppositeCorner, TFunctionRef<FBlockID(const FIntVector& BlockCoord, FBlockID Block)> Edit)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_VoxelRegionEdit, MCUEWorld);
+
+	const FIntVector Min(FMath::Min(Corner.X, OppositeCorner.X), FMath::Min(Corner.Y, OppositeCorner.Y), FMath::Max(FMath::Min(Corner.Z, OppositeCorner.Z), 0));
+	const FIntVector Max(FMath::Max(Corner.X, OppositeCorner.X), FMath::Max(Corner.Y, OppositeCorner.Y), FMath::Min(FMath::Max(Corner.Z, OppositeCorner.Z), FChunk::Height - 1));
+	if (Min.Z > Max.Z)
+	{
+		return 0;
+	}
+
+	//all the block data first, chunk by chunk so the changes come out grouped by chunk
+	RegionEdit.Reset();
+	const FIntPoint MinChunk = BlockToChunk(Min);
+	const FIntPoint MaxChunk = BlockToChunk(Max);
+	for (int32 ChunkY = MinChunk.Y; ChunkY <= MaxChunk.Y; ++ChunkY)
+	{
+		for (int32 ChunkX = MinChunk.X; ChunkX <= MaxChunk.X; ++ChunkX)
+		{
+			const FIntPoint ChunkCoord(ChunkX, ChunkY);
+			FChunk* Chunk = FindChunk(ChunkCoord);
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			const FIntVector ChunkOrigin(ChunkX * FChunkSection::Size, ChunkY * FChunkSection::Size, 0);
+			const int32 MinX = FMath::Max(Min.X - ChunkOrigin.X, 0);
+			const int32 MaxX = FMath::Min(Max.X - ChunkOrigin.X, FChunkSection::Size - 1);
+			const int32 MinY = FMath::Max(Min.Y - ChunkOrigin.Y, 0);
+			const int32 MaxY = FMath::Min(Max.Y - ChunkOrigin.Y, FChunkSection::Size - 1);
+			const int32 FirstChange = RegionEdit.Changes.Num();
+
+			for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+			{
+				for (int32 Y = MinY; Y <= MaxY; ++Y)
+				{
+					for (int32 X = MinX; X <= MaxX; ++X)
+					{
+						const FIntVector BlockCoord = ChunkOrigin + FIntVector(X, Y, Z);
+						const FBlockID OldBlock = Chunk->GetBlock(X, Y, Z);
+						const FBlockID NewBlock = Edit(BlockCoord, OldBlock);
+						if (NewBlock != OldBlock && Chunk->SetBlock(X, Y, Z, NewBlock))
+						{
+							RegionEdit.Changes.Add(FVoxelBlockChange{ BlockCoord, OldBlock, NewBlock });
+						}
+					}
+				}
+			}
+
+			if (RegionEdit.Changes.Num() > FirstChange)
+			{
+				RegionEdit.Chunks.Emplace(ChunkCoord, FirstChange);
+			}
+		}
+	}
+
+	const int32 NumChanged = RegionEdit.Changes.Num();
+	if (NumChanged > 0)
+	{
+		ApplyRegionEdit(Min.Z, Max.Z);
+	}
+
+	INC_DWORD_STAT_BY(STAT_VoxelRegionEditBlocks, NumChanged);
+	return NumChanged;
+}
+
+int32 UVoxelWorldSubsystem::FillBox(const FIntVector& Corner, const FIntVector& OppositeCorner, FBlockID Block)
+{
+	return EditRegion(Corner, OppositeCorner, [Block](const FIntVector&, FBlockID) { return Block; });
+}
+
+int32 UVoxelWorldSubsystem::FillSphere(const FIntVector& Center, int32 Radius, FBlockID Block)
+{
+	const int32 RadiusSquared = Radius * Radius;
+	return EditRegion(Center - FIntVector(Radius), Center + FIntVector(Radius), [&Center, RadiusSquared, Block](const FIntVector& BlockCoord, FBlockID OldBlock)
+	{
+		const FIntVector Offset = BlockCoord - Center;
+		return Offset.X * Offset.X + Offset.Y * Offset.Y + Offset.Z * Offset.Z <= RadiusSquared ? Block : OldBlock;
+	});
+}
+
+int32 UVoxelWorldSubsystem::ReplaceInBox(const FIntVector& Corner, const FIntVector& OppositeCorner, FBlockID From, FBlockID To)
+{
+	const FBlockID FromType = EBlockID::GetType(From);
+	return EditRegion(Corner, OppositeCorner, [FromType, To](const FIntVector&, FBlockID Block) { return EBlockID::GetType(Block) == FromType ? To : Block; });
+}
+
+int32 UVoxelWorldSubsystem::CarveExplosion(const FVector& Center, float Radius, float Power)
+{
+	if (Radius <= 0.0f || Power <= 0.0f)
+	{
+		return 0;
+	}
+
+	//block units from here on
+	const FVector Local = (Center - WorldOrigin) / BlockSize;
+	const FIntVector Min(FMath::FloorToInt(Local.X - Radius), FMath::FloorToInt(Local.Y - Radius), FMath::FloorToInt(Local.Z - Radius));
+	const FIntVector Max(FMath::FloorToInt(Local.X + Radius), FMath::FloorToInt(Local.Y + Radius), FMath::FloorToInt(Local.Z + Radius));
+	const float RadiusSquared = Radius * Radius;
+
+	//the noise only depends on where the blast went off, so replaying it carves the same blocks
+	const uint32 Seed = GetTypeHash(WorldToBlock(Center));
+
+	return EditRegion(Min, Max, [&Local, Radius, RadiusSquared, Power, Seed](const FIntVector& BlockCoord, FBlockID Block)
+	{
+		if (!FBlockRegistry::IsSolid(Block))
+		{
+			return Block;
+		}
+
+		const float DistanceSquared = FVector::DistSquared(FVector(BlockCoord) + FVector(0.5f), Local);
+		if (DistanceSquared > RadiusSquared)
+		{
+			return Block;
+		}
+
+		//between 0.75 and 1.25 of the blast's strength at that distance
+		const float Noise = (float)(HashCombine(Seed, GetTypeHash(BlockCoord)) & 0xffff) / 65535.0f;
+		const float Strength = Power * (1.0f - FMath::Sqrt(DistanceSquared) / Radius) * (0.75f + 0.5f * Noise);
+		return Strength > FBlockRegistry::Get(Block).Resistance ? (FBlockID)EBlockID::Air : Block;
+	});
+}
+
+void UVoxelWorldSubsystem::ApplyRegionEdit(int32 MinZ, int32 MaxZ)
+{
+	//one light fill for the whole edit, and each section it touches is queued for remeshing once
+	TGuardValue<bool> BulkGuard(bBulkEditing, true);
+	LastDirtySection = FIntVector(MAX_int32);
+
+	Lighting.UpdateBlocks(*this, RegionEdit.Changes);
+
+	//whatever is there now starts undamaged, most edits happen with nothing being mined
+	const bool bAnyDamage = BlockDamage.GetEntries().Num() > 0;
+	for (const FVoxelBlockChange& Change : RegionEdit.Changes)
+	{
+		MarkBlockDirty(Change.BlockCoord);
+		if (bAnyDamage)
+		{
+			BlockDamage.Remove(Change.BlockCoord);
+		}
+	}
+
+	RegionEditedEvent.Broadcast(RegionEdit);
+
+	if (bIsNetClient)
+	{
+		return;
+	}
+
+	//fluids only move when something near them changed, chunks with none around them are skipped whole
+	for (int32 ChunkIndex = 0; ChunkIndex < RegionEdit.Chunks.Num(); ++ChunkIndex)
+	{
+		if (!HasFluidNear(RegionEdit.Chunks[ChunkIndex].Key, MinZ - 1, MaxZ + 1))
+		{
+			continue;
+		}
+
+		const int32 End = RegionEdit.GetChunkEnd(ChunkIndex);
+		for (int32 Index = RegionEdit.Chunks[ChunkIndex].Value; Index < End; ++Index)
+		{
+			ScheduleFluidTicksAround(RegionEdit.Changes[Index].BlockCoord);
+		}
+	}
+}
+
+void UVoxelWorldSubsystem::ScheduleFluidTicksAround(const FIntVector& BlockCoord)
+{
+	static const FIntVector FluidNeighbours[7] =
+	{
+		FIntVector(0, 0, 0),
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1),
+		FIntVector(0, 0, -1)
+	};
+	for (const FIntVector& Offset : FluidNeighbours)
+	{
+		const FBlockID Neighbour = GetBlock(BlockCoord + Offset);
+		if (FBlockRegistry::IsFluid(Neighbour))
+		{
+			BlockTicks.ScheduleTick(BlockCoord + Offset, FBlockRegistry::Get(Neighbour).FluidTickSteps);
+		}
+	}
+}
+
+bool UVoxelWorldSubsystem::HasFluidNear(const FIntPoint& ChunkCoord, int32 MinZ, int32 MaxZ) const
+{
+	static const FIntPoint Offsets[5] = { FIntPoint(0, 0), FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+
+	const int32 MinSection = FMath::Max(MinZ, 0) >> 4;
+	const int32 MaxSection = FMath::Min(MaxZ, FChunk::Height - 1) >> 4;
+	for (const FIntPoint& Offset : Offsets)
+	{
+		const FChunk* Chunk = FindChunk(ChunkCoord + Offset);
+		for (int32 Section = MinSection; Chunk != nullptr && Section <= MaxSection; ++Section)
+		{
+			if (Chunk->GetSection(Section).AnyBlockType([](FBlockID Block) { return FBlockRegistry::IsFluid(Block); }))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+uint8 UVoxelWorldSubsystem::GetLight(const FIntVector& BlockCoord) const
+{
+	if (BlockCoord.Z < 0)
+	{
+		return 0;
+	}
+
+	const FChunk* Chunk = BlockCoord.Z < FChunk::Height ? FindChunk(BlockToChunk(BlockCoord)) : nullptr;
+	return Chunk != nullptr ? Chunk->GetLight().Get(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z) : FChunkLight::Pack(FChunkLight::MaxLevel, 0);
+}
+
+void UVoxelWorldSubsystem::PlaceLevelBlock(const FIntVector& BlockCoord, FBlockID Block)
+{
+	if (!IsValidHeight(BlockCoord.Z))
+	{
+		return;
+	}
+
+	const FIntPoint ChunkCoord = BlockToChunk(BlockCoord);
+	const FChunk* Existing = FindChunk(ChunkCoord);
+	if (Existing != nullptr && Existing->HasSavedLevelBlocks())
+	{
+		return;
+	}
+
+	//a placeholder carries the flag into the terrain or save that replaces it
+	SetBlock(BlockCoord, Block);
+	GetOrCreateChunk(ChunkCoord).MarkLevelBlocks();
+}
+
+bool UVoxelWorldSubsystem::DamageBlock(const FIntVector& BlockCoord, AActor* Instigator)
+{
+	MCUE_SCOPE_CYCLE_COUNTER(STAT_MCUEDamageBlock, MCUEGameplay);
+
+	if (!FBlockRegistry::IsSolid(GetBlock(BlockCoord)))
+	{
+		return false;
+	}
+
+	if (BlockDamage.AddDamage(BlockCoord, Instigator, GetWorld()->GetTimeSeconds()) < FBlockDamageMap::NumStages)
+	{
+		return false;
+	}
+
+	return SetBlock(BlockCoord, EBlockID::Air);
+}
+
+void UVoxelWorldSubsystem::GetTickableChunks(TArray<const FChunk*>& OutChunks) const
+{
+	OutChunks.Reset(Chunks.Num());
+	for (const TPair<FIntPoint, TUniquePtr<FChunk>>& Pair : Chunks)
+	{
+		if (!PlaceholderChunks.Contains(Pair.Key))
+		{
+			OutChunks.Add(Pair.Value.Get());
+		}
+	}
+
+	//map order depends on the load history
+	OutChunks.Sort([](const FChunk& A, const FChunk& B)
+	{
+		return A.GetCoord().Y != B.GetCoord().Y ? A.GetCoord().Y < B.GetCoord().Y : A.GetCoord().X < B.GetCoord().X;
+	});
+}
+
+FChunk* UVoxelWorldSubsystem::FindChunk(const FIntPoint& ChunkCoord)
+{
+	TUniquePtr<FChunk>* Chunk = Chunks.Find(ChunkCoord);
+	return Chunk != nullptr ? Chunk->Get() : nullptr;
+}
+
+const FChunk* UVoxelWorldSubsystem::FindChunk(const FIntPoint& ChunkCoord) const
+{
+	const TUniquePtr<FChunk>* Chunk = Chunks.Find(ChunkCoord);
+	return Chunk != nullptr ? Chunk->Get() : nullptr;
+}
+
+FChunk& UVoxelWorldSubsystem::GetOrCreateChunk(const FIntPoint& ChunkCoord)
+{
+	TUniquePtr<FChunk>& Chunk = Chunks.FindOrAdd(ChunkCoord);
+	if (!Chunk.IsValid())
+	{
+		Chunk = MakeUnique<FChunk>(ChunkCoord);
+		PlaceholderChunks.Add(ChunkCoord);
+	}
+	return *Chunk;
+}
+
+void UVoxelWorldSubsystem::UnloadChunk(const FIntPoint& ChunkCoord)
+{
+	//a placeholder has no terrain yet, saving it would make the terrain never generate, and dropping it would lose its blocks
+	//a client can let go of one, the server has the blocks
+	if (PlaceholderChunks.Contains(ChunkCoord) && !bIsNetClient)
+	{
+		return;
+	}
+
+	TUniquePtr<FChunk> Unloaded;
+	if (!Chunks.RemoveAndCopyValue(ChunkCoord, Unloaded))
+	{
+		return;
+	}
+	PlaceholderChunks.Remove(ChunkCoord);
+
+	//compressed on a worker, PumpStreaming writes the result out within the budget
+	if (Unloaded->NeedsSave() && !bIsNetClient && bSaveWorld)
+	{
+		SavingChunks.Add(ChunkCoord);
+		TSharedPtr<FEncodedChunkQueue, ESPMode::ThreadSafe> Results = EncodedChunks;
+		SaveTasks.Add(FFunctionGraphTask::CreateAndDispatchWhenReady([Chunk = MoveTemp(Unloaded), Results]()
+		{
+			FEncodedChunk Encoded;
+			Encoded.ChunkCoord = Chunk->GetCoord();
+			if (!FRegionFile::EncodeChunk(*Chunk, Encoded.Buffer))
+			{
+				Encoded.Buffer.Reset();
+			}
+			Results->Enqueue(MoveTemp(Encoded));
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask));
+	}
+
+	if (Renderer != nullptr)
+	{
+		Renderer->RemoveChunk(ChunkCoord);
+	}
+
+	//the neighbours now border unloaded space, their edge faces have to show
+	MarkChunkDirty(ChunkCoord);
+}
+
+void UVoxelWorldSubsystem::ApplyReplicatedChunk(TUniquePtr<FChunk> Chunk)
+{
+	//the server's copy replaces whatever this client had at the coordinate
+	InstallChunk(MoveTemp(Chunk), false);
+}
+
+void UVoxelWorldSubsystem::AddStreamingSource(AActor* Source)
+{
+	StreamingSources.AddUnique(Source);
+}
+
+void UVoxelWorldSubsystem::RemoveStreamingSource(AActor* Source)
+{
+	StreamingSources.Remove(Source);
+}
+
+void UVoxelWorldSubsystem::UpdateStreaming()
+{
+	TArray<FStreamingView> Views;
+	for (int32 i = StreamingSources.Num() - 1; i >= 0; --i)
+	{
+		AActor* Source = StreamingSources[i].Get();
+		if (Source == nullptr)
+		{
+			StreamingSources.RemoveAtSwap(i);
+			continue;
+		}
+
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		Source->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+
+		const FVector Local = (EyeLocation - WorldOrigin) / (BlockSize * FChunkSection::Size);
+
+		FStreamingView& View = Views.AddDefaulted_GetRef();
+		View.Location = FVector2D(Local.X, Local.Y);
+		View.Direction = FVector2D(EyeRotation.Vector()).GetSafeNormal();
+		View.ChunkCoord = FIntPoint(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y));
+		View.YawOctant = FMath::FloorToInt(FRotator::ClampAxis(EyeRotation.Yaw) / 45.0f);
+	}
+
+	//the queues only change when a source crosses a chunk border or turns by an eighth, not every frame
+	bool bChanged = Views.Num() != StreamingViews.Num();
+	for (int32 i = 0; !bChanged && i < Views.Num(); ++i)
+	{
+		bChanged = Views[i].ChunkCoord != StreamingViews[i].ChunkCoord || Views[i].YawOctant != StreamingViews[i].YawOctant;
+	}
+
+	//priorities are measured from where the sources are now, even when the queues stay
+	StreamingViews = MoveTemp(Views);
+
+	if (!bChanged)
+	{
+		return;
+	}
+
+	TSet<FIntPoint> Wanted;
+	PendingChunks.Reset();
+	for (const FStreamingView& View : StreamingViews)
+	{
+		for (int32 Y = -StreamingRadius; Y <= StreamingRadius; ++Y)
+		{
+			for (int32 X = -StreamingRadius; X <= StreamingRadius; ++X)
+			{
+				const FIntPoint ChunkCoord = View.ChunkCoord + FIntPoint(X, Y);
+				if (X * X + Y * Y > StreamingRadius * StreamingRadius || Wanted.Contains(ChunkCoord))
+				{
+					continue;
+				}
+				Wanted.Add(ChunkCoord);
+
+				const bool bLoaded = Chunks.Contains(ChunkCoord) && !PlaceholderChunks.Contains(ChunkCoord);
+				if (!bLoaded && !RequestedChunks.Contains(ChunkCoord))
+				{
+					PendingChunks.Add({ ChunkCoord, GetStreamingPriority(ChunkCoord) });
+				}
+			}
+		}
+	}
+	PendingChunks.Heapify();
+
+	//placeholders stay until their terrain arrives, they hold the only copy of the blocks written into them
+	PendingUnloads.Reset();
+	for (const TPair<FIntPoint, TUniquePtr<FChunk>>& Pair : Chunks)
+	{
+		if (!PlaceholderChunks.Contains(Pair.Key) && !IsNearStreamingSource(Pair.Key, StreamingRadius + UnloadHysteresis))
+		{
+			PendingUnloads.Add(Pair.Key);
+		}
+	}
+}
+
+void UVoxelWorldSubsystem::PumpStreaming()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = GetStreamingBudgetLeft();
+	auto IsOverBudget = [&]() { return FPlatformTime::Seconds() - StartTime >= Budget; };
+
+	int32 NumApplied = 0;
+	int32 NumUnloaded = 0;
+
+	//finished terrain first, the work for it is already done
+	while (TerrainGenerator.IsValid() && (NumApplied == 0 || !IsOverBudget()))
+	{
+		TUniquePtr<FChunk> Chunk = TerrainGenerator->PopFinished();
+		if (!Chunk.IsValid())
+		{
+			break;
+		}
+
+		const FIntPoint ChunkCoord = Chunk->GetCoord();
+		RequestedChunks.Remove(ChunkCoord);
+
+		//every source moved away while it was generating, unless a placeholder is waiting for this terrain
+		if (!IsNearStreamingSource(ChunkCoord, StreamingRadius + UnloadHysteresis) && !PlaceholderChunks.Contains(ChunkCoord))
+		{
+			continue;
+		}
+
+		InstallChunk(MoveTemp(Chunk), true);
+		++NumApplied;
+	}
+
+	//then start the most important waiting chunks, saved ones load right here and count as applied
+	while (PendingChunks.Num() > 0 && !IsOverBudget())
+	{
+		const FIntPoint ChunkCoord = PendingChunks.HeapTop().ChunkCoord;
+		if (!PlaceholderChunks.Contains(ChunkCoord) && Chunks.Contains(ChunkCoord))
+		{
+			PendingChunks.HeapPopDiscard();
+			continue;
+		}
+
+		//its last copy is still on its way to disk, loading now would read the one before it
+		if (SavingChunks.Contains(ChunkCoord))
+		{
+			break;
+		}
+
+		const EChunkLoadResult Result = StartLoadingChunk(ChunkCoord);
+		if (Result == EChunkLoadResult::Refused)
+		{
+			//the generator is full, whatever is left waits for a later frame
+			break;
+		}
+		PendingChunks.HeapPopDiscard();
+		NumApplied += Result == EChunkLoadResult::Loaded;
+	}
+
+	while (PendingUnloads.Num() > 0 && (NumUnloaded == 0 || !IsOverBudget()))
+	{
+		const FIntPoint ChunkCoord = PendingUnloads.Pop(false);
+
+		//a source may have come back since the list was made
+		if (Chunks.Contains(ChunkCoord) && !IsNearStreamingSource(ChunkCoord, StreamingRadius + UnloadHysteresis))
+		{
+			UnloadChunk(ChunkCoord);
+			++NumUnloaded;
+		}
+	}
+
+	WriteEncodedChunks(IsOverBudget);
+
+	StreamingSecondsThisFrame += FPlatformTime::Seconds() - StartTime;
+
+	StreamingStats.NumPending = PendingChunks.Num();
+	StreamingStats.NumInFlight = RequestedChunks.Num();
+	StreamingStats.NumAppliedLastFrame = NumApplied;
+	StreamingStats.NumUnloadedLastFrame = NumUnloaded;
+	StreamingStats.MicrosecondsLastFrame = (float)(StreamingSecondsThisFrame * 1.0e6);
+
+	SET_DWORD_STAT(STAT_VoxelStreamingPending, StreamingStats.NumPending);
+	SET_DWORD_STAT(STAT_VoxelStreamingInFlight, StreamingStats.NumInFlight);
+	SET_DWORD_STAT(STAT_VoxelStreamingApplied, NumApplied);
+	SET_DWORD_STAT(STAT_VoxelStreamingUnloaded, NumUnloaded);
+	SET_FLOAT_STAT(STAT_VoxelStreamingMicroseconds, StreamingStats.MicrosecondsLastFrame);
+
+	//the renderer ticks before the subsystem, so this starts the budget for the next frame
+	StreamingSecondsThisFrame = 0.0;
+}
+
+UVoxelWorldSubsystem::EChunkLoadResult UVoxelWorldSubsystem::StartLoadingChunk(const FIntPoint& ChunkCoord)
+{
+	FRegionFile* Region = GetRegionFile(ChunkCoord, false);
+	if (Region != nullptr && Region->HasChunk(ChunkCoord))
+	{
+		TUniquePtr<FChunk> Saved = Region->ReadChunk(ChunkCoord);
+		if (Saved.IsValid())
+		{
+			//a save that already has the level blocks replaces the placeholder, otherwise they are merged in like over terrain
+			//PlaceLevelBlock leaves the chunk alone from now on if the save has them
+			Saved->MarkSavedLevelBlocks();
+			const bool bMergeLevelBlocks = !Saved->HasSavedLevelBlocks() && PlaceholderChunks.Contains(ChunkCoord);
+			InstallChunk(MoveTemp(Saved), bMergeLevelBlocks);
+			if (!bMergeLevelBlocks)
+			{
+				FindChunk(ChunkCoord)->MarkSaved();
+			}
+			return EChunkLoadResult::Loaded;
+		}
+	}
+
+	if (!TerrainGenerator.IsValid())
+	{
+		return EChunkLoadResult::Unavailable;
+	}
+
+	if (!TerrainGenerator->Request(ChunkCoord))
+	{
+		return EChunkLoadResult::Refused;
+	}
+
+	RequestedChunks.Add(ChunkCoord);
+	return EChunkLoadResult::Generating;
+}
+
+float UVoxelWorldSubsystem::GetStreamingPriority(const FIntPoint& ChunkCoord) const
+{
+	const FVector2D ChunkCenter(ChunkCoord.X + 0.5f, ChunkCoord.Y + 0.5f);
+
+	float Priority = MAX_flt;
+	for (const FStreamingView& View : StreamingViews)
+	{
+		const FVector2D Offset = ChunkCenter - View.Location;
+		const float Distance = Offset.Size();
+
+		//chunks straight ahead keep their distance, chunks behind count as up to twice as far
+		const float Facing = Distance > KINDA_SMALL_NUMBER ? FVector2D::DotProduct(Offset / Distance, View.Direction) : 1.0f;
+		Priority = FMath::Min(Priority, Distance * (1.5f - 0.5f * Facing));
+	}
+	return Priority;
+}
+
+bool UVoxelWorldSubsystem::IsNearStreamingSource(const FIntPoint& ChunkCoord, float Radius) const
+{
+	for (const FStreamingView& View : StreamingViews)
+	{
+		if ((ChunkCoord - View.ChunkCoord).SizeSquared() <= Radius * Radius)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UVoxelWorldSubsystem::InstallChunk(TUniquePtr<FChunk> NewChunk, bool bKeepExistingBlocks)
+{
+	const FIntPoint ChunkCoord = NewChunk->GetCoord();
+	TUniquePtr<FChunk>& Slot = Chunks.FindOrAdd(ChunkCoord);
+
+	if (Slot.IsValid() && bKeepExistingBlocks)
+	{
+		//blocks written before the terrain arrived win over the generated ones
+		for (int32 Z = 0; Z < FChunk::Height; ++Z)
+		{
+			if (Slot->GetSection(Z >> 4).IsEmpty())
+			{
+				Z |= FChunkSection::Size - 1;
+				continue;
+			}
+
+			for (int32 Y = 0; Y < FChunkSection::Size; ++Y)
+			{
+				for (int32 X = 0; X < FChunkSection::Size; ++X)
+				{
+					const FBlockID Block = Slot->GetBlock(X, Y, Z);
+					if (Block != EBlockID::Air)
+					{
+						NewChunk->SetBlock(X, Y, Z, Block);
+					}
+				}
+			}
+		}
+	}
+
+	if (Slot.IsValid())
+	{
+		if (bKeepExistingBlocks && Slot->HasLevelBlocks())
+		{
+			NewChunk->MarkLevelBlocks();
+		}
+		NewChunk->InheritRevision(*Slot);
+	}
+
+	Slot = MoveTemp(NewChunk);
+	PlaceholderChunks.Remove(ChunkCoord);
+	MarkChunkDirty(ChunkCoord);
+
+	Lighting.LightChunk(*this, *Slot);
+}
+
+void UVoxelWorldSubsystem::SaveModifiedChunks()
+{
+	for (TPair<FIntPoint, TUniquePtr<FChunk>>& Pair : Chunks)
+	{
+		if (Pair.Value->NeedsSave())
+		{
+			SaveChunk(*Pair.Value);
+		}
+	}
+}
+
+FRegionFile* UVoxelWorldSubsystem::GetRegionFile(const FIntPoint& ChunkCoord, bool bCreate)
+{
+	if (!bSaveWorld)
+	{
+		return nullptr;
+	}
+
+	const FIntPoint RegionCoord = FRegionFile::ChunkToRegion(ChunkCoord);
+	if (TUniquePtr<FRegionFile>* Region = RegionFiles.Find(RegionCoord))
+	{
+		return (*Region)->IsValid() ? Region->Get() : nullptr;
+	}
+
+	const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Worlds"), WorldName, TEXT("region"));
+	const FString Filename = FRegionFile::GetRegionFilename(Directory, RegionCoord);
+
+	//don't create files for regions that were only looked at
+	if (!bCreate && !FPaths::FileExists(Filename))
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<FRegionFile>& Region = RegionFiles.Add(RegionCoord, MakeUnique<FRegionFile>(Filename));
+	return Region->IsValid() ? Region.Get() : nullptr;
+}
+
+void UVoxelWorldSubsystem::WriteEncodedChunks(TFunctionRef<bool()> IsOverBudget)
+{
+	SaveTasks.RemoveAll([](const FGraphEventRef& Task) { return Task->IsComplete(); });
+
+	FEncodedChunk Encoded;
+	while (!IsOverBudget() && EncodedChunks->Dequeue(Encoded))
+	{
+		SavingChunks.Remove(Encoded.ChunkCoord);
+
+		FRegionFile* Region = GetRegionFile(Encoded.ChunkCoord, true);
+		if (Region == nullptr || !Region->WriteEncodedChunk(Encoded.ChunkCoord, Encoded.Buffer))
+		{
+			UE_LOG(LogVoxelWorld, Warning, TEXT("Couldn't save unloaded chunk (%d, %d)"), Encoded.ChunkCoord.X, Encoded.ChunkCoord.Y);
+		}
+	}
+}
+
+bool UVoxelWorldSubsystem::SaveChunk(FChunk& Chunk)
+{
+	FRegionFile* Region = GetRegionFile(Chunk.GetCoord(), true);
+	if (Region == nullptr || !Region->WriteChunk(Chunk))
+	{
+		return false;
+	}
+
+	Chunk.MarkSaved();
+	return true;
+}
+
+void UVoxelWorldSubsystem::MarkChunkDirty(const FIntPoint& ChunkCoord)
+{
+	for (int32 Section = 0; Section < FChunk::NumSections; ++Section)
+	{
+		DirtySections.Add(FIntVector(ChunkCoord.X, ChunkCoord.Y, Section));
+
+		//neighbours may have been showing faces against what used to be empty space
+		DirtySections.Add(FIntVector(ChunkCoord.X - 1, ChunkCoord.Y, Section));
+		DirtySections.Add(FIntVector(ChunkCoord.X + 1, ChunkCoord.Y, Section));
+		DirtySections.Add(FIntVector(ChunkCoord.X, ChunkCoord.Y - 1, Section));
+		DirtySections.Add(FIntVector(ChunkCoord.X, ChunkCoord.Y + 1, Section));
+	}
+}
+
+void UVoxelWorldSubsystem::ConsumeDirtySections(TArray<FIntVector>& OutSections)
+{
+	//throttled sections go out together, and only every so often
+	const float Time = GetWorld()->GetTimeSeconds();
+	if (ThrottledSections.Num() > 0 && Time - LastThrottledRemeshTime >= TickRemeshInterval)
+	{
+		NumThrottledRemeshes += ThrottledSections.Num();
+		DirtySections.Append(ThrottledSections);
+		ThrottledSections.Reset();
+		LastThrottledRemeshTime = Time;
+	}
+
+	OutSections.Reset(DirtySections.Num());
+	for (const FIntVector& Section : DirtySections)
+	{
+		//skip sections of chunks that aren't loaded, there is nothing to draw for them
+		if (Section.Z >= 0 && Section.Z < FChunk::NumSections && Chunks.Contains(FIntPoint(Section.X, Section.Y)))
+		{
+			OutSections.Add(Section);
+		}
+	}
+	DirtySections.Reset();
+}
+
+void UVoxelWorldSubsystem::MarkBlockDirty(const FIntVector& BlockCoord)
+{
+	const FIntVector Section(BlockCoord.X >> 4, BlockCoord.Y >> 4, BlockCoord.Z >> 4);
+	const FIntVector Local(BlockCoord.X & 15, BlockCoord.Y & 15, BlockCoord.Z & 15);
+
+	//a block away from the section's faces can't add anything the last block of the same section didn't
+	if (bBulkEditing)
+	{
+		const bool bInterior = Local.X > 0 && Local.Y > 0 && Local.Z > 0
+			&& Local.X < FChunkSection::Size - 1 && Local.Y < FChunkSection::Size - 1 && Local.Z < FChunkSection::Size - 1;
+		if (bInterior && Section == LastDirtySection)
+		{
+			return;
+		}
+		LastDirtySection = Section;
+	}
+
+	TSet<FIntVector>& Sections = bThrottlingRemesh ? ThrottledSections : DirtySections;
+	Sections.Add(Section);
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		FIntVector Step(0, 0, 0);
+		Step[Axis] = 1;
+
+		if (Local[Axis] == 0)
+		{
+			Sections.Add(Section - Step);
+		}
+		else if (Local[Axis] == FChunkSection::Size - 1)
+		{
+			Sections.Add(Section + Step);
+		}
+	}
+}
+
+SIZE_T UVoxelWorldSubsystem::GetAllocatedSize() const
+{
+	SIZE_T Size = Chunks.GetAllocatedSize();
+	for (const TPair<FIntPoint, TUniquePtr<FChunk>>& Pair : Chunks)
+	{
+		Size += Pair.Value->GetAllocatedSize();
+	}
+	return Size;
+}
+
+bool UVoxelWorldSubsystem::Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FVoxelHit& OutHit, TArray<FIntPoint, TInlineAllocator<4>>* OutVisitedChunks) const
+{
+	const FVector Dir = Direction.GetSafeNormal();
+	if (Dir.IsZero())
+	{
+		return false;
+	}
+
+	//everything below is in block units
+	const FVector Origin = (Start - WorldOrigin) / BlockSize;
+	const float MaxT = MaxDistance / BlockSize;
+
+	FIntVector Cell(FMath::FloorToInt(Origin.X), FMath::FloorToInt(Origin.Y), FMath::FloorToInt(Origin.Z));
+	FIntVector Step;
+	FVector TMax;
+	FVector TDelta;
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (Dir[Axis] > 0.0f)
+		{
+			Step[Axis] = 1;
+			TDelta[Axis] = 1.0f / Dir[Axis];
+			TMax[Axis] = ((float)Cell[Axis] + 1.0f - Origin[Axis]) * TDelta[Axis];
+		}
+		else if (Dir[Axis] < 0.0f)
+		{
+			Step[Axis] = -1;
+			TDelta[Axis] = -1.0f / Dir[Axis];
+			TMax[Axis] = (Origin[Axis] - (float)Cell[Axis]) * TDelta[Axis];
+		}
+		else
+		{
+			Step[Axis] = 0;
+			TDelta[Axis] = BIG_NUMBER;
+			TMax[Axis] = BIG_NUMBER;
+		}
+	}
+
+	FIntVector Normal(0, 0, 0);
+	float T = 0.0f;
+
+	//the ray usually stays inside one or two chunks, so remember the last one
+	FIntPoint ChunkCoord(MAX_int32, MAX_int32);
+	const FChunk* Chunk = nullptr;
+
+	while (T <= MaxT)
+	{
+		const FIntPoint CellChunk = BlockToChunk(Cell);
+		if (CellChunk != ChunkCoord)
+		{
+			ChunkCoord = CellChunk;
+			Chunk = FindChunk(ChunkCoord);
+
+			if (OutVisitedChunks != nullptr)
+			{
+				OutVisitedChunks->Add(ChunkCoord);
+			}
+		}
+
+		if (Chunk != nullptr && IsValidHeight(Cell.Z))
+		{
+			const FBlockID Block = Chunk->GetBlock(Cell.X & 15, Cell.Y & 15, Cell.Z);
+			if (FBlockRegistry::IsSolid(Block))
+			{
+				OutHit.BlockCoord = Cell;
+				OutHit.Normal = Normal;
+				OutHit.Block = Block;
+				OutHit.Distance = T * BlockSize;
+				OutHit.Location = Start + Dir * OutHit.Distance;
+				return true;
+			}
+		}
+
+		//step into the neighbouring cell whose boundary the ray crosses first
+		int32 Axis = 0;
+		if (TMax.Y < TMax[Axis])
+		{
+			Axis = 1;
+		}
+		if (TMax.Z < TMax[Axis])
+		{
+			Axis = 2;
+		}
+
+		T = TMax[Axis];
+		TMax[Axis] += TDelta[Axis];
+		Cell[Axis] += Step[Axis];
+
+		Normal = FIntVector(0, 0, 0);
+		Normal[Axis] = -Step[Axis];
+	}
+
+	return false;
+}
+
+FIntVector UVoxelWorldSubsystem::WorldToBlock(const FVector& WorldLocation) const
+{
+	const FVector Local = (WorldLocation - WorldOrigin) / BlockSize;
+	return FIntVector(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y), FMath::FloorToInt(Local.Z));
+}
+
+FVector UVoxelWorldSubsystem::BlockToWorld(const FIntVector& BlockCoord) const
+{
+	return WorldOrigin + FVector(BlockCoord) * BlockSize;
+}
@@ -0,0 +1,475 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Queue.h"
+#include "Chunk.h"
+#include "TerrainGenerator.h"
+#include "RegionFile.h"
+#include "BlockDamage.h"
+#include "BlockTicks.h"
+#include "VoxelLighting.h"
+#include "VoxelWorldSubsystem.generated.h"
+
+class AVoxelWorldRenderer;
+class UBlockRegistryAsset;
+
+DECLARE_STATS_GROUP(TEXT("VoxelWorld"), STATGROUP_VoxelWorld, STATCAT_Advanced);
+
+//result of a raycast against block data
+struct FVoxelHit
+{
+	//the solid block that was hit
+	FIntVector BlockCoord;
+
+	//unit step towards the cell the ray came from, zero if the ray started inside the block
+	FIntVector Normal;
+
+	FBlockID Block;
+
+	//world space entry point and its distance from the ray start
+	FVector Location;
+	float Distance;
+};
+
+//what chunk streaming did in the last frame
+struct FVoxelStreamingStats
+{
+	//chunks wanted but not started yet
+	int32 NumPending;
+
+	//chunks in the terrain generator
+	int32 NumInFlight;
+
+	int32 NumAppliedLastFrame;
+	int32 NumUnloadedLastFrame;
+
+	//game thread time spent applying chunks and meshes in the last frame
+	float MicrosecondsLastFrame;
+};
+
+//how a block write is handled beyond changing the block
+enum class EBlockWriteFlags : uint8
+{
+	None = 0,
+
+	//the sections it changes are remeshed with the other throttled writes, at most every TickRemeshInterval seconds
+	ThrottleRemesh = 1 << 0
+};
+ENUM_CLASS_FLAGS(EBlockWriteFlags);
+
+//one block a bulk edit changed
+struct FVoxelBlockChange
+{
+	FIntVector BlockCoord;
+	FBlockID OldBlock;
+	FBlockID NewBlock;
+};
+
+//every block one bulk edit changed, grouped by chunk
+struct FVoxelRegionEdit
+{
+	TArray<FVoxelBlockChange> Changes;
+
+	//each chunk the edit changed and the index of its first change, its changes run up to the next chunk's first
+	TArray<TPair<FIntPoint, int32>> Chunks;
+
+	int32 GetChunkEnd(int32 ChunkIndex) const { return ChunkIndex + 1 < Chunks.Num() ? Chunks[ChunkIndex + 1].Value : Changes.Num(); }
+
+	void Reset()
+	{
+		Changes.Reset();
+		Chunks.Reset();
+	}
+};
+
+//a block that SetBlock actually changed, and what it is now
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnVoxelBlockChanged, const FIntVector& /*BlockCoord*/, FBlockID /*Block*/);
+
+//a bulk edit that changed at least one block, sent once for the whole edit instead of OnBlockChanged per block
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnVoxelRegionEdited, const FVoxelRegionEdit& /*Edit*/);
+
+//owns every loaded chunk in the world and is the only place block data lives
+UCLASS(config=Game)
+class MCUE_API UVoxelWorldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	//edge length of one block in world units, matches the 1M_Cube mesh
+	static constexpr float BlockSize = 100.0f;
+
+	UVoxelWorldSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	//returns air for unloaded chunks and out of range heights
+	FBlockID GetBlock(const FIntVector& BlockCoord) const;
+
+	//creates the chunk if needed, returns true if the block actually changed
+	//fluids in and around the block are scheduled to tick so they can react to the change
+	bool SetBlock(const FIntVector& BlockCoord, FBlockID Block, EBlockWriteFlags Flags = EBlockWriteFlags::None);
+
+	//writes a block placed in the level, skipped for a chunk read back from a save that already had the level blocks
+	//so whatever the player did to it in an earlier session stays
+	void PlaceLevelBlock(const FIntVector& BlockCoord, FBlockID Block);
+
+	//hits a solid block once on behalf of Instigator, returns true if that broke it
+	bool DamageBlock(const FIntVector& BlockCoord, AActor* Instigator);
+
+	const FBlockDamageMap& GetBlockDamage() const { return BlockDamage; }
+
+	//fires after every block write that changed something, server replication listens to it
+	FOnVoxelBlockChanged& OnBlockChanged() { return BlockChangedEvent; }
+
+	//bulk edits write every block in one pass over the chunks they touch, then relight the whole edit at once,
+	//queue each changed section for remeshing once and fire OnRegionEdited once
+	//blocks in chunks that aren't loaded are left alone, every edit returns how many blocks it changed
+
+	//calls Edit for every block in the box between the corners, inclusive, and writes whatever it returns
+	int32 EditRegion(const FIntVector& Corner, const FIntVector& OppositeCorner, TFunctionRef<FBlockID(const FIntVector& BlockCoord, FBlockID Block)> Edit);
+
+	int32 FillBox(const FIntVector& Corner, const FIntVector& OppositeCorner, FBlockID Block);
+
+	//every block whose center is within Radius blocks of the center of the Center block
+	int32 FillSphere(const FIntVector& Center, int32 Radius, FBlockID Block);
+
+	//turns every block of From's type in the box into To, whatever state it is in, e.g. water of any level
+	int32 ReplaceInBox(const FIntVector& Corner, const FIntVector& OppositeCorner, FBlockID From, FBlockID To);
+
+	//removes the solid blocks within Radius blocks of a world location that a blast of Power overcomes
+	//the blast weakens linearly to nothing at Radius and breaks a block when it is stronger than the block's resistance,
+	//a little noise keeps the crater from being a perfect sphere, the same blast always carves the same crater
+	int32 CarveExplosion(const FVector& Center, float Radius, float Power);
+
+	FOnVoxelRegionEdited& OnRegionEdited() { return RegionEditedEvent; }
+
+	FChunk* FindChunk(const FIntPoint& ChunkCoord);
+	const FChunk* FindChunk(const FIntPoint& ChunkCoord) const;
+
+	FChunk& GetOrCreateChunk(const FIntPoint& ChunkCoord);
+
+	//saves the chunk if it changed since it was loaded, the save is compressed on a worker and written within the streaming budget
+	//placeholders are kept on a server or standalone until their terrain arrives
+	void UnloadChunk(const FIntPoint& ChunkCoord);
+
+	//true on network clients, their chunks come from the server instead of disk or the terrain generator
+	//clients also leave block ticks to the server and never save
+	bool IsNetClient() const { return bIsNetClient; }
+
+	//adds a chunk received from the server, replacing the one already at its coordinate
+	void ApplyReplicatedChunk(TUniquePtr<FChunk> Chunk);
+
+	int32 GetNumChunks() const { return Chunks.Num(); }
+
+	//true if the chunk is loaded with its real terrain, only those take part in block ticks
+	bool IsChunkTickable(const FIntPoint& ChunkCoord) const { return Chunks.Contains(ChunkCoord) && !PlaceholderChunks.Contains(ChunkCoord); }
+
+	//every tickable chunk, in a fixed order so ticks play out the same way every run
+	void GetTickableChunks(TArray<const FChunk*>& OutChunks) const;
+
+	//runs the block's scheduled tick DelaySteps block tick steps from now
+	void ScheduleBlockTick(const FIntVector& BlockCoord, int32 DelaySteps) { BlockTicks.ScheduleTick(BlockCoord, DelaySteps); }
+
+	const FBlockTickScheduler& GetBlockTicks() const { return BlockTicks; }
+
+	//sections released by the remesh throttle since the last reset
+	int32 GetNumThrottledRemeshes() const { return NumThrottledRemeshes; }
+
+	void ResetBlockTickStats() { BlockTicks.ResetStats(); NumThrottledRemeshes = 0; }
+
+	const FVoxelLighting& GetLighting() const { return Lighting; }
+
+	//sky light level in the high nibble, block light in the low one, see FChunkLight
+	//full sky above the world and in unloaded chunks, dark below the world
+	uint8 GetLight(const FIntVector& BlockCoord) const;
+
+	//chunks are streamed in around every source and out once no source is near them any more
+	void AddStreamingSource(AActor* Source);
+	void RemoveStreamingSource(AActor* Source);
+
+	const FVoxelStreamingStats& GetStreamingStats() const { return StreamingStats; }
+
+	//chunks within this many chunks of a source are loaded
+	int32 GetStreamingRadius() const { return StreamingRadius; }
+
+	//what is left of this frame's game thread budget for applying streamed chunks and meshes
+	double GetStreamingBudgetLeft() const { return FMath::Max(0.0, StreamingBudgetMicroseconds * 1.0e-6 - StreamingSecondsThisFrame); }
+
+	//charges work done outside the subsystem, e.g. mesh uploads, to this frame's budget
+	void AddStreamingTime(double Seconds) { StreamingSecondsThisFrame += Seconds; }
+
+	//writes every loaded chunk that changed since it was loaded or last saved
+	void SaveModifiedChunks();
+
+	//queues every section of the chunk, and the bordering sections of its neighbours, for remeshing
+	void MarkChunkDirty(const FIntPoint& ChunkCoord);
+
+	//hands over the sections changed since the last call, as (chunk x, chunk y, section index)
+	void ConsumeDirtySections(TArray<FIntVector>& OutSections);
+
+	//queues the section holding the block, plus any neighbour section that shares a face with it
+	void MarkBlockDirty(const FIntVector& BlockCoord);
+
+	AVoxelWorldRenderer* GetRenderer() const { return Renderer; }
+
+	//memory used by all loaded block data
+	SIZE_T GetAllocatedSize() const;
+
+	//walks the block grid along the ray (Amanatidis-Woo DDA) and stops at the first solid block
+	//no physics scene is involved, OutVisitedChunks receives every chunk the ray passed through
+	bool Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FVoxelHit& OutHit, TArray<FIntPoint, TInlineAllocator<4>>* OutVisitedChunks = nullptr) const;
+
+	//converts between world space and block coordinates
+	FIntVector WorldToBlock(const FVector& WorldLocation) const;
+	FVector BlockToWorld(const FIntVector& BlockCoord) const;
+	FVector GetBlockCenter(const FIntVector& BlockCoord) const { return BlockToWorld(BlockCoord) + FVector(BlockSize * 0.5f); }
+
+	static FIntPoint BlockToChunk(const FIntVector& BlockCoord)
+	{
+		return FIntPoint(BlockCoord.X >> 4, BlockCoord.Y >> 4);
+	}
+
+	static bool IsValidHeight(int32 Z) { return Z >= 0 && Z < FChunk::Height; }
+
+private:
+	struct FStreamingView
+	{
+		//in chunk units
+		FVector2D Location;
+		FVector2D Direction;
+
+		FIntPoint ChunkCoord;
+		int32 YawOctant;
+	};
+
+	struct FPendingChunk
+	{
+		FIntPoint ChunkCoord;
+		float Priority;
+
+		bool operator<(const FPendingChunk& Other) const { return Priority < Other.Priority; }
+	};
+
+	//rebuilds the load queue and the unload list whenever a source moves to another chunk or turns
+	void UpdateStreaming();
+
+	//installs finished chunks, starts loading the most important pending ones and unloads, all within the budget
+	void PumpStreaming();
+
+	enum class EChunkLoadResult : uint8
+	{
+		//read from disk and added to the world
+		Loaded,
+		//handed to the terrain generator
+		Generating,
+		//the generator is full, try again later
+		Refused,
+		//not saved and no terrain generator to make it
+		Unavailable
+	};
+
+	//loads the chunk from disk if it was saved before, otherwise hands it to the terrain generator
+	EChunkLoadResult StartLoadingChunk(const FIntPoint& ChunkCoord);
+
+	//lower is sooner, nearby chunks in front of a source come first
+	float GetStreamingPriority(const FIntPoint& ChunkCoord) const;
+
+	//true if any source is within Radius chunks
+	bool IsNearStreamingSource(const FIntPoint& ChunkCoord, float Radius) const;
+
+	//adds a chunk to the world, replacing any chunk already at its coordinate
+	//with bKeepExistingBlocks the blocks already written there (e.g. placed blocks) win over the new ones
+	void InstallChunk(TUniquePtr<FChunk> NewChunk, bool bKeepExistingBlocks);
+
+	//region file holding the chunk, opened on first use, nullptr if saving is off or the file can't be used
+	FRegionFile* GetRegionFile(const FIntPoint& ChunkCoord, bool bCreate);
+
+	bool SaveChunk(FChunk& Chunk);
+
+	//writes unloaded chunks the workers finished compressing until IsOverBudget says to stop
+	void WriteEncodedChunks(TFunctionRef<bool()> IsOverBudget);
+
+	//relights, remeshes and notifies for the blocks EditRegion wrote into RegionEdit
+	void ApplyRegionEdit(int32 MinZ, int32 MaxZ);
+
+	//schedules every fluid in and next to the block to tick
+	void ScheduleFluidTicksAround(const FIntVector& BlockCoord);
+
+	//true if the chunk or one of its neighbours has fluid anywhere between the heights
+	bool HasFluidNear(const FIntPoint& ChunkCoord, int32 MinZ, int32 MaxZ) const;
+
+	TMap<FIntPoint, TUniquePtr<FChunk>> Chunks;
+
+	//chunks created by a block write before their terrain arrived, still to be loaded or generated
+	TSet<FIntPoint> PlaceholderChunks;
+
+	TSet<FIntVector> DirtySections;
+
+	//dirty sections held back by the remesh throttle, and the world time they were last let through
+	TSet<FIntVector> ThrottledSections;
+	float LastThrottledRemeshTime;
+	int32 NumThrottledRemeshes;
+
+	//true while a throttled write is marking sections dirty
+	bool bThrottlingRemesh;
+
+	//true while a bulk edit is marking sections dirty, it marks runs of blocks in one section so the last one is remembered
+	bool bBulkEditing;
+	FIntVector LastDirtySection;
+
+	UPROPERTY(config)
+	float TickRemeshInterval;
+
+	FBlockDamageMap BlockDamage;
+
+	FOnVoxelBlockChanged BlockChangedEvent;
+
+	FOnVoxelRegionEdited RegionEditedEvent;
+
+	//the bulk edit being applied, kept so the next one doesn't reallocate
+	FVoxelRegionEdit RegionEdit;
+
+	bool bIsNetClient;
+
+	FBlockTickScheduler BlockTicks;
+
+	FVoxelLighting Lighting;
+
+	//block tick steps per second of game time, zero turns block ticks off
+	UPROPERTY(config)
+	float BlockTicksPerSecond;
+
+	//steps run in one frame at most, the world falls behind rather than hitching further
+	UPROPERTY(config)
+	int32 MaxBlockTickStepsPerFrame;
+
+	//cells picked in each non empty section every step
+	UPROPERTY(config)
+	int32 RandomTicksPerSection;
+
+	UPROPERTY(config)
+	int32 MaxScheduledTicksPerStep;
+
+	//seconds a damaged block keeps its progress after the last hit, then seconds per stage it loses
+	UPROPERTY(config)
+	float DamageDecayDelay;
+
+	UPROPERTY(config)
+	float DamageDecayInterval;
+
+	UPROPERTY(Transient)
+	AVoxelWorldRenderer* Renderer;
+
+	//class spawned to draw the chunks, a blueprint subclass can carry the block materials
+	UPROPERTY(config)
+	TSoftClassPtr<AVoxelWorldRenderer> RendererClass;
+
+	//block properties to use instead of the built in ones, loaded before any chunk is generated
+	UPROPERTY(config)
+	TSoftObjectPtr<UBlockRegistryAsset> BlockRegistry;
+
+	//world location of the min corner of block (0, 0, 0)
+	UPROPERTY(config)
+	FVector WorldOrigin;
+
+	TUniquePtr<FTerrainGenerator> TerrainGenerator;
+
+	//open region files by region coordinate
+	TMap<FIntPoint, TUniquePtr<FRegionFile>> RegionFiles;
+
+	//chunks are loaded from and saved to Saved/Worlds/<WorldName>/region
+	UPROPERTY(config)
+	bool bSaveWorld;
+
+	UPROPERTY(config)
+	FString WorldName;
+
+	//chunks in the generator, so nothing is requested twice
+	TSet<FIntPoint> RequestedChunks;
+
+	TArray<TWeakObjectPtr<AActor>> StreamingSources;
+
+	//views the current queues were built for
+	TArray<FStreamingView> StreamingViews;
+
+	//heap of chunks to load, most important on top
+	TArray<FPendingChunk> PendingChunks;
+
+	//loaded chunks that every source has left behind
+	TArray<FIntPoint> PendingUnloads;
+
+	//an unloaded chunk compressed for its region file
+	struct FEncodedChunk
+	{
+		FIntPoint ChunkCoord;
+
+		//empty if it couldn't be encoded
+		TArray<uint8> Buffer;
+	};
+	typedef TQueue<FEncodedChunk, EQueueMode::Mpsc> FEncodedChunkQueue;
+	TSharedPtr<FEncodedChunkQueue, ESPMode::ThreadSafe> EncodedChunks;
+
+	//unloaded chunks not written out yet, and the tasks compressing them
+	TSet<FIntPoint> SavingChunks;
+	FGraphEventArray SaveTasks;
+
+	FVoxelStreamingStats StreamingStats;
+
+	double StreamingSecondsThisFrame;
+
+	//terrain generation settings
+	UPROPERTY(config)
+	bool bGenerateTerrain;
+
+	UPROPERTY(config)
+	int32 TerrainSeed;
+
+	UPROPERTY(config)
+	int32 TerrainBaseHeight;
+
+	UPROPERTY(config)
+	int32 TerrainHeightVariation;
+
+	UPROPERTY(config)
+	float TerrainHillScale;
+
+	//low ground is flooded with still water up to this height, 0 for none
+	UPROPERTY(config)
+	int32 TerrainSeaLevel;
+
+	//chunks within this many chunks of a source are loaded
+	UPROPERTY(config)
+	int32 StreamingRadius;
+
+	//extra chunks past the streaming radius a chunk may be before it is unloaded, stops chunks on the edge from flickering
+	UPROPERTY(config)
+	int32 UnloadHysteresis;
+
+	//game thread time per frame for applying finished chunks and meshes, at least one of each is always applied
+	UPROPERTY(config)
+	float StreamingBudgetMicroseconds;
+
+	UPROPERTY(config)
+	int32 NumTerrainWorkers;
+
+	//how many jobs each pipeline stage may hold before new requests are refused
+	UPROPERTY(config)
+	int32 TerrainQueueCapacity;
+};